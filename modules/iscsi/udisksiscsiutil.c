@@ -157,20 +157,14 @@ iscsi_make_node (struct libiscsi_node *node,
 }
 
 static gint
-iscsi_perform_login_action (UDisksLinuxModuleISCSI     *module,
+iscsi_perform_login_action (struct libiscsi_context    *ctx,
                             libiscsi_login_action       action,
                             struct libiscsi_node       *node,
                             struct libiscsi_auth_info  *auth_info,
                             gchar                     **errorstr)
 {
-  struct libiscsi_context *ctx;
   gint err;
 
-  g_return_val_if_fail (UDISKS_IS_LINUX_MODULE_ISCSI (module), 1);
-
-  /* Get a libiscsi context. */
-  ctx = udisks_linux_module_iscsi_get_libiscsi_context (module);
-
   if (action == ACTION_LOGIN &&
       auth_info && auth_info->method == libiscsi_auth_chap)
     {
@@ -304,11 +298,12 @@ iscsi_login (UDisksLinuxModuleISCSI *module,
   /* Create iscsi node. */
   iscsi_make_node (&node, name, tpgt, address, port, iface);
 
-  /* Get iscsi context. */
+  /* Enter a critical section. */
+  udisks_linux_module_iscsi_lock_libiscsi_context (module);
   ctx = udisks_linux_module_iscsi_get_libiscsi_context (module);
 
   /* Login */
-  err = iscsi_perform_login_action (module,
+  err = iscsi_perform_login_action (ctx,
                                     ACTION_LOGIN,
                                     &node,
                                     &auth_info,
@@ -320,6 +315,9 @@ iscsi_login (UDisksLinuxModuleISCSI *module,
       err = iscsi_node_set_parameters (ctx, &node, params_without_chap);
     }
 
+  /* Leave the critical section. */
+  udisks_linux_module_iscsi_unlock_libiscsi_context (module);
+
   g_variant_unref (params_without_chap);
 
   return err;
@@ -344,11 +342,12 @@ iscsi_logout (UDisksLinuxModuleISCSI *module,
   /* Create iscsi node. */
   iscsi_make_node (&node, name, tpgt, address, port, iface);
 
-  /* Get iscsi context. */
+  /* Enter a critical section. */
+  udisks_linux_module_iscsi_lock_libiscsi_context (module);
   ctx = udisks_linux_module_iscsi_get_libiscsi_context (module);
 
   /* Logout */
-  err = iscsi_perform_login_action (module,
+  err = iscsi_perform_login_action (ctx,
                                     ACTION_LOGOUT,
                                     &node,
                                     NULL,
@@ -361,6 +360,9 @@ iscsi_logout (UDisksLinuxModuleISCSI *module,
 
     }
 
+  /* Leave the critical section. */
+  udisks_linux_module_iscsi_unlock_libiscsi_context (module);
+
   return err;
 }
 
@@ -384,8 +386,6 @@ iscsi_discover_send_targets (UDisksLinuxModuleISCSI *module,
 
   g_return_val_if_fail (UDISKS_IS_LINUX_MODULE_ISCSI (module), 1);
 
-  ctx = udisks_linux_module_iscsi_get_libiscsi_context (module);
-
   /* Optional data for CHAP authentication. */
   iscsi_params_get_chap_data (params,
                               &username,
@@ -400,6 +400,10 @@ iscsi_discover_send_targets (UDisksLinuxModuleISCSI *module,
                         reverse_username,
                         reverse_password);
 
+  /* Enter a critical section. */
+  udisks_linux_module_iscsi_lock_libiscsi_context (module);
+  ctx = udisks_linux_module_iscsi_get_libiscsi_context (module);
+
   /* Discovery */
   err = libiscsi_discover_sendtargets (ctx,
                                        address,
@@ -413,6 +417,9 @@ iscsi_discover_send_targets (UDisksLinuxModuleISCSI *module,
   else if (errorstr)
       *errorstr = g_strdup (libiscsi_get_error_string (ctx));
 
+  /* Leave the critical section. */
+  udisks_linux_module_iscsi_unlock_libiscsi_context (module);
+
   /* Release the resources */
   iscsi_libiscsi_nodes_free (found_nodes);
 
@@ -319,44 +319,90 @@ udisks_linux_iscsi_session_object_get_object_path (UDisksLinuxISCSISessionObject
 }
 
 static void
-udisks_linux_iscsi_session_object_update_iface (UDisksLinuxISCSISessionObject *session_object)
+get_session_info_thread_func (GTask        *task,
+                              gpointer      source_object,
+                              gpointer      task_data,
+                              GCancellable *cancellable)
 {
-  UDisksISCSISession *iface;
+  UDisksLinuxISCSISessionObject *session_object = UDISKS_LINUX_ISCSI_SESSION_OBJECT (source_object);
   struct libiscsi_context *ctx;
-  struct libiscsi_session_info session_info = {0,};
-
-  g_return_if_fail (UDISKS_IS_LINUX_ISCSI_SESSION_OBJECT (session_object));
+  struct libiscsi_session_info *session_info;
+  gint rval;
 
-  ctx = udisks_linux_module_iscsi_get_libiscsi_context (session_object->module);
+  session_info = g_new0 (struct libiscsi_session_info, 1);
 
   /* Enter a critical section. */
   udisks_linux_module_iscsi_lock_libiscsi_context (session_object->module);
+  ctx = udisks_linux_module_iscsi_get_libiscsi_context (session_object->module);
 
   /* Get session info */
-  if (libiscsi_get_session_info_by_id (ctx, &session_info, session_object->session_id) != 0)
+  rval = libiscsi_get_session_info_by_id (ctx, session_info, session_object->session_id);
+
+  /* Leave the critical section. */
+  udisks_linux_module_iscsi_unlock_libiscsi_context (session_object->module);
+
+  if (rval != 0)
     {
-      udisks_linux_module_iscsi_unlock_libiscsi_context (session_object->module);
-      udisks_critical ("Can not retrieve session information for %s", session_object->session_id);
+      g_free (session_info);
+      g_task_return_new_error (task, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                               "Can not retrieve session information for %s",
+                               session_object->session_id);
       return;
     }
 
-  /* Leave the critical section. */
-  udisks_linux_module_iscsi_unlock_libiscsi_context (session_object->module);
+  g_task_return_pointer (task, session_info, g_free);
+}
+
+static void
+on_get_session_info_done (GObject      *source_object,
+                          GAsyncResult *res,
+                          gpointer      user_data)
+{
+  UDisksLinuxISCSISessionObject *session_object = UDISKS_LINUX_ISCSI_SESSION_OBJECT (source_object);
+  UDisksISCSISession *iface;
+  struct libiscsi_session_info *session_info;
+  GError *error = NULL;
+
+  session_info = g_task_propagate_pointer (G_TASK (res), &error);
+  if (session_info == NULL)
+    {
+      udisks_critical ("%s", error->message);
+      g_clear_error (&error);
+      return;
+    }
 
   /* Set properties */
   iface = UDISKS_ISCSI_SESSION (session_object->iface_iscsi_session);
-  udisks_iscsi_session_set_target_name (iface, session_info.targetname);
-  udisks_iscsi_session_set_tpgt (iface, session_info.tpgt);
-  udisks_iscsi_session_set_address (iface, session_info.address);
-  udisks_iscsi_session_set_port (iface, session_info.port);
-  udisks_iscsi_session_set_persistent_address (iface, session_info.persistent_address);
-  udisks_iscsi_session_set_persistent_port (iface, session_info.persistent_port);
-  udisks_iscsi_session_set_abort_timeout (iface, session_info.tmo.abort_tmo);
-  udisks_iscsi_session_set_lu_reset_timeout (iface, session_info.tmo.lu_reset_tmo);
-  udisks_iscsi_session_set_recovery_timeout (iface, session_info.tmo.recovery_tmo);
-  udisks_iscsi_session_set_tgt_reset_timeout (iface, session_info.tmo.tgt_reset_tmo);
+  udisks_iscsi_session_set_target_name (iface, session_info->targetname);
+  udisks_iscsi_session_set_tpgt (iface, session_info->tpgt);
+  udisks_iscsi_session_set_address (iface, session_info->address);
+  udisks_iscsi_session_set_port (iface, session_info->port);
+  udisks_iscsi_session_set_persistent_address (iface, session_info->persistent_address);
+  udisks_iscsi_session_set_persistent_port (iface, session_info->persistent_port);
+  udisks_iscsi_session_set_abort_timeout (iface, session_info->tmo.abort_tmo);
+  udisks_iscsi_session_set_lu_reset_timeout (iface, session_info->tmo.lu_reset_tmo);
+  udisks_iscsi_session_set_recovery_timeout (iface, session_info->tmo.recovery_tmo);
+  udisks_iscsi_session_set_tgt_reset_timeout (iface, session_info->tmo.tgt_reset_tmo);
 
   g_dbus_interface_skeleton_flush (G_DBUS_INTERFACE_SKELETON (iface));
+
+  g_free (session_info);
+}
+
+/* The libiscsi context may be busy with a long login or logout, so the
+ * session information is retrieved in a thread and the properties are
+ * set once it's done rather than blocking the main loop.
+ */
+static void
+udisks_linux_iscsi_session_object_update_iface (UDisksLinuxISCSISessionObject *session_object)
+{
+  GTask *task;
+
+  g_return_if_fail (UDISKS_IS_LINUX_ISCSI_SESSION_OBJECT (session_object));
+
+  task = g_task_new (session_object, NULL, on_get_session_info_done, NULL);
+  g_task_run_in_thread (task, get_session_info_thread_func);
+  g_object_unref (task);
 }
 
 static gboolean
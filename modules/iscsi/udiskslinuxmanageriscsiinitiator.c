@@ -494,15 +494,9 @@ handle_discover_send_targets (UDisksManagerISCSIInitiator *object,
                                      N_("Authentication is required to discover targets"),
                                      invocation);
 
-  /* Enter a critical section. */
-  udisks_linux_module_iscsi_lock_libiscsi_context (manager->module);
-
   /* Perform the discovery. */
   err = iscsi_discover_send_targets (manager->module, arg_address, arg_port, arg_options, &nodes, &nodes_cnt, &errorstr);
 
-  /* Leave the critical section. */
-  udisks_linux_module_iscsi_unlock_libiscsi_context (manager->module);
-
   if (err != 0)
     {
       /* Discovery failed. */
@@ -569,65 +563,52 @@ out:
   return TRUE;
 }
 
+/* Logs in to the node and waits for its objects to appear, can be called from several
+ * threads at once. The libiscsi calls are serialized by the module, only the waiting
+ * overlaps.
+ */
 static gboolean
-handle_login (UDisksManagerISCSIInitiator *object,
-              GDBusMethodInvocation       *invocation,
-              const gchar                 *arg_name,
-              gint                         arg_tpgt,
-              const gchar                 *arg_address,
-              gint                         arg_port,
-              const gchar                 *arg_iface,
-              GVariant                    *arg_options)
+login_and_wait (UDisksLinuxManagerISCSIInitiator  *manager,
+                const gchar                       *name,
+                gint                               tpgt,
+                const gchar                       *address,
+                gint                               port,
+                const gchar                       *iface,
+                GVariant                          *options,
+                GError                           **error)
 {
-  UDisksLinuxManagerISCSIInitiator *manager = UDISKS_LINUX_MANAGER_ISCSI_INITIATOR (object);
   UDisksDaemon *daemon;
   gint err = 0;
   gchar *errorstr = NULL;
-  GError *error = NULL;
   UDisksObject *iscsi_object = NULL;
   UDisksObject *iscsi_session_object = NULL;
+  gboolean ret = FALSE;
 
   daemon = udisks_module_get_daemon (UDISKS_MODULE (manager->module));
 
-  /* Policy check. */
-  UDISKS_DAEMON_CHECK_AUTHORIZATION (daemon,
-                                     NULL,
-                                     ISCSI_MODULE_POLICY_ACTION_ID,
-                                     arg_options,
-                                     N_("Authentication is required to perform iSCSI login"),
-                                     invocation);
-
-  /* Enter a critical section. */
-  udisks_linux_module_iscsi_lock_libiscsi_context (manager->module);
-
   /* Login */
-  err = iscsi_login (manager->module, arg_name, arg_tpgt, arg_address, arg_port, arg_iface, arg_options, &errorstr);
-
-  /* Leave the critical section. */
-  udisks_linux_module_iscsi_unlock_libiscsi_context (manager->module);
-
+  err = iscsi_login (manager->module, name, tpgt, address, port, iface, options, &errorstr);
   if (err != 0)
     {
       /* Login failed. */
-      g_dbus_method_invocation_return_error (invocation,
-                                             UDISKS_ERROR,
-                                             iscsi_error_to_udisks_error (err),
-                                             N_("Login failed: %s"),
-                                             errorstr);
+      g_set_error (error,
+                   UDISKS_ERROR,
+                   iscsi_error_to_udisks_error (err),
+                   N_("Login failed: %s"),
+                   errorstr);
       goto out;
     }
 
   /* sit and wait until the device appears on dbus */
   iscsi_object = udisks_daemon_wait_for_object_sync (daemon,
                                                      wait_for_iscsi_object,
-                                                     g_strdup (arg_name),
+                                                     g_strdup (name),
                                                      g_free,
                                                      UDISKS_DEFAULT_WAIT_TIMEOUT,
-                                                     &error);
-   if (iscsi_object == NULL)
+                                                     error);
+  if (iscsi_object == NULL)
     {
-      g_prefix_error (&error, "Error waiting for iSCSI device to appear: ");
-      g_dbus_method_invocation_take_error (invocation, error);
+      g_prefix_error (error, "Error waiting for iSCSI device to appear: ");
       goto out;
     }
 
@@ -635,26 +616,179 @@ handle_login (UDisksManagerISCSIInitiator *object,
     {
       iscsi_session_object = udisks_daemon_wait_for_object_sync (daemon,
                                                                  wait_for_iscsi_session_object,
-                                                                 g_strdup (arg_name),
+                                                                 g_strdup (name),
                                                                  g_free,
                                                                  UDISKS_DEFAULT_WAIT_TIMEOUT,
-                                                                 &error);
+                                                                 error);
       if (iscsi_session_object == NULL)
         {
-          g_prefix_error (&error, "Error waiting for iSCSI session object to appear: ");
-          g_dbus_method_invocation_take_error (invocation, error);
+          g_prefix_error (error, "Error waiting for iSCSI session object to appear: ");
           goto out;
         }
     }
 
-  /* Complete DBus call. */
-  udisks_manager_iscsi_initiator_complete_login (object, invocation);
+  ret = TRUE;
 
 out:
   g_clear_object (&iscsi_object);
   g_clear_object (&iscsi_session_object);
   g_free (errorstr);
+  return ret;
+}
+
+static gboolean
+handle_login (UDisksManagerISCSIInitiator *object,
+              GDBusMethodInvocation       *invocation,
+              const gchar                 *arg_name,
+              gint                         arg_tpgt,
+              const gchar                 *arg_address,
+              gint                         arg_port,
+              const gchar                 *arg_iface,
+              GVariant                    *arg_options)
+{
+  UDisksLinuxManagerISCSIInitiator *manager = UDISKS_LINUX_MANAGER_ISCSI_INITIATOR (object);
+  UDisksDaemon *daemon;
+  GError *error = NULL;
+
+  daemon = udisks_module_get_daemon (UDISKS_MODULE (manager->module));
+
+  /* Policy check. */
+  UDISKS_DAEMON_CHECK_AUTHORIZATION (daemon,
+                                     NULL,
+                                     ISCSI_MODULE_POLICY_ACTION_ID,
+                                     arg_options,
+                                     N_("Authentication is required to perform iSCSI login"),
+                                     invocation);
+
+  if (! login_and_wait (manager, arg_name, arg_tpgt, arg_address, arg_port, arg_iface, arg_options, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  /* Complete DBus call. */
+  udisks_manager_iscsi_initiator_complete_login (object, invocation);
 
+out:
+  /* Indicate that we handled the method invocation. */
+  return TRUE;
+}
+
+/* Maximal number of nodes LoginNodes() waits for at the same time */
+#define LOGIN_NODES_MAX_PARALLEL 8
+
+typedef struct
+{
+  UDisksLinuxManagerISCSIInitiator *manager;
+  GVariant *options;
+  GMutex lock;
+  GVariantBuilder failed;
+} LoginNodesData;
+
+typedef struct
+{
+  gchar *name;
+  gint tpgt;
+  gchar *address;
+  gint port;
+  gchar *iface;
+} LoginNodesNode;
+
+static void
+login_nodes_worker (gpointer data,
+                    gpointer user_data)
+{
+  LoginNodesNode *node = data;
+  LoginNodesData *login_data = user_data;
+  GError *error = NULL;
+
+  if (! login_and_wait (login_data->manager, node->name, node->tpgt, node->address,
+                        node->port, node->iface, login_data->options, &error))
+    {
+      g_mutex_lock (&login_data->lock);
+      g_variant_builder_add (&login_data->failed, "(sisiss)",
+                             node->name, node->tpgt, node->address, node->port, node->iface,
+                             error->message);
+      g_mutex_unlock (&login_data->lock);
+      g_clear_error (&error);
+    }
+
+  g_free (node->name);
+  g_free (node->address);
+  g_free (node->iface);
+  g_free (node);
+}
+
+static gboolean
+handle_login_nodes (UDisksManagerISCSIInitiator *object,
+                    GDBusMethodInvocation       *invocation,
+                    GVariant                    *arg_nodes,
+                    GVariant                    *arg_options)
+{
+  UDisksLinuxManagerISCSIInitiator *manager = UDISKS_LINUX_MANAGER_ISCSI_INITIATOR (object);
+  UDisksDaemon *daemon;
+  LoginNodesData login_data;
+  GThreadPool *pool;
+  GVariantIter iter;
+  LoginNodesNode *node;
+  gchar *name;
+  gint tpgt;
+  gchar *address;
+  gint port;
+  gchar *iface;
+  GError *error = NULL;
+
+  daemon = udisks_module_get_daemon (UDISKS_MODULE (manager->module));
+
+  /* Policy check. */
+  UDISKS_DAEMON_CHECK_AUTHORIZATION (daemon,
+                                     NULL,
+                                     ISCSI_MODULE_POLICY_ACTION_ID,
+                                     arg_options,
+                                     N_("Authentication is required to perform iSCSI login"),
+                                     invocation);
+
+  login_data.manager = manager;
+  login_data.options = arg_options;
+  g_mutex_init (&login_data.lock);
+  g_variant_builder_init (&login_data.failed, G_VARIANT_TYPE ("a(sisiss)"));
+
+  /* The logins themselves are serialized by the module, the workers wait for the devices in parallel. */
+  pool = g_thread_pool_new (login_nodes_worker,
+                            &login_data,
+                            LOGIN_NODES_MAX_PARALLEL,
+                            FALSE,
+                            &error);
+  if (pool == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      g_variant_builder_clear (&login_data.failed);
+      g_mutex_clear (&login_data.lock);
+      goto out;
+    }
+
+  g_variant_iter_init (&iter, arg_nodes);
+  while (g_variant_iter_next (&iter, "(sisis)", &name, &tpgt, &address, &port, &iface))
+    {
+      node = g_new0 (LoginNodesNode, 1);
+      node->name = name;
+      node->tpgt = tpgt;
+      node->address = address;
+      node->port = port;
+      node->iface = iface;
+      g_thread_pool_push (pool, node, NULL);
+    }
+
+  /* Wait for all the logins to finish. */
+  g_thread_pool_free (pool, FALSE, TRUE);
+  g_mutex_clear (&login_data.lock);
+
+  /* Complete DBus call. */
+  udisks_manager_iscsi_initiator_complete_login_nodes (object,
+                                                       invocation,
+                                                       g_variant_builder_end (&login_data.failed));
+
+out:
   /* Indicate that we handled the method invocation. */
   return TRUE;
 }
@@ -685,15 +819,9 @@ handle_logout(UDisksManagerISCSIInitiator *object,
                                      N_("Authentication is required to perform iSCSI logout"),
                                      invocation);
 
-  /* Enter a critical section. */
-  udisks_linux_module_iscsi_lock_libiscsi_context (manager->module);
-
   /* Logout */
   err = iscsi_logout (manager->module, arg_name, arg_tpgt, arg_address, arg_port, arg_iface, arg_options, &errorstr);
 
-  /* Leave the critical section. */
-  udisks_linux_module_iscsi_unlock_libiscsi_context (manager->module);
-
   if (err != 0)
     {
       /* Logout failed. */
@@ -755,5 +883,6 @@ udisks_linux_manager_iscsi_initiator_iface_init (UDisksManagerISCSIInitiatorIfac
   iface->handle_discover_send_targets = handle_discover_send_targets;
   iface->handle_discover_firmware = handle_discover_firmware;
   iface->handle_login = handle_login;
+  iface->handle_login_nodes = handle_login_nodes;
   iface->handle_logout = handle_logout;
 }
@@ -54,6 +54,9 @@
 struct _UDisksLinuxModuleISCSI {
   UDisksModule parent_instance;
 
+  /* libiscsi keeps process-global state (the iscsid IPC, the config and
+   * sysfs walking helpers), so a single context serializes all the calls
+   */
   GMutex libiscsi_mutex;
   struct libiscsi_context *iscsi_ctx;
 };
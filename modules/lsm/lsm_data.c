@@ -26,8 +26,11 @@
 
 #include <src/udisksdaemon.h>
 #include <src/udisksdaemontypes.h>
+#include <src/udisksdaemonutil.h>
 #include <src/udiskslogging.h>
 #include <src/udisksconfigmanager.h>
+#include <src/udiskslinuxdevice.h>
+#include <src/udiskslinuxdriveobject.h>
 #include <glib.h>
 #include <glib/gprintf.h>
 #include <libconfig.h>
@@ -101,6 +104,27 @@ static GHashTable *_supported_sys_id_hash = NULL;
 static GHashTable *_vpd83_2_lsm_conn_data_hash = NULL;
 static GHashTable *_pl_id_2_lsm_pl_data_hash = NULL;
 static GHashTable *_vpd83_2_lsm_vri_data_hash = NULL;
+static GHashTable *_lsm_conn_2_mutex_hash = NULL;
+static UDisksDaemon *_daemon = NULL;
+
+/*
+ * The lsm connections are used both by the background refresh thread and
+ * the main thread. Each connection has its own mutex (see
+ * _lsm_conn_mutex_get ()) serializing the calls made on it, it is only held
+ * for a single call to the storage array.
+ * _lsm_data_mutex protects the hash tables above and is only held for
+ * short periods of time, never while talking to the storage array.
+ * When both are needed, the connection mutex has to be taken first.
+ * _all_lsm_conn_array and _lsm_conn_2_mutex_hash are only modified
+ * by std_lsm_data_init () and std_lsm_data_teardown ().
+ */
+static GMutex _lsm_data_mutex;
+
+static GThread *_refresh_thread = NULL;
+static GMutex _refresh_mutex;
+static GCond _refresh_cond;
+static gboolean _refresh_stop = FALSE;
+static gboolean _relist_requested = FALSE;
 
 static void _fill_lsm_pl_data (struct _LsmPlData *lsm_pl_data,
                                lsm_pool          *lsm_pl,
@@ -108,6 +132,16 @@ static void _fill_lsm_pl_data (struct _LsmPlData *lsm_pl_data,
 
 static void _free_lsm_uri_set (gpointer data);
 
+static GMutex *
+_lsm_conn_mutex_get (lsm_connect *lsm_conn)
+{
+  GMutex *mutex;
+
+  mutex = g_hash_table_lookup (_lsm_conn_2_mutex_hash, lsm_conn);
+  g_assert (mutex != NULL);
+  return mutex;
+}
+
 static struct _LsmUriSet *
 _lsm_uri_set_new (const char *uri, const char *pass)
 {
@@ -580,8 +614,6 @@ _fill_pl_id_2_lsm_pl_data_hash (GPtrArray *lsm_pl_array,
   struct _LsmPlData *lsm_pl_data = NULL;
   lsm_pool *lsm_pl = NULL;
   const char *pl_id = NULL;
-  const char *orig_pl_id = NULL;
-  struct _LsmPlData *orig_lsm_pl_data = NULL;
   guint i;
 
   for (i = 0; i < lsm_pl_array->len; ++i)
@@ -591,17 +623,12 @@ _fill_pl_id_2_lsm_pl_data_hash (GPtrArray *lsm_pl_array,
       if (pl_id == NULL || strlen (pl_id) == 0)
         continue;
 
-      /* Override old data  */
-      g_hash_table_lookup_extended (_pl_id_2_lsm_pl_data_hash, pl_id,
-                                    (gpointer *) &orig_pl_id,
-                                    (gpointer *) &orig_lsm_pl_data);
-      if (orig_pl_id != NULL)
-        g_hash_table_remove (_pl_id_2_lsm_pl_data_hash, (gconstpointer) orig_pl_id);
-
       lsm_pl_data = (struct _LsmPlData *) g_malloc (sizeof (struct _LsmPlData));
 
       _fill_lsm_pl_data (lsm_pl_data, lsm_pl, last_refresh_time);
-      g_hash_table_insert (_pl_id_2_lsm_pl_data_hash, g_strdup (pl_id), lsm_pl_data);
+
+      /* Override old data  */
+      g_hash_table_replace (_pl_id_2_lsm_pl_data_hash, g_strdup (pl_id), lsm_pl_data);
     }
 }
 
@@ -713,51 +740,24 @@ _fill_lsm_pl_data (struct _LsmPlData *lsm_pl_data, lsm_pool *lsm_pl,
 
 
 /*
- * Refresh _LsmVriData in _vpd83_2_lsm_vri_data_hash for certain VPD83.
- * If volume has been delete, update _vpd83_2_lsm_conn_data_hash also to
- * reflect that.
+ * Query the RAID information of a volume from the storage array.
+ * Must be called with the connection mutex held. Returns NULL on failure
+ * with the lsm error code in out_lsm_rc.
  */
 static struct _LsmVriData *
-_refresh_lsm_vri_data (struct _LsmConnData *lsm_conn_data,
-                       const char          *vpd83)
+_query_lsm_vri_data (lsm_connect *lsm_conn,
+                     lsm_volume  *lsm_vol,
+                     int         *out_lsm_rc)
 {
   struct _LsmVriData *lsm_vri_data = NULL;
-  const char *orig_vpd83 = NULL;
-  struct _LsmVriData *orig_lsm_vri_data = NULL;
-  struct _LsmConnData *orig_lsm_conn_data = NULL;
   lsm_volume_raid_type raid_type;
   uint32_t strip_size, disk_count, min_io_size, opt_io_size;
-  int lsm_rc;
-
-  /* Remove _vpd83_2_lsm_vri_data_hash old entry */
-  g_hash_table_lookup_extended (_vpd83_2_lsm_vri_data_hash, vpd83,
-                                (gpointer *) &orig_vpd83,
-                                (gpointer *) &orig_lsm_vri_data);
-  if (orig_vpd83 != NULL)
-    g_hash_table_remove (_vpd83_2_lsm_vri_data_hash, orig_vpd83);
 
-  lsm_rc = lsm_volume_raid_info (lsm_conn_data->lsm_conn,
-                                 lsm_conn_data->lsm_vol, &raid_type,
-                                 &strip_size, &disk_count, &min_io_size,
-                                 &opt_io_size, LSM_CLIENT_FLAG_RSVD);
-
-  if (lsm_rc != LSM_ERR_OK)
-    {
-      if (lsm_rc == LSM_ERR_NOT_FOUND_VOLUME)
-        udisks_debug ("LSM: Volume %s deleted", vpd83);
-      else
-        udisks_warning ("LSM: Failed to retrieve RAID information of volume");
-
-      /* Remove _vpd83_2_lsm_conn_data_hash entry */
-      g_hash_table_lookup_extended (_vpd83_2_lsm_conn_data_hash, vpd83,
-                                    (gpointer *) &orig_vpd83,
-                                    (gpointer *) &orig_lsm_conn_data);
-
-      if (orig_vpd83 != NULL)
-        g_hash_table_remove (_vpd83_2_lsm_conn_data_hash, orig_vpd83);
-
-      return NULL;
-    }
+  *out_lsm_rc = lsm_volume_raid_info (lsm_conn, lsm_vol, &raid_type,
+                                      &strip_size, &disk_count, &min_io_size,
+                                      &opt_io_size, LSM_CLIENT_FLAG_RSVD);
+  if (*out_lsm_rc != LSM_ERR_OK)
+    return NULL;
 
   lsm_vri_data = (struct _LsmVriData *) g_malloc (sizeof (struct _LsmVriData));
   lsm_vri_data->raid_type_str = g_strdup (_lsm_raid_type_to_str (raid_type));
@@ -766,108 +766,342 @@ _refresh_lsm_vri_data (struct _LsmConnData *lsm_conn_data,
   lsm_vri_data->raid_disk_count = disk_count;
   lsm_vri_data->last_refresh_time = g_get_monotonic_time ();
 
-  g_hash_table_insert (_vpd83_2_lsm_vri_data_hash, g_strdup (vpd83), lsm_vri_data);
-
   return lsm_vri_data;
 }
 
 /*
- * Check _pl_id_2_lsm_pl_data_hash and _vpd83_2_lsm_conn_data_hash hash table
- * to find out the struct _LsmPlData.
- * If data is outdated, try to update it.
+ * Store the result of _query_lsm_vri_data () in _vpd83_2_lsm_vri_data_hash.
+ * If volume has been deleted, update _vpd83_2_lsm_conn_data_hash also to
+ * reflect that. On other errors the last known data is kept.
+ * Must be called with _lsm_data_mutex held, takes ownership of lsm_vri_data.
+ */
+static void
+_store_lsm_vri_data (const char         *vpd83,
+                     struct _LsmVriData *lsm_vri_data,
+                     int                 lsm_rc)
+{
+  if (lsm_vri_data != NULL)
+    {
+      g_hash_table_replace (_vpd83_2_lsm_vri_data_hash, g_strdup (vpd83), lsm_vri_data);
+      return;
+    }
+
+  if (lsm_rc == LSM_ERR_NOT_FOUND_VOLUME)
+    {
+      udisks_debug ("LSM: Volume %s deleted", vpd83);
+      g_hash_table_remove (_vpd83_2_lsm_vri_data_hash, vpd83);
+      g_hash_table_remove (_vpd83_2_lsm_conn_data_hash, vpd83);
+    }
+  else
+    {
+      udisks_warning ("LSM: Failed to retrieve RAID information of volume %s", vpd83);
+    }
+}
+
+/*
+ * Fill struct StdLsmVolData from the cached data, never talks to the array.
+ * Must be called with _lsm_data_mutex held.
+ * If the volume is known but its RAID information was never retrieved,
+ * out_lsm_vol is set to a copy of the volume so that the caller can query it.
  */
-static struct _LsmPlData *
-_lsm_pl_data_lookup (const char *vpd83)
+static struct StdLsmVolData *
+_lsm_vol_data_from_cache (const char   *vpd83,
+                          lsm_connect **out_lsm_conn,
+                          lsm_volume  **out_lsm_vol)
 {
+  struct StdLsmVolData *std_lsm_vol_data = NULL;
   struct _LsmConnData *lsm_conn_data = NULL;
   struct _LsmPlData *lsm_pl_data = NULL;
-  GPtrArray *new_lsm_pl_array = NULL;
-  gint64 current_time = 0;
-  gint64 refresh_interval = 0;
-  const char *orig_pl_id;
-  struct _LsmPlData *orig_lsm_pl_data;
+  struct _LsmVriData *lsm_vri_data = NULL;
 
-  refresh_interval = std_lsm_refresh_time_get ();
+  *out_lsm_conn = NULL;
+  *out_lsm_vol = NULL;
 
   if ((_vpd83_2_lsm_conn_data_hash == NULL) ||
       (_pl_id_2_lsm_pl_data_hash == NULL))
     return NULL;
 
   lsm_conn_data = g_hash_table_lookup (_vpd83_2_lsm_conn_data_hash, vpd83);
-
   if ((lsm_conn_data == NULL) || (lsm_conn_data->pl_id == NULL))
     return NULL;
 
   lsm_pl_data = g_hash_table_lookup (_pl_id_2_lsm_pl_data_hash, lsm_conn_data->pl_id);
-
   if (lsm_pl_data == NULL)
     return NULL;
 
-  current_time = g_get_monotonic_time ();
+  lsm_vri_data = g_hash_table_lookup (_vpd83_2_lsm_vri_data_hash, vpd83);
+  if (lsm_vri_data == NULL)
+    {
+      *out_lsm_conn = lsm_conn_data->lsm_conn;
+      *out_lsm_vol = lsm_volume_record_copy (lsm_conn_data->lsm_vol);
+      return NULL;
+    }
 
-  if ((current_time - lsm_pl_data->last_refresh_time) / 1000000 < refresh_interval)
-    return lsm_pl_data;
+  std_lsm_vol_data = (struct StdLsmVolData *) g_malloc (sizeof (struct StdLsmVolData));
 
-  /* Refresh data is required. */
-  udisks_debug ("LSM: Refreshing Pool(id %s) data", lsm_conn_data->pl_id);
-  new_lsm_pl_array = _get_supported_lsm_pls (lsm_conn_data->lsm_conn, NULL);
-  _fill_pl_id_2_lsm_pl_data_hash (new_lsm_pl_array, current_time);
-  g_ptr_array_unref (new_lsm_pl_array);
+  strncpy (std_lsm_vol_data->raid_type, lsm_vri_data->raid_type_str, _MAX_RAID_TYPE_LEN);
+  std_lsm_vol_data->raid_type[_MAX_RAID_TYPE_LEN - 1] = '\0';
 
-  /* Search again */
-  lsm_pl_data = g_hash_table_lookup (_pl_id_2_lsm_pl_data_hash, lsm_conn_data->pl_id);
+  strncpy (std_lsm_vol_data->status_info, lsm_pl_data->status_info, _MAX_STATUS_INFO_LEN);
 
-  if (_pl_id_2_lsm_pl_data_hash == NULL)
-    /* Normally old data should not be delete yet. */
-    return NULL;
+  std_lsm_vol_data->status_info[_MAX_STATUS_INFO_LEN - 1] = '\0';
+
+  std_lsm_vol_data->is_raid_degraded = lsm_pl_data->is_raid_degraded;
+  std_lsm_vol_data->is_raid_reconstructing = lsm_pl_data->is_raid_reconstructing;
+  std_lsm_vol_data->is_raid_verifying = lsm_pl_data->is_raid_verifying;
+  std_lsm_vol_data->is_raid_error = lsm_pl_data->is_raid_error;
+  std_lsm_vol_data->is_ok = lsm_pl_data->is_ok;
+  std_lsm_vol_data->min_io_size = lsm_vri_data->min_io_size;
+  std_lsm_vol_data->opt_io_size = lsm_vri_data->opt_io_size;
+  std_lsm_vol_data->raid_disk_count = lsm_vri_data->raid_disk_count;
+
+  return std_lsm_vol_data;
+}
+
+/*
+ * _LsmVolRefresh is holding a snapshot of a volume refreshed by the
+ * background thread.
+ */
+struct _LsmVolRefresh
+{
+  char *vpd83;
+  char *pl_id;
+  lsm_volume *lsm_vol;
+  struct _LsmVriData *lsm_vri_data;
+  int lsm_rc;
+};
+
+static void
+_free_lsm_vol_refresh (gpointer data)
+{
+  struct _LsmVolRefresh *vol_refresh = (struct _LsmVolRefresh *) data;
+
+  g_free (vol_refresh->vpd83);
+  g_free (vol_refresh->pl_id);
+  lsm_volume_record_free (vol_refresh->lsm_vol);
+  g_free (vol_refresh);
+}
 
-  if (lsm_pl_data->last_refresh_time != current_time)
+/*
+ * Refresh pool and volume RAID data of all volumes on a connection.
+ * Pools are listed once for the whole connection. The connection mutex is
+ * taken for each query separately so that other users of the connection
+ * only ever wait for a single call.
+ */
+static void
+_refresh_lsm_conn (lsm_connect *lsm_conn)
+{
+  GMutex *conn_mutex = _lsm_conn_mutex_get (lsm_conn);
+  GPtrArray *vol_refreshes;
+  GPtrArray *lsm_pl_array;
+  struct _LsmVolRefresh *vol_refresh;
+  struct _LsmConnData *lsm_conn_data;
+  struct _LsmPlData *lsm_pl_data;
+  GHashTableIter iter;
+  const char *vpd83;
+  gint64 refresh_time;
+  guint i;
+
+  vol_refreshes = g_ptr_array_new_with_free_func (_free_lsm_vol_refresh);
+
+  /* Take a snapshot of the volumes, the hash tables must not be locked while talking to the array. */
+  g_mutex_lock (&_lsm_data_mutex);
+  g_hash_table_iter_init (&iter, _vpd83_2_lsm_conn_data_hash);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &vpd83, (gpointer *) &lsm_conn_data))
+    {
+      if (lsm_conn_data->lsm_conn != lsm_conn)
+        continue;
+      vol_refresh = g_new0 (struct _LsmVolRefresh, 1);
+      vol_refresh->vpd83 = g_strdup (vpd83);
+      vol_refresh->pl_id = g_strdup (lsm_conn_data->pl_id);
+      vol_refresh->lsm_vol = lsm_volume_record_copy (lsm_conn_data->lsm_vol);
+      g_ptr_array_add (vol_refreshes, vol_refresh);
+    }
+  g_mutex_unlock (&_lsm_data_mutex);
+
+  if (vol_refreshes->len == 0)
+    goto out;
+
+  refresh_time = g_get_monotonic_time ();
+  g_mutex_lock (conn_mutex);
+  lsm_pl_array = _get_supported_lsm_pls (lsm_conn, NULL);
+  g_mutex_unlock (conn_mutex);
+  for (i = 0; i < vol_refreshes->len; ++i)
     {
-      udisks_debug ("LSM: _lsm_pl_data_lookup: pool deleted");
+      vol_refresh = g_ptr_array_index (vol_refreshes, i);
+      g_mutex_lock (conn_mutex);
+      vol_refresh->lsm_vri_data = _query_lsm_vri_data (lsm_conn, vol_refresh->lsm_vol,
+                                                       &vol_refresh->lsm_rc);
+      g_mutex_unlock (conn_mutex);
+    }
+
+  g_mutex_lock (&_lsm_data_mutex);
+  if (lsm_pl_array != NULL)
+    _fill_pl_id_2_lsm_pl_data_hash (lsm_pl_array, refresh_time);
+  for (i = 0; i < vol_refreshes->len; ++i)
+    {
+      vol_refresh = g_ptr_array_index (vol_refreshes, i);
+      _store_lsm_vri_data (vol_refresh->vpd83, vol_refresh->lsm_vri_data, vol_refresh->lsm_rc);
 
       /* Pool got deleted, we should delete the old data */
-      g_hash_table_lookup_extended (_pl_id_2_lsm_pl_data_hash,
-                                    lsm_conn_data->pl_id,
-                                    (gpointer *) &orig_pl_id,
-                                    (gpointer *) &orig_lsm_pl_data);
-      if (orig_pl_id != NULL)
-        g_hash_table_remove (_pl_id_2_lsm_pl_data_hash, orig_pl_id);
-      return NULL;
+      if (lsm_pl_array != NULL && vol_refresh->pl_id != NULL)
+        {
+          lsm_pl_data = g_hash_table_lookup (_pl_id_2_lsm_pl_data_hash, vol_refresh->pl_id);
+          if (lsm_pl_data != NULL && lsm_pl_data->last_refresh_time != refresh_time)
+            {
+              udisks_debug ("LSM: Pool %s deleted", vol_refresh->pl_id);
+              g_hash_table_remove (_pl_id_2_lsm_pl_data_hash, vol_refresh->pl_id);
+            }
+        }
     }
-  return lsm_pl_data;
+  g_mutex_unlock (&_lsm_data_mutex);
+
+  if (lsm_pl_array != NULL)
+    g_ptr_array_unref (lsm_pl_array);
+
+out:
+  g_ptr_array_unref (vol_refreshes);
 }
 
 /*
- * Search _vpd83_2_lsm_vri_data_hash, if not found or outdated, update it.
+ * Re-list the volumes and pools of a connection and replace the cached
+ * volume list of that connection. Like _refresh_lsm_conn (), the connection
+ * mutex is only taken for each call to the array and _lsm_data_mutex only
+ * while the results are swapped in afterwards. The VPD 83 of volumes that
+ * were not known before are added to new_vpd83s.
  */
-static struct _LsmVriData *
-_lsm_vri_data_lookup (const char *vpd83)
+static void
+_relist_lsm_conn (lsm_connect *lsm_conn,
+                  GHashTable  *new_vpd83s)
 {
-  struct _LsmConnData *lsm_conn_data = NULL;
-  struct _LsmVriData *lsm_vri_data = NULL;
-  gint64 current_time = 0;
-  gint64 refresh_interval = 0;
+  GMutex *conn_mutex = _lsm_conn_mutex_get (lsm_conn);
+  struct _LsmConnData *lsm_conn_data;
+  GPtrArray *lsm_vol_array;
+  GPtrArray *lsm_pl_array;
+  GHashTableIter iter;
+  const char *vpd83;
+  gint64 refresh_time;
+  guint i;
 
-  refresh_interval = std_lsm_refresh_time_get ();
+  refresh_time = g_get_monotonic_time ();
+  g_mutex_lock (conn_mutex);
+  lsm_vol_array = _get_supported_lsm_volumes (lsm_conn, NULL);
+  g_mutex_unlock (conn_mutex);
+  if (lsm_vol_array == NULL)
+    return;
+  g_mutex_lock (conn_mutex);
+  lsm_pl_array = _get_supported_lsm_pls (lsm_conn, NULL);
+  g_mutex_unlock (conn_mutex);
 
-  if (_vpd83_2_lsm_conn_data_hash == NULL)
-    return NULL;
+  g_mutex_lock (&_lsm_data_mutex);
+  for (i = 0; i < lsm_vol_array->len; ++i)
+    {
+      vpd83 = lsm_volume_vpd83_get (g_ptr_array_index (lsm_vol_array, i));
+      if (g_hash_table_lookup (_vpd83_2_lsm_conn_data_hash, vpd83) == NULL)
+        g_hash_table_add (new_vpd83s, g_strdup (vpd83));
+    }
+  g_hash_table_iter_init (&iter, _vpd83_2_lsm_conn_data_hash);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &lsm_conn_data))
+    if (lsm_conn_data->lsm_conn == lsm_conn)
+      g_hash_table_iter_remove (&iter);
+  if (lsm_pl_array != NULL)
+    _fill_pl_id_2_lsm_pl_data_hash (lsm_pl_array, refresh_time);
+  _fill_vpd83_2_lsm_conn_data_hash (lsm_conn, lsm_vol_array);
+  g_mutex_unlock (&_lsm_data_mutex);
+
+  if (lsm_pl_array != NULL)
+    g_ptr_array_unref (lsm_pl_array);
+  g_ptr_array_unref (lsm_vol_array);
+}
 
-  lsm_conn_data = g_hash_table_lookup (_vpd83_2_lsm_conn_data_hash, vpd83);
+/*
+ * Triggers a change uevent for the drives whose volumes just appeared in the
+ * volume list, so that the module checks them again.
+ */
+static void
+_trigger_drive_uevents (GHashTable *new_vpd83s)
+{
+  UDisksLinuxDevice *device;
+  const gchar *wwn;
+  GList *objects;
+  GList *l;
 
-  if (lsm_conn_data == NULL)
-    return NULL;
+  objects = udisks_daemon_get_objects (_daemon);
+  for (l = objects; l != NULL; l = l->next)
+    {
+      if (! UDISKS_IS_LINUX_DRIVE_OBJECT (l->data))
+        continue;
+      device = udisks_linux_drive_object_get_device (UDISKS_LINUX_DRIVE_OBJECT (l->data), TRUE);
+      if (device == NULL)
+        continue;
 
-  lsm_vri_data = g_hash_table_lookup (_vpd83_2_lsm_vri_data_hash, vpd83);
+      /* udev ID_WWN is started with 0x. */
+      wwn = g_udev_device_get_property (device->udev_device, "ID_WWN_WITH_EXTENSION");
+      if (wwn != NULL && strlen (wwn) >= 2 && g_hash_table_contains (new_vpd83s, wwn + 2))
+        {
+          udisks_debug ("LSM: VPD %s is managed now", wwn + 2);
+          udisks_daemon_util_trigger_uevent (_daemon, NULL, g_udev_device_get_sysfs_path (device->udev_device));
+        }
+      g_object_unref (device);
+    }
+  g_list_free_full (objects, g_object_unref);
+}
+
+/*
+ * Background thread keeping the pool and volume RAID data up to date, so
+ * that lookups from the drive update path never wait for the array.
+ * It also re-lists the volumes when std_lsm_vpd83_list_refresh () asks for it.
+ */
+static gpointer
+_refresh_thread_func (gpointer user_data)
+{
+  lsm_connect *lsm_conn;
+  GHashTable *new_vpd83s;
+  gboolean relist;
+  gboolean refresh;
+  gint64 end_time;
+  guint i;
 
-  current_time = g_get_monotonic_time ();
+  g_mutex_lock (&_refresh_mutex);
+  end_time = g_get_monotonic_time () + (gint64) std_lsm_refresh_time_get () * G_TIME_SPAN_SECOND;
+  while (! _refresh_stop)
+    {
+      while (! _refresh_stop && ! _relist_requested)
+        if (! g_cond_wait_until (&_refresh_cond, &_refresh_mutex, end_time))
+          break;
+      if (_refresh_stop)
+        break;
+      relist = _relist_requested;
+      _relist_requested = FALSE;
+      refresh = g_get_monotonic_time () >= end_time;
+      g_mutex_unlock (&_refresh_mutex);
+
+      new_vpd83s = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      for (i = 0; i < _all_lsm_conn_array->len; ++i)
+        {
+          lsm_conn = g_ptr_array_index (_all_lsm_conn_array, i);
+          if (relist)
+            {
+              udisks_debug ("LSM: Re-listing volumes");
+              _relist_lsm_conn (lsm_conn, new_vpd83s);
+            }
+          if (refresh)
+            {
+              udisks_debug ("LSM: Refreshing pool and volume RAID data");
+              _refresh_lsm_conn (lsm_conn);
+            }
+        }
+      if (g_hash_table_size (new_vpd83s) > 0)
+        _trigger_drive_uevents (new_vpd83s);
+      g_hash_table_unref (new_vpd83s);
 
-  if (lsm_vri_data != NULL && (current_time - lsm_vri_data->last_refresh_time) / 1000000 < refresh_interval)
-    return lsm_vri_data;
+      g_mutex_lock (&_refresh_mutex);
+      if (refresh)
+        end_time = g_get_monotonic_time () + (gint64) std_lsm_refresh_time_get () * G_TIME_SPAN_SECOND;
+    }
+  g_mutex_unlock (&_refresh_mutex);
 
-  /* Refresh data is required. */
-  udisks_debug ("LSM: Refreshing VRI data for %s", vpd83);
-  return _refresh_lsm_vri_data (lsm_conn_data, vpd83);
+  return NULL;
 }
 
 static void
@@ -876,6 +1110,15 @@ _free_lsm_connect (gpointer data)
   lsm_connect_close ((lsm_connect *) data, LSM_CLIENT_FLAG_RSVD);
 }
 
+static void
+_free_lsm_conn_mutex (gpointer data)
+{
+  GMutex *mutex = (GMutex *) data;
+
+  g_mutex_clear (mutex);
+  g_free (mutex);
+}
+
 static void
 _free_lsm_uri_set (gpointer data)
 {
@@ -933,12 +1176,15 @@ std_lsm_data_init (UDisksDaemon  *daemon,
   lsm_connect *lsm_conn = NULL;
   GPtrArray *lsm_vol_array = NULL;
   GPtrArray *lsm_pl_array = NULL;
+  GMutex *conn_mutex;
   guint i = 0;
   gboolean success = FALSE;
 
   if (! _load_module_conf (daemon, error))
     return FALSE;
 
+  _daemon = daemon;
+
   _all_lsm_conn_array = g_ptr_array_new_full (0, (GDestroyNotify) _free_lsm_connect);
 
   _vpd83_2_lsm_conn_data_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
@@ -957,6 +1203,10 @@ std_lsm_data_init (UDisksDaemon  *daemon,
                                                   (GDestroyNotify) g_free,
                                                   NULL);
 
+  _lsm_conn_2_mutex_hash = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                  NULL,
+                                                  (GDestroyNotify) _free_lsm_conn_mutex);
+
   /* fail globally in case none URI can be initialized */
   for (i = 0; i < _conf_lsm_uri_sets->len; ++i)
     {
@@ -991,8 +1241,6 @@ std_lsm_data_init (UDisksDaemon  *daemon,
           lsm_connect_close (lsm_conn, LSM_CLIENT_FLAG_RSVD);
           continue;
         }
-      g_ptr_array_add (_all_lsm_conn_array, lsm_conn);
-
       lsm_vol_array = _get_supported_lsm_volumes (lsm_conn, &local_error);
       if (lsm_vol_array == NULL)
         {
@@ -1007,18 +1255,29 @@ std_lsm_data_init (UDisksDaemon  *daemon,
           lsm_connect_close (lsm_conn, LSM_CLIENT_FLAG_RSVD);
           continue;
         }
+      g_ptr_array_add (_all_lsm_conn_array, lsm_conn);
+      conn_mutex = g_new0 (GMutex, 1);
+      g_mutex_init (conn_mutex);
+      g_hash_table_insert (_lsm_conn_2_mutex_hash, lsm_conn, conn_mutex);
       lsm_pl_array = _get_supported_lsm_pls (lsm_conn, NULL);
 
-      _fill_pl_id_2_lsm_pl_data_hash (lsm_pl_array, g_get_monotonic_time ());
+      if (lsm_pl_array != NULL)
+        {
+          _fill_pl_id_2_lsm_pl_data_hash (lsm_pl_array, g_get_monotonic_time ());
+          g_ptr_array_unref (lsm_pl_array);
+        }
       _fill_vpd83_2_lsm_conn_data_hash (lsm_conn, lsm_vol_array);
       g_ptr_array_unref (lsm_vol_array);
-      g_ptr_array_unref (lsm_pl_array);
 
       success = TRUE;
     }
 
   if (success)
-    g_clear_error (error);
+    {
+      g_clear_error (error);
+      _refresh_stop = FALSE;
+      _refresh_thread = g_thread_new ("lsm-refresh", _refresh_thread_func, NULL);
+    }
 
   return success;
 }
@@ -1037,36 +1296,40 @@ struct StdLsmVolData *
 std_lsm_vol_data_get (const char *vpd83)
 {
   struct StdLsmVolData *std_lsm_vol_data = NULL;
-  struct _LsmPlData *lsm_pl_data = NULL;
   struct _LsmVriData *lsm_vri_data = NULL;
+  lsm_connect *lsm_conn = NULL;
+  lsm_volume *lsm_vol = NULL;
+  GMutex *conn_mutex;
+  int lsm_rc;
 
-  lsm_pl_data = _lsm_pl_data_lookup (vpd83);
-  if (lsm_pl_data == NULL)
-    goto out;
-
-  lsm_vri_data = _lsm_vri_data_lookup (vpd83);
-  if (lsm_vri_data == NULL)
-    goto out;
-
-  std_lsm_vol_data = (struct StdLsmVolData *) g_malloc (sizeof (struct StdLsmVolData));
+  /* Return the last known data, the background thread keeps it fresh. */
+  g_mutex_lock (&_lsm_data_mutex);
+  std_lsm_vol_data = _lsm_vol_data_from_cache (vpd83, &lsm_conn, &lsm_vol);
+  g_mutex_unlock (&_lsm_data_mutex);
 
-  strncpy (std_lsm_vol_data->raid_type, lsm_vri_data->raid_type_str, _MAX_RAID_TYPE_LEN);
-  std_lsm_vol_data->raid_type[_MAX_RAID_TYPE_LEN - 1] = '\0';
+  if (lsm_vol == NULL)
+    return std_lsm_vol_data;
 
-  strncpy (std_lsm_vol_data->status_info, lsm_pl_data->status_info, _MAX_STATUS_INFO_LEN);
+  /* No RAID information retrieved yet for this volume, this only waits
+   * for the current call on the connection, not for a whole refresh. */
+  udisks_debug ("LSM: Retrieving VRI data for %s", vpd83);
+  conn_mutex = _lsm_conn_mutex_get (lsm_conn);
+  g_mutex_lock (conn_mutex);
+  lsm_vri_data = _query_lsm_vri_data (lsm_conn, lsm_vol, &lsm_rc);
+  g_mutex_unlock (conn_mutex);
 
-  std_lsm_vol_data->status_info[_MAX_STATUS_INFO_LEN - 1] = '\0';
+  g_mutex_lock (&_lsm_data_mutex);
+  _store_lsm_vri_data (vpd83, lsm_vri_data, lsm_rc);
+  if (lsm_vri_data != NULL)
+    {
+      lsm_volume_record_free (lsm_vol);
+      std_lsm_vol_data = _lsm_vol_data_from_cache (vpd83, &lsm_conn, &lsm_vol);
+    }
+  g_mutex_unlock (&_lsm_data_mutex);
 
-  std_lsm_vol_data->is_raid_degraded = lsm_pl_data->is_raid_degraded;
-  std_lsm_vol_data->is_raid_reconstructing = lsm_pl_data->is_raid_reconstructing;
-  std_lsm_vol_data->is_raid_verifying = lsm_pl_data->is_raid_verifying;
-  std_lsm_vol_data->is_raid_error = lsm_pl_data->is_raid_error;
-  std_lsm_vol_data->is_ok = lsm_pl_data->is_ok;
-  std_lsm_vol_data->min_io_size = lsm_vri_data->min_io_size;
-  std_lsm_vol_data->opt_io_size = lsm_vri_data->opt_io_size;
-  std_lsm_vol_data->raid_disk_count = lsm_vri_data->raid_disk_count;
+  if (lsm_vol != NULL)
+    lsm_volume_record_free (lsm_vol);
 
-out:
   return std_lsm_vol_data;
 }
 
@@ -1079,6 +1342,16 @@ std_lsm_vol_data_free (struct StdLsmVolData *std_lsm_vol_data)
 void
 std_lsm_data_teardown (void)
 {
+  if (_refresh_thread)
+    {
+      g_mutex_lock (&_refresh_mutex);
+      _refresh_stop = TRUE;
+      g_cond_signal (&_refresh_cond);
+      g_mutex_unlock (&_refresh_mutex);
+      g_thread_join (_refresh_thread);
+      _refresh_thread = NULL;
+    }
+
   if (_conf_lsm_uri_sets)
     {
       g_ptr_array_unref (_conf_lsm_uri_sets);
@@ -1097,6 +1370,12 @@ std_lsm_data_teardown (void)
       _all_lsm_conn_array = NULL;
     }
 
+  if (_lsm_conn_2_mutex_hash)
+    {
+      g_hash_table_unref (_lsm_conn_2_mutex_hash);
+      _lsm_conn_2_mutex_hash = NULL;
+    }
+
   if (_vpd83_2_lsm_conn_data_hash)
     {
       g_hash_table_unref (_vpd83_2_lsm_conn_data_hash);
@@ -1114,51 +1393,36 @@ std_lsm_data_teardown (void)
       g_hash_table_unref (_pl_id_2_lsm_pl_data_hash);
       _pl_id_2_lsm_pl_data_hash = NULL;
     }
+  _daemon = NULL;
 }
 
+/*
+ * Asks the background thread to re-list the volumes of all connections.
+ * This is called from the main thread and does not wait for the arrays.
+ */
 void
 std_lsm_vpd83_list_refresh (void)
 {
-  lsm_connect *lsm_conn = NULL;
-  GPtrArray *lsm_pl_array = NULL;
-  GPtrArray *lsm_vol_array = NULL;
-  guint i;
-
   udisks_debug ("LSM: std_lsm_vpd83_list_refresh ()");
 
-  if (_all_lsm_conn_array == NULL )
+  if (_refresh_thread == NULL)
     return;
 
-  /* free old data:
-   *  _vpd83_2_lsm_conn_data_hash
-   *  _pl_id_2_lsm_pl_data_hash
-   */
-  g_hash_table_remove_all (_vpd83_2_lsm_conn_data_hash);
-  g_hash_table_remove_all (_pl_id_2_lsm_pl_data_hash);
-
-  for (i = 0; i < _all_lsm_conn_array->len; ++i)
-    {
-      lsm_conn = g_ptr_array_index (_all_lsm_conn_array, i);
-      if (lsm_conn == NULL)
-        continue;
-
-      lsm_vol_array = _get_supported_lsm_volumes (lsm_conn, NULL);
-      if (lsm_vol_array == NULL)
-        continue;
-      lsm_pl_array = _get_supported_lsm_pls (lsm_conn, NULL);
-
-      _fill_pl_id_2_lsm_pl_data_hash (lsm_pl_array, g_get_monotonic_time ());
-      _fill_vpd83_2_lsm_conn_data_hash (lsm_conn, lsm_vol_array);
-      g_ptr_array_unref (lsm_vol_array);
-      g_ptr_array_unref (lsm_pl_array);
-    }
+  g_mutex_lock (&_refresh_mutex);
+  _relist_requested = TRUE;
+  g_cond_signal (&_refresh_cond);
+  g_mutex_unlock (&_refresh_mutex);
 }
 
 gboolean
 std_lsm_vpd83_is_managed (const char *vpd83)
 {
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&_lsm_data_mutex);
   if (vpd83 != NULL && _vpd83_2_lsm_conn_data_hash != NULL &&
       g_hash_table_lookup (_vpd83_2_lsm_conn_data_hash, vpd83))
-    return TRUE;
-  return FALSE;
+    ret = TRUE;
+  g_mutex_unlock (&_lsm_data_mutex);
+  return ret;
 }
@@ -63,12 +63,19 @@ gboolean std_lsm_data_init (UDisksDaemon *daemon, GError **error);
  * The cached lsm volume/vpd83 list will not refresh automatically. This is
  * might cause new volume get incorrectly marked as not managed by
  * std_lsm_vol_data_get ().
- * This method is used to manually refresh that cache.
+ * This method asks the background thread to refresh that cache and returns
+ * right away. Drives whose volumes show up in the new list get a change
+ * uevent, so that they are checked again.
  */
 void std_lsm_vpd83_list_refresh (void);
 
 void std_lsm_data_teardown (void);
 
+/*
+ * Returns the last known data for given VPD83 without waiting for the storage
+ * array, the data is refreshed by a background thread every
+ * std_lsm_refresh_time_get () seconds.
+ */
 struct StdLsmVolData *std_lsm_vol_data_get (const char *vpd83);
 
 void std_lsm_vol_data_free (struct StdLsmVolData *std_lsm_vol_data);
@@ -177,13 +177,9 @@ udisks_linux_module_lsm_drive_check (UDisksLinuxModuleLSM   *module,
   is_managed = std_lsm_vpd83_is_managed (wwn + 2);
   if (is_managed == FALSE)
     {
-      /* Refresh and try again. */
+      /* The volume may be new, the drive gets a change uevent once the
+       * refreshed list contains it. */
       std_lsm_vpd83_list_refresh ();
-      is_managed = std_lsm_vpd83_is_managed (wwn + 2);
-    }
-
-  if (is_managed == FALSE)
-    {
       udisks_debug ("LSM: VPD %s is not managed by LibstorageMgmt", wwn + 2);
       goto out;
     }
@@ -70,6 +70,7 @@ BuildRequires: libblockdev-fs-devel     >= %{libblockdev_version}
 BuildRequires: libblockdev-crypto-devel >= %{libblockdev_version}
 BuildRequires: libblockdev-nvme-devel   >= %{libblockdev_version}
 BuildRequires: libmount-devel
+BuildRequires: cryptsetup-devel
 BuildRequires: libuuid-devel
 
 Requires: libblockdev        >= %{libblockdev_version}
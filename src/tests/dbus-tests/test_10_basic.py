@@ -127,6 +127,22 @@ class UdisksBaseTest(udiskstestcase.UdisksTestCase):
             else:
                 self.assertGreater(len(util), 0)
 
+    def test_40_format_profiles(self):
+        '''Test for the options of format profiles with GetFormatProfiles'''
+        manager = self.get_interface(self.manager_obj, '.Manager')
+        with self.assertRaises(dbus.exceptions.DBusException):
+            manager.GetFormatProfiles('wxyz', self.no_options)
+        for fs in map(str, self.get_property(self.manager_obj, '.Manager', 'SupportedFilesystems').value):
+            profiles = manager.GetFormatProfiles(fs, self.no_options)
+            self.assertEqual(set(profiles.keys()), {'default', 'fast', 'thorough'})
+            self.assertEqual(profiles['default'], '')
+        # built-in mappings, unless overridden in udisks2.conf
+        profiles = manager.GetFormatProfiles('ext4', self.no_options)
+        self.assertIn('lazy_itable_init=1', profiles['fast'])
+        self.assertIn('lazy_itable_init=0', profiles['thorough'])
+        profiles = manager.GetFormatProfiles('xfs', self.no_options)
+        self.assertEqual(profiles['fast'], '-K')
+
     def test_40_can_resize(self):
         '''Test for installed filesystem resize utility with CanResize'''
         offline_shrink = 0b00010
@@ -217,6 +233,25 @@ class UdisksBaseTest(udiskstestcase.UdisksTestCase):
         for path in block_paths:
             self.assertIn(path, dbus_blocks)
 
+    def test_55_authorization_statistics(self):
+        manager = self.get_interface(self.manager_obj, '.Manager')
+        keys = ('credential-hits', 'credential-misses', 'authorization-hits', 'authorization-misses')
+
+        stats = manager.GetAuthorizationStatistics(self.no_options)
+        self.assertEqual(sorted(stats.keys()), sorted(keys))
+
+        # loop setup needs the caller uid and an authorization check,
+        # repeated calls on the same connection should hit the caches
+        for _i in range(2):
+            with open(self.vdevs[0], 'rb') as f:
+                self.assertRaises(dbus.exceptions.DBusException, manager.LoopSetup,
+                                  f.fileno(), dbus.Dictionary({'sector-size': dbus.UInt32(1000)}, signature='sv'))
+
+        new_stats = manager.GetAuthorizationStatistics(self.no_options)
+        for key in keys:
+            self.assertGreaterEqual(new_stats[key], stats[key])
+        self.assertGreater(new_stats['credential-hits'], stats['credential-hits'])
+
     def _wipe(self, device, retry=True):
         ret, out = self.run_command('wipefs -a %s' % device)
         if ret != 0:
@@ -124,6 +124,39 @@ class UdisksISCSITest(udiskstestcase.UdisksTestCase):
         objects = udisks.GetManagedObjects(dbus_interface='org.freedesktop.DBus.ObjectManager')
         self.assertNotIn(dbus_path, objects.keys())
 
+    def test_login_nodes(self):
+        manager = self.get_object('/Manager')
+        nodes, _ = manager.DiscoverSendTargets(self.address, self.port, self.no_options,
+                                               dbus_interface=self.iface_prefix + '.Manager.ISCSI.Initiator',
+                                               timeout=self.iscsi_timeout)
+
+        node = next((node for node in nodes if node[0] == self.noauth_iqn), None)
+        self.assertIsNotNone(node)
+        (iqn, tpg, host, port, iface) = node
+
+        # CHAP node fails without credentials, the other login must not be affected
+        chap_node = next((node for node in nodes if node[0] == self.chap_iqn), None)
+        self.assertIsNotNone(chap_node)
+
+        self.addCleanup(self._force_lougout, self.noauth_iqn)
+        self.addCleanup(self._force_lougout, self.chap_iqn)
+        failed = manager.LoginNodes([node, chap_node], self.no_options,
+                                    dbus_interface=self.iface_prefix + '.Manager.ISCSI.Initiator',
+                                    timeout=self.iscsi_timeout)
+        self.assertEqual(len(failed), 1)
+        self.assertEqual(failed[0][0], self.chap_iqn)
+        self.assertIn('Login failed', failed[0][5])
+
+        devs = glob.glob('/dev/disk/by-path/*%s*' % iqn)
+        self.assertEqual(len(devs), 1)
+
+        manager.Logout(iqn, tpg, host, port, iface, self.no_options,
+                       dbus_interface=self.iface_prefix + '.Manager.ISCSI.Initiator',
+                       timeout=self.iscsi_timeout)
+
+        devs = glob.glob('/dev/disk/by-path/*%s*' % iqn)
+        self.assertEqual(len(devs), 0)
+
     def test_login_chap_auth(self):
         self._set_initiator_name()  # set initiator name to the one set in targetcli config
 
@@ -81,6 +81,18 @@ class UdisksDriveTest(udiskstestcase.UdisksTestCase):
         conf_value.assertIsNotNone()
         self.assertEqual(int(conf_value.value['ata-pm-standby']), 286)
 
+        # changes made to the config file directly have to be picked up too
+        drive_id = self.get_property_raw(self.cd_drive, '.Drive', 'Id')
+        conf_file = os.path.join('/etc/udisks2', '%s.conf' % drive_id)
+        self.addCleanup(self.remove_file, conf_file, True)
+        self.write_file(conf_file, '[ATA]\nStandbyTimeout=42\n')
+        conf_value = self.get_property(self.cd_drive, '.Drive', 'Configuration')
+        conf_value.assertEqual(42, getter=lambda c: int(c.get('ata-pm-standby', 0)))
+
+        os.unlink(conf_file)
+        conf_value = self.get_property(self.cd_drive, '.Drive', 'Configuration')
+        conf_value.assertEqual(False, getter=lambda c: 'ata-pm-standby' in (c or {}))
+
     def test_40_properties(self):
         ''' Test of Drive properties values '''
 
@@ -3,6 +3,8 @@ import dbus
 import glob
 import fcntl
 import os
+import six
+import tempfile
 import time
 import unittest
 
@@ -75,6 +77,39 @@ class UdisksBlockTest(udiskstestcase.UdisksTestCase):
         _ret, sys_fstype = self.run_command('lsblk -d -no FSTYPE %s' % self.vdevs[0])
         self.assertEqual(sys_fstype, '')
 
+    def test_format_stage_statistics(self):
+        disk = self.get_object('/block_devices/' + os.path.basename(self.vdevs[0]))
+        self.assertIsNotNone(disk)
+
+        manager = self.get_interface(self.get_object('/Manager'), '.Manager')
+        stats = manager.GetStageStatistics(self.no_options)
+
+        disk.Format('xfs', self.no_options, dbus_interface=self.iface_prefix + '.Block')
+        self.addCleanup(self.wipe_fs, self.vdevs[0])
+
+        # every Format() records at least the wipe and mkfs stages
+        new_stats = manager.GetStageStatistics(self.no_options)
+        for stage in ('format:wipe', 'format:wipe-sync', 'format:mkfs', 'format:mkfs-sync'):
+            self.assertIn(stage, new_stats)
+            count, total, buckets = new_stats[stage]
+            old_count = stats[stage][0] if stage in stats else 0
+            self.assertEqual(count, old_count + 1)
+            self.assertEqual(sum(buckets), count)
+
+    def test_format_profile(self):
+        disk = self.get_object('/block_devices/' + os.path.basename(self.vdevs[0]))
+        self.assertIsNotNone(disk)
+
+        msg = 'Unknown format profile'
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, msg):
+            disk.Format('ext4', {'format-profile': 'bogus'}, dbus_interface=self.iface_prefix + '.Block')
+
+        disk.Format('ext4', {'format-profile': 'fast'}, dbus_interface=self.iface_prefix + '.Block')
+        self.addCleanup(self.wipe_fs, self.vdevs[0])
+
+        fstype = self.get_property(disk, '.Block', 'IdType')
+        fstype.assertEqual('ext4')
+
     def test_format_parttype(self):
 
         disk = self.get_object('/block_devices/' + os.path.basename(self.vdevs[0]))
@@ -349,6 +384,106 @@ class UdisksBlockTest(udiskstestcase.UdisksTestCase):
         self.assertIsNotNone(sec_conf)
         self.assertEqual(sec_conf[0][1]['passphrase-path'], self.str_to_ay(''))
 
+    def test_copy(self):
+        disk = self.get_object('/block_devices/' + os.path.basename(self.vdevs[0]))
+        disk.Format('xfs', self.no_options, dbus_interface=self.iface_prefix + '.Block')
+        self.addCleanup(self.wipe_fs, self.vdevs[0])
+
+        # backup into a sparse image file
+        image = tempfile.NamedTemporaryFile(prefix='udisks_test', delete=False)
+        self.addCleanup(os.remove, image.name)
+        disk.Copy(dbus.types.UnixFd(image.fileno()), self.no_options,
+                  dbus_interface=self.iface_prefix + '.Block')
+        image.close()
+
+        ret, _out = self.run_command('cmp %s %s' % (self.vdevs[0], image.name))
+        self.assertEqual(ret, 0)
+        st = os.stat(image.name)
+        self.assertLess(st.st_blocks * 512, st.st_size)
+
+        # restore the image onto another device
+        target = self.get_object('/block_devices/' + os.path.basename(self.vdevs[1]))
+        self.addCleanup(self.wipe_fs, self.vdevs[1])
+        d = dbus.Dictionary(signature='sv')
+        d['direction'] = 'restore'
+        with open(image.name, 'rb') as f:
+            target.Copy(dbus.types.UnixFd(f.fileno()), d,
+                        dbus_interface=self.iface_prefix + '.Block')
+
+        _ret, sys_fstype = self.run_command('lsblk -d -no FSTYPE %s' % self.vdevs[1])
+        self.assertEqual(sys_fstype, 'xfs')
+        ret, _out = self.run_command('cmp -n %d %s %s' % (st.st_size, self.vdevs[1], image.name))
+        self.assertEqual(ret, 0)
+
+        # clone the device directly, without skipping zeroes
+        self.wipe_fs(self.vdevs[1])
+        d = dbus.Dictionary(signature='sv')
+        d['sparse'] = False
+        d['queue-depth'] = dbus.UInt32(2)
+        disk.Clone(target.object_path, d, dbus_interface=self.iface_prefix + '.Block')
+        ret, _out = self.run_command('cmp -n %d %s %s' % (st.st_size, self.vdevs[0], self.vdevs[1]))
+        self.assertEqual(ret, 0)
+
+        # invalid options and targets
+        d = dbus.Dictionary(signature='sv')
+        d['direction'] = 'sideways'
+        msg = 'Unknown copy direction sideways'
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, msg):
+            disk.Copy(dbus.types.UnixFd(0), d, dbus_interface=self.iface_prefix + '.Block')
+
+        msg = 'Cannot clone a device onto itself'
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, msg):
+            disk.Clone(disk.object_path, self.no_options, dbus_interface=self.iface_prefix + '.Block')
+
+    def test_benchmark(self):
+        disk = self.get_object('/block_devices/' + os.path.basename(self.vdevs[0]))
+        self.assertIsNotNone(disk)
+
+        d = dbus.Dictionary(signature='sv')
+        d['num-samples'] = dbus.UInt32(4)
+        d['sample-size'] = dbus.UInt64(1024**2)
+        d['access-time-samples'] = dbus.UInt32(50)
+        d['queue-depths'] = dbus.Array([dbus.UInt32(1), dbus.UInt32(4)], signature='u')
+        d['random-ios'] = dbus.UInt32(200)
+        d['writable'] = True
+        result = disk.Benchmark(d, dbus_interface=self.iface_prefix + '.Block')
+
+        self.assertGreater(result['read-rate'], 0)
+        self.assertGreater(result['write-rate'], 0)
+        mean, p50, p99, maximum = result['access-time']
+        self.assertLessEqual(p50, p99)
+        self.assertLessEqual(p99, maximum)
+        self.assertEqual([r[0] for r in result['random-read']], [1, 4])
+        for _depth, iops, _mean, p50, p99, maximum in result['random-read']:
+            self.assertGreater(iops, 0)
+            self.assertLessEqual(p50, maximum)
+
+        last = self.get_property_raw(disk, '.Block', 'LastBenchmark')
+        self.assertEqual(last['time'], result['time'])
+
+        # only the access time
+        d = dbus.Dictionary(signature='sv')
+        d['num-samples'] = dbus.UInt32(0)
+        d['random-ios'] = dbus.UInt32(0)
+        d['access-time-samples'] = dbus.UInt32(10)
+        result = disk.Benchmark(d, dbus_interface=self.iface_prefix + '.Block')
+        self.assertIn('access-time', result)
+        self.assertNotIn('read-rate', result)
+        self.assertNotIn('random-read', result)
+
+        d = dbus.Dictionary(signature='sv')
+        d['queue-depths'] = dbus.Array([dbus.UInt32(0)], signature='u')
+        msg = 'Queue depths have to be between'
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, msg):
+            disk.Benchmark(d, dbus_interface=self.iface_prefix + '.Block')
+
+        # huge samples are rejected before allocating anything
+        d = dbus.Dictionary(signature='sv')
+        d['sample-size'] = dbus.UInt64(1024**3)
+        msg = 'org.freedesktop.UDisks2.Error.OptionNotPermitted'
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, msg):
+            disk.Benchmark(d, dbus_interface=self.iface_prefix + '.Block')
+
     def test_rescan(self):
 
         disk = self.get_object('/block_devices/' + os.path.basename(self.vdevs[0]))
@@ -330,6 +330,85 @@ class UdisksPartitionTableTest(udiskstestcase.UdisksTestCase):
         _ret, sys_fstype = self.run_command('lsblk -d -no FSTYPE /dev/%s' % part_name)
         self.assertEqual(sys_fstype, 'xfs')
 
+    def test_create_partitions(self):
+        disk = self.get_object('/block_devices/' + os.path.basename(self.vdevs[0]))
+        self.assertIsNotNone(disk)
+
+        # create gpt partition table
+        self._create_format(disk, 'gpt')
+
+        self.addCleanup(self._remove_format, disk)
+
+        layout = [(dbus.UInt64(1024**2), dbus.UInt64(50 * 1024**2), '', 'first',
+                   dbus.Dictionary({'format-type': 'ext4', 'format-label': 'data'}, signature='sv')),
+                  (dbus.UInt64(51 * 1024**2), dbus.UInt64(50 * 1024**2), '', 'second',
+                   dbus.Dictionary(signature='sv'))]
+        paths = disk.CreatePartitions(dbus.Array(layout, signature='(ttssa{sv})'), self.no_options,
+                                      dbus_interface=self.iface_prefix + '.PartitionTable')
+        self.assertEqual(len(paths), 2)
+
+        parts = [self.bus.get_object(self.iface_prefix, path) for path in paths]
+        for part in parts:
+            self.addCleanup(self._remove_partition, part)
+        self.addCleanup(self._remove_format, parts[0])
+
+        # partitions are returned in the order of the layout
+        offset = self.get_property(parts[0], '.Partition', 'Offset')
+        offset.assertEqual(1024**2)
+        offset = self.get_property(parts[1], '.Partition', 'Offset')
+        offset.assertEqual(51 * 1024**2)
+
+        name = self.get_property(parts[1], '.Partition', 'Name')
+        name.assertEqual('second')
+
+        fstype = self.get_property(parts[0], '.Block', 'IdType')
+        fstype.assertEqual('ext4')
+        label = self.get_property(parts[0], '.Block', 'IdLabel')
+        label.assertEqual('data')
+
+        # the table lists all the new partitions
+        dbus_parts = self.get_property(disk, '.PartitionTable', 'Partitions')
+        dbus_parts.assertLen(2)
+
+        # invalid layouts are rejected before touching the disk
+        layout = [(dbus.UInt64(101 * 1024**2), dbus.UInt64(10 * 1024**2), '', '',
+                   dbus.Dictionary({'format-type': 'definitely-not-a-fs'}, signature='sv'))]
+        msg = 'Creation of file system type definitely-not-a-fs is not supported'
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, msg):
+            disk.CreatePartitions(dbus.Array(layout, signature='(ttssa{sv})'), self.no_options,
+                                  dbus_interface=self.iface_prefix + '.PartitionTable')
+        dbus_parts = self.get_property(disk, '.PartitionTable', 'Partitions')
+        dbus_parts.assertLen(2)
+
+        # overlaps with existing partitions or within the layout are rejected too
+        layout = [(dbus.UInt64(30 * 1024**2), dbus.UInt64(10 * 1024**2), '', '',
+                   dbus.Dictionary(signature='sv'))]
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, 'overlaps with existing partition'):
+            disk.CreatePartitions(dbus.Array(layout, signature='(ttssa{sv})'), self.no_options,
+                                  dbus_interface=self.iface_prefix + '.PartitionTable')
+        layout = [(dbus.UInt64(101 * 1024**2), dbus.UInt64(10 * 1024**2), '', '',
+                   dbus.Dictionary(signature='sv')),
+                  (dbus.UInt64(105 * 1024**2), dbus.UInt64(10 * 1024**2), '', '',
+                   dbus.Dictionary(signature='sv'))]
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, 'overlaps with partition 0'):
+            disk.CreatePartitions(dbus.Array(layout, signature='(ttssa{sv})'), self.no_options,
+                                  dbus_interface=self.iface_prefix + '.PartitionTable')
+        dbus_parts = self.get_property(disk, '.PartitionTable', 'Partitions')
+        dbus_parts.assertLen(2)
+
+        # partitions created by a failed call are removed again, xfs labels
+        # are limited to 12 characters (the partition is big enough for xfs
+        # so that only the label makes mkfs fail)
+        layout = [(dbus.UInt64(101 * 1024**2), dbus.UInt64(10 * 1024**2), '', '',
+                   dbus.Dictionary(signature='sv')),
+                  (dbus.UInt64(111 * 1024**2), dbus.UInt64(320 * 1024**2), '', '',
+                   dbus.Dictionary({'format-type': 'xfs', 'format-label': 'a' * 20}, signature='sv'))]
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, 'Partition 1: Error creating file system'):
+            disk.CreatePartitions(dbus.Array(layout, signature='(ttssa{sv})'), self.no_options,
+                                  dbus_interface=self.iface_prefix + '.PartitionTable')
+        dbus_parts = self.get_property(disk, '.PartitionTable', 'Partitions')
+        dbus_parts.assertLen(2)
+
     def _have_udftools(self):
         ret, _out = self.run_command('type mkudffs')
         return ret == 0
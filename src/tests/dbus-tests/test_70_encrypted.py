@@ -611,6 +611,100 @@ class UdisksEncryptedTestLUKS2(UdisksEncryptedTest):
         default_encryption_type = self.get_property(manager, '.Manager', 'DefaultEncryptionType')
         default_encryption_type.assertEqual(config['defaults']['encryption'])
 
+    def test_benchmark(self):
+        manager = self.get_object('/Manager')
+
+        options = dbus.Dictionary(signature='sv')
+        options['pbkdf-time'] = dbus.UInt32(100)
+        ciphers, pbkdfs = manager.BenchmarkEncryption(options, dbus_interface=self.iface_prefix + '.Manager',
+                                                      timeout=120)
+
+        # aes-xts-plain64 is the cryptsetup default and always available
+        aes = [c for c in ciphers if c[0] == 'aes-xts-plain64' and c[1] == 512]
+        self.assertEqual(len(aes), 1)
+        self.assertGreater(aes[0][2], 0)
+        self.assertGreater(aes[0][3], 0)
+
+        pbkdf2 = [p for p in pbkdfs if p[0] == 'pbkdf2-sha256']
+        self.assertEqual(len(pbkdf2), 1)
+        self.assertGreater(pbkdf2[0][1], 0)
+        self.assertEqual(pbkdf2[0][2], 0)
+
+        # zero unlock time makes no sense
+        options['pbkdf-time'] = dbus.UInt32(0)
+        msg = 'org.freedesktop.UDisks2.Error.Failed: The pbkdf-time option must be greater than 0'
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, msg):
+            manager.BenchmarkEncryption(options, dbus_interface=self.iface_prefix + '.Manager')
+
+    def _get_flags_from_dump(self, disk):
+        ret, out = self.run_command("cryptsetup luksDump %s" % disk)
+        if ret != 0:
+            self.fail("Failed to get LUKS 2 information from '%s':\n%s" % (disk, out))
+
+        m = re.search(r"Flags:\s*(.*)", out)
+        if m is None:
+            self.fail("Failed to get LUKS 2 flags using 'cryptsetup luksDump %s'" % disk)
+        return m.group(1).split()
+
+    def test_performance_options(self):
+        passwd = 'test'
+
+        cryptsetup_version = _get_cryptsetup_version()
+        if cryptsetup_version < Version('2.3.4'):
+            self.skipTest('Workqueue flags not supported by cryptsetup < 2.3.4')
+
+        device = self.get_device(self.vdevs[0])
+
+        # sector size has to be a power of two between 512 and 4096
+        options = dbus.Dictionary(signature='sv')
+        options['encrypt.passphrase'] = passwd
+        options['encrypt.type'] = 'luks2'
+        options['encrypt.sector-size'] = dbus.UInt32(1000)
+        msg = 'org.freedesktop.UDisks2.Error.Failed: Invalid encryption sector size'
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, msg):
+            device.Format('xfs', options, dbus_interface=self.iface_prefix + '.Block')
+
+        options['encrypt.sector-size'] = dbus.UInt32(4096)
+        options['encrypt.allow-discards'] = True
+        options['encrypt.no-read-workqueue'] = True
+        device.Format('xfs', options, dbus_interface=self.iface_prefix + '.Block')
+        self.addCleanup(self._remove_luks, device)
+        self.udev_settle()
+
+        ret, out = self.run_command("cryptsetup luksDump %s" % self.vdevs[0])
+        self.assertEqual(ret, 0)
+        self.assertRegex(out, r"sector:\s*4096 \[bytes\]")
+        flags = self._get_flags_from_dump(self.vdevs[0])
+        self.assertIn('allow-discards', flags)
+        self.assertIn('no-read-workqueue', flags)
+
+        device.Lock(self.no_options, dbus_interface=self.iface_prefix + '.Encrypted')
+
+        # flags given to Unlock are only used for the activation, the stored
+        # ones are used as well unless disabled
+        options = dbus.Dictionary(signature='sv')
+        options['no-write-workqueue'] = True
+        options['allow-discards'] = False
+        device.Unlock(passwd, options, dbus_interface=self.iface_prefix + '.Encrypted')
+        flags = self._get_flags_from_dump(self.vdevs[0])
+        self.assertEqual(sorted(flags), ['allow-discards', 'no-read-workqueue'])
+
+        luks_uuid = self.get_property_raw(device, '.Block', 'IdUUID')
+        ret, out = self.run_command('dmsetup table luks-%s' % luks_uuid)
+        self.assertEqual(ret, 0)
+        self.assertIn('no_read_workqueue', out)
+        self.assertIn('no_write_workqueue', out)
+        self.assertNotIn('allow_discards', out)
+
+        device.Lock(self.no_options, dbus_interface=self.iface_prefix + '.Encrypted')
+
+        # flags can be used when unlocking read-only too
+        options['read-only'] = True
+        device.Unlock(passwd, options, dbus_interface=self.iface_prefix + '.Encrypted')
+        device.Lock(self.no_options, dbus_interface=self.iface_prefix + '.Encrypted')
+
+        device.Unlock(passwd, self.no_options, dbus_interface=self.iface_prefix + '.Encrypted')
+
     @udiskstestcase.tag_test(udiskstestcase.TestTags.UNSTABLE)
     def test_integrity(self):
         passwd = 'test'
@@ -961,6 +961,29 @@ class Ext4TestCase(Ext2TestCase):
         self.assertEqual(sys_stat.st_uid, int(uid))
         self.assertEqual(sys_stat.st_gid, int(gid))
 
+        # wide and deep tree, more directories than are handed over between the walker threads
+        paths = []
+        for i in range(300):
+            path = os.path.join(mnt_path, 'wide%d' % i)
+            os.mkdir(path)
+            paths.append(path)
+        path = mnt_path
+        for i in range(50):
+            path = os.path.join(path, 'deep%d' % i)
+            os.mkdir(path)
+            paths.append(path)
+            paths.append(os.path.join(path, fname))
+            os.mknod(paths[-1])
+        for path in paths:
+            os.lchown(path, int(uid), int(gid))
+
+        disk.TakeOwnership(d, dbus_interface=self.iface_prefix + '.Filesystem')
+
+        for path in paths:
+            sys_stat = os.lstat(path)
+            self.assertEqual(sys_stat.st_uid, 0)
+            self.assertEqual(sys_stat.st_gid, 0)
+
 
 class XFSTestCase(UdisksFSTestCase):
     _fs_name = 'xfs'
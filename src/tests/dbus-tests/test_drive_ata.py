@@ -213,3 +213,119 @@ class UdisksDriveAtaTest(udiskstestcase.UdisksTestCase):
             updated = self.get_property(drive_obj, ".Drive.Ata", "SmartUpdated")
             updated.assertTrue()
             self.assertGreater(int(updated.value), orig)
+
+    @unittest.skipUnless(smart_supported, "No disks supporting S.M.A.R.T. available")
+    def test_smart_batch_update(self):
+        manager = self.get_object("/Manager")
+        drive_paths = []
+        orig = dict()
+        for disk in smart_supported:
+            drive_name = self.get_drive_name(self.get_device(disk))
+            drive_obj = self.get_object("/drives/%s" % drive_name)
+            drive_paths.append(drive_obj.object_path)
+            orig[drive_obj.object_path] = int(self.get_property_raw(drive_obj, ".Drive.Ata", "SmartUpdated"))
+
+        # not an ATA drive
+        drive_paths.append(self.path_prefix + "/Manager")
+
+        # wait at least a second so that the timestamps have a chance to change
+        time.sleep(1)
+        results = manager.SmartBatch(drive_paths, "update", self.no_options,
+                                     dbus_interface=self.iface_prefix + ".Manager")
+        self.assertEqual(len(results), len(drive_paths))
+        for path, error, _status in results:
+            if path in orig:
+                self.assertEqual(error, "")
+                drive_obj = self.get_object(str(path))
+                updated = self.get_property(drive_obj, ".Drive.Ata", "SmartUpdated")
+                self.assertGreater(int(updated.value), orig[path])
+            else:
+                self.assertIn("not an ATA drive", error)
+
+    def _restore_configuration(self, conf_file, orig_conf):
+        if orig_conf is None:
+            self.remove_file(conf_file, True)
+        else:
+            self.write_file(conf_file, orig_conf)
+
+    @unittest.skipUnless(smart_supported, "No disks supporting S.M.A.R.T. available")
+    def test_configuration_applied(self):
+        # all the drives at once so that they queue up behind the per-controller limit
+        drives = dict()
+        for disk in smart_supported:
+            wcache = self.get_smart_setting(disk, "wcache", "Write cache is")
+            if wcache not in ("Enabled", "Disabled"):
+                continue
+            drive_name = self.get_drive_name(self.get_device(disk))
+            drive_obj = self.get_object("/drives/%s" % drive_name)
+            drive_id = self.get_property_raw(drive_obj, ".Drive", "Id")
+            conf_file = os.path.join("/etc/udisks2", "%s.conf" % drive_id)
+            orig_conf = self.read_file(conf_file) if os.path.exists(conf_file) else None
+            self.addCleanup(self._restore_configuration, conf_file, orig_conf)
+            drives[disk] = (drive_obj, wcache == "Enabled")
+
+        if not drives:
+            self.skipTest("No disks with a switchable write cache available")
+
+        def set_write_cache(enabled):
+            applied = dict()
+            for disk, (drive_obj, _orig) in drives.items():
+                applied[disk] = int(self.get_property_raw(drive_obj, ".Drive.Ata", "ConfigurationApplied"))
+                drive = self.get_interface(drive_obj, ".Drive")
+                drive.SetConfiguration(dbus.Dictionary({"ata-write-cache-enabled": dbus.Boolean(enabled[disk])},
+                                                       signature="sv"),
+                                       self.no_options)
+            for disk, (drive_obj, _orig) in drives.items():
+                prop = self.get_property(drive_obj, ".Drive.Ata", "ConfigurationApplied")
+                prop.assertGreater(applied[disk])
+                wcache = self.get_smart_setting(disk, "wcache", "Write cache is")
+                self.assertEqual(wcache, "Enabled" if enabled[disk] else "Disabled")
+
+        # switching back checks that the drive is asked for what is in
+        # effect, the IDENTIFY data from the last probe still has the
+        # original value
+        for disk, (_drive_obj, orig) in drives.items():
+            self.addCleanup(self.run_command, "smartctl -s wcache,%s /dev/%s" % ("on" if orig else "off", disk))
+        set_write_cache({disk: not orig for disk, (_drive_obj, orig) in drives.items()})
+        set_write_cache({disk: orig for disk, (_drive_obj, orig) in drives.items()})
+
+    def test_smart_batch_invalid(self):
+        manager = self.get_object("/Manager")
+        msg = "Unknown SMART batch action"
+        with self.assertRaisesRegex(dbus.exceptions.DBusException, msg):
+            manager.SmartBatch(dbus.Array([], signature="o"), "selftest", self.no_options,
+                               dbus_interface=self.iface_prefix + ".Manager")
+
+    @unittest.skipUnless(smart_supported, "No disks supporting S.M.A.R.T. available")
+    def test_pm_get_states(self):
+        manager = self.get_object("/Manager")
+        states = manager.PmGetStates(dbus.Dictionary({"refresh": True}, signature="sv"),
+                                     dbus_interface=self.iface_prefix + ".Manager")
+        for path, pm_state, updated in states:
+            drive_obj = self.get_object(str(path))
+            self.assertTrue(self.get_property_raw(drive_obj, ".Drive.Ata", "PmEnabled"))
+            # drives that answered have a valid state and sample time
+            if pm_state >= 0:
+                self.assertLessEqual(pm_state, 0xff)
+                self.assertGreater(updated, 0)
+                self.get_property(drive_obj, ".Drive.Ata", "PmState").assertEqual(pm_state)
+            else:
+                self.assertEqual(updated, 0)
+
+        # without refresh the last known states are returned as they are
+        cached = manager.PmGetStates(self.no_options,
+                                     dbus_interface=self.iface_prefix + ".Manager")
+        self.assertEqual(sorted(path for path, _state, _updated in cached),
+                         sorted(path for path, _state, _updated in states))
+        for path, pm_state, updated in cached:
+            drive_obj = self.get_object(str(path))
+            self.get_property(drive_obj, ".Drive.Ata", "PmState").assertEqual(pm_state)
+
+    def test_secure_erase_batch_invalid(self):
+        # only objects that can't be erased, real drives would be wiped
+        manager = self.get_object("/Manager")
+        results = manager.SecureEraseBatch([self.path_prefix + "/Manager"], self.no_options,
+                                           dbus_interface=self.iface_prefix + ".Manager")
+        self.assertEqual(len(results), 1)
+        self.assertEqual(results[0][0], self.path_prefix + "/Manager")
+        self.assertIn("not an ATA drive", results[0][1])
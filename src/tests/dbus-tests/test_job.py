@@ -1,10 +1,14 @@
+import configparser
 import os
+import re
+import select
 import time
 import threading
 
 import gi
 gi.require_version('GLib', '2.0')
-from gi.repository import GLib
+gi.require_version('Gio', '2.0')
+from gi.repository import GLib, Gio
 
 import safe_dbus
 import udiskstestcase
@@ -145,3 +149,241 @@ class UdisksJobTest(udiskstestcase.UdisksTestCase):
         self.assertIsNotNone(self.exception)
         self.assertTrue(isinstance(self.exception, safe_dbus.DBusCallError))
         self.assertIn('Error erasing device: Job was canceled', str(self.exception))
+
+
+
+class UdisksJobSchedulerTest(udiskstestcase.UdisksTestCase):
+    '''This is a test suite for queueing of jobs over the configured limits'''
+
+    def _get_udisks2_conf_path(self):
+        if os.environ['UDISKS_TESTS_ARG_SYSTEM'] == '1':
+            return '/etc/udisks2/udisks2.conf'
+        else:
+            return os.path.join(os.environ['UDISKS_TESTS_PROJDIR'], 'udisks', 'udisks2.conf')
+
+    def _restore_udisks2_conf(self, contents):
+        self.write_file(self._get_udisks2_conf_path(), contents)
+        # the daemon reloads the job limits once it notices the change
+        time.sleep(1)
+
+    def _set_job_limits(self, **limits):
+        conf_path = self._get_udisks2_conf_path()
+        contents = self.read_file(conf_path)
+        self.addCleanup(self._restore_udisks2_conf, contents)
+
+        config = configparser.ConfigParser(interpolation=None)
+        config.optionxform = str
+        config.read_string(contents)
+        if 'jobs' not in config:
+            config['jobs'] = {}
+        for key, value in limits.items():
+            config['jobs'][key] = str(value)
+        with open(conf_path, 'w') as f:
+            config.write(f)
+        time.sleep(1)
+
+    def _get_jobs(self):
+        objects = safe_dbus.call_sync(self.iface_prefix,
+                                      self.path_prefix,
+                                      'org.freedesktop.DBus.ObjectManager',
+                                      'GetManagedObjects',
+                                      None)
+        return {path: props[self.iface_prefix + '.Job'] for (path, props) in objects[0].items() if '/jobs/' in path}
+
+    def _find_job(self, operation, obj_path):
+        for job_path, props in self._get_jobs().items():
+            if props['Operation'] == operation and props['Objects'] == [obj_path]:
+                return job_path
+        return None
+
+    def _wait_for_job(self, operation, obj_path, timeout=10):
+        for _ in range(timeout * 20):
+            job_path = self._find_job(operation, obj_path)
+            if job_path is not None:
+                return job_path
+            time.sleep(0.05)
+        self.fail('Job %s on %s not found' % (operation, obj_path))
+
+    def _get_job_state(self, job_path):
+        props = self._get_jobs().get(job_path)
+        return props['State'] if props else None
+
+    def _wait_for_job_state(self, job_path, state, timeout=10):
+        for _ in range(timeout * 20):
+            if self._get_job_state(job_path) == state:
+                return
+            time.sleep(0.05)
+        self.fail('Job %s did not reach the %s state' % (job_path, state))
+
+    def _cancel_job(self, job_path):
+        try:
+            safe_dbus.call_sync(self.iface_prefix,
+                                job_path,
+                                self.iface_prefix + '.Job',
+                                'Cancel',
+                                GLib.Variant('(a{sv})', ({},)))
+        except safe_dbus.DBusCallError:
+            # already finished
+            pass
+
+    def _start_copy(self, obj_path):
+        '''Starts copying @obj_path into a pipe nobody reads, the job runs until cancelled'''
+        read_fd, write_fd = os.pipe()
+        fd_list = Gio.UnixFDList.new()
+        fd_list.append(write_fd)
+        os.close(write_fd)
+        result = {}
+
+        def call():
+            try:
+                connection = safe_dbus.get_new_system_connection()
+                connection.call_with_unix_fd_list_sync(self.iface_prefix, obj_path, self.iface_prefix + '.Block',
+                                                       'Copy', GLib.Variant('(ha{sv})', (0, {})), None,
+                                                       Gio.DBusCallFlags.NONE, -1, fd_list, None)
+            except GLib.GError as e:
+                result['error'] = e.message
+
+        thread = threading.Thread(target=call)
+        thread.start()
+        self.addCleanup(self._stop_copy, obj_path, thread, read_fd)
+        return thread, result, read_fd
+
+    def _drain(self, thread, read_fd):
+        # a copy blocked on the full pipe only notices the cancellation once it can write again
+        while thread.is_alive():
+            readable, _w, _x = select.select([read_fd], [], [], 0.1)
+            if readable:
+                os.read(read_fd, 1024 * 1024)
+        thread.join()
+
+    def _stop_copy(self, obj_path, thread, read_fd):
+        job_path = self._find_job('block-copy', obj_path)
+        if job_path is not None:
+            self._cancel_job(job_path)
+        self._drain(thread, read_fd)
+        os.close(read_fd)
+
+    def _stop_swap_start(self, swap_path, thread):
+        # still queued if the test failed
+        job_path = self._find_job('swapspace-start', swap_path)
+        if job_path is not None:
+            self._cancel_job(job_path)
+        thread.join()
+
+    def _get_controller(self, dev):
+        # the closest PCI function, like udisks_linux_device_dup_controller_key()
+        path = os.path.realpath('/sys/block/%s' % os.path.basename(dev))
+        m = re.match(r'(.*/[0-9a-f]{4}:[0-9a-f]{2}:[0-9a-f]{2}\.[0-9a-f])/', path)
+        return m.group(1) if m else None
+
+    def test_max_concurrent_priority(self):
+        '''Test that queued interactive jobs start before queued bulk jobs'''
+
+        self._set_job_limits(max_concurrent=1)
+
+        first_path = self.path_prefix + '/block_devices/' + os.path.basename(self.vdevs[0])
+        second_path = self.path_prefix + '/block_devices/' + os.path.basename(self.vdevs[1])
+        swap_dev = self.vdevs[2]
+        swap_path = self.path_prefix + '/block_devices/' + os.path.basename(swap_dev)
+
+        self.run_command('mkswap %s' % swap_dev)
+        self.addCleanup(self.wipe_fs, swap_dev)
+        self.addCleanup(self.run_command, 'swapoff %s' % swap_dev)
+        self.udev_settle()
+        swap_obj = self.get_object('/block_devices/' + os.path.basename(swap_dev))
+        self.get_property(swap_obj, '.Block', 'IdType').assertEqual('swap')
+
+        # the only slot is taken by a job that runs until cancelled
+        first_thread, first_result, first_fd = self._start_copy(first_path)
+        first_job = self._wait_for_job('block-copy', first_path)
+
+        # a bulk job queued before an interactive one
+        second_thread, second_result, second_fd = self._start_copy(second_path)
+        second_job = self._wait_for_job('block-copy', second_path)
+        swap_result = {}
+
+        def start_swap():
+            try:
+                safe_dbus.call_sync(self.iface_prefix, swap_path, self.iface_prefix + '.Swapspace', 'Start',
+                                    GLib.Variant('(a{sv})', ({},)))
+            except safe_dbus.DBusCallError as e:
+                swap_result['error'] = e
+
+        swap_thread = threading.Thread(target=start_swap)
+        swap_thread.start()
+        self.addCleanup(self._stop_swap_start, swap_path, swap_thread)
+        swap_job = self._wait_for_job('swapspace-start', swap_path)
+
+        self.assertEqual(self._get_job_state(first_job), 'running')
+        self.assertEqual(self._get_job_state(second_job), 'queued')
+        self.assertEqual(self._get_job_state(swap_job), 'queued')
+
+        self._cancel_job(first_job)
+        self._drain(first_thread, first_fd)
+        self.assertIn('Job was canceled', first_result.get('error', ''))
+
+        # the bulk job never finishes on its own, the interactive job has to run first
+        swap_thread.join(timeout=30)
+        self.assertFalse(swap_thread.is_alive())
+        self.assertNotIn('error', swap_result)
+        _ret, out = self.run_command('swapon --show=NAME --noheadings')
+        self.assertIn(swap_dev, out)
+        self._wait_for_job_state(second_job, 'running')
+
+    def test_max_concurrent_per_drive(self):
+        '''Test that jobs over the per-drive limit are queued'''
+
+        self._set_job_limits(max_concurrent_per_drive=1)
+
+        disk = self.vdevs[0]
+        self.run_command('parted --script %s mklabel gpt mkpart first 1MiB 50%% mkpart second 50%% 100%%' % disk)
+        self.addCleanup(self.wipe_fs, disk)
+        self.udev_settle()
+        part1_path = self.path_prefix + '/block_devices/' + os.path.basename(disk) + '1'
+        part2_path = self.path_prefix + '/block_devices/' + os.path.basename(disk) + '2'
+        other_path = self.path_prefix + '/block_devices/' + os.path.basename(self.vdevs[1])
+
+        first_thread, first_result, first_fd = self._start_copy(part1_path)
+        first_job = self._wait_for_job('block-copy', part1_path)
+        self._start_copy(part2_path)
+        second_job = self._wait_for_job('block-copy', part2_path)
+        self._start_copy(other_path)
+        other_job = self._wait_for_job('block-copy', other_path)
+
+        # only the job on the same drive has to wait
+        self.assertEqual(self._get_job_state(first_job), 'running')
+        self.assertEqual(self._get_job_state(second_job), 'queued')
+        self.assertEqual(self._get_job_state(other_job), 'running')
+
+        self._cancel_job(first_job)
+        self._drain(first_thread, first_fd)
+        self.assertIn('Job was canceled', first_result.get('error', ''))
+
+        # the queued job takes over the slot of the drive
+        self._wait_for_job_state(second_job, 'running')
+
+    def test_max_concurrent_per_controller(self):
+        '''Test that jobs over the per-controller limit are queued'''
+
+        controller = self._get_controller(self.vdevs[0])
+        if controller is None or self._get_controller(self.vdevs[1]) != controller:
+            self.skipTest('Test devices are not attached to the same PCI controller')
+
+        self._set_job_limits(max_concurrent_per_controller=1)
+
+        first_path = self.path_prefix + '/block_devices/' + os.path.basename(self.vdevs[0])
+        second_path = self.path_prefix + '/block_devices/' + os.path.basename(self.vdevs[1])
+
+        self._start_copy(first_path)
+        first_job = self._wait_for_job('block-copy', first_path)
+        second_thread, second_result, _fd = self._start_copy(second_path)
+        second_job = self._wait_for_job('block-copy', second_path)
+
+        self.assertEqual(self._get_job_state(first_job), 'running')
+        self.assertEqual(self._get_job_state(second_job), 'queued')
+
+        # cancelling a queued job completes it without ever running it
+        self._cancel_job(second_job)
+        second_thread.join(timeout=10)
+        self.assertFalse(second_thread.is_alive())
+        self.assertIn('Operation was cancelled', second_result.get('error', ''))
@@ -238,3 +238,28 @@ class UdisksManagerLoopDeviceTest(udiskstestcase.UdisksTestCase):
 
         # partitions should be scanned
         self.assertTrue(os.path.exists("/dev/%sp1" % loop_dev))
+
+    def test_60_create_sector_size_direct_io(self):
+        opts = dbus.Dictionary({"sector-size": dbus.UInt32(4096),
+                                "direct-io": dbus.Boolean(False)}, signature=dbus.Signature('sv'))
+        with open(self.LOOP_DEVICE_FILENAME, "r+b") as loop_file:
+            fd = loop_file.fileno()
+            loop_dev_obj_path = self.manager.LoopSetup(fd, opts)
+        self.assertTrue(loop_dev_obj_path)
+        path, loop_dev = loop_dev_obj_path.rsplit("/", 1)
+        self.addCleanup(self.run_command, "losetup -d /dev/%s" % loop_dev)
+
+        loop_dev_obj = self.get_object(loop_dev_obj_path)
+
+        sector_size = self.get_property(loop_dev_obj, '.Loop', 'SectorSize')
+        sector_size.assertEqual(4096)
+        dio = self.get_property(loop_dev_obj, '.Loop', 'DirectIO')
+        dio.assertFalse()
+
+        # the sector size must be a power of two
+        opts = dbus.Dictionary({"sector-size": dbus.UInt32(1000)}, signature=dbus.Signature('sv'))
+        with open(self.LOOP_DEVICE_FILENAME, "r+b") as loop_file:
+            fd = loop_file.fileno()
+            msg = 'Invalid sector size 1000'
+            with self.assertRaisesRegex(dbus.exceptions.DBusException, msg):
+                self.manager.LoopSetup(fd, opts)
@@ -300,6 +300,74 @@ class UdisksNVMeTest(udiskstestcase.UdisksTestCase):
         self.assertEquals(unalloc_cap, 0)
 
 
+    def test_health_info(self):
+        self._nvme_connect()
+        self.addCleanup(self._nvme_disconnect, self.SUBNQN, ignore_errors=True)
+        time.sleep(1)
+
+        ns_devs = find_nvme_ns_devs_for_subnqn(self.SUBNQN)
+        ns = self.get_object('/block_devices/' + os.path.basename(ns_devs[0]))
+        self.assertHasIface(ns, 'org.freedesktop.UDisks2.NVMe.Namespace')
+        drive_obj_path = self.get_property_raw(ns, '.Block', 'Drive')
+        drive_obj = self.get_object(drive_obj_path)
+        self.assertHasIface(drive_obj, 'org.freedesktop.UDisks2.NVMe.Controller')
+        state = self.get_property(drive_obj, '.NVMe.Controller', 'State')
+        state.assertEqual('live', timeout=10)
+
+        drive_obj.SmartUpdate(self.no_options, dbus_interface=self.iface_prefix + '.NVMe.Controller')
+        updated = self.get_property_raw(drive_obj, '.NVMe.Controller', 'SmartUpdated')
+        self.assertGreater(updated, 0)
+        critical_warning = self.get_property_raw(drive_obj, '.NVMe.Controller', 'SmartCriticalWarning')
+        self.assertEqual(len(critical_warning), 0)
+        selftest_status = self.get_property_raw(drive_obj, '.NVMe.Controller', 'SmartSelftestStatus')
+        self.assertEqual(selftest_status, '')
+        selftest_remaining = self.get_property_raw(drive_obj, '.NVMe.Controller', 'SmartSelftestPercentRemaining')
+        self.assertEqual(selftest_remaining, -1)
+
+        attrs = drive_obj.SmartGetAttributes(self.no_options, dbus_interface=self.iface_prefix + '.NVMe.Controller')
+        self.assertIn('percent_used', attrs)
+        self.assertIn('media_errors', attrs)
+        self.assertEqual(len(attrs['temp_sensors']), 8)
+        self.assertEqual(attrs['percent_used'], self.get_property_raw(drive_obj, '.NVMe.Controller', 'SmartPercentageUsed'))
+
+        # the Linux target doesn't implement device self-tests
+        msg = r'org.freedesktop.UDisks2.Error.NotSupported: The NVMe controller has no support for self-tests'
+        with self.assertRaisesRegex(dbus.exceptions.DBusException, msg):
+            drive_obj.SmartSelftestStart('short', self.no_options, dbus_interface=self.iface_prefix + '.NVMe.Controller')
+
+
+    def test_sanitize_format(self):
+        self._nvme_connect()
+        self.addCleanup(self._nvme_disconnect, self.SUBNQN, ignore_errors=True)
+        time.sleep(1)
+
+        ns_devs = find_nvme_ns_devs_for_subnqn(self.SUBNQN)
+        ns = self.get_object('/block_devices/' + os.path.basename(ns_devs[0]))
+        self.assertHasIface(ns, 'org.freedesktop.UDisks2.NVMe.Namespace')
+        drive_obj_path = self.get_property_raw(ns, '.Block', 'Drive')
+        drive_obj = self.get_object(drive_obj_path)
+        self.assertHasIface(drive_obj, 'org.freedesktop.UDisks2.NVMe.Controller')
+        state = self.get_property(drive_obj, '.NVMe.Controller', 'State')
+        state.assertEqual('live', timeout=10)
+
+        # the Linux target doesn't implement sanitize
+        sanitize_status = self.get_property_raw(drive_obj, '.NVMe.Controller', 'SanitizeStatus')
+        self.assertEqual(sanitize_status, '')
+        sanitize_remaining = self.get_property_raw(drive_obj, '.NVMe.Controller', 'SanitizePercentRemaining')
+        self.assertEqual(sanitize_remaining, -1)
+        msg = r'org.freedesktop.UDisks2.Error.NotSupported: The NVMe controller has no support for the block-erase sanitize action'
+        with self.assertRaisesRegex(dbus.exceptions.DBusException, msg):
+            drive_obj.Sanitize('block-erase', self.no_options, dbus_interface=self.iface_prefix + '.NVMe.Controller')
+
+        msg = r'org.freedesktop.UDisks2.Error.Failed: Unknown secure erase type foo'
+        with self.assertRaisesRegex(dbus.exceptions.DBusException, msg):
+            ns.FormatNamespace({'secure_erase': 'foo'}, dbus_interface=self.iface_prefix + '.NVMe.Namespace')
+
+        # nor Format NVM
+        with self.assertRaises(dbus.exceptions.DBusException):
+            ns.FormatNamespace(self.no_options, dbus_interface=self.iface_prefix + '.NVMe.Namespace')
+
+
     def test_namespace_info(self):
         self._nvme_connect()
         self.addCleanup(self._nvme_disconnect, self.SUBNQN, ignore_errors=True)
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
 #include <string.h>
 
@@ -30,6 +31,7 @@
 #include <udisksdaemon.h>
 #include <udisksspawnedjob.h>
 #include <udisksthreadedjob.h>
+#include <udiskslinuxfsinfo.h>
 
 #include "testutil.h"
 
@@ -454,6 +456,42 @@ test_spawned_job_binary_input_string (void)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static gboolean
+output_limit_on_spawned_job_completed (UDisksSpawnedJob *job,
+                                       GError           *error,
+                                       gint              status,
+                                       GString          *standard_output,
+                                       GString          *standard_error,
+                                       gpointer          user_data)
+{
+  g_assert_no_error (error);
+  g_assert_cmpstr (standard_output->str, ==,
+                   "Hello\n"
+                   "[... 10 bytes omitted ...]\n"
+                   "ne 2\n");
+  g_assert_cmpstr (standard_error->str, ==, "");
+  g_assert (WIFEXITED (status));
+  g_assert (WEXITSTATUS (status) == 0);
+  return FALSE;
+}
+
+static void
+test_spawned_job_output_limit (void)
+{
+  UDisksSpawnedJob *job;
+  gchar *s;
+
+  s = g_strdup_printf (UDISKS_TEST_DIR "/udisks-test-helper 0");
+  job = udisks_spawned_job_new (s, NULL, getuid (), geteuid (), NULL, NULL);
+  udisks_spawned_job_set_output_limit (job, 10);
+  udisks_spawned_job_start (job);
+  _g_assert_signal_received (job, "spawned-job-completed", G_CALLBACK (output_limit_on_spawned_job_completed), NULL);
+  g_object_unref (job);
+  g_free (s);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 static gboolean
 threaded_job_successful_func (UDisksThreadedJob   *job,
                               GCancellable        *cancellable,
@@ -682,6 +720,31 @@ test_threaded_job_override_signal_handler (void)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static void
+test_fsinfo_join_mkfs_options (void)
+{
+  gchar *options;
+
+  options = udisks_linux_fsinfo_join_mkfs_options (NULL, NULL);
+  g_assert_cmpstr (options, ==, "");
+  g_free (options);
+
+  options = udisks_linux_fsinfo_join_mkfs_options ("-K", "-K");
+  g_assert_cmpstr (options, ==, "-K -K");
+  g_free (options);
+
+  /* mke2fs only honours the last -E */
+  options = udisks_linux_fsinfo_join_mkfs_options ("-E nodiscard", "-E lazy_itable_init=0,lazy_journal_init=0");
+  g_assert_cmpstr (options, ==, "-E nodiscard,lazy_itable_init=0,lazy_journal_init=0");
+  g_free (options);
+
+  options = udisks_linux_fsinfo_join_mkfs_options ("-E nodiscard", "-m 0");
+  g_assert_cmpstr (options, ==, "-m 0 -E nodiscard");
+  g_free (options);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 int
 main (int    argc,
       char **argv)
@@ -714,6 +777,7 @@ main (int    argc,
   g_test_add_func ("/udisks/daemon/spawned_job/binary_output", test_spawned_job_binary_output);
   g_test_add_func ("/udisks/daemon/spawned_job/input_string", test_spawned_job_input_string);
   g_test_add_func ("/udisks/daemon/spawned_job/binary_input_string", test_spawned_job_binary_input_string);
+  g_test_add_func ("/udisks/daemon/spawned_job/output_limit", test_spawned_job_output_limit);
   g_test_add_func ("/udisks/daemon/threaded_job/successful", test_threaded_job_successful);
   g_test_add_func ("/udisks/daemon/threaded_job/failure", test_threaded_job_failure);
   g_test_add_func ("/udisks/daemon/threaded_job/cancelled_at_start", test_threaded_job_cancelled_at_start);
@@ -723,6 +787,7 @@ main (int    argc,
   g_test_add_func ("/udisks/daemon/threaded_job_sync/failure", test_threaded_job_sync_failure);
   g_test_add_func ("/udisks/daemon/threaded_job_sync/cancelled_at_start", test_threaded_job_sync_cancelled_at_start);
   g_test_add_func ("/udisks/daemon/threaded_job_sync/cancelled_midway", test_threaded_job_sync_cancelled_midway);
+  g_test_add_func ("/udisks/daemon/fsinfo/join_mkfs_options", test_fsinfo_join_mkfs_options);
 
   ret = g_test_run();
 
@@ -334,6 +334,27 @@ udisks_ata_send_command_sync (gint                       fd,
  */
 gboolean
 udisks_ata_get_pm_state (const gchar *device, GError **error, guchar *pm_state)
+{
+  return udisks_ata_get_pm_state_with_timeout (device, -1, error, pm_state);
+}
+
+/**
+ * udisks_ata_get_pm_state_with_timeout:
+ * @device: ATA drive block device path.
+ * @timeout_msec: Timeout in milli-seconds for the command. Use -1 for the default timeout.
+ * @error: Return location for error.
+ * @pm_state: Return location for the current power state value.
+ *
+ * Like udisks_ata_get_pm_state() but allows using a shorter timeout
+ * so that unresponsive drives don't block the caller for long.
+ *
+ * Returns: %TRUE if the operation succeeded, %FALSE if @error is set.
+ */
+gboolean
+udisks_ata_get_pm_state_with_timeout (const gchar  *device,
+                                      gint          timeout_msec,
+                                      GError      **error,
+                                      guchar       *pm_state)
 {
   int fd;
   gboolean rc = FALSE;
@@ -353,7 +374,7 @@ udisks_ata_get_pm_state (const gchar *device, GError **error, guchar *pm_state)
     }
 
   if (!udisks_ata_send_command_sync (fd,
-                                     -1,
+                                     timeout_msec,
                                      UDISKS_ATA_COMMAND_PROTOCOL_NONE,
                                      &input,
                                      &output,
@@ -94,6 +94,11 @@ gboolean udisks_ata_get_pm_state      (const gchar               *device,
                                        GError                   **error,
                                        guchar                    *pm_state);
 
+gboolean udisks_ata_get_pm_state_with_timeout (const gchar       *device,
+                                               gint               timeout_msec,
+                                               GError           **error,
+                                               guchar            *pm_state);
+
 G_END_DECLS
 
 #endif /* __UDISKS_ATA_H__ */
@@ -0,0 +1,661 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "udiskslogging.h"
+#include "udisksdaemon.h"
+#include "udisksconfigmanager.h"
+#include "udisksauthorizationcache.h"
+
+/**
+ * SECTION:udisksauthorizationcache
+ * @title: UDisksAuthorizationCache
+ * @short_description: Caches caller credentials and authorizations
+ *
+ * The #UDisksAuthorizationCache saves the round trips to the message
+ * bus and to polkit that almost every method call would otherwise
+ * need.
+ *
+ * The UNIX user and process id of a caller are cached for its unique
+ * bus name, which the bus never reuses, until the name disappears
+ * from the bus.
+ *
+ * Positive authorization results obtained without user interaction
+ * are cached per caller, action, object and polkit details for the
+ * time configured by the <literal>cache_ttl</literal> key in the
+ * <literal>[authorization]</literal> section of the udisks2.conf file.
+ * Since polkit rules may match on any of the details (such as
+ * <literal>id.uuid</literal> or <literal>drive.removable</literal>),
+ * a cached result is only reused if they are all the same. The whole
+ * authorization cache is dropped when the polkit configuration
+ * changes and when any session or seat changes in logind, as
+ * <literal>allow_active</literal> and <literal>allow_inactive</literal>
+ * results depend on the state of the caller's session.
+ */
+
+/* Upper bound on the number of callers to remember, the table is
+ * dropped when it is exceeded. Protects against names whose
+ * NameOwnerChanged signal arrives before their credentials are added.
+ */
+#define MAX_CACHED_CALLERS 4096
+
+typedef struct _UDisksAuthorizationCacheClass UDisksAuthorizationCacheClass;
+
+typedef struct
+{
+  gboolean has_uid;
+  uid_t uid;
+  gboolean has_pid;
+  pid_t pid;
+} CallerCredentials;
+
+/**
+ * UDisksAuthorizationCache:
+ *
+ * The #UDisksAuthorizationCache structure contains only private data and
+ * should only be accessed using the provided API.
+ */
+struct _UDisksAuthorizationCache
+{
+  GObject parent_instance;
+
+  UDisksDaemon *daemon;
+  GDBusConnection *connection;
+  guint name_owner_changed_id;
+  guint logind_changed_id;
+  PolkitAuthority *authority;
+  gulong authority_changed_id;
+
+  GMutex lock;
+  /* unique bus name -> CallerCredentials */
+  GHashTable *credentials;
+  /* "<bus name>\n<action id>\n<object path>\n<details>" -> expiration (gint64 *) */
+  GHashTable *authorizations;
+
+  guint64 credential_hits;
+  guint64 credential_misses;
+  guint64 authorization_hits;
+  guint64 authorization_misses;
+};
+
+struct _UDisksAuthorizationCacheClass
+{
+  GObjectClass parent_class;
+};
+
+enum
+{
+  PROP_0,
+  PROP_DAEMON,
+};
+
+G_DEFINE_TYPE (UDisksAuthorizationCache, udisks_authorization_cache, G_TYPE_OBJECT);
+
+static gboolean
+remove_authorizations_for_name (gpointer key,
+                                gpointer value,
+                                gpointer user_data)
+{
+  const gchar *prefix = user_data;
+
+  return g_str_has_prefix (key, prefix);
+}
+
+static void
+on_name_owner_changed (GDBusConnection *connection,
+                       const gchar     *sender_name,
+                       const gchar     *object_path,
+                       const gchar     *interface_name,
+                       const gchar     *signal_name,
+                       GVariant        *parameters,
+                       gpointer         user_data)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (user_data);
+  const gchar *name;
+  const gchar *old_owner;
+  const gchar *new_owner;
+  gchar *prefix;
+
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sss)")))
+    return;
+
+  g_variant_get (parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+  if (name[0] != ':' || new_owner[0] != '\0')
+    return;
+
+  prefix = g_strdup_printf ("%s\n", name);
+  g_mutex_lock (&cache->lock);
+  g_hash_table_remove (cache->credentials, name);
+  g_hash_table_foreach_remove (cache->authorizations, remove_authorizations_for_name, prefix);
+  g_mutex_unlock (&cache->lock);
+  g_free (prefix);
+}
+
+static void
+on_authority_changed (PolkitAuthority *authority,
+                      gpointer         user_data)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (user_data);
+
+  g_mutex_lock (&cache->lock);
+  g_hash_table_remove_all (cache->authorizations);
+  g_mutex_unlock (&cache->lock);
+}
+
+static void
+on_logind_changed (GDBusConnection *connection,
+                   const gchar     *sender_name,
+                   const gchar     *object_path,
+                   const gchar     *interface_name,
+                   const gchar     *signal_name,
+                   GVariant        *parameters,
+                   gpointer         user_data)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (user_data);
+
+  /* Sessions going (in)active or remote, sessions and seats coming and
+   * going. Not worth telling them apart, any of them may change what
+   * polkit answers.
+   */
+  g_mutex_lock (&cache->lock);
+  g_hash_table_remove_all (cache->authorizations);
+  g_mutex_unlock (&cache->lock);
+}
+
+static void
+udisks_authorization_cache_finalize (GObject *object)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (object);
+
+  if (cache->name_owner_changed_id != 0)
+    g_dbus_connection_signal_unsubscribe (cache->connection, cache->name_owner_changed_id);
+  if (cache->logind_changed_id != 0)
+    g_dbus_connection_signal_unsubscribe (cache->connection, cache->logind_changed_id);
+  g_clear_object (&cache->connection);
+  if (cache->authority_changed_id != 0)
+    g_signal_handler_disconnect (cache->authority, cache->authority_changed_id);
+  g_clear_object (&cache->authority);
+
+  g_hash_table_unref (cache->credentials);
+  g_hash_table_unref (cache->authorizations);
+  g_mutex_clear (&cache->lock);
+
+  if (G_OBJECT_CLASS (udisks_authorization_cache_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (udisks_authorization_cache_parent_class)->finalize (object);
+}
+
+static void
+udisks_authorization_cache_set_property (GObject      *object,
+                                         guint         prop_id,
+                                         const GValue *value,
+                                         GParamSpec   *pspec)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_assert (cache->daemon == NULL);
+      /* we don't take a reference to the daemon */
+      cache->daemon = g_value_get_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_authorization_cache_constructed (GObject *object)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (object);
+  PolkitAuthority *authority;
+
+  cache->connection = g_object_ref (udisks_daemon_get_connection (cache->daemon));
+  cache->name_owner_changed_id = g_dbus_connection_signal_subscribe (cache->connection,
+                                                                     "org.freedesktop.DBus",
+                                                                     "org.freedesktop.DBus",
+                                                                     "NameOwnerChanged",
+                                                                     "/org/freedesktop/DBus",
+                                                                     NULL, /* arg0 */
+                                                                     G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                     on_name_owner_changed,
+                                                                     cache,
+                                                                     NULL); /* user_data_free_func */
+  cache->logind_changed_id = g_dbus_connection_signal_subscribe (cache->connection,
+                                                                 "org.freedesktop.login1",
+                                                                 NULL, /* interface_name */
+                                                                 NULL, /* member */
+                                                                 NULL, /* object_path */
+                                                                 NULL, /* arg0 */
+                                                                 G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                 on_logind_changed,
+                                                                 cache,
+                                                                 NULL); /* user_data_free_func */
+
+  authority = udisks_daemon_get_authority (cache->daemon);
+  if (authority != NULL)
+    {
+      cache->authority = g_object_ref (authority);
+      cache->authority_changed_id = g_signal_connect (cache->authority,
+                                                      "changed",
+                                                      G_CALLBACK (on_authority_changed),
+                                                      cache);
+    }
+
+  if (G_OBJECT_CLASS (udisks_authorization_cache_parent_class)->constructed != NULL)
+    G_OBJECT_CLASS (udisks_authorization_cache_parent_class)->constructed (object);
+}
+
+static void
+udisks_authorization_cache_init (UDisksAuthorizationCache *cache)
+{
+  g_mutex_init (&cache->lock);
+  cache->credentials = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  cache->authorizations = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+udisks_authorization_cache_class_init (UDisksAuthorizationCacheClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize     = udisks_authorization_cache_finalize;
+  gobject_class->set_property = udisks_authorization_cache_set_property;
+  gobject_class->constructed  = udisks_authorization_cache_constructed;
+
+  /**
+   * UDisksAuthorizationCache:daemon:
+   *
+   * The #UDisksDaemon the cache is for.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_DAEMON,
+                                   g_param_spec_object ("daemon",
+                                                        "Daemon",
+                                                        "The daemon the cache is for",
+                                                        UDISKS_TYPE_DAEMON,
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * udisks_authorization_cache_new:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Creates a new #UDisksAuthorizationCache instance. The instance
+ * listens for signals in the thread-default main context of the
+ * calling thread.
+ *
+ * Returns: A new #UDisksAuthorizationCache. Free with g_object_unref().
+ */
+UDisksAuthorizationCache *
+udisks_authorization_cache_new (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return UDISKS_AUTHORIZATION_CACHE (g_object_new (UDISKS_TYPE_AUTHORIZATION_CACHE,
+                                                   "daemon", daemon,
+                                                   NULL));
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* must be called with the lock held */
+static CallerCredentials *
+lookup_credentials (UDisksAuthorizationCache *cache,
+                    const gchar              *bus_name,
+                    gboolean                  create)
+{
+  CallerCredentials *credentials;
+
+  credentials = g_hash_table_lookup (cache->credentials, bus_name);
+  if (credentials == NULL && create)
+    {
+      if (g_hash_table_size (cache->credentials) >= MAX_CACHED_CALLERS)
+        g_hash_table_remove_all (cache->credentials);
+      credentials = g_new0 (CallerCredentials, 1);
+      g_hash_table_insert (cache->credentials, g_strdup (bus_name), credentials);
+    }
+  return credentials;
+}
+
+/**
+ * udisks_authorization_cache_lookup_uid:
+ * @cache: A #UDisksAuthorizationCache.
+ * @bus_name: (allow-none): The unique bus name of the caller.
+ * @out_uid: (out): Return location for the user id.
+ *
+ * Looks up the cached UNIX user id of the caller with @bus_name.
+ *
+ * Returns: %TRUE if @out_uid was set, %FALSE if the user id is not known.
+ */
+gboolean
+udisks_authorization_cache_lookup_uid (UDisksAuthorizationCache *cache,
+                                       const gchar              *bus_name,
+                                       uid_t                    *out_uid)
+{
+  CallerCredentials *credentials;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache), FALSE);
+
+  /* peer-to-peer connections have no bus name */
+  if (bus_name == NULL)
+    return FALSE;
+
+  g_mutex_lock (&cache->lock);
+  credentials = lookup_credentials (cache, bus_name, FALSE);
+  if (credentials != NULL && credentials->has_uid)
+    {
+      *out_uid = credentials->uid;
+      cache->credential_hits++;
+      ret = TRUE;
+    }
+  else
+    {
+      cache->credential_misses++;
+    }
+  g_mutex_unlock (&cache->lock);
+
+  return ret;
+}
+
+/**
+ * udisks_authorization_cache_insert_uid:
+ * @cache: A #UDisksAuthorizationCache.
+ * @bus_name: (allow-none): The unique bus name of the caller.
+ * @uid: The user id of the caller.
+ *
+ * Caches the UNIX user id of the caller with @bus_name.
+ */
+void
+udisks_authorization_cache_insert_uid (UDisksAuthorizationCache *cache,
+                                       const gchar              *bus_name,
+                                       uid_t                     uid)
+{
+  CallerCredentials *credentials;
+
+  g_return_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache));
+
+  if (bus_name == NULL)
+    return;
+
+  g_mutex_lock (&cache->lock);
+  credentials = lookup_credentials (cache, bus_name, TRUE);
+  credentials->uid = uid;
+  credentials->has_uid = TRUE;
+  g_mutex_unlock (&cache->lock);
+}
+
+/**
+ * udisks_authorization_cache_lookup_pid:
+ * @cache: A #UDisksAuthorizationCache.
+ * @bus_name: (allow-none): The unique bus name of the caller.
+ * @out_pid: (out): Return location for the process id.
+ *
+ * Looks up the cached UNIX process id of the caller with @bus_name.
+ *
+ * Returns: %TRUE if @out_pid was set, %FALSE if the process id is not known.
+ */
+gboolean
+udisks_authorization_cache_lookup_pid (UDisksAuthorizationCache *cache,
+                                       const gchar              *bus_name,
+                                       pid_t                    *out_pid)
+{
+  CallerCredentials *credentials;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache), FALSE);
+
+  if (bus_name == NULL)
+    return FALSE;
+
+  g_mutex_lock (&cache->lock);
+  credentials = lookup_credentials (cache, bus_name, FALSE);
+  if (credentials != NULL && credentials->has_pid)
+    {
+      *out_pid = credentials->pid;
+      cache->credential_hits++;
+      ret = TRUE;
+    }
+  else
+    {
+      cache->credential_misses++;
+    }
+  g_mutex_unlock (&cache->lock);
+
+  return ret;
+}
+
+/**
+ * udisks_authorization_cache_insert_pid:
+ * @cache: A #UDisksAuthorizationCache.
+ * @bus_name: (allow-none): The unique bus name of the caller.
+ * @pid: The process id of the caller.
+ *
+ * Caches the UNIX process id of the caller with @bus_name.
+ */
+void
+udisks_authorization_cache_insert_pid (UDisksAuthorizationCache *cache,
+                                       const gchar              *bus_name,
+                                       pid_t                     pid)
+{
+  CallerCredentials *credentials;
+
+  g_return_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache));
+
+  if (bus_name == NULL)
+    return;
+
+  g_mutex_lock (&cache->lock);
+  credentials = lookup_credentials (cache, bus_name, TRUE);
+  credentials->pid = pid;
+  credentials->has_pid = TRUE;
+  g_mutex_unlock (&cache->lock);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gint64
+get_ttl_usec (UDisksAuthorizationCache *cache)
+{
+  UDisksConfigManager *config_manager;
+
+  config_manager = udisks_daemon_get_config_manager (cache->daemon);
+  return (gint64) udisks_config_manager_get_authorization_cache_ttl (config_manager) * G_TIME_SPAN_MILLISECOND;
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return g_strcmp0 (*((const gchar **) a), *((const gchar **) b));
+}
+
+static gchar *
+make_authorization_key (const gchar   *bus_name,
+                        const gchar   *action_id,
+                        const gchar   *object_path,
+                        PolkitDetails *details)
+{
+  GString *key;
+  gchar **keys = NULL;
+  guint n;
+
+  key = g_string_new (NULL);
+  g_string_append_printf (key, "%s\n%s\n%s", bus_name, action_id, object_path != NULL ? object_path : "");
+
+  /* the details in a stable order, values escaped so that they can't
+   * be confused with the separators
+   */
+  if (details != NULL)
+    keys = polkit_details_get_keys (details);
+  if (keys != NULL)
+    {
+      qsort (keys, g_strv_length (keys), sizeof (gchar *), compare_strings);
+      for (n = 0; keys[n] != NULL; n++)
+        {
+          gchar *value;
+
+          value = g_strescape (polkit_details_lookup (details, keys[n]), NULL);
+          g_string_append_printf (key, "\n%s=%s", keys[n], value);
+          g_free (value);
+        }
+      g_strfreev (keys);
+    }
+
+  return g_string_free (key, FALSE);
+}
+
+static gboolean
+remove_expired_authorization (gpointer key,
+                              gpointer value,
+                              gpointer user_data)
+{
+  return *((gint64 *) value) <= *((gint64 *) user_data);
+}
+
+/**
+ * udisks_authorization_cache_lookup:
+ * @cache: A #UDisksAuthorizationCache.
+ * @bus_name: (allow-none): The unique bus name of the caller.
+ * @action_id: The polkit action id.
+ * @object_path: (allow-none): The object the call is on or %NULL.
+ * @details: (allow-none): The details the authorization is checked with or %NULL.
+ *
+ * Checks whether the caller with @bus_name was recently authorized
+ * for @action_id on @object_path with the same @details.
+ *
+ * Returns: %TRUE if a cached authorization is still valid, %FALSE otherwise.
+ */
+gboolean
+udisks_authorization_cache_lookup (UDisksAuthorizationCache *cache,
+                                   const gchar              *bus_name,
+                                   const gchar              *action_id,
+                                   const gchar              *object_path,
+                                   PolkitDetails            *details)
+{
+  gint64 *expiration;
+  gchar *key;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache), FALSE);
+  g_return_val_if_fail (action_id != NULL, FALSE);
+
+  if (bus_name == NULL || get_ttl_usec (cache) == 0)
+    return FALSE;
+
+  key = make_authorization_key (bus_name, action_id, object_path, details);
+  g_mutex_lock (&cache->lock);
+  expiration = g_hash_table_lookup (cache->authorizations, key);
+  if (expiration != NULL && *expiration > g_get_monotonic_time ())
+    {
+      cache->authorization_hits++;
+      ret = TRUE;
+    }
+  else
+    {
+      cache->authorization_misses++;
+    }
+  g_mutex_unlock (&cache->lock);
+  g_free (key);
+
+  return ret;
+}
+
+/**
+ * udisks_authorization_cache_insert:
+ * @cache: A #UDisksAuthorizationCache.
+ * @bus_name: (allow-none): The unique bus name of the caller.
+ * @action_id: The polkit action id.
+ * @object_path: (allow-none): The object the call is on or %NULL.
+ * @details: (allow-none): The details the authorization was checked with or %NULL.
+ *
+ * Remembers that the caller with @bus_name was authorized for
+ * @action_id on @object_path with @details without user interaction. Does nothing
+ * if caching of authorizations is disabled.
+ */
+void
+udisks_authorization_cache_insert (UDisksAuthorizationCache *cache,
+                                   const gchar              *bus_name,
+                                   const gchar              *action_id,
+                                   const gchar              *object_path,
+                                   PolkitDetails            *details)
+{
+  gint64 ttl;
+  gint64 now;
+  gint64 *expiration;
+
+  g_return_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache));
+  g_return_if_fail (action_id != NULL);
+
+  ttl = get_ttl_usec (cache);
+  if (bus_name == NULL || ttl == 0)
+    return;
+
+  now = g_get_monotonic_time ();
+  expiration = g_new (gint64, 1);
+  *expiration = now + ttl;
+
+  g_mutex_lock (&cache->lock);
+  g_hash_table_foreach_remove (cache->authorizations, remove_expired_authorization, &now);
+  g_hash_table_insert (cache->authorizations,
+                       make_authorization_key (bus_name, action_id, object_path, details),
+                       expiration);
+  g_mutex_unlock (&cache->lock);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/**
+ * udisks_authorization_cache_get_statistics:
+ * @cache: A #UDisksAuthorizationCache.
+ * @out_credential_hits: (out) (allow-none): Return location for the number of credential lookups served from the cache or %NULL.
+ * @out_credential_misses: (out) (allow-none): Return location for the number of credential lookups not in the cache or %NULL.
+ * @out_authorization_hits: (out) (allow-none): Return location for the number of authorization checks served from the cache or %NULL.
+ * @out_authorization_misses: (out) (allow-none): Return location for the number of authorization checks not in the cache or %NULL.
+ *
+ * Gets the hit and miss counters of @cache since the daemon started.
+ */
+void
+udisks_authorization_cache_get_statistics (UDisksAuthorizationCache *cache,
+                                           guint64                  *out_credential_hits,
+                                           guint64                  *out_credential_misses,
+                                           guint64                  *out_authorization_hits,
+                                           guint64                  *out_authorization_misses)
+{
+  g_return_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache));
+
+  g_mutex_lock (&cache->lock);
+  if (out_credential_hits != NULL)
+    *out_credential_hits = cache->credential_hits;
+  if (out_credential_misses != NULL)
+    *out_credential_misses = cache->credential_misses;
+  if (out_authorization_hits != NULL)
+    *out_authorization_hits = cache->authorization_hits;
+  if (out_authorization_misses != NULL)
+    *out_authorization_misses = cache->authorization_misses;
+  g_mutex_unlock (&cache->lock);
+}
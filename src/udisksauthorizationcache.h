@@ -0,0 +1,66 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __UDISKS_AUTHORIZATION_CACHE_H__
+#define __UDISKS_AUTHORIZATION_CACHE_H__
+
+#include "udisksdaemontypes.h"
+#include <sys/types.h>
+
+G_BEGIN_DECLS
+
+#define UDISKS_TYPE_AUTHORIZATION_CACHE  (udisks_authorization_cache_get_type ())
+#define UDISKS_AUTHORIZATION_CACHE(o)    (G_TYPE_CHECK_INSTANCE_CAST ((o), UDISKS_TYPE_AUTHORIZATION_CACHE, UDisksAuthorizationCache))
+#define UDISKS_IS_AUTHORIZATION_CACHE(o) (G_TYPE_CHECK_INSTANCE_TYPE ((o), UDISKS_TYPE_AUTHORIZATION_CACHE))
+
+GType                     udisks_authorization_cache_get_type   (void) G_GNUC_CONST;
+UDisksAuthorizationCache *udisks_authorization_cache_new        (UDisksDaemon             *daemon);
+
+gboolean                  udisks_authorization_cache_lookup_uid (UDisksAuthorizationCache *cache,
+                                                                 const gchar              *bus_name,
+                                                                 uid_t                    *out_uid);
+void                      udisks_authorization_cache_insert_uid (UDisksAuthorizationCache *cache,
+                                                                 const gchar              *bus_name,
+                                                                 uid_t                     uid);
+gboolean                  udisks_authorization_cache_lookup_pid (UDisksAuthorizationCache *cache,
+                                                                 const gchar              *bus_name,
+                                                                 pid_t                    *out_pid);
+void                      udisks_authorization_cache_insert_pid (UDisksAuthorizationCache *cache,
+                                                                 const gchar              *bus_name,
+                                                                 pid_t                     pid);
+
+gboolean                  udisks_authorization_cache_lookup     (UDisksAuthorizationCache *cache,
+                                                                 const gchar              *bus_name,
+                                                                 const gchar              *action_id,
+                                                                 const gchar              *object_path,
+                                                                 PolkitDetails            *details);
+void                      udisks_authorization_cache_insert     (UDisksAuthorizationCache *cache,
+                                                                 const gchar              *bus_name,
+                                                                 const gchar              *action_id,
+                                                                 const gchar              *object_path,
+                                                                 PolkitDetails            *details);
+
+void                      udisks_authorization_cache_get_statistics (UDisksAuthorizationCache *cache,
+                                                                     guint64                  *out_credential_hits,
+                                                                     guint64                  *out_credential_misses,
+                                                                     guint64                  *out_authorization_hits,
+                                                                     guint64                  *out_authorization_misses);
+
+G_END_DECLS
+
+#endif /* __UDISKS_AUTHORIZATION_CACHE_H__ */
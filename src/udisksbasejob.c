@@ -27,9 +27,16 @@
 #include "udisksbasejob.h"
 #include "udisksdaemon.h"
 #include "udisksdaemonutil.h"
+#include "udisksconfigmanager.h"
+#include "udisksstagestatistics.h"
+#include "udiskslogging.h"
 #include "udisks-daemon-marshal.h"
 
-#define MAX_SAMPLES 100
+/* we want at least this many samples before making an estimate */
+#define MIN_SAMPLES 5
+
+/* weight of the most recent speed sample in the moving average */
+#define EWMA_WEIGHT 0.2
 
 typedef struct
 {
@@ -53,8 +60,13 @@ struct _UDisksBaseJobPrivate
   gboolean auto_estimate;
   gulong notify_progress_signal_handler_id;
 
-  Sample *samples;
+  /* the previous progress sample, the speed since then is folded into avg_speed */
+  Sample last_sample;
+  /* number of samples seen so far, stops counting at MIN_SAMPLES */
   guint num_samples;
+
+  gdouble avg_speed;
+  gint64 last_estimate_usec;
 };
 
 static void job_iface_init (UDisksJobIface *iface);
@@ -76,9 +88,6 @@ udisks_base_job_finalize (GObject *object)
 {
   UDisksBaseJob *job = UDISKS_BASE_JOB (object);
 
-
-  g_free (job->priv->samples);
-
   if (job->priv->cancellable != NULL)
     {
       g_object_unref (job->priv->cancellable);
@@ -173,6 +182,7 @@ udisks_base_job_init (UDisksBaseJob *job)
 
   now_usec = g_get_real_time ();
   udisks_job_set_start_time (UDISKS_JOB (job), now_usec);
+  udisks_job_set_stage_timings (UDISKS_JOB (job), g_variant_new ("a{st}", NULL));
 }
 
 static void
@@ -357,6 +367,59 @@ udisks_base_job_remove_object (UDisksBaseJob  *job,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/**
+ * udisks_base_job_add_stage_timing:
+ * @job: A #UDisksBaseJob.
+ * @stage: The name of the finished stage.
+ * @duration_usec: How long the stage took, in micro-seconds.
+ *
+ * Appends @stage to the <link
+ * linkend="gdbus-property-org-freedesktop-UDisks2-Job.StageTimings">StageTimings</link>
+ * property of @job and adds it to the statistics kept by the daemon
+ * (see udisks_daemon_get_stage_statistics()).
+ */
+void
+udisks_base_job_add_stage_timing (UDisksBaseJob  *job,
+                                  const gchar    *stage,
+                                  gint64          duration_usec)
+{
+  GVariantBuilder builder;
+  GVariantIter iter;
+  GVariant *timings;
+  const gchar *name;
+  guint64 usec;
+  const gchar *operation;
+
+  g_return_if_fail (UDISKS_IS_BASE_JOB (job));
+  g_return_if_fail (stage != NULL);
+
+  if (duration_usec < 0)
+    duration_usec = 0;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{st}"));
+  timings = udisks_job_dup_stage_timings (UDISKS_JOB (job));
+  if (timings != NULL)
+    {
+      g_variant_iter_init (&iter, timings);
+      while (g_variant_iter_next (&iter, "{&st}", &name, &usec))
+        g_variant_builder_add (&builder, "{st}", name, usec);
+    }
+  g_variant_builder_add (&builder, "{st}", stage, (guint64) duration_usec);
+  udisks_job_set_stage_timings (UDISKS_JOB (job), g_variant_builder_end (&builder));
+  if (timings != NULL)
+    g_variant_unref (timings);
+
+  operation = udisks_job_get_operation (UDISKS_JOB (job));
+  udisks_debug ("Job %s: stage %s took %" G_GINT64_FORMAT " ms",
+                operation, stage, duration_usec / 1000);
+
+  if (job->priv->daemon != NULL)
+    udisks_stage_statistics_record (udisks_daemon_get_stage_statistics (job->priv->daemon),
+                                    operation, stage, duration_usec);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 static gboolean
 handle_cancel (UDisksJob              *_job,
                GDBusMethodInvocation  *invocation,
@@ -454,17 +517,28 @@ udisks_base_job_get_auto_estimate (UDisksBaseJob  *job)
 }
 
 
+static gint64
+get_estimate_interval_usec (UDisksBaseJob *job)
+{
+  UDisksConfigManager *config_manager;
+
+  /* jobs created outside of the daemon (e.g. in tests) use the default */
+  if (job->priv->daemon == NULL)
+    return (gint64) UDISKS_JOB_UPDATE_INTERVAL_DEFAULT * 1000;
+
+  config_manager = udisks_daemon_get_config_manager (job->priv->daemon);
+  return (gint64) udisks_config_manager_get_job_update_interval (config_manager) * 1000;
+}
+
 static void
 on_notify_progress (GObject     *object,
                     GParamSpec  *spec,
                     gpointer     user_data)
 {
   UDisksBaseJob *job = UDISKS_BASE_JOB (user_data);
-  Sample *sample;
-  guint n;
-  gdouble sum_of_speeds;
-  guint num_speeds;
-  gdouble avg_speed;
+  Sample sample;
+  Sample prev;
+  gdouble speed;
   gint64 usec_remaining;
   gint64 now;
   guint64 bytes;
@@ -473,47 +547,49 @@ on_notify_progress (GObject     *object,
   now = g_get_real_time ();
   current_progress = udisks_job_get_progress (UDISKS_JOB (job));
 
-  /* first add new sample... */
-  if (job->priv->num_samples == MAX_SAMPLES)
-    {
-      memmove (job->priv->samples, job->priv->samples + 1, sizeof (Sample) * (MAX_SAMPLES - 1));
-      job->priv->num_samples -= 1;
-    }
-  sample = &job->priv->samples[job->priv->num_samples++];
-  sample->time_usec = now;
-  sample->value = current_progress;
+  /* first replace the previous sample with the new one... */
+  prev = job->priv->last_sample;
+  sample.time_usec = now;
+  sample.value = current_progress;
+  job->priv->last_sample = sample;
+  if (job->priv->num_samples < MIN_SAMPLES)
+    job->priv->num_samples++;
 
-  /* ... then update expected-end-time from samples - we want at
-   * least five samples before making an estimate...
-   */
-  if (job->priv->num_samples < 5)
+  /* ... then fold the speed since the previous sample into the moving average ... */
+  if (job->priv->num_samples < 2 || sample.time_usec <= prev.time_usec)
     goto out;
+  speed = (sample.value - prev.value) / (sample.time_usec - prev.time_usec);
+  if (job->priv->num_samples == 2)
+    job->priv->avg_speed = speed;
+  else
+    job->priv->avg_speed = EWMA_WEIGHT * speed + (1.0 - EWMA_WEIGHT) * job->priv->avg_speed;
 
-  num_speeds = 0;
-  sum_of_speeds = 0.0;
-  for (n = 1; n < job->priv->num_samples; n++)
-    {
-      Sample *a = &job->priv->samples[n-1];
-      Sample *b = &job->priv->samples[n];
-      gdouble speed;
-      speed = (b->value - a->value) / (b->time_usec - a->time_usec);
-      sum_of_speeds += speed;
-      num_speeds++;
-    }
-  avg_speed = sum_of_speeds / num_speeds;
+  /* ... and only publish the estimate once we have enough samples and
+   * at most once per update interval so we don't flood the bus with
+   * PropertiesChanged signals
+   */
+  if (job->priv->num_samples < MIN_SAMPLES)
+    goto out;
+  if (job->priv->last_estimate_usec != 0 &&
+      now - job->priv->last_estimate_usec < get_estimate_interval_usec (job))
+    goto out;
+  job->priv->last_estimate_usec = now;
 
   bytes = udisks_job_get_bytes (UDISKS_JOB (job));
-  if (bytes > 0)
+  if (bytes > 0 && job->priv->avg_speed > 0)
     {
-      udisks_job_set_rate (UDISKS_JOB (job), bytes * avg_speed * G_USEC_PER_SEC);
+      udisks_job_set_rate (UDISKS_JOB (job), bytes * job->priv->avg_speed * G_USEC_PER_SEC);
     }
   else
     {
       udisks_job_set_rate (UDISKS_JOB (job), 0);
     }
 
-  usec_remaining = (1.0 - current_progress) / avg_speed;
-  udisks_job_set_expected_end_time (UDISKS_JOB (job), now + usec_remaining);
+  if (job->priv->avg_speed > 0)
+    {
+      usec_remaining = (1.0 - current_progress) / job->priv->avg_speed;
+      udisks_job_set_expected_end_time (UDISKS_JOB (job), now + usec_remaining);
+    }
 
  out:
   ;
@@ -537,8 +613,11 @@ udisks_base_job_set_auto_estimate (UDisksBaseJob  *job,
 
   if (value)
     {
-      if (job->priv->samples == NULL)
-        job->priv->samples = g_new0 (Sample, MAX_SAMPLES);
+      job->priv->last_sample.time_usec = 0;
+      job->priv->last_sample.value = 0.0;
+      job->priv->num_samples = 0;
+      job->priv->avg_speed = 0.0;
+      job->priv->last_estimate_usec = 0;
       g_assert_cmpint (job->priv->notify_progress_signal_handler_id, ==, 0);
       job->priv->notify_progress_signal_handler_id = g_signal_connect (job,
                                                                        "notify::progress",
@@ -73,6 +73,10 @@ void               udisks_base_job_add_object        (UDisksBaseJob  *job,
 void               udisks_base_job_remove_object     (UDisksBaseJob  *job,
                                                       UDisksObject   *object);
 
+void               udisks_base_job_add_stage_timing  (UDisksBaseJob  *job,
+                                                      const gchar    *stage,
+                                                      gint64          duration_usec);
+
 G_END_DECLS
 
 #endif /* __UDISKS_BASE_JOB_H__ */
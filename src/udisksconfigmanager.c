@@ -36,7 +36,43 @@ struct _UDisksConfigManager {
   UDisksModuleLoadPreference load_preference;
 
   const gchar *encryption;
+  guint encryption_sector_size;
+  UDisksEncryptionFlags encryption_flags;
+  /* protected by encryption_cipher_lock, may be changed at runtime */
+  GMutex encryption_cipher_lock;
+  gchar *encryption_cipher;
+  guint encryption_key_size;
   gchar *config_dir;
+
+  gboolean loop_direct_io;
+
+  guint job_update_interval;
+  gsize job_output_limit;
+  guint max_concurrent_jobs;
+  guint max_concurrent_jobs_per_drive;
+  guint max_concurrent_jobs_per_controller;
+
+  guint authorization_cache_ttl;
+
+  /* "<fstype>_<profile>" -> mkfs options, read-only after construction */
+  GHashTable *format_profiles;
+
+  /* protected by mount_options_lock, parsed mount_options.conf cached
+   * until something in config_dir changes
+   */
+  GMutex mount_options_lock;
+  GHashTable *mount_options;
+  gint64 mount_options_stamp;
+  guint mount_options_generation;
+  GFileMonitor *config_dir_monitor;
+
+  /* protected by drive_configurations_lock, drive id -> parsed
+   * <id>.conf (NULL if the file does not exist), entries are dropped
+   * by udisks_config_manager_invalidate_drive_configuration()
+   */
+  GMutex drive_configurations_lock;
+  GHashTable *drive_configurations;
+  guint drive_configurations_generation;
 };
 
 struct _UDisksConfigManagerClass {
@@ -60,6 +96,23 @@ enum
 
 #define DEFAULTS_GROUP_NAME "defaults"
 #define DEFAULTS_ENCRYPTION_KEY "encryption"
+#define DEFAULTS_ENCRYPTION_SECTOR_SIZE_KEY "encryption_sector_size"
+#define DEFAULTS_ENCRYPTION_FLAGS_KEY "encryption_flags"
+#define DEFAULTS_ENCRYPTION_CIPHER_KEY "encryption_cipher"
+#define DEFAULTS_ENCRYPTION_KEY_SIZE_KEY "encryption_key_size"
+#define DEFAULTS_LOOP_DIRECT_IO_KEY "loop_direct_io"
+
+#define JOBS_GROUP_NAME "jobs"
+#define JOBS_UPDATE_INTERVAL_KEY "update_interval"
+#define JOBS_OUTPUT_LIMIT_KEY "output_limit"
+#define JOBS_MAX_CONCURRENT_KEY "max_concurrent"
+#define JOBS_MAX_CONCURRENT_PER_DRIVE_KEY "max_concurrent_per_drive"
+#define JOBS_MAX_CONCURRENT_PER_CONTROLLER_KEY "max_concurrent_per_controller"
+
+#define AUTHORIZATION_GROUP_NAME "authorization"
+#define AUTHORIZATION_CACHE_TTL_KEY "cache_ttl"
+
+#define FORMAT_PROFILES_GROUP_NAME "format_profiles"
 
 #define MODULES_ALL_ARG "*"
 
@@ -138,11 +191,163 @@ udisks_config_manager_set_property (GObject      *object,
     }
 }
 
+static void
+parse_uint (GKeyFile    *config_file,
+            const gchar *group_name,
+            const gchar *key,
+            guint       *out_value)
+{
+  GError *error = NULL;
+  gint value;
+
+  value = g_key_file_get_integer (config_file, group_name, key, &error);
+  if (error != NULL)
+    {
+      g_error_free (error);
+      return;
+    }
+  if (value < 0)
+    {
+      udisks_warning ("Invalid value used for '%s': %d; defaulting to %u", key, value, *out_value);
+      return;
+    }
+  *out_value = value;
+}
+
+static void
+parse_encryption_flags (GKeyFile              *config_file,
+                        UDisksEncryptionFlags *out_flags)
+{
+  gchar **flags;
+  gchar **flag;
+
+  flags = g_key_file_get_string_list (config_file, DEFAULTS_GROUP_NAME, DEFAULTS_ENCRYPTION_FLAGS_KEY, NULL, NULL);
+  if (flags == NULL)
+    return;
+
+  *out_flags = UDISKS_ENCRYPTION_FLAGS_NONE;
+  for (flag = flags; *flag != NULL; flag++)
+    {
+      g_strstrip (*flag);
+      if (**flag == '\0')
+        continue;
+      else if (g_strcmp0 (*flag, "allow_discards") == 0)
+        *out_flags |= UDISKS_ENCRYPTION_FLAGS_ALLOW_DISCARDS;
+      else if (g_strcmp0 (*flag, "no_read_workqueue") == 0)
+        *out_flags |= UDISKS_ENCRYPTION_FLAGS_NO_READ_WORKQUEUE;
+      else if (g_strcmp0 (*flag, "no_write_workqueue") == 0)
+        *out_flags |= UDISKS_ENCRYPTION_FLAGS_NO_WRITE_WORKQUEUE;
+      else
+        udisks_warning ("Unknown value used for '%s': %s; ignoring", DEFAULTS_ENCRYPTION_FLAGS_KEY, *flag);
+    }
+  g_strfreev (flags);
+}
+
+static void
+parse_format_profiles (GKeyFile   *config_file,
+                       GHashTable *format_profiles)
+{
+  gchar **keys;
+  gchar **key;
+
+  keys = g_key_file_get_keys (config_file, FORMAT_PROFILES_GROUP_NAME, NULL, NULL);
+  for (key = keys; key != NULL && *key != NULL; key++)
+    {
+      gchar *options;
+
+      /* keys are <fstype>_<profile> */
+      if (strchr (*key, '_') == NULL)
+        {
+          udisks_warning ("Invalid key in the '%s' group: %s; ignoring",
+                          FORMAT_PROFILES_GROUP_NAME, *key);
+          continue;
+        }
+
+      /* not using g_key_file_get_string() as the options may contain the list separator */
+      options = g_key_file_get_value (config_file, FORMAT_PROFILES_GROUP_NAME, *key, NULL);
+      if (options != NULL)
+        g_hash_table_replace (format_profiles, g_strdup (*key), g_strstrip (options));
+    }
+  g_strfreev (keys);
+}
+
+static void
+parse_job_limits (UDisksConfigManager *manager,
+                  GKeyFile            *config_file)
+{
+  guint max_total = 0;
+  guint max_drive = 0;
+  guint max_controller = 0;
+
+  parse_uint (config_file, JOBS_GROUP_NAME, JOBS_MAX_CONCURRENT_KEY, &max_total);
+  parse_uint (config_file, JOBS_GROUP_NAME, JOBS_MAX_CONCURRENT_PER_DRIVE_KEY, &max_drive);
+  parse_uint (config_file, JOBS_GROUP_NAME, JOBS_MAX_CONCURRENT_PER_CONTROLLER_KEY, &max_controller);
+
+  /* read by the job scheduler from any thread */
+  g_atomic_int_set (&manager->max_concurrent_jobs, max_total);
+  g_atomic_int_set (&manager->max_concurrent_jobs_per_drive, max_drive);
+  g_atomic_int_set (&manager->max_concurrent_jobs_per_controller, max_controller);
+}
+
+static void
+parse_tunables (UDisksConfigManager *manager,
+                GKeyFile            *config_file)
+{
+  GError *error = NULL;
+  guint64 value64;
+  gboolean value;
+  guint sector_size;
+  gchar *cipher;
+
+  sector_size = manager->encryption_sector_size;
+  parse_uint (config_file, DEFAULTS_GROUP_NAME, DEFAULTS_ENCRYPTION_SECTOR_SIZE_KEY, &sector_size);
+  if (sector_size != 0 && !UDISKS_ENCRYPTION_SECTOR_SIZE_VALID (sector_size))
+    udisks_warning ("Invalid value used for '%s': %u; defaulting to %u",
+                    DEFAULTS_ENCRYPTION_SECTOR_SIZE_KEY, sector_size, manager->encryption_sector_size);
+  else
+    manager->encryption_sector_size = sector_size;
+  parse_encryption_flags (config_file, &manager->encryption_flags);
+
+  cipher = g_key_file_get_string (config_file, DEFAULTS_GROUP_NAME, DEFAULTS_ENCRYPTION_CIPHER_KEY, NULL);
+  if (cipher != NULL)
+    {
+      g_strstrip (cipher);
+      if (*cipher != '\0')
+        {
+          g_free (manager->encryption_cipher);
+          manager->encryption_cipher = g_steal_pointer (&cipher);
+        }
+      g_free (cipher);
+    }
+  parse_uint (config_file, DEFAULTS_GROUP_NAME, DEFAULTS_ENCRYPTION_KEY_SIZE_KEY, &manager->encryption_key_size);
+
+  value = g_key_file_get_boolean (config_file, DEFAULTS_GROUP_NAME, DEFAULTS_LOOP_DIRECT_IO_KEY, &error);
+  if (error == NULL)
+    manager->loop_direct_io = value;
+  g_clear_error (&error);
+
+  parse_uint (config_file, JOBS_GROUP_NAME, JOBS_UPDATE_INTERVAL_KEY,
+              &manager->job_update_interval);
+
+  value64 = g_key_file_get_uint64 (config_file, JOBS_GROUP_NAME, JOBS_OUTPUT_LIMIT_KEY, &error);
+  if (error == NULL)
+    manager->job_output_limit = MIN (value64, G_MAXSIZE);
+  g_clear_error (&error);
+
+  parse_job_limits (manager, config_file);
+
+  parse_uint (config_file, AUTHORIZATION_GROUP_NAME, AUTHORIZATION_CACHE_TTL_KEY,
+              &manager->authorization_cache_ttl);
+
+  parse_format_profiles (config_file, manager->format_profiles);
+}
+
 static void
 parse_config_file (UDisksConfigManager         *manager,
                    UDisksModuleLoadPreference  *out_load_preference,
                    const gchar                **out_encryption,
-                   GList                      **out_modules)
+                   GList                      **out_modules,
+                   gboolean                     read_tunables)
 {
   GKeyFile *config_file;
   gchar *conf_filename;
@@ -222,6 +427,9 @@ parse_config_file (UDisksConfigManager         *manager,
               g_free (encryption);
             }
         }
+
+      if (read_tunables)
+        parse_tunables (manager, config_file);
     }
   else
     {
@@ -232,10 +440,62 @@ parse_config_file (UDisksConfigManager         *manager,
   g_free (conf_filename);
 }
 
+static void
+drive_configuration_free (GVariant *configuration)
+{
+  if (configuration != NULL)
+    g_variant_unref (configuration);
+}
+
+static void
+reload_job_limits (UDisksConfigManager *manager)
+{
+  GKeyFile *config_file;
+  gchar *conf_filename;
+
+  conf_filename = g_build_filename (G_DIR_SEPARATOR_S,
+                                    manager->config_dir,
+                                    PACKAGE_NAME_UDISKS2 ".conf",
+                                    NULL);
+  config_file = g_key_file_new ();
+  /* a missing file means no limits */
+  g_key_file_load_from_file (config_file, conf_filename, G_KEY_FILE_NONE, NULL);
+  parse_job_limits (manager, config_file);
+  g_key_file_free (config_file);
+  g_free (conf_filename);
+}
+
+static void
+on_config_dir_changed (GFileMonitor      *monitor,
+                       GFile             *file,
+                       GFile             *other_file,
+                       GFileMonitorEvent  event_type,
+                       gpointer           user_data)
+{
+  UDisksConfigManager *manager = UDISKS_CONFIG_MANAGER (user_data);
+  gchar *basename;
+
+  g_mutex_lock (&manager->mount_options_lock);
+  g_clear_pointer (&manager->mount_options, g_hash_table_unref);
+  manager->mount_options_generation++;
+  g_mutex_unlock (&manager->mount_options_lock);
+
+  /* the job limits take effect without restarting the daemon */
+  basename = g_file_get_basename (file);
+  if (g_strcmp0 (basename, PACKAGE_NAME_UDISKS2 ".conf") == 0 &&
+      (event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT ||
+       event_type == G_FILE_MONITOR_EVENT_CREATED ||
+       event_type == G_FILE_MONITOR_EVENT_DELETED))
+    reload_job_limits (manager);
+  g_free (basename);
+}
+
 static void
 udisks_config_manager_constructed (GObject *object)
 {
   UDisksConfigManager *manager = UDISKS_CONFIG_MANAGER (object);
+  GFile *config_dir;
+  GError *error = NULL;
 
   /* Build a path to the config directory */
   manager->config_dir = g_build_path (G_DIR_SEPARATOR_S,
@@ -250,7 +510,24 @@ udisks_config_manager_constructed (GObject *object)
       udisks_warning ("Error creating directory %s: %m", manager->config_dir);
     }
 
-  parse_config_file (manager, &manager->load_preference, &manager->encryption, NULL);
+  /* Cached configuration is only used while changes can be noticed */
+  config_dir = g_file_new_for_path (manager->config_dir);
+  manager->config_dir_monitor = g_file_monitor_directory (config_dir, G_FILE_MONITOR_NONE, NULL, &error);
+  if (manager->config_dir_monitor != NULL)
+    {
+      g_signal_connect (manager->config_dir_monitor,
+                        "changed",
+                        G_CALLBACK (on_config_dir_changed),
+                        manager);
+    }
+  else
+    {
+      udisks_warning ("Error monitoring directory %s: %s", manager->config_dir, error->message);
+      g_clear_error (&error);
+    }
+  g_object_unref (config_dir);
+
+  parse_config_file (manager, &manager->load_preference, &manager->encryption, NULL, TRUE);
 
   if (G_OBJECT_CLASS (udisks_config_manager_parent_class))
     G_OBJECT_CLASS (udisks_config_manager_parent_class)->constructed (object);
@@ -259,6 +536,17 @@ udisks_config_manager_constructed (GObject *object)
 static void
 udisks_config_manager_dispose (GObject *object)
 {
+  UDisksConfigManager *manager = UDISKS_CONFIG_MANAGER (object);
+
+  if (manager->config_dir_monitor != NULL)
+    {
+      g_signal_handlers_disconnect_by_func (manager->config_dir_monitor,
+                                            G_CALLBACK (on_config_dir_changed),
+                                            manager);
+      g_file_monitor_cancel (manager->config_dir_monitor);
+      g_clear_object (&manager->config_dir_monitor);
+    }
+
   if (G_OBJECT_CLASS (udisks_config_manager_parent_class))
     G_OBJECT_CLASS (udisks_config_manager_parent_class)->dispose (object);
 }
@@ -269,6 +557,13 @@ udisks_config_manager_finalize (GObject *object)
   UDisksConfigManager *manager = UDISKS_CONFIG_MANAGER (object);
 
   g_free (manager->config_dir);
+  g_free (manager->encryption_cipher);
+  g_mutex_clear (&manager->encryption_cipher_lock);
+  g_hash_table_unref (manager->format_profiles);
+  g_clear_pointer (&manager->mount_options, g_hash_table_unref);
+  g_mutex_clear (&manager->mount_options_lock);
+  g_hash_table_unref (manager->drive_configurations);
+  g_mutex_clear (&manager->drive_configurations_lock);
 
   if (G_OBJECT_CLASS (udisks_config_manager_parent_class))
     G_OBJECT_CLASS (udisks_config_manager_parent_class)->finalize (object);
@@ -342,6 +637,16 @@ udisks_config_manager_init (UDisksConfigManager *manager)
 {
   manager->load_preference = UDISKS_MODULE_LOAD_ONDEMAND;
   manager->encryption = UDISKS_ENCRYPTION_DEFAULT;
+  g_mutex_init (&manager->encryption_cipher_lock);
+  manager->loop_direct_io = TRUE;
+  manager->job_update_interval = UDISKS_JOB_UPDATE_INTERVAL_DEFAULT;
+  manager->job_output_limit = UDISKS_JOB_OUTPUT_LIMIT_DEFAULT;
+  manager->authorization_cache_ttl = UDISKS_AUTHORIZATION_CACHE_TTL_DEFAULT;
+  manager->format_profiles = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_mutex_init (&manager->mount_options_lock);
+  manager->drive_configurations = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                         (GDestroyNotify) drive_configuration_free);
+  g_mutex_init (&manager->drive_configurations_lock);
 }
 
 UDisksConfigManager *
@@ -386,7 +691,7 @@ udisks_config_manager_get_modules (UDisksConfigManager *manager)
 
   g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), NULL);
 
-  parse_config_file (manager, NULL, NULL, &modules);
+  parse_config_file (manager, NULL, NULL, &modules, FALSE);
   return modules;
 }
 
@@ -407,7 +712,7 @@ udisks_config_manager_get_modules_all (UDisksConfigManager *manager)
 
   g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), FALSE);
 
-  parse_config_file (manager, NULL, NULL, &modules);
+  parse_config_file (manager, NULL, NULL, &modules, FALSE);
 
   ret = !modules || (g_strcmp0 (modules->data, MODULES_ALL_ARG) == 0 && g_list_length (modules) == 1);
 
@@ -432,6 +737,386 @@ udisks_config_manager_get_encryption (UDisksConfigManager *manager)
   return manager->encryption;
 }
 
+/**
+ * udisks_config_manager_get_encryption_sector_size:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the default sector size of newly created LUKS2 devices.
+ *
+ * Returns: The sector size in bytes or 0 to use the cryptsetup default.
+ */
+guint
+udisks_config_manager_get_encryption_sector_size (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), 0);
+  return manager->encryption_sector_size;
+}
+
+/**
+ * udisks_config_manager_get_encryption_flags:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the dm-crypt flags applied by default to formatted and unlocked
+ * LUKS2 devices.
+ *
+ * Returns: A mask of #UDisksEncryptionFlags.
+ */
+UDisksEncryptionFlags
+udisks_config_manager_get_encryption_flags (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), UDISKS_ENCRYPTION_FLAGS_NONE);
+  return manager->encryption_flags;
+}
+
+/**
+ * udisks_config_manager_dup_encryption_cipher:
+ * @manager: A #UDisksConfigManager.
+ * @out_key_size: (out) (optional): Return location for the volume key size in bits,
+ *   0 means the cryptsetup default.
+ *
+ * Gets the default cipher specification of newly created LUKS devices,
+ * e.g. <literal>aes-xts-plain64</literal>.
+ *
+ * Returns: (transfer full) (nullable): The cipher or %NULL to use the cryptsetup
+ *   default. Free with g_free().
+ */
+gchar *
+udisks_config_manager_dup_encryption_cipher (UDisksConfigManager *manager,
+                                             guint               *out_key_size)
+{
+  gchar *ret;
+
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), NULL);
+
+  g_mutex_lock (&manager->encryption_cipher_lock);
+  ret = g_strdup (manager->encryption_cipher);
+  if (out_key_size != NULL)
+    *out_key_size = manager->encryption_key_size;
+  g_mutex_unlock (&manager->encryption_cipher_lock);
+
+  return ret;
+}
+
+/**
+ * udisks_config_manager_set_encryption_cipher:
+ * @manager: A #UDisksConfigManager.
+ * @cipher: (nullable): The cipher specification or %NULL to use the cryptsetup default.
+ * @key_size: The volume key size in bits or 0 to use the cryptsetup default.
+ *
+ * Changes the default cipher of newly created LUKS devices until the
+ * daemon is restarted. The configuration file is not modified.
+ */
+void
+udisks_config_manager_set_encryption_cipher (UDisksConfigManager *manager,
+                                             const gchar         *cipher,
+                                             guint                key_size)
+{
+  g_return_if_fail (UDISKS_IS_CONFIG_MANAGER (manager));
+
+  g_mutex_lock (&manager->encryption_cipher_lock);
+  g_free (manager->encryption_cipher);
+  manager->encryption_cipher = g_strdup (cipher);
+  manager->encryption_key_size = key_size;
+  g_mutex_unlock (&manager->encryption_cipher_lock);
+}
+
+/**
+ * udisks_config_manager_get_loop_direct_io:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets whether loop devices set up without an explicit
+ * <literal>direct-io</literal> option use direct I/O on the backing
+ * file when its alignment allows it.
+ *
+ * Returns: %TRUE if direct I/O is used by default.
+ */
+gboolean
+udisks_config_manager_get_loop_direct_io (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), FALSE);
+  return manager->loop_direct_io;
+}
+
+/**
+ * udisks_config_manager_get_job_update_interval:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the minimal interval between two updates of the estimated rate
+ * and end time of a job.
+ *
+ * Returns: The interval in milliseconds, 0 means no throttling.
+ */
+guint
+udisks_config_manager_get_job_update_interval (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager),
+                        UDISKS_JOB_UPDATE_INTERVAL_DEFAULT);
+  return manager->job_update_interval;
+}
+
+/**
+ * udisks_config_manager_get_job_output_limit:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the maximal number of bytes of standard output and standard error
+ * that spawned jobs keep from the programs they run.
+ *
+ * Returns: The limit in bytes, 0 means no limit.
+ */
+gsize
+udisks_config_manager_get_job_output_limit (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager),
+                        UDISKS_JOB_OUTPUT_LIMIT_DEFAULT);
+  return manager->job_output_limit;
+}
+
+/**
+ * udisks_config_manager_get_max_concurrent_jobs:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the maximal number of jobs the #UDisksJobScheduler lets run at
+ * the same time.
+ *
+ * Returns: The limit or 0 if not limited.
+ */
+guint
+udisks_config_manager_get_max_concurrent_jobs (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), 0);
+  return (guint) g_atomic_int_get (&manager->max_concurrent_jobs);
+}
+
+/**
+ * udisks_config_manager_get_max_concurrent_jobs_per_drive:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the maximal number of jobs that may run on a single drive at
+ * the same time.
+ *
+ * Returns: The limit or 0 if not limited.
+ */
+guint
+udisks_config_manager_get_max_concurrent_jobs_per_drive (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), 0);
+  return (guint) g_atomic_int_get (&manager->max_concurrent_jobs_per_drive);
+}
+
+/**
+ * udisks_config_manager_get_max_concurrent_jobs_per_controller:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the maximal number of jobs that may run on drives attached to
+ * a single controller at the same time.
+ *
+ * Returns: The limit or 0 if not limited.
+ */
+guint
+udisks_config_manager_get_max_concurrent_jobs_per_controller (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), 0);
+  return (guint) g_atomic_int_get (&manager->max_concurrent_jobs_per_controller);
+}
+
+/**
+ * udisks_config_manager_get_authorization_cache_ttl:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets for how long an authorization obtained without user interaction
+ * is reused for further calls of the same caller.
+ *
+ * Returns: The time in milliseconds, 0 means authorizations are not cached.
+ */
+guint
+udisks_config_manager_get_authorization_cache_ttl (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), 0);
+  return manager->authorization_cache_ttl;
+}
+
+/**
+ * udisks_config_manager_get_format_profile:
+ * @manager: A #UDisksConfigManager.
+ * @fstype: The filesystem type, e.g. <literal>ext4</literal>.
+ * @profile: The format profile, e.g. <literal>fast</literal>.
+ *
+ * Gets the mkfs options configured for @profile and @fstype in the
+ * <literal>[format_profiles]</literal> group of the configuration file,
+ * overriding the built-in mapping.
+ *
+ * Returns: (transfer none) (nullable): The options, possibly empty, or %NULL
+ *          if the built-in mapping should be used. Do not free, the string
+ *          is owned by @manager.
+ */
+const gchar *
+udisks_config_manager_get_format_profile (UDisksConfigManager *manager,
+                                          const gchar         *fstype,
+                                          const gchar         *profile)
+{
+  const gchar *options;
+  gchar *key;
+
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), NULL);
+
+  key = g_strdup_printf ("%s_%s", fstype, profile);
+  options = g_hash_table_lookup (manager->format_profiles, key);
+  g_free (key);
+
+  return options;
+}
+
+/**
+ * udisks_config_manager_dup_mount_options:
+ * @manager: A #UDisksConfigManager.
+ * @stamp: The modification time of the mount options file in microseconds, 0 if it does not exist.
+ * @out_generation: (out): Return location for the generation to pass to udisks_config_manager_set_mount_options().
+ *
+ * Gets the parsed global mount options overrides cached by
+ * udisks_config_manager_set_mount_options() for the same @stamp. The
+ * cache is dropped whenever a file in the configuration directory
+ * changes, @stamp catches changes made before the file monitor
+ * reported them.
+ *
+ * Returns: (transfer full) (nullable): The overrides as set, or %NULL if
+ *          they need to be parsed again. Free with g_hash_table_unref().
+ */
+GHashTable *
+udisks_config_manager_dup_mount_options (UDisksConfigManager *manager,
+                                         gint64               stamp,
+                                         guint               *out_generation)
+{
+  GHashTable *ret = NULL;
+
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), NULL);
+
+  g_mutex_lock (&manager->mount_options_lock);
+  if (manager->mount_options != NULL && manager->mount_options_stamp == stamp)
+    ret = g_hash_table_ref (manager->mount_options);
+  *out_generation = manager->mount_options_generation;
+  g_mutex_unlock (&manager->mount_options_lock);
+
+  return ret;
+}
+
+/**
+ * udisks_config_manager_set_mount_options:
+ * @manager: A #UDisksConfigManager.
+ * @mount_options: The parsed global mount options overrides.
+ * @stamp: The modification time of the mount options file before parsing it.
+ * @generation: The generation returned by udisks_config_manager_dup_mount_options() before parsing.
+ *
+ * Caches @mount_options for udisks_config_manager_dup_mount_options().
+ * Nothing is cached if the configuration directory changed since
+ * @generation was obtained or if it cannot be monitored.
+ */
+void
+udisks_config_manager_set_mount_options (UDisksConfigManager *manager,
+                                         GHashTable          *mount_options,
+                                         gint64               stamp,
+                                         guint                generation)
+{
+  g_return_if_fail (UDISKS_IS_CONFIG_MANAGER (manager));
+
+  g_mutex_lock (&manager->mount_options_lock);
+  if (manager->config_dir_monitor != NULL && manager->mount_options_generation == generation)
+    {
+      g_clear_pointer (&manager->mount_options, g_hash_table_unref);
+      manager->mount_options = g_hash_table_ref (mount_options);
+      manager->mount_options_stamp = stamp;
+    }
+  g_mutex_unlock (&manager->mount_options_lock);
+}
+
+/**
+ * udisks_config_manager_lookup_drive_configuration:
+ * @manager: A #UDisksConfigManager.
+ * @id: The drive id, i.e. the name of its configuration file without the <filename>.conf</filename> suffix.
+ * @out_configuration: (out) (transfer full) (nullable): Return location for the cached configuration or %NULL.
+ * @out_generation: (out): Return location for the generation to pass to udisks_config_manager_set_drive_configuration().
+ *
+ * Looks up the drive configuration cached for @id by
+ * udisks_config_manager_set_drive_configuration(). A cached %NULL
+ * configuration means that the drive has no configuration file.
+ *
+ * Returns: %TRUE if @out_configuration is valid, %FALSE if the
+ *          configuration file needs to be parsed again.
+ */
+gboolean
+udisks_config_manager_lookup_drive_configuration (UDisksConfigManager  *manager,
+                                                  const gchar          *id,
+                                                  GVariant            **out_configuration,
+                                                  guint                *out_generation)
+{
+  gpointer value = NULL;
+  gboolean ret;
+
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), FALSE);
+  g_return_val_if_fail (id != NULL, FALSE);
+
+  g_mutex_lock (&manager->drive_configurations_lock);
+  ret = g_hash_table_lookup_extended (manager->drive_configurations, id, NULL, &value);
+  *out_configuration = value != NULL ? g_variant_ref (value) : NULL;
+  *out_generation = manager->drive_configurations_generation;
+  g_mutex_unlock (&manager->drive_configurations_lock);
+
+  return ret;
+}
+
+/**
+ * udisks_config_manager_set_drive_configuration:
+ * @manager: A #UDisksConfigManager.
+ * @id: The drive id.
+ * @configuration: (nullable): The parsed configuration or %NULL if there is no configuration file.
+ * @generation: The generation returned by udisks_config_manager_lookup_drive_configuration() before parsing.
+ *
+ * Caches @configuration for udisks_config_manager_lookup_drive_configuration().
+ * Nothing is cached if a drive configuration was invalidated since
+ * @generation was obtained or if the configuration directory cannot be
+ * monitored.
+ */
+void
+udisks_config_manager_set_drive_configuration (UDisksConfigManager *manager,
+                                               const gchar         *id,
+                                               GVariant            *configuration,
+                                               guint                generation)
+{
+  g_return_if_fail (UDISKS_IS_CONFIG_MANAGER (manager));
+  g_return_if_fail (id != NULL);
+
+  g_mutex_lock (&manager->drive_configurations_lock);
+  if (manager->config_dir_monitor != NULL && manager->drive_configurations_generation == generation)
+    {
+      g_hash_table_replace (manager->drive_configurations,
+                            g_strdup (id),
+                            configuration != NULL ? g_variant_ref_sink (configuration) : NULL);
+    }
+  g_mutex_unlock (&manager->drive_configurations_lock);
+}
+
+/**
+ * udisks_config_manager_invalidate_drive_configuration:
+ * @manager: A #UDisksConfigManager.
+ * @id: (nullable): The drive id or %NULL to invalidate all drives.
+ *
+ * Drops the cached configuration of the drive with @id, to be called
+ * when its configuration file was created, changed or removed.
+ */
+void
+udisks_config_manager_invalidate_drive_configuration (UDisksConfigManager *manager,
+                                                      const gchar         *id)
+{
+  g_return_if_fail (UDISKS_IS_CONFIG_MANAGER (manager));
+
+  g_mutex_lock (&manager->drive_configurations_lock);
+  if (id != NULL)
+    g_hash_table_remove (manager->drive_configurations, id);
+  else
+    g_hash_table_remove_all (manager->drive_configurations);
+  manager->drive_configurations_generation++;
+  g_mutex_unlock (&manager->drive_configurations_lock);
+}
+
 /**
  * udisks_config_manager_get_config_dir:
  * @manager: A #UDisksConfigManager.
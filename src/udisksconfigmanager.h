@@ -49,6 +49,36 @@ typedef enum
 #define UDISKS_ENCRYPTION_LUKS2 "luks2"
 #define UDISKS_ENCRYPTION_DEFAULT UDISKS_ENCRYPTION_LUKS1
 
+/* sector sizes supported by dm-crypt, in bytes */
+#define UDISKS_ENCRYPTION_SECTOR_SIZE_VALID(size) ((size) >= 512 && (size) <= 4096 && ((size) & ((size) - 1)) == 0)
+
+/**
+ * UDisksEncryptionFlags:
+ * @UDISKS_ENCRYPTION_FLAGS_NONE: No flags.
+ * @UDISKS_ENCRYPTION_FLAGS_ALLOW_DISCARDS: Pass discard requests to the underlying device.
+ * @UDISKS_ENCRYPTION_FLAGS_NO_READ_WORKQUEUE: Decrypt synchronously instead of using the kcryptd workqueue.
+ * @UDISKS_ENCRYPTION_FLAGS_NO_WRITE_WORKQUEUE: Encrypt synchronously instead of using the kcryptd workqueue.
+ * @UDISKS_ENCRYPTION_FLAGS_ALL: All of the flags above.
+ *
+ * dm-crypt flags used when unlocking LUKS devices and stored in the
+ * LUKS2 header of newly created devices.
+ */
+typedef enum
+{
+  UDISKS_ENCRYPTION_FLAGS_NONE               = 0,
+  UDISKS_ENCRYPTION_FLAGS_ALLOW_DISCARDS     = 1 << 0,
+  UDISKS_ENCRYPTION_FLAGS_NO_READ_WORKQUEUE  = 1 << 1,
+  UDISKS_ENCRYPTION_FLAGS_NO_WRITE_WORKQUEUE = 1 << 2,
+  UDISKS_ENCRYPTION_FLAGS_ALL                = (1 << 3) - 1,
+} UDisksEncryptionFlags;
+
+/* in milliseconds */
+#define UDISKS_JOB_UPDATE_INTERVAL_DEFAULT 1000
+/* in bytes */
+#define UDISKS_JOB_OUTPUT_LIMIT_DEFAULT (1024 * 1024)
+/* in milliseconds */
+#define UDISKS_AUTHORIZATION_CACHE_TTL_DEFAULT 5000
+
 GType                 udisks_config_manager_get_type        (void) G_GNUC_CONST;
 UDisksConfigManager  *udisks_config_manager_new             (void);
 UDisksConfigManager  *udisks_config_manager_new_uninstalled (void);
@@ -60,6 +90,40 @@ gboolean              udisks_config_manager_get_modules_all (UDisksConfigManager
 UDisksModuleLoadPreference
                       udisks_config_manager_get_load_preference (UDisksConfigManager *manager);
 const gchar          *udisks_config_manager_get_encryption (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_encryption_sector_size (UDisksConfigManager *manager);
+UDisksEncryptionFlags udisks_config_manager_get_encryption_flags (UDisksConfigManager *manager);
+gchar                *udisks_config_manager_dup_encryption_cipher (UDisksConfigManager *manager,
+                                                                   guint               *out_key_size);
+void                  udisks_config_manager_set_encryption_cipher (UDisksConfigManager *manager,
+                                                                   const gchar         *cipher,
+                                                                   guint                key_size);
+gboolean              udisks_config_manager_get_loop_direct_io (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_job_update_interval (UDisksConfigManager *manager);
+gsize                 udisks_config_manager_get_job_output_limit (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_max_concurrent_jobs (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_max_concurrent_jobs_per_drive (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_max_concurrent_jobs_per_controller (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_authorization_cache_ttl (UDisksConfigManager *manager);
+const gchar          *udisks_config_manager_get_format_profile (UDisksConfigManager *manager,
+                                                                const gchar         *fstype,
+                                                                const gchar         *profile);
+GHashTable           *udisks_config_manager_dup_mount_options (UDisksConfigManager *manager,
+                                                               gint64               stamp,
+                                                               guint               *out_generation);
+void                  udisks_config_manager_set_mount_options (UDisksConfigManager *manager,
+                                                               GHashTable          *mount_options,
+                                                               gint64               stamp,
+                                                               guint                generation);
+gboolean              udisks_config_manager_lookup_drive_configuration (UDisksConfigManager  *manager,
+                                                                        const gchar          *id,
+                                                                        GVariant            **out_configuration,
+                                                                        guint                *out_generation);
+void                  udisks_config_manager_set_drive_configuration (UDisksConfigManager *manager,
+                                                                     const gchar         *id,
+                                                                     GVariant            *configuration,
+                                                                     guint                generation);
+void                  udisks_config_manager_invalidate_drive_configuration (UDisksConfigManager *manager,
+                                                                            const gchar         *id);
 
 const gchar          *udisks_config_manager_get_config_dir  (UDisksConfigManager *manager);
 
@@ -43,6 +43,9 @@
 #include "udisksmodulemanager.h"
 #include "udisksmodule.h"
 #include "udisksconfigmanager.h"
+#include "udisksjobscheduler.h"
+#include "udisksauthorizationcache.h"
+#include "udisksstagestatistics.h"
 #include "udiskslinuxmountoptions.h"
 #include "udisksutabmonitor.h"
 
@@ -84,6 +87,12 @@ struct _UDisksDaemon
 
   UDisksConfigManager *config_manager;
 
+  UDisksJobScheduler *job_scheduler;
+
+  UDisksAuthorizationCache *authorization_cache;
+
+  UDisksStageStatistics *stage_statistics;
+
   gboolean disable_modules;
   gboolean force_load_modules;
   gboolean uninstalled;
@@ -124,6 +133,8 @@ udisks_daemon_finalize (GObject *object)
   /* Modules use the monitors and try to reference them when cleaning up */
   udisks_module_manager_unload_modules (daemon->module_manager);
 
+  g_clear_object (&daemon->authorization_cache);
+  g_clear_object (&daemon->stage_statistics);
   g_clear_object (&daemon->authority);
   g_object_unref (daemon->object_manager);
   g_object_unref (daemon->linux_provider);
@@ -136,6 +147,7 @@ udisks_daemon_finalize (GObject *object)
   g_object_unref (daemon->state);
   g_free (daemon->uuid);
 
+  g_clear_object (&daemon->job_scheduler);
   g_clear_object (&daemon->config_manager);
 
   if (G_OBJECT_CLASS (udisks_daemon_parent_class)->finalize != NULL)
@@ -408,6 +420,10 @@ udisks_daemon_constructed (GObject *object)
       daemon->module_manager = udisks_module_manager_new_uninstalled (daemon);
     }
 
+  daemon->job_scheduler = udisks_job_scheduler_new (daemon);
+  daemon->authorization_cache = udisks_authorization_cache_new (daemon);
+  daemon->stage_statistics = udisks_stage_statistics_new ();
+
   daemon->mount_monitor = udisks_mount_monitor_new ();
 
   daemon->state = udisks_state_new (daemon);
@@ -770,6 +786,9 @@ on_job_completed (UDisksJob    *job,
                                          g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
   g_object_unref (object);
 
+  /* let queued jobs run */
+  udisks_job_scheduler_release (daemon->job_scheduler, UDISKS_BASE_JOB (job));
+
   /* free the allocated job object */
   g_object_unref (job);
 
@@ -818,6 +837,7 @@ common_job (UDisksDaemon    *daemon,
   udisks_job_set_cancelable (UDISKS_JOB (job), TRUE);
   udisks_job_set_operation (UDISKS_JOB (job), job_operation);
   udisks_job_set_started_by_uid (UDISKS_JOB (job), job_started_by_uid);
+  udisks_job_set_state (UDISKS_JOB (job), UDISKS_JOB_STATE_RUNNING);
 
   g_dbus_object_manager_server_export (daemon->object_manager, G_DBUS_OBJECT_SKELETON (job_object));
   g_signal_connect_after (job,
@@ -1736,6 +1756,51 @@ udisks_daemon_get_module_manager (UDisksDaemon *daemon)
   return daemon->module_manager;
 }
 
+/**
+ * udisks_daemon_get_job_scheduler:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Gets the job scheduler used by @daemon.
+ *
+ * Returns: A #UDisksJobScheduler. Do not free, the object is owned by @daemon.
+ */
+UDisksJobScheduler *
+udisks_daemon_get_job_scheduler (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return daemon->job_scheduler;
+}
+
+/**
+ * udisks_daemon_get_authorization_cache:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Gets the cache of caller credentials and authorizations used by @daemon.
+ *
+ * Returns: A #UDisksAuthorizationCache. Do not free, the object is owned by @daemon.
+ */
+UDisksAuthorizationCache *
+udisks_daemon_get_authorization_cache (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return daemon->authorization_cache;
+}
+
+/**
+ * udisks_daemon_get_stage_statistics:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Gets the aggregated durations of job stages recorded by @daemon.
+ *
+ * Returns: A #UDisksStageStatistics. Do not free, the object is owned by @daemon.
+ */
+UDisksStageStatistics *
+udisks_daemon_get_stage_statistics (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return daemon->stage_statistics;
+}
+
 /**
  * udisks_daemon_get_config_manager:
  * @daemon: A #UDisksDaemon.
@@ -46,6 +46,9 @@ PolkitAuthority          *udisks_daemon_get_authority         (UDisksDaemon    *
 UDisksState              *udisks_daemon_get_state             (UDisksDaemon    *daemon);
 UDisksModuleManager      *udisks_daemon_get_module_manager    (UDisksDaemon    *daemon);
 UDisksConfigManager      *udisks_daemon_get_config_manager    (UDisksDaemon    *daemon);
+UDisksJobScheduler       *udisks_daemon_get_job_scheduler     (UDisksDaemon    *daemon);
+UDisksAuthorizationCache *udisks_daemon_get_authorization_cache (UDisksDaemon  *daemon);
+UDisksStageStatistics    *udisks_daemon_get_stage_statistics  (UDisksDaemon    *daemon);
 gboolean                  udisks_daemon_get_disable_modules   (UDisksDaemon    *daemon);
 gboolean                  udisks_daemon_get_force_load_modules(UDisksDaemon    *daemon);
 gboolean                  udisks_daemon_get_uninstalled       (UDisksDaemon    *daemon);
@@ -128,6 +128,15 @@ typedef struct _UDisksLinuxNVMeNamespace UDisksLinuxNVMeNamespace;
 typedef struct _UDisksConfigManager        UDisksConfigManager;
 typedef struct _UDisksConfigManagerClass   UDisksConfigManagerClass;
 
+struct _UDisksJobScheduler;
+typedef struct _UDisksJobScheduler UDisksJobScheduler;
+
+struct _UDisksAuthorizationCache;
+typedef struct _UDisksAuthorizationCache UDisksAuthorizationCache;
+
+struct _UDisksStageStatistics;
+typedef struct _UDisksStageStatistics UDisksStageStatistics;
+
 /**
  * UDisksThreadedJobFunc:
  * @job: A #UDisksThreadedJob.
@@ -44,6 +44,7 @@
 #include "udiskslinuxprovider.h"
 #include "udiskslinuxblockobject.h"
 #include "udiskslinuxdriveobject.h"
+#include "udisksauthorizationcache.h"
 
 #if defined(HAVE_LIBSYSTEMD_LOGIN)
 #include <systemd/sd-daemon.h>
@@ -774,6 +775,10 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
   gboolean auth_no_user_interaction = FALSE;
   const gchar *details_device = NULL;
   gchar *details_drive = NULL;
+  UDisksAuthorizationCache *cache;
+  const gchar *caller;
+  const gchar *object_path = NULL;
+  uid_t caller_uid;
 
   authority = udisks_daemon_get_authority (daemon);
   if (authority == NULL)
@@ -782,7 +787,8 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
       goto out;
     }
 
-  subject = polkit_system_bus_name_new (g_dbus_method_invocation_get_sender (invocation));
+  caller = g_dbus_method_invocation_get_sender (invocation);
+  subject = polkit_system_bus_name_new (caller);
   if (options != NULL)
     {
       g_variant_lookup (options,
@@ -910,6 +916,16 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
   if (details_drive != NULL)
     polkit_details_insert (details, "drive", details_drive);
 
+  /* only after all the details are known, rules may match on any of them */
+  cache = udisks_daemon_get_authorization_cache (daemon);
+  if (object != NULL)
+    object_path = g_dbus_object_get_object_path (G_DBUS_OBJECT (object));
+  if (udisks_authorization_cache_lookup (cache, caller, action_id, object_path, details))
+    {
+      ret = TRUE;
+      goto out;
+    }
+
   sub_error = NULL;
   result = polkit_authority_check_authorization_sync (authority,
                                                       subject,
@@ -958,6 +974,13 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
       goto out;
     }
 
+  /* Only remember results that could not have involved an authentication
+   * dialog, polkit always authorizes root without one.
+   */
+  if (auth_no_user_interaction ||
+      (udisks_daemon_util_get_caller_uid_sync (daemon, invocation, NULL, &caller_uid, NULL) && caller_uid == 0))
+    udisks_authorization_cache_insert (cache, caller, action_id, object_path, details);
+
   ret = TRUE;
 
  out:
@@ -1099,18 +1122,24 @@ udisks_daemon_util_get_caller_uid_sync (UDisksDaemon            *daemon,
                                         uid_t                   *out_uid,
                                         GError                 **error)
 {
+  UDisksAuthorizationCache *cache;
+  const gchar *caller;
   gboolean ret;
   uid_t uid;
 
-  /* TODO: cache this on @daemon */
-
   ret = FALSE;
 
-  if (!dbus_freedesktop_guint32_get (invocation, cancellable,
-                                     "GetConnectionUnixUser",
-                                     &uid, error))
+  cache = udisks_daemon_get_authorization_cache (daemon);
+  caller = g_dbus_method_invocation_get_sender (invocation);
+  if (!udisks_authorization_cache_lookup_uid (cache, caller, &uid))
     {
-      goto out;
+      if (!dbus_freedesktop_guint32_get (invocation, cancellable,
+                                         "GetConnectionUnixUser",
+                                         &uid, error))
+        {
+          goto out;
+        }
+      udisks_authorization_cache_insert_uid (cache, caller, uid);
     }
 
   if (out_uid != NULL)
@@ -1143,15 +1172,26 @@ udisks_daemon_util_get_caller_pid_sync (UDisksDaemon            *daemon,
                                         pid_t                   *out_pid,
                                         GError                 **error)
 {
-  /* "GetConnectionUnixProcessID" */
+  UDisksAuthorizationCache *cache;
+  const gchar *caller;
+  pid_t pid;
 
-  /* TODO: cache this on @daemon */
-  /* NOTE: pid_t is a signed 32 bit, but the
-   * GetConnectionUnixProcessID dbus method returns an unsigned */
+  cache = udisks_daemon_get_authorization_cache (daemon);
+  caller = g_dbus_method_invocation_get_sender (invocation);
+  if (!udisks_authorization_cache_lookup_pid (cache, caller, &pid))
+    {
+      /* NOTE: pid_t is a signed 32 bit, but the
+       * GetConnectionUnixProcessID dbus method returns an unsigned */
+      if (!dbus_freedesktop_guint32_get (invocation, cancellable,
+                                         "GetConnectionUnixProcessID",
+                                         (guint32*)(&pid), error))
+        return FALSE;
+      udisks_authorization_cache_insert_pid (cache, caller, pid);
+    }
 
-  return dbus_freedesktop_guint32_get (invocation, cancellable,
-                                       "GetConnectionUnixProcessID",
-                                       (guint32*)(out_pid), error);
+  if (out_pid != NULL)
+    *out_pid = pid;
+  return TRUE;
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -0,0 +1,637 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "udiskslogging.h"
+#include "udisksdaemon.h"
+#include "udisksbasejob.h"
+#include "udisksconfigmanager.h"
+#include "udisksjobscheduler.h"
+#include "udiskslinuxblockobject.h"
+#include "udiskslinuxdriveobject.h"
+#include "udiskslinuxdevice.h"
+
+/**
+ * SECTION:udisksjobscheduler
+ * @title: UDisksJobScheduler
+ * @short_description: Limits the number of concurrently running jobs
+ *
+ * The #UDisksJobScheduler limits how many jobs run at the same time,
+ * globally as well as per drive and per controller, as configured in
+ * the <literal>[jobs]</literal> section of the udisks2.conf file.
+ *
+ * A job that would exceed any of the limits is kept in the
+ * <literal>queued</literal> state (see the
+ * <link linkend="gdbus-property-org-freedesktop-UDisks2-Job.State">State</link>
+ * property) until a slot becomes free. Queued jobs are started in the
+ * order of their #UDisksJobPriority and, within the same priority, in
+ * the order they were queued. A job queued for an idle drive may start
+ * before a job waiting for a busy one.
+ *
+ * Jobs launched while running an admitted job, e.g. from the job function
+ * of a threaded job (see udisks_job_scheduler_enter_job()), are started
+ * right away to avoid deadlocks of nested jobs.
+ *
+ * Waiting never blocks a thread: udisks_job_scheduler_submit() returns
+ * right away and the job is started from the thread-default main context
+ * of the caller once it may run. Spawned and threaded jobs of a daemon are
+ * submitted by udisks_spawned_job_start(), udisks_threaded_job_start()
+ * and udisks_threaded_job_run_sync(). Simple jobs are neither queued nor
+ * counted, they only report the progress of work done by their callers.
+ */
+
+typedef struct _UDisksJobSchedulerClass UDisksJobSchedulerClass;
+
+typedef struct
+{
+  volatile gint ref_count;
+  UDisksJobScheduler *scheduler;
+  UDisksBaseJob *job;
+  UDisksJobPriority priority;
+  guint64 seq;
+  gchar *drive_key;
+  gchar *controller_key;
+  gboolean was_queued;
+
+  UDisksJobSchedulerStartFunc start_func;
+  gpointer user_data;
+  GMainContext *context;
+  GCancellable *cancellable;
+  gulong cancelled_handler_id;
+  GError *error;
+} SchedulerEntry;
+
+/* the admitted job the calling thread is working for */
+static GPrivate current_job = G_PRIVATE_INIT (NULL);
+
+/**
+ * UDisksJobScheduler:
+ *
+ * The #UDisksJobScheduler structure contains only private data and should
+ * only be accessed using the provided API.
+ */
+struct _UDisksJobScheduler
+{
+  GObject parent_instance;
+
+  UDisksDaemon *daemon;
+
+  GMutex lock;
+  guint64 seq;
+
+  /* of SchedulerEntry, sorted by priority and queueing order */
+  GList *queue;
+  /* of SchedulerEntry */
+  GList *running;
+};
+
+struct _UDisksJobSchedulerClass
+{
+  GObjectClass parent_class;
+};
+
+enum
+{
+  PROP_0,
+  PROP_DAEMON,
+};
+
+G_DEFINE_TYPE (UDisksJobScheduler, udisks_job_scheduler, G_TYPE_OBJECT);
+
+static SchedulerEntry *
+scheduler_entry_ref (SchedulerEntry *entry)
+{
+  g_atomic_int_inc (&entry->ref_count);
+  return entry;
+}
+
+static void
+scheduler_entry_unref (SchedulerEntry *entry)
+{
+  if (!g_atomic_int_dec_and_test (&entry->ref_count))
+    return;
+
+  g_object_unref (entry->job);
+  g_free (entry->drive_key);
+  g_free (entry->controller_key);
+  g_main_context_unref (entry->context);
+  g_object_unref (entry->cancellable);
+  g_clear_error (&entry->error);
+  g_free (entry);
+}
+
+static void
+udisks_job_scheduler_finalize (GObject *object)
+{
+  UDisksJobScheduler *scheduler = UDISKS_JOB_SCHEDULER (object);
+
+  g_warn_if_fail (scheduler->queue == NULL);
+  g_list_free_full (scheduler->running, (GDestroyNotify) scheduler_entry_unref);
+  g_mutex_clear (&scheduler->lock);
+
+  if (G_OBJECT_CLASS (udisks_job_scheduler_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (udisks_job_scheduler_parent_class)->finalize (object);
+}
+
+static void
+udisks_job_scheduler_set_property (GObject      *object,
+                                   guint         prop_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+  UDisksJobScheduler *scheduler = UDISKS_JOB_SCHEDULER (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_assert (scheduler->daemon == NULL);
+      /* we don't take a reference to the daemon */
+      scheduler->daemon = g_value_get_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_job_scheduler_init (UDisksJobScheduler *scheduler)
+{
+  g_mutex_init (&scheduler->lock);
+}
+
+static void
+udisks_job_scheduler_class_init (UDisksJobSchedulerClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize     = udisks_job_scheduler_finalize;
+  gobject_class->set_property = udisks_job_scheduler_set_property;
+
+  /**
+   * UDisksJobScheduler:daemon:
+   *
+   * The #UDisksDaemon the scheduler is for.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_DAEMON,
+                                   g_param_spec_object ("daemon",
+                                                        "Daemon",
+                                                        "The daemon the scheduler is for",
+                                                        UDISKS_TYPE_DAEMON,
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * udisks_job_scheduler_new:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Creates a new #UDisksJobScheduler instance.
+ *
+ * Returns: A new #UDisksJobScheduler. Free with g_object_unref().
+ */
+UDisksJobScheduler *
+udisks_job_scheduler_new (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return UDISKS_JOB_SCHEDULER (g_object_new (UDISKS_TYPE_JOB_SCHEDULER,
+                                             "daemon", daemon,
+                                             NULL));
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static const gchar *high_priority_operations[] = {
+  "drive-eject",
+  "encrypted-lock",
+  "encrypted-unlock",
+  "filesystem-mount",
+  "filesystem-unmount",
+  "loop-setup",
+  "swapspace-start",
+  "swapspace-stop",
+  NULL
+};
+
+static const gchar *low_priority_operations[] = {
+  "ata-enhanced-secure-erase",
+  "ata-secure-erase",
+  "ata-secure-erase-batch",
+  "block-benchmark",
+  "block-copy",
+  "format-erase",
+  "format-mkfs",
+  "md-raid-create",
+  "nvme-format-ns",
+  "nvme-sanitize",
+  NULL
+};
+
+/**
+ * udisks_job_scheduler_get_priority_for_operation:
+ * @job_operation: A job operation, e.g. <literal>format-mkfs</literal>.
+ *
+ * Gets the priority of jobs for @job_operation.
+ *
+ * Returns: A #UDisksJobPriority.
+ */
+UDisksJobPriority
+udisks_job_scheduler_get_priority_for_operation (const gchar *job_operation)
+{
+  if (job_operation == NULL)
+    return UDISKS_JOB_PRIORITY_NORMAL;
+  if (g_strv_contains (high_priority_operations, job_operation))
+    return UDISKS_JOB_PRIORITY_HIGH;
+  if (g_strv_contains (low_priority_operations, job_operation))
+    return UDISKS_JOB_PRIORITY_LOW;
+  return UDISKS_JOB_PRIORITY_NORMAL;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* figures out which drive and which controller @job is working with */
+static void
+get_job_keys (UDisksJobScheduler  *scheduler,
+              UDisksBaseJob       *job,
+              gchar              **out_drive_key,
+              gchar              **out_controller_key)
+{
+  const gchar *const *paths;
+  UDisksObject *object;
+  UDisksLinuxDevice *device = NULL;
+
+  *out_drive_key = NULL;
+  *out_controller_key = NULL;
+
+  paths = udisks_job_get_objects (UDISKS_JOB (job));
+  if (paths == NULL || paths[0] == NULL)
+    return;
+
+  object = udisks_daemon_find_object (scheduler->daemon, paths[0]);
+  if (object == NULL)
+    return;
+
+  if (UDISKS_IS_LINUX_BLOCK_OBJECT (object))
+    {
+      UDisksBlock *block = udisks_object_peek_block (object);
+
+      if (block != NULL && g_strcmp0 (udisks_block_get_drive (block), "/") != 0)
+        *out_drive_key = udisks_block_dup_drive (block);
+      else
+        *out_drive_key = g_strdup (paths[0]);
+      device = udisks_linux_block_object_get_device (UDISKS_LINUX_BLOCK_OBJECT (object));
+    }
+  else if (UDISKS_IS_LINUX_DRIVE_OBJECT (object))
+    {
+      *out_drive_key = g_strdup (paths[0]);
+      device = udisks_linux_drive_object_get_device (UDISKS_LINUX_DRIVE_OBJECT (object), FALSE /* get_hw */);
+    }
+
+  *out_controller_key = udisks_linux_device_dup_controller_key (device);
+
+  g_clear_object (&device);
+  g_object_unref (object);
+}
+
+static guint
+count_running (UDisksJobScheduler *scheduler,
+               const gchar        *drive_key,
+               const gchar        *controller_key,
+               guint              *out_drive,
+               guint              *out_controller)
+{
+  GList *l;
+  guint total = 0;
+
+  *out_drive = 0;
+  *out_controller = 0;
+  for (l = scheduler->running; l != NULL; l = l->next)
+    {
+      SchedulerEntry *entry = l->data;
+
+      total++;
+      if (drive_key != NULL && g_strcmp0 (entry->drive_key, drive_key) == 0)
+        (*out_drive)++;
+      if (controller_key != NULL && g_strcmp0 (entry->controller_key, controller_key) == 0)
+        (*out_controller)++;
+    }
+  return total;
+}
+
+/* must be called with the lock held */
+static gboolean
+entry_can_run (UDisksJobScheduler *scheduler,
+               SchedulerEntry     *entry)
+{
+  UDisksConfigManager *config_manager;
+  guint max_total;
+  guint max_drive;
+  guint max_controller;
+  guint total;
+  guint drive;
+  guint controller;
+
+  config_manager = udisks_daemon_get_config_manager (scheduler->daemon);
+  max_total = udisks_config_manager_get_max_concurrent_jobs (config_manager);
+  max_drive = udisks_config_manager_get_max_concurrent_jobs_per_drive (config_manager);
+  max_controller = udisks_config_manager_get_max_concurrent_jobs_per_controller (config_manager);
+
+  total = count_running (scheduler, entry->drive_key, entry->controller_key, &drive, &controller);
+
+  if (max_total > 0 && total >= max_total)
+    return FALSE;
+  if (max_drive > 0 && entry->drive_key != NULL && drive >= max_drive)
+    return FALSE;
+  if (max_controller > 0 && entry->controller_key != NULL && controller >= max_controller)
+    return FALSE;
+  return TRUE;
+}
+
+/* must be called with the lock held */
+static SchedulerEntry *
+find_running_entry (UDisksJobScheduler *scheduler,
+                    UDisksBaseJob      *job)
+{
+  GList *l;
+
+  for (l = scheduler->running; l != NULL; l = l->next)
+    {
+      SchedulerEntry *entry = l->data;
+      if (entry->job == job)
+        return entry;
+    }
+  return NULL;
+}
+
+/* must be called with the lock held; returns the queued entry that should be started next */
+static SchedulerEntry *
+find_next_runnable (UDisksJobScheduler *scheduler)
+{
+  GList *l;
+
+  for (l = scheduler->queue; l != NULL; l = l->next)
+    {
+      SchedulerEntry *entry = l->data;
+      if (entry_can_run (scheduler, entry))
+        return entry;
+    }
+  return NULL;
+}
+
+static gint
+compare_entries (gconstpointer a,
+                 gconstpointer b)
+{
+  const SchedulerEntry *entry_a = a;
+  const SchedulerEntry *entry_b = b;
+
+  if (entry_a->priority != entry_b->priority)
+    return entry_b->priority - entry_a->priority;
+  return entry_a->seq < entry_b->seq ? -1 : 1;
+}
+
+static gboolean
+start_entry_in_idle_cb (gpointer user_data)
+{
+  SchedulerEntry *entry = user_data;
+
+  /* not done by the ::cancelled handler, disconnecting from it would deadlock */
+  if (entry->cancelled_handler_id != 0)
+    {
+      g_cancellable_disconnect (entry->cancellable, entry->cancelled_handler_id);
+      entry->cancelled_handler_id = 0;
+    }
+  entry->start_func (entry->job, entry->error, entry->user_data);
+  return G_SOURCE_REMOVE;
+}
+
+/* calls the start function of @entry in the main context it was submitted from */
+static void
+start_entry_in_idle (SchedulerEntry *entry)
+{
+  GSource *idle_source;
+
+  idle_source = g_idle_source_new ();
+  g_source_set_priority (idle_source, G_PRIORITY_DEFAULT);
+  g_source_set_callback (idle_source,
+                         start_entry_in_idle_cb,
+                         scheduler_entry_ref (entry),
+                         (GDestroyNotify) scheduler_entry_unref);
+  g_source_attach (idle_source, entry->context);
+  g_source_unref (idle_source);
+}
+
+/* must be called with the lock held; starts all queued entries that may run now */
+static void
+start_runnable_entries (UDisksJobScheduler *scheduler)
+{
+  SchedulerEntry *entry;
+
+  while ((entry = find_next_runnable (scheduler)) != NULL)
+    {
+      scheduler->queue = g_list_remove (scheduler->queue, entry);
+      scheduler->running = g_list_prepend (scheduler->running, entry);
+      if (entry->was_queued)
+        {
+          udisks_job_set_state (UDISKS_JOB (entry->job), UDISKS_JOB_STATE_RUNNING);
+          /* the job really starts now */
+          udisks_job_set_start_time (UDISKS_JOB (entry->job), g_get_real_time ());
+        }
+      start_entry_in_idle (entry);
+    }
+}
+
+/* called in the thread where the cancellable of a submitted job was cancelled */
+static void
+on_queued_job_cancelled (GCancellable *cancellable,
+                         gpointer      user_data)
+{
+  SchedulerEntry *entry = user_data;
+  UDisksJobScheduler *scheduler = entry->scheduler;
+  GList *l;
+
+  g_mutex_lock (&scheduler->lock);
+  l = g_list_find (scheduler->queue, entry);
+  if (l != NULL)
+    {
+      scheduler->queue = g_list_delete_link (scheduler->queue, l);
+      g_cancellable_set_error_if_cancelled (cancellable, &entry->error);
+      start_entry_in_idle (entry);
+      scheduler_entry_unref (entry);
+    }
+  g_mutex_unlock (&scheduler->lock);
+}
+
+/**
+ * UDisksJobSchedulerStartFunc:
+ * @job: The #UDisksBaseJob passed to udisks_job_scheduler_submit().
+ * @error: (nullable): %NULL if @job may run now or the reason why it may not.
+ * @user_data: The @user_data passed to udisks_job_scheduler_submit().
+ *
+ * Function called when a submitted job may start, or with @error set if
+ * it was cancelled while queued. In the latter case, the function must
+ * complete @job with @error.
+ */
+
+/**
+ * udisks_job_scheduler_submit:
+ * @scheduler: A #UDisksJobScheduler.
+ * @job: A #UDisksBaseJob that is about to start.
+ * @start_func: Function to call when @job may start.
+ * @user_data: User data to pass to @start_func.
+ *
+ * Submits @job for starting without exceeding the configured limits.
+ * While it waits for a free slot, the job is in the
+ * <literal>queued</literal> state.
+ *
+ * This does not block, @start_func is always called later, from the
+ * <link linkend="g-main-context-push-thread-default">thread-default main loop</link>
+ * of the calling thread. Once @job has been started, the slot it takes
+ * must be freed with udisks_job_scheduler_release() when it completes.
+ */
+void
+udisks_job_scheduler_submit (UDisksJobScheduler          *scheduler,
+                             UDisksBaseJob               *job,
+                             UDisksJobSchedulerStartFunc  start_func,
+                             gpointer                     user_data)
+{
+  SchedulerEntry *entry;
+  UDisksBaseJob *parent;
+
+  g_return_if_fail (UDISKS_IS_JOB_SCHEDULER (scheduler));
+  g_return_if_fail (UDISKS_IS_BASE_JOB (job));
+  g_return_if_fail (start_func != NULL);
+
+  entry = g_new0 (SchedulerEntry, 1);
+  entry->ref_count = 1;
+  entry->scheduler = scheduler;
+  entry->job = g_object_ref (job);
+  entry->priority = udisks_job_scheduler_get_priority_for_operation (udisks_job_get_operation (UDISKS_JOB (job)));
+  get_job_keys (scheduler, job, &entry->drive_key, &entry->controller_key);
+  entry->start_func = start_func;
+  entry->user_data = user_data;
+  entry->context = g_main_context_ref_thread_default ();
+  entry->cancellable = g_object_ref (udisks_base_job_get_cancellable (job));
+
+  /* connect before the entry is queued, the handler runs right away if already cancelled */
+  entry->cancelled_handler_id = g_cancellable_connect (entry->cancellable,
+                                                       G_CALLBACK (on_queued_job_cancelled),
+                                                       scheduler_entry_ref (entry),
+                                                       (GDestroyNotify) scheduler_entry_unref);
+
+  g_mutex_lock (&scheduler->lock);
+
+  /* nested job, the outer job already holds the slot */
+  parent = g_private_get (&current_job);
+  if (parent != NULL && find_running_entry (scheduler, parent) != NULL)
+    {
+      scheduler->running = g_list_prepend (scheduler->running, entry);
+      start_entry_in_idle (entry);
+      goto out;
+    }
+
+  if (g_cancellable_set_error_if_cancelled (entry->cancellable, &entry->error))
+    {
+      start_entry_in_idle (entry);
+      scheduler_entry_unref (entry);
+      goto out;
+    }
+
+  entry->seq = scheduler->seq++;
+  scheduler->queue = g_list_insert_sorted (scheduler->queue, entry, compare_entries);
+  start_runnable_entries (scheduler);
+
+  if (g_list_find (scheduler->queue, entry) != NULL)
+    {
+      udisks_debug ("Queueing job %p (%s), limits reached",
+                    job, udisks_job_get_operation (UDISKS_JOB (job)));
+      udisks_job_set_state (UDISKS_JOB (job), UDISKS_JOB_STATE_QUEUED);
+      entry->was_queued = TRUE;
+    }
+
+ out:
+  g_mutex_unlock (&scheduler->lock);
+}
+
+/**
+ * udisks_job_scheduler_release:
+ * @scheduler: A #UDisksJobScheduler.
+ * @job: A #UDisksBaseJob.
+ *
+ * Frees the slot taken by @job and starts queued jobs that may run now.
+ * Does nothing if @job does not hold a slot.
+ */
+void
+udisks_job_scheduler_release (UDisksJobScheduler *scheduler,
+                              UDisksBaseJob      *job)
+{
+  SchedulerEntry *entry;
+
+  g_return_if_fail (UDISKS_IS_JOB_SCHEDULER (scheduler));
+
+  g_mutex_lock (&scheduler->lock);
+  entry = find_running_entry (scheduler, job);
+  if (entry != NULL)
+    {
+      scheduler->running = g_list_remove (scheduler->running, entry);
+      scheduler_entry_unref (entry);
+      start_runnable_entries (scheduler);
+    }
+  g_mutex_unlock (&scheduler->lock);
+}
+
+/**
+ * udisks_job_scheduler_enter_job:
+ * @job: The #UDisksBaseJob the calling thread starts working for.
+ *
+ * Marks the calling thread as working for @job, so that jobs launched
+ * from it while @job holds a slot are treated as nested jobs of @job.
+ * This is done by #UDisksThreadedJob around its job function, which runs
+ * in a worker thread. Must be balanced by udisks_job_scheduler_leave_job().
+ *
+ * Returns: (transfer none) (nullable): The job the thread was working for
+ * before, to be passed to udisks_job_scheduler_leave_job().
+ */
+UDisksBaseJob *
+udisks_job_scheduler_enter_job (UDisksBaseJob *job)
+{
+  UDisksBaseJob *previous;
+
+  previous = g_private_get (&current_job);
+  g_private_set (&current_job, job);
+  return previous;
+}
+
+/**
+ * udisks_job_scheduler_leave_job:
+ * @previous: (nullable): The job returned by udisks_job_scheduler_enter_job().
+ *
+ * Marks the calling thread as working for @previous again.
+ */
+void
+udisks_job_scheduler_leave_job (UDisksBaseJob *previous)
+{
+  g_private_set (&current_job, previous);
+}
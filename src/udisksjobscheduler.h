@@ -0,0 +1,69 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __UDISKS_JOB_SCHEDULER_H__
+#define __UDISKS_JOB_SCHEDULER_H__
+
+#include "udisksdaemontypes.h"
+
+G_BEGIN_DECLS
+
+#define UDISKS_TYPE_JOB_SCHEDULER         (udisks_job_scheduler_get_type ())
+#define UDISKS_JOB_SCHEDULER(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), UDISKS_TYPE_JOB_SCHEDULER, UDisksJobScheduler))
+#define UDISKS_IS_JOB_SCHEDULER(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), UDISKS_TYPE_JOB_SCHEDULER))
+
+/**
+ * UDisksJobPriority:
+ * @UDISKS_JOB_PRIORITY_LOW: Bulk operations like erasing or formatting.
+ * @UDISKS_JOB_PRIORITY_NORMAL: Everything else.
+ * @UDISKS_JOB_PRIORITY_HIGH: Interactive operations like mounting or unlocking.
+ *
+ * Priorities of queued jobs, jobs with higher priority are started first.
+ */
+typedef enum
+{
+  UDISKS_JOB_PRIORITY_LOW,
+  UDISKS_JOB_PRIORITY_NORMAL,
+  UDISKS_JOB_PRIORITY_HIGH
+} UDisksJobPriority;
+
+#define UDISKS_JOB_STATE_QUEUED  "queued"
+#define UDISKS_JOB_STATE_RUNNING "running"
+
+typedef void (*UDisksJobSchedulerStartFunc) (UDisksBaseJob *job,
+                                             const GError  *error,
+                                             gpointer       user_data);
+
+GType               udisks_job_scheduler_get_type     (void) G_GNUC_CONST;
+UDisksJobScheduler *udisks_job_scheduler_new          (UDisksDaemon       *daemon);
+
+UDisksJobPriority   udisks_job_scheduler_get_priority_for_operation (const gchar *job_operation);
+
+void                udisks_job_scheduler_submit       (UDisksJobScheduler          *scheduler,
+                                                       UDisksBaseJob               *job,
+                                                       UDisksJobSchedulerStartFunc  start_func,
+                                                       gpointer                     user_data);
+void                udisks_job_scheduler_release      (UDisksJobScheduler *scheduler,
+                                                       UDisksBaseJob      *job);
+
+UDisksBaseJob      *udisks_job_scheduler_enter_job    (UDisksBaseJob      *job);
+void                udisks_job_scheduler_leave_job    (UDisksBaseJob      *previous);
+
+G_END_DECLS
+
+#endif /* __UDISKS_JOB_SCHEDULER_H__ */
@@ -49,6 +49,8 @@
 #include "udiskslinuxblockobject.h"
 #include "udiskslinuxdriveobject.h"
 #include "udiskslinuxfsinfo.h"
+#include "udiskslinuxblockcopy.h"
+#include "udiskslinuxblockbenchmark.h"
 #include "udisksdaemon.h"
 #include "udisksstate.h"
 #include "udisksprivate.h"
@@ -62,6 +64,8 @@
 #include "udisksbasejob.h"
 #include "udiskssimplejob.h"
 #include "udiskslinuxdriveata.h"
+#include "udiskslinuxnvmecontroller.h"
+#include "udiskslinuxnvmenamespace.h"
 #include "udiskslinuxmdraidobject.h"
 #include "udiskslinuxdevice.h"
 #include "udiskslinuxpartition.h"
@@ -115,6 +119,7 @@ udisks_linux_block_init (UDisksLinuxBlock *block)
   g_mutex_init (&(block->encrypted_lock));
   g_dbus_interface_skeleton_set_flags (G_DBUS_INTERFACE_SKELETON (block),
                                        G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD);
+  udisks_block_set_last_benchmark (UDISKS_BLOCK (block), g_variant_new ("a{sv}", NULL));
 }
 
 static void
@@ -1653,6 +1658,35 @@ make_block_luksname (UDisksBlock *block, GError **error)
     return NULL;
 }
 
+/* Returns a copy of the crypttab entry @details with @flags recorded in its options */
+static GVariant *
+crypttab_details_add_flags (GVariant              *details,
+                            UDisksEncryptionFlags  flags)
+{
+  GVariantBuilder builder;
+  GVariantIter iter;
+  const gchar *key;
+  GVariant *value;
+  const gchar *options = NULL;
+  gchar *new_options;
+
+  g_variant_lookup (details, "options", "^&ay", &options);
+  new_options = crypto_flags_add_to_crypttab (options, flags);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_iter_init (&iter, details);
+  while (g_variant_iter_next (&iter, "{&sv}", &key, &value))
+    {
+      if (g_strcmp0 (key, "options") != 0)
+        g_variant_builder_add (&builder, "{sv}", key, value);
+      g_variant_unref (value);
+    }
+  g_variant_builder_add (&builder, "{sv}", "options", g_variant_new_bytestring (new_options));
+  g_free (new_options);
+
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
 static gboolean
 add_remove_crypttab_entry (UDisksBlock *block,
                            GVariant    *remove,
@@ -2387,6 +2421,134 @@ erase_ata_device (UDisksBlock   *block,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static gboolean
+erase_nvme_device (UDisksBlock   *block,
+                   UDisksObject  *object,
+                   UDisksDaemon  *daemon,
+                   uid_t          caller_uid,
+                   const gchar   *erase_type,
+                   GError       **error)
+{
+  gboolean ret = FALSE;
+  UDisksObject *drive_object = NULL;
+  UDisksNVMeNamespace *ns = NULL;
+  UDisksNVMeController *ctrl = NULL;
+
+  if (g_str_has_prefix (erase_type, "nvme-format-"))
+    {
+      ns = udisks_object_get_nvme_namespace (object);
+      if (ns == NULL)
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED, "Block device is not a NVMe namespace");
+          goto out;
+        }
+      ret = udisks_linux_nvme_namespace_format_sync (UDISKS_LINUX_NVME_NAMESPACE (ns),
+                                                     caller_uid,
+                                                     0, 0,
+                                                     g_strcmp0 (erase_type, "nvme-format-crypto-erase") == 0 ?
+                                                       "crypto_erase" : "user_data",
+                                                     error);
+      goto out;
+    }
+
+  drive_object = udisks_daemon_find_object (daemon, udisks_block_get_drive (block));
+  if (drive_object == NULL)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED, "No drive object");
+      goto out;
+    }
+  ctrl = udisks_object_get_nvme_controller (drive_object);
+  if (ctrl == NULL)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED, "Drive is not a NVMe controller");
+      goto out;
+    }
+
+  ret = udisks_linux_nvme_controller_sanitize_sync (UDISKS_LINUX_NVME_CONTROLLER (ctrl),
+                                                    caller_uid,
+                                                    erase_type + strlen ("nvme-sanitize-"),
+                                                    NULL,
+                                                    error);
+
+ out:
+  g_clear_object (&ctrl);
+  g_clear_object (&ns);
+  g_clear_object (&drive_object);
+  return ret;
+}
+
+/* Sanitize erases every namespace of the controller, not just @block. It is
+ * only allowed if @block is the only namespace and the caller is authorized
+ * the same way as for NVMe.Controller.SanitizeStart().
+ */
+static gboolean
+check_nvme_sanitize (UDisksBlock           *block,
+                     UDisksDaemon          *daemon,
+                     GVariant              *options,
+                     GDBusMethodInvocation *invocation)
+{
+  UDisksObject *drive_object = NULL;
+  const gchar *drive_path;
+  GList *objects = NULL;
+  GList *l;
+  guint num_namespaces = 0;
+  gboolean ret = FALSE;
+
+  drive_path = udisks_block_get_drive (block);
+  drive_object = udisks_daemon_find_object (daemon, drive_path);
+  if (drive_object == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED, "No drive object");
+      goto out;
+    }
+
+  objects = udisks_daemon_get_objects (daemon);
+  for (l = objects; l != NULL; l = l->next)
+    {
+      UDisksObject *other = UDISKS_OBJECT (l->data);
+      UDisksBlock *other_block;
+
+      other_block = udisks_object_peek_block (other);
+      if (other_block != NULL &&
+          udisks_object_peek_nvme_namespace (other) != NULL &&
+          g_strcmp0 (udisks_block_get_drive (other_block), drive_path) == 0)
+        num_namespaces++;
+    }
+  if (num_namespaces > 1)
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_NOT_SUPPORTED,
+                                             "Sanitize would erase all the %u namespaces of the NVMe controller, "
+                                             "use org.freedesktop.UDisks2.NVMe.Controller.SanitizeStart() instead",
+                                             num_namespaces);
+      goto out;
+    }
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    drive_object,
+                                                    "org.freedesktop.udisks2.ata-secure-erase",
+                                                    options,
+                                                    /* Translators: Shown in authentication dialog when the user
+                                                     * requests sanitizing a NVMe drive.
+                                                     *
+                                                     * Do not translate $(drive), it's a placeholder and
+                                                     * will be replaced by the name of the drive/device in question
+                                                     */
+                                                    N_("Authentication is required to perform a sanitize operation on $(drive)"),
+                                                    invocation))
+    goto out;
+
+  ret = TRUE;
+
+ out:
+  g_list_free_full (objects, g_object_unref);
+  g_clear_object (&drive_object);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 #define ERASE_SIZE (1 * 1024*1024)
 
 static gboolean
@@ -2417,6 +2579,15 @@ erase_device (UDisksBlock   *block,
       ret = erase_ata_device (block, object, daemon, caller_uid, TRUE, error);
       goto out;
     }
+  else if (g_strcmp0 (erase_type, "nvme-format-user-data") == 0 ||
+           g_strcmp0 (erase_type, "nvme-format-crypto-erase") == 0 ||
+           g_strcmp0 (erase_type, "nvme-sanitize-block-erase") == 0 ||
+           g_strcmp0 (erase_type, "nvme-sanitize-crypto-erase") == 0 ||
+           g_strcmp0 (erase_type, "nvme-sanitize-overwrite") == 0)
+    {
+      ret = erase_nvme_device (block, object, daemon, caller_uid, erase_type, error);
+      goto out;
+    }
   else if (g_strcmp0 (erase_type, "zero") != 0)
     {
       g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
@@ -2883,6 +3054,18 @@ trigger_uevent_on_nested_partitions (UDisksDaemon           *daemon,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Records the time since *stage_start_usec as @stage of @job and starts the next stage */
+static void
+format_stage_done (UDisksBaseJob *job,
+                   const gchar   *stage,
+                   gint64        *stage_start_usec)
+{
+  gint64 now_usec = g_get_monotonic_time ();
+
+  udisks_base_job_add_stage_timing (job, stage, now_usec - *stage_start_usec);
+  *stage_start_usec = now_usec;
+}
+
 static void
 handle_format_failure (GDBusMethodInvocation *invocation,
                        GError *error)
@@ -2952,6 +3135,133 @@ build_command (const gchar *template,
   return command;
 }
 
+/**
+ * udisks_linux_block_mkfs_sync:
+ * @daemon: A #UDisksDaemon.
+ * @object: The #UDisksObject of the block device to create the filesystem on.
+ * @type: The filesystem type, e.g. <literal>ext4</literal>.
+ * @label: (allow-none): The filesystem label or %NULL.
+ * @caller_uid: The uid of the caller.
+ * @error: Return location for error or %NULL.
+ *
+ * Runs mkfs for @type on the block device of @object in a <literal>format-mkfs</literal>
+ * job. Like udisks_linux_block_handle_format() all signatures are wiped from the
+ * device first, but the device is not torn down and the function doesn't wait for
+ * the new filesystem to show up. A @label is checked by a dry run before anything
+ * is wiped, as with the <literal>dry-run-first</literal> option of
+ * udisks_linux_block_handle_format().
+ *
+ * Returns: %TRUE if the filesystem was created, %FALSE if @error is set.
+ */
+gboolean
+udisks_linux_block_mkfs_sync (UDisksDaemon  *daemon,
+                              UDisksObject  *object,
+                              const gchar   *type,
+                              const gchar   *label,
+                              uid_t          caller_uid,
+                              GError       **error)
+{
+  const FSInfo *fs_info;
+  UDisksBlock *block;
+  GError *local_error = NULL;
+  gchar *command = NULL;
+  gchar *error_message = NULL;
+  gint status = 0;
+  gboolean ret = FALSE;
+
+  block = udisks_object_peek_block (object);
+  if (block == NULL)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Object is not a block device");
+      goto out;
+    }
+
+  fs_info = get_fs_info (type);
+  if (fs_info == NULL || fs_info->command_create_fs == NULL)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_NOT_SUPPORTED,
+                   "Creation of file system type %s is not supported",
+                   type);
+      goto out;
+    }
+
+  if (label != NULL && strstr (fs_info->command_create_fs, "$LABEL") == NULL)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_NOT_SUPPORTED,
+                   "File system type %s does not support labels", type);
+      goto out;
+    }
+
+  /* Check the label the same way Format() does with dry-run-first */
+  if (label != NULL && fs_info->command_validate_create_fs != NULL)
+    {
+      command = build_command (fs_info->command_validate_create_fs, udisks_block_get_device (block), label, NULL, error);
+      if (command == NULL)
+        goto out;
+
+      if (!udisks_daemon_launch_spawned_job_sync (daemon,
+                                                  object,
+                                                  "format-mkfs", caller_uid,
+                                                  NULL, /* cancellable */
+                                                  0,    /* uid_t run_as_uid */
+                                                  0,    /* uid_t run_as_euid */
+                                                  &status,
+                                                  &error_message,
+                                                  NULL, /* input_string */
+                                                  "%s", command))
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error creating file system: %s", error_message);
+          goto out;
+        }
+      g_clear_pointer (&error_message, g_free);
+      g_clear_pointer (&command, g_free);
+    }
+
+  /* Same as Format(), so that mkfs doesn't refuse or leave stale signatures behind */
+  if (!bd_fs_wipe (udisks_block_get_device (block), TRUE, FALSE, &local_error))
+    {
+      if (g_error_matches (local_error, BD_FS_ERROR, BD_FS_ERROR_NOFS))
+        /* no signature to remove, ignore */
+        g_clear_error (&local_error);
+      else
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error wiping device: %s", local_error->message);
+          g_clear_error (&local_error);
+          goto out;
+        }
+    }
+
+  command = build_command (fs_info->command_create_fs, udisks_block_get_device (block), label, NULL, error);
+  if (command == NULL)
+    goto out;
+
+  if (!udisks_daemon_launch_spawned_job_sync (daemon,
+                                              object,
+                                              "format-mkfs", caller_uid,
+                                              NULL, /* cancellable */
+                                              0,    /* uid_t run_as_uid */
+                                              0,    /* uid_t run_as_euid */
+                                              &status,
+                                              &error_message,
+                                              NULL, /* input_string */
+                                              "%s", command))
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error creating file system: %s", error_message);
+      goto out;
+    }
+
+  ret = TRUE;
+
+ out:
+  g_free (error_message);
+  g_free (command);
+  return ret;
+}
+
 void
 udisks_linux_block_handle_format (UDisksBlock             *block,
                                   GDBusMethodInvocation   *invocation,
@@ -2975,7 +3285,9 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
   const gchar *action_id;
   const gchar *message;
   const FSInfo *fs_info;
-  const gchar *command_options = NULL;
+  gchar *command_options = NULL;
+  const gchar *format_profile = NULL;
+  const gchar *profile_options = NULL;
   gchar *command = NULL;
   gchar *error_message;
   GError *error;
@@ -2985,6 +3297,10 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
   gboolean take_ownership = FALSE;
   GString *encrypt_passphrase = NULL;
   gchar *encrypt_type = NULL;
+  guint encrypt_sector_size = 0;
+  UDisksEncryptionFlags encrypt_flags = UDISKS_ENCRYPTION_FLAGS_NONE;
+  gchar *encrypt_cipher = NULL;
+  guint encrypt_key_size = 0;
   gchar *erase_type = NULL;
   gchar *mapped_name = NULL;
   const gchar *label = NULL;
@@ -2999,6 +3315,9 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
   gboolean no_discard_flag = FALSE;
   BDPartTableType part_table_type = BD_PART_TABLE_UNDEF;
   UDisksObject *filesystem_object;
+  UDisksBaseJob *job = NULL;
+  gboolean job_success = FALSE;
+  gint64 stage_start_usec;
 
   error = NULL;
   object = udisks_daemon_util_dup_object (block, &error);
@@ -3020,6 +3339,28 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
   g_variant_lookup (options, "take-ownership", "b", &take_ownership);
   udisks_variant_lookup_binary (options, "encrypt.passphrase", &encrypt_passphrase);
   g_variant_lookup (options, "encrypt.type", "s", &encrypt_type);
+  if (encrypt_passphrase != NULL)
+    {
+      /* the configured defaults only apply to LUKS2, explicit options
+       * are rejected by luks_format_job_func() for other types */
+      if (g_strcmp0 (encrypt_type != NULL ? encrypt_type : udisks_config_manager_get_encryption (config_manager),
+                     UDISKS_ENCRYPTION_LUKS2) == 0)
+        {
+          encrypt_sector_size = udisks_config_manager_get_encryption_sector_size (config_manager);
+          encrypt_flags = udisks_config_manager_get_encryption_flags (config_manager);
+        }
+      g_variant_lookup (options, "encrypt.sector-size", "u", &encrypt_sector_size);
+      encrypt_flags = crypto_flags_from_options (options, "encrypt.", encrypt_flags, NULL);
+      if (encrypt_sector_size != 0 && !UDISKS_ENCRYPTION_SECTOR_SIZE_VALID (encrypt_sector_size))
+        {
+          g_dbus_method_invocation_return_error (invocation,
+                                                 UDISKS_ERROR,
+                                                 UDISKS_ERROR_FAILED,
+                                                 "Invalid encryption sector size %u, must be a power of two between 512 and 4096",
+                                                 encrypt_sector_size);
+          goto out;
+        }
+    }
   g_variant_lookup (options, "erase", "s", &erase_type);
   g_variant_lookup (options, "no-block", "b", &no_block);
   g_variant_lookup (options, "update-partition-type", "b", &update_partition_type);
@@ -3027,6 +3368,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
   g_variant_lookup (options, "config-items", "@a(sa{sv})", &config_items);
   g_variant_lookup (options, "tear-down", "b", &teardown_flag);
   g_variant_lookup (options, "no-discard", "b", &no_discard_flag);
+  g_variant_lookup (options, "format-profile", "&s", &format_profile);
   g_variant_lookup (options, "label", "&s", &label);
 
   partition = udisks_object_get_partition (object);
@@ -3077,7 +3419,8 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
     }
 
   if (g_strcmp0 (erase_type, "ata-secure-erase") == 0 ||
-      g_strcmp0 (erase_type, "ata-secure-erase-enhanced") == 0)
+      g_strcmp0 (erase_type, "ata-secure-erase-enhanced") == 0 ||
+      g_str_has_prefix (erase_type, "nvme-"))
     {
       /* Translators: Shown in authentication dialog when the user
        * requests erasing a hard disk using the SECURE ERASE UNIT
@@ -3127,6 +3470,22 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
       goto out;
     }
 
+  if (format_profile != NULL)
+    {
+      if (!udisks_linux_fsinfo_get_format_profile_options (fs_info, format_profile, &profile_options))
+        {
+          g_dbus_method_invocation_return_error (invocation,
+                                                 UDISKS_ERROR,
+                                                 UDISKS_ERROR_NOT_SUPPORTED,
+                                                 "Unknown format profile %s",
+                                                 format_profile);
+          goto out;
+        }
+      /* udisks2.conf overrides the built-in mapping */
+      if (udisks_config_manager_get_format_profile (config_manager, type, format_profile) != NULL)
+        profile_options = udisks_config_manager_get_format_profile (config_manager, type, format_profile);
+    }
+
   if (!udisks_daemon_util_check_authorization_sync (daemon,
                                                     object,
                                                     action_id,
@@ -3135,6 +3494,10 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
                                                     invocation))
     goto out;
 
+  if (erase_type != NULL && g_str_has_prefix (erase_type, "nvme-sanitize-") &&
+      !check_nvme_sanitize (block, daemon, options, invocation))
+    goto out;
+
   if ((config_items != NULL || teardown_flag) &&
       !udisks_daemon_util_check_authorization_sync (daemon,
                                                     NULL,
@@ -3146,6 +3509,18 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
 
   was_partitioned = (udisks_object_peek_partition_table (object) != NULL);
 
+  /* The individual steps run their own jobs, this one spans all of them
+   * and records how long each step took.
+   */
+  job = udisks_daemon_launch_simple_job (daemon, object, "format", caller_uid, NULL);
+  if (job == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                             "Failed to create a job object");
+      goto out;
+    }
+  stage_start_usec = g_get_monotonic_time ();
+
   if (teardown_flag)
     {
       if (!udisks_linux_block_teardown (block, invocation, options, &error))
@@ -3153,6 +3528,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
           g_dbus_method_invocation_take_error (invocation, error);
           goto out;
         }
+      format_stage_done (job, "teardown", &stage_start_usec);
     }
 
   device_name = udisks_block_dup_device (block);
@@ -3174,6 +3550,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
           goto out;
         }
     }
+  format_stage_done (job, "wipe", &stage_start_usec);
 
   /* ...then wait until this change has taken effect */
   if (was_partitioned &&
@@ -3200,9 +3577,11 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
       goto out;
     }
   g_object_unref (filesystem_object);
+  format_stage_done (job, "wipe-sync", &stage_start_usec);
 
-  if (no_discard_flag && fs_info->option_no_discard)
-    command_options = fs_info->option_no_discard;
+  /* options of the profile come last so that they take precedence */
+  command_options = udisks_linux_fsinfo_join_mkfs_options (no_discard_flag ? fs_info->option_no_discard : NULL,
+                                                           profile_options);
 
   /* If requested, check whether the ultimate filesystem creation
      will succeed before actually getting to work.
@@ -3239,6 +3618,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
 
       g_free (error_message);
       g_free (command);
+      format_stage_done (job, "dry-run", &stage_start_usec);
     }
 
   /* And now create the desired filesystem */
@@ -3248,8 +3628,14 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
     {
       UDisksObject *luks_uuid_object;
       CryptoJobData data;
+      memset (&data, 0, sizeof (data));
       data.device = device_name;
       data.passphrase = encrypt_passphrase;
+      data.sector_size = encrypt_sector_size;
+      data.flags = encrypt_flags;
+      encrypt_cipher = udisks_config_manager_dup_encryption_cipher (config_manager, &encrypt_key_size);
+      data.cipher = encrypt_cipher;
+      data.key_size = encrypt_key_size;
 
       if (encrypt_type != NULL)
         data.type = encrypt_type;
@@ -3291,6 +3677,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
           goto out;
         }
       g_object_unref (luks_uuid_object);
+      format_stage_done (job, "luks-format", &stage_start_usec);
 
       /* Open it */
       mapped_name = make_block_luksname (block, &error);
@@ -3304,6 +3691,8 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
       udisks_linux_block_encrypted_lock (block);
       data.map_name = mapped_name;
       data.read_only = FALSE;
+      /* already stored in the header by luks_format_job_func() */
+      data.flags = UDISKS_ENCRYPTION_FLAGS_NONE;
       if (!udisks_daemon_launch_threaded_job_sync (daemon,
                                                    object,
                                                    "format-mkfs",
@@ -3351,6 +3740,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
                                             udisks_block_get_device_number (block),
                                             g_udev_device_get_sysfs_attr (udev_cleartext_device->udev_device, "dm/uuid"),
                                             caller_uid);
+      format_stage_done (job, "luks-open", &stage_start_usec);
 
       object_to_mkfs = cleartext_object;
       block_to_mkfs = cleartext_block;
@@ -3378,6 +3768,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
           handle_format_failure (invocation, error);
           goto out;
         }
+      format_stage_done (job, "erase", &stage_start_usec);
     }
 
   /* Set label, if needed */
@@ -3435,6 +3826,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
           goto out;
         }
     }
+  format_stage_done (job, "mkfs", &stage_start_usec);
 
   /* Set the partition type, if requested */
   if (partition_type != NULL && partition != NULL)
@@ -3452,6 +3844,7 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
               goto out;
             }
         }
+      format_stage_done (job, "partition-type", &stage_start_usec);
     }
 
   /* The mkfs program may not generate all the uevents we need - so explicitly
@@ -3490,18 +3883,21 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
       goto out;
     }
   g_object_unref (filesystem_object);
+  format_stage_done (job, "mkfs-sync", &stage_start_usec);
 
   /* Change ownership, if requested and supported */
   if (take_ownership && fs_info->supports_owners)
     {
       if (!take_filesystem_ownership (udisks_block_get_device (block_to_mkfs),
-                                      type, caller_uid, caller_gid, FALSE, &error))
+                                      type, caller_uid, caller_gid, FALSE,
+                                      NULL /* job */, NULL /* cancellable */, &error))
         {
           g_prefix_error (&error,
                           "Failed to take ownership of newly created filesystem: ");
           handle_format_failure (invocation, error);
           goto out;
         }
+      format_stage_done (job, "ownership", &stage_start_usec);
     }
 
   /* Add configuration items */
@@ -3524,6 +3920,12 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
             }
           else if (strcmp (item_type, "crypttab") == 0)
             {
+              if (encrypt_flags != UDISKS_ENCRYPTION_FLAGS_NONE)
+                {
+                  GVariant *tmp = details;
+                  details = crypttab_details_add_flags (tmp, encrypt_flags);
+                  g_variant_unref (tmp);
+                }
               if (!add_remove_crypttab_entry (block, NULL, details, &error))
                 {
                   handle_format_failure (invocation, error);
@@ -3533,12 +3935,16 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
           g_variant_unref (details);
         }
       update_configuration (UDISKS_LINUX_BLOCK (block), daemon);
+      format_stage_done (job, "configuration", &stage_start_usec);
     }
 
+  job_success = TRUE;
   if (invocation != NULL)
     complete (complete_user_data);
 
  out:
+  if (job != NULL)
+    udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), job_success, NULL);
   if (object != NULL)
     udisks_linux_block_object_release_cleanup_lock (UDISKS_LINUX_BLOCK_OBJECT (object));
   if (state != NULL)
@@ -3546,11 +3952,13 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
   g_free (device_name);
   g_free (mapped_name);
   g_free (command);
+  g_free (command_options);
   if (config_items)
     g_variant_unref (config_items);
   g_free (erase_type);
   udisks_string_wipe_and_free (encrypt_passphrase);
   g_free (encrypt_type);
+  g_free (encrypt_cipher);
   g_clear_object (&cleartext_object);
   g_clear_object (&cleartext_block);
   g_clear_object (&udev_cleartext_device);
@@ -3990,6 +4398,547 @@ handle_rescan (UDisksBlock           *block,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+typedef struct
+{
+  gint source_fd;
+  gint target_fd;
+  guint queue_depth;
+  UDisksBlockCopyFlags flags;
+} CopyJobData;
+
+static gboolean
+copy_job_func (UDisksThreadedJob  *job,
+               GCancellable       *cancellable,
+               gpointer            user_data,
+               GError            **error)
+{
+  CopyJobData *data = user_data;
+
+  return udisks_linux_block_copy_sync (UDISKS_BASE_JOB (job),
+                                       data->source_fd,
+                                       data->target_fd,
+                                       data->queue_depth,
+                                       data->flags,
+                                       cancellable,
+                                       error);
+}
+
+static gboolean
+get_copy_options (GVariant              *options,
+                  CopyJobData           *data,
+                  GError               **error)
+{
+  gboolean sparse = TRUE;
+
+  data->queue_depth = UDISKS_BLOCK_COPY_DEFAULT_QUEUE_DEPTH;
+  g_variant_lookup (options, "sparse", "b", &sparse);
+  g_variant_lookup (options, "queue-depth", "u", &data->queue_depth);
+
+  if (data->queue_depth < 1 || data->queue_depth > UDISKS_BLOCK_COPY_MAX_QUEUE_DEPTH)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "The queue-depth option has to be between 1 and %d",
+                   UDISKS_BLOCK_COPY_MAX_QUEUE_DEPTH);
+      return FALSE;
+    }
+
+  data->flags = sparse ? UDISKS_BLOCK_COPY_FLAGS_SPARSE : UDISKS_BLOCK_COPY_FLAGS_NONE;
+  return TRUE;
+}
+
+/* makes the new contents of a device written by a copy show up */
+static void
+rescan_copy_target (UDisksObject *object)
+{
+  UDisksLinuxDevice *device;
+  GError *error = NULL;
+
+  device = udisks_linux_block_object_get_device (UDISKS_LINUX_BLOCK_OBJECT (object));
+  udisks_linux_block_object_trigger_uevent_sync (UDISKS_LINUX_BLOCK_OBJECT (object),
+                                                 UDISKS_DEFAULT_WAIT_TIMEOUT);
+  if (g_strcmp0 (g_udev_device_get_devtype (device->udev_device), "disk") == 0 &&
+      !udisks_linux_block_object_reread_partition_table (UDISKS_LINUX_BLOCK_OBJECT (object), &error))
+    {
+      udisks_warning ("%s", error->message);
+      g_clear_error (&error);
+    }
+  g_object_unref (device);
+}
+
+static gboolean
+handle_copy (UDisksBlock           *block,
+             GDBusMethodInvocation *invocation,
+             GUnixFDList           *fd_list,
+             GVariant              *fd_index,
+             GVariant              *options)
+{
+  UDisksObject *object = NULL;
+  UDisksDaemon *daemon;
+  const gchar *action_id;
+  const gchar *message;
+  const gchar *direction = "backup";
+  const gchar *device;
+  gboolean restore;
+  CopyJobData data;
+  uid_t caller_uid;
+  gint fd = -1;
+  gint device_fd = -1;
+  gint fd_num;
+  GError *error = NULL;
+
+  object = udisks_daemon_util_dup_object (block, &error);
+  if (object == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  daemon = udisks_linux_block_object_get_daemon (UDISKS_LINUX_BLOCK_OBJECT (object));
+
+  if (!udisks_daemon_util_get_caller_uid_sync (daemon, invocation, NULL /* GCancellable */, &caller_uid, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  g_variant_lookup (options, "direction", "&s", &direction);
+  if (g_strcmp0 (direction, "backup") == 0)
+    {
+      restore = FALSE;
+      /* Translators: Shown in authentication dialog when creating a
+       * disk image file.
+       *
+       * Do not translate $(drive), it's a placeholder and will
+       * be replaced by the name of the drive/device in question
+       */
+      message = N_("Authentication is required to open $(drive) for reading");
+    }
+  else if (g_strcmp0 (direction, "restore") == 0)
+    {
+      restore = TRUE;
+      /* Translators: Shown in authentication dialog when restoring
+       * from a disk image file.
+       *
+       * Do not translate $(drive), it's a placeholder and will
+       * be replaced by the name of the drive/device in question
+       */
+      message = N_("Authentication is required to open $(drive) for writing");
+    }
+  else
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_FAILED,
+                                             "Unknown copy direction %s",
+                                             direction);
+      goto out;
+    }
+
+  if (!get_copy_options (options, &data, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  action_id = "org.freedesktop.udisks2.open-device";
+  if (udisks_block_get_hint_system (block))
+    action_id = "org.freedesktop.udisks2.open-device-system";
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    object,
+                                                    action_id,
+                                                    options,
+                                                    message,
+                                                    invocation))
+    goto out;
+
+  fd_num = g_variant_get_handle (fd_index);
+  if (fd_list == NULL || fd_num >= g_unix_fd_list_get_length (fd_list))
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_FAILED,
+                                             "Expected to use fd at index %d, but message has only %d fds",
+                                             fd_num,
+                                             fd_list == NULL ? 0 : g_unix_fd_list_get_length (fd_list));
+      goto out;
+    }
+  fd = g_unix_fd_list_get (fd_list, fd_num, &error);
+  if (fd == -1)
+    {
+      g_prefix_error (&error, "Error getting file descriptor %d from message: ", fd_num);
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  device = udisks_block_get_device (block);
+  device_fd = open_device (device, restore ? "w" : "r", O_CLOEXEC | O_EXCL, &error);
+  if (device_fd == -1)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  data.source_fd = restore ? fd : device_fd;
+  data.target_fd = restore ? device_fd : fd;
+  if (!udisks_daemon_launch_threaded_job_sync (daemon,
+                                               object,
+                                               "block-copy",
+                                               caller_uid,
+                                               copy_job_func,
+                                               &data,
+                                               NULL, /* user_data_free_func */
+                                               NULL, /* cancellable */
+                                               &error))
+    {
+      g_prefix_error (&error, "Error copying %s: ", device);
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  /* close before rescanning so that the new contents are probed */
+  close (device_fd);
+  device_fd = -1;
+  if (restore)
+    rescan_copy_target (object);
+
+  udisks_block_complete_copy (block, invocation, NULL);
+
+ out:
+  if (device_fd != -1)
+    close (device_fd);
+  if (fd != -1)
+    close (fd);
+  g_clear_object (&object);
+  return TRUE; /* returning true means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+handle_clone (UDisksBlock           *block,
+              GDBusMethodInvocation *invocation,
+              const gchar           *target,
+              GVariant              *options)
+{
+  UDisksObject *object = NULL;
+  UDisksObject *target_object = NULL;
+  UDisksBlock *target_block = NULL;
+  UDisksDaemon *daemon;
+  const gchar *action_id;
+  CopyJobData data;
+  uid_t caller_uid;
+  gint source_fd = -1;
+  gint target_fd = -1;
+  GError *error = NULL;
+
+  object = udisks_daemon_util_dup_object (block, &error);
+  if (object == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  daemon = udisks_linux_block_object_get_daemon (UDISKS_LINUX_BLOCK_OBJECT (object));
+
+  if (!udisks_daemon_util_get_caller_uid_sync (daemon, invocation, NULL /* GCancellable */, &caller_uid, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  target_object = udisks_daemon_find_object (daemon, target);
+  if (target_object != NULL)
+    target_block = udisks_object_get_block (target_object);
+  if (target_block == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_FAILED,
+                                             "Invalid object path %s",
+                                             target);
+      goto out;
+    }
+  if (target_object == object)
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_FAILED,
+                                             "Cannot clone a device onto itself");
+      goto out;
+    }
+
+  if (!get_copy_options (options, &data, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  action_id = "org.freedesktop.udisks2.open-device";
+  if (udisks_block_get_hint_system (block))
+    action_id = "org.freedesktop.udisks2.open-device-system";
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    object,
+                                                    action_id,
+                                                    options,
+                                                    /* Translators: Shown in authentication dialog when cloning
+                                                     * a device onto another one.
+                                                     *
+                                                     * Do not translate $(drive), it's a placeholder and will
+                                                     * be replaced by the name of the drive/device in question
+                                                     */
+                                                    N_("Authentication is required to open $(drive) for reading"),
+                                                    invocation))
+    goto out;
+
+  action_id = "org.freedesktop.udisks2.open-device";
+  if (udisks_block_get_hint_system (target_block))
+    action_id = "org.freedesktop.udisks2.open-device-system";
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    target_object,
+                                                    action_id,
+                                                    options,
+                                                    /* Translators: Shown in authentication dialog when cloning
+                                                     * a device onto another one.
+                                                     *
+                                                     * Do not translate $(drive), it's a placeholder and will
+                                                     * be replaced by the name of the drive/device in question
+                                                     */
+                                                    N_("Authentication is required to open $(drive) for writing"),
+                                                    invocation))
+    goto out;
+
+  source_fd = open_device (udisks_block_get_device (block), "r", O_CLOEXEC | O_EXCL, &error);
+  if (source_fd == -1)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+  target_fd = open_device (udisks_block_get_device (target_block), "w", O_CLOEXEC | O_EXCL, &error);
+  if (target_fd == -1)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  data.source_fd = source_fd;
+  data.target_fd = target_fd;
+  if (!udisks_daemon_launch_threaded_job_sync (daemon,
+                                               object,
+                                               "block-copy",
+                                               caller_uid,
+                                               copy_job_func,
+                                               &data,
+                                               NULL, /* user_data_free_func */
+                                               NULL, /* cancellable */
+                                               &error))
+    {
+      g_prefix_error (&error, "Error cloning %s to %s: ",
+                      udisks_block_get_device (block),
+                      udisks_block_get_device (target_block));
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  /* close before rescanning so that the new contents are probed */
+  close (target_fd);
+  target_fd = -1;
+  rescan_copy_target (target_object);
+
+  udisks_block_complete_clone (block, invocation);
+
+ out:
+  if (source_fd != -1)
+    close (source_fd);
+  if (target_fd != -1)
+    close (target_fd);
+  g_clear_object (&target_block);
+  g_clear_object (&target_object);
+  g_clear_object (&object);
+  return TRUE; /* returning true means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct
+{
+  gint fd;
+  UDisksBlockBenchmarkOptions options;
+  GVariant *result;
+} BenchmarkJobData;
+
+static gboolean
+benchmark_job_func (UDisksThreadedJob  *job,
+                    GCancellable       *cancellable,
+                    gpointer            user_data,
+                    GError            **error)
+{
+  BenchmarkJobData *data = user_data;
+
+  data->result = udisks_linux_block_benchmark_sync (UDISKS_BASE_JOB (job),
+                                                    data->fd,
+                                                    &data->options,
+                                                    cancellable,
+                                                    error);
+  if (data->result == NULL)
+    return FALSE;
+
+  g_variant_ref_sink (data->result);
+  return TRUE;
+}
+
+static gboolean
+handle_benchmark (UDisksBlock           *block,
+                  GDBusMethodInvocation *invocation,
+                  GVariant              *options)
+{
+  UDisksObject *object = NULL;
+  UDisksDaemon *daemon;
+  const gchar *action_id;
+  const gchar *device;
+  BenchmarkJobData data = { -1, { 0, }, NULL };
+  GVariant *queue_depths = NULL;
+  gsize num_queue_depths = 0;
+  const guint32 *depths = NULL;
+  uid_t caller_uid;
+  gint open_flags;
+  GError *error = NULL;
+  guint n;
+
+  object = udisks_daemon_util_dup_object (block, &error);
+  if (object == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  daemon = udisks_linux_block_object_get_daemon (UDISKS_LINUX_BLOCK_OBJECT (object));
+
+  if (!udisks_daemon_util_get_caller_uid_sync (daemon, invocation, NULL /* GCancellable */, &caller_uid, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  data.options.num_samples = 100;
+  data.options.sample_size = 10 * 1024 * 1024;
+  data.options.access_time_samples = 1000;
+  data.options.random_ios = 4096;
+  g_variant_lookup (options, "writable", "b", &data.options.write);
+  g_variant_lookup (options, "num-samples", "u", &data.options.num_samples);
+  g_variant_lookup (options, "sample-size", "t", &data.options.sample_size);
+  g_variant_lookup (options, "access-time-samples", "u", &data.options.access_time_samples);
+  g_variant_lookup (options, "random-ios", "u", &data.options.random_ios);
+
+  if (data.options.num_samples > UDISKS_BLOCK_BENCHMARK_MAX_NUM_SAMPLES ||
+      data.options.sample_size > UDISKS_BLOCK_BENCHMARK_MAX_SAMPLE_SIZE ||
+      data.options.access_time_samples > UDISKS_BLOCK_BENCHMARK_MAX_ACCESS_TIME_SAMPLES ||
+      data.options.random_ios > UDISKS_BLOCK_BENCHMARK_MAX_RANDOM_IOS)
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_OPTION_NOT_PERMITTED,
+                                             "At most %d samples of %d bytes, %d access time samples "
+                                             "and %d random reads are allowed",
+                                             UDISKS_BLOCK_BENCHMARK_MAX_NUM_SAMPLES,
+                                             UDISKS_BLOCK_BENCHMARK_MAX_SAMPLE_SIZE,
+                                             UDISKS_BLOCK_BENCHMARK_MAX_ACCESS_TIME_SAMPLES,
+                                             UDISKS_BLOCK_BENCHMARK_MAX_RANDOM_IOS);
+      goto out;
+    }
+
+  queue_depths = g_variant_lookup_value (options, "queue-depths", G_VARIANT_TYPE ("au"));
+  if (queue_depths != NULL)
+    depths = g_variant_get_fixed_array (queue_depths, &num_queue_depths, sizeof (guint32));
+  else
+    {
+      static const guint32 default_queue_depths[] = { 1, 32 };
+      depths = default_queue_depths;
+      num_queue_depths = G_N_ELEMENTS (default_queue_depths);
+    }
+  data.options.queue_depths = g_new0 (guint, num_queue_depths);
+  for (n = 0; n < num_queue_depths; n++)
+    {
+      if (depths[n] < 1 || depths[n] > UDISKS_BLOCK_BENCHMARK_MAX_QUEUE_DEPTH)
+        {
+          g_dbus_method_invocation_return_error (invocation,
+                                                 UDISKS_ERROR,
+                                                 UDISKS_ERROR_OPTION_NOT_PERMITTED,
+                                                 "Queue depths have to be between 1 and %d",
+                                                 UDISKS_BLOCK_BENCHMARK_MAX_QUEUE_DEPTH);
+          goto out;
+        }
+      data.options.queue_depths[n] = depths[n];
+    }
+  data.options.num_queue_depths = data.options.random_ios > 0 ? num_queue_depths : 0;
+
+  action_id = "org.freedesktop.udisks2.open-device";
+  if (udisks_block_get_hint_system (block))
+    action_id = "org.freedesktop.udisks2.open-device-system";
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    object,
+                                                    action_id,
+                                                    options,
+                                                    /* Translators: Shown in authentication dialog when an application
+                                                     * wants to benchmark a device.
+                                                     *
+                                                     * Do not translate $(drive), it's a placeholder and will
+                                                     * be replaced by the name of the drive/device in question
+                                                     */
+                                                    N_("Authentication is required to open $(drive) for benchmarking"),
+                                                    invocation))
+    goto out;
+
+  device = udisks_block_get_device (block);
+
+  /* the write test writes back the data it has read, make sure it
+   * reaches the device and nobody else changes it in the meantime
+   */
+  open_flags = O_DIRECT | O_CLOEXEC;
+  if (data.options.write)
+    open_flags |= O_SYNC | O_EXCL;
+  data.fd = open_device (device, data.options.write ? "rw" : "r", open_flags, &error);
+  if (data.fd == -1)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  if (!udisks_daemon_launch_threaded_job_sync (daemon,
+                                               object,
+                                               "block-benchmark",
+                                               caller_uid,
+                                               benchmark_job_func,
+                                               &data,
+                                               NULL, /* user_data_free_func */
+                                               NULL, /* cancellable */
+                                               &error))
+    {
+      g_prefix_error (&error, "Error benchmarking %s: ", device);
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  udisks_block_set_last_benchmark (block, data.result);
+  udisks_block_complete_benchmark (block, invocation, data.result);
+
+ out:
+  if (data.fd != -1)
+    close (data.fd);
+  if (data.result != NULL)
+    g_variant_unref (data.result);
+  if (queue_depths != NULL)
+    g_variant_unref (queue_depths);
+  g_free (data.options.queue_depths);
+  g_clear_object (&object);
+  return TRUE; /* returning true means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 static void
 block_iface_init (UDisksBlockIface *iface)
 {
@@ -4003,4 +4952,7 @@ block_iface_init (UDisksBlockIface *iface)
   iface->handle_open_for_benchmark        = handle_open_for_benchmark;
   iface->handle_open_device               = handle_open_device;
   iface->handle_rescan                    = handle_rescan;
+  iface->handle_copy                      = handle_copy;
+  iface->handle_clone                     = handle_clone;
+  iface->handle_benchmark                 = handle_benchmark;
 }
@@ -41,6 +41,13 @@ void         udisks_linux_block_handle_format (UDisksBlock            *block,
                                                void                  (*complete)(gpointer user_data),
                                                gpointer                complete_user_data);
 
+gboolean     udisks_linux_block_mkfs_sync (UDisksDaemon  *daemon,
+                                           UDisksObject  *object,
+                                           const gchar   *type,
+                                           const gchar   *label,
+                                           uid_t          caller_uid,
+                                           GError       **error);
+
 gboolean     udisks_linux_block_matches_id (UDisksLinuxBlock *block,
                                             const gchar      *device_path);
 
@@ -57,6 +64,7 @@ gboolean     udisks_linux_block_teardown (UDisksBlock            *block,
 
 gboolean     udisks_linux_block_is_luks (UDisksBlock *block);
 
+
 gboolean     udisks_linux_block_is_tcrypt (UDisksBlock *block);
 
 gboolean     udisks_linux_block_is_bitlk (UDisksBlock *block);
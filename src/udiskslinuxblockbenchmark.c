@@ -0,0 +1,463 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <linux/fs.h>
+
+#include "udiskslinuxblockbenchmark.h"
+#include "udisksbasejob.h"
+
+/**
+ * SECTION:udiskslinuxblockbenchmark
+ * @title: Block device benchmark
+ * @short_description: Measuring the performance of block devices
+ *
+ * Measures the sequential transfer rate, the access time and the
+ * random read performance at several queue depths of a block device
+ * opened with <literal>O_DIRECT</literal>.
+ *
+ * The sequential rate is measured by reading (and optionally writing
+ * back) samples spread evenly over the device, the same way the GNOME
+ * Disks benchmark does. The access time is the latency of reads of a
+ * single logical block at random offsets. Random reads at a queue depth
+ * of <literal>n</literal> are issued by <literal>n</literal> threads
+ * doing synchronous reads of 4 KiB each, which keeps <literal>n</literal>
+ * requests in flight without depending on an asynchronous I/O library.
+ */
+
+#define BENCHMARK_RANDOM_IO_SIZE 4096
+
+typedef struct
+{
+  gint          fd;
+  guint64       num_blocks;
+  guint         io_size;
+  guint         num_ios;
+  guint32       seed;
+  GCancellable *cancellable;
+  GArray       *latencies;
+  guint64       failed_offset;
+  gint          failed_errno;
+} RandomReader;
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+transfer_all (gint      fd,
+              gboolean  write,
+              guchar   *buf,
+              gsize     count,
+              guint64   offset)
+{
+  gsize done = 0;
+
+  while (done < count)
+    {
+      gssize num;
+
+      if (write)
+        num = pwrite (fd, buf + done, count - done, offset + done);
+      else
+        num = pread (fd, buf + done, count - done, offset + done);
+      if (num == -1 && errno == EINTR)
+        continue;
+      if (num <= 0)
+        {
+          if (num == 0)
+            errno = EIO;
+          return FALSE;
+        }
+      done += num;
+    }
+
+  return TRUE;
+}
+
+static gpointer
+random_reader_thread_func (gpointer user_data)
+{
+  RandomReader *reader = user_data;
+  GRand *rand;
+  guchar *buf = NULL;
+  guint n;
+
+  if (posix_memalign ((void **) &buf, MAX (reader->io_size, 4096), reader->io_size) != 0)
+    {
+      reader->failed_errno = ENOMEM;
+      return NULL;
+    }
+
+  rand = g_rand_new_with_seed (reader->seed);
+  for (n = 0; n < reader->num_ios; n++)
+    {
+      guint64 offset;
+      guint64 latency;
+      gint64 start;
+
+      if (g_cancellable_is_cancelled (reader->cancellable))
+        break;
+
+      offset = (((guint64) g_rand_int (rand) << 32) | g_rand_int (rand)) % reader->num_blocks;
+      offset *= reader->io_size;
+
+      start = g_get_monotonic_time ();
+      if (!transfer_all (reader->fd, FALSE, buf, reader->io_size, offset))
+        {
+          reader->failed_offset = offset;
+          reader->failed_errno = errno;
+          break;
+        }
+      latency = g_get_monotonic_time () - start;
+      g_array_append_val (reader->latencies, latency);
+    }
+
+  g_rand_free (rand);
+  free (buf);
+  return NULL;
+}
+
+static gint
+compare_latencies (gconstpointer a,
+                   gconstpointer b)
+{
+  guint64 la = *((const guint64 *) a);
+  guint64 lb = *((const guint64 *) b);
+
+  return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+/* Does @num_ios random reads of @io_size bytes with @queue_depth of
+ * them in flight. Returns the sorted latencies in microseconds and the
+ * wall clock time it took.
+ */
+static GArray *
+run_random_reads (gint           fd,
+                  guint64        size,
+                  guint          io_size,
+                  guint          queue_depth,
+                  guint          num_ios,
+                  gint64        *out_elapsed_usec,
+                  GCancellable  *cancellable,
+                  GError       **error)
+{
+  RandomReader *readers;
+  GThread **threads;
+  GArray *ret;
+  gint64 start;
+  guint n;
+
+  readers = g_new0 (RandomReader, queue_depth);
+  threads = g_new0 (GThread *, queue_depth);
+  ret = g_array_sized_new (FALSE, FALSE, sizeof (guint64), num_ios);
+
+  start = g_get_monotonic_time ();
+  for (n = 0; n < queue_depth; n++)
+    {
+      readers[n].fd = fd;
+      readers[n].num_blocks = size / io_size;
+      readers[n].io_size = io_size;
+      /* spread the remainder over the first threads */
+      readers[n].num_ios = num_ios / queue_depth + (n < num_ios % queue_depth ? 1 : 0);
+      readers[n].seed = g_random_int ();
+      readers[n].cancellable = cancellable;
+      readers[n].latencies = g_array_sized_new (FALSE, FALSE, sizeof (guint64), readers[n].num_ios);
+      threads[n] = g_thread_new ("benchmark-reader", random_reader_thread_func, &readers[n]);
+    }
+
+  for (n = 0; n < queue_depth; n++)
+    g_thread_join (threads[n]);
+  *out_elapsed_usec = MAX (g_get_monotonic_time () - start, 1);
+
+  for (n = 0; n < queue_depth; n++)
+    {
+      if (readers[n].failed_errno != 0 && ret != NULL)
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error reading %u bytes at offset %" G_GUINT64_FORMAT ": %s",
+                       io_size, readers[n].failed_offset, g_strerror (readers[n].failed_errno));
+          g_array_unref (ret);
+          ret = NULL;
+        }
+      if (ret != NULL)
+        g_array_append_vals (ret, readers[n].latencies->data, readers[n].latencies->len);
+      g_array_unref (readers[n].latencies);
+    }
+
+  if (ret != NULL && g_cancellable_is_cancelled (cancellable))
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_CANCELLED,
+                   "Job was canceled");
+      g_array_unref (ret);
+      ret = NULL;
+    }
+
+  if (ret != NULL)
+    g_array_sort (ret, compare_latencies);
+
+  g_free (threads);
+  g_free (readers);
+  return ret;
+}
+
+/* mean, median, 99th percentile and maximum of sorted @latencies */
+static void
+get_latency_stats (GArray  *latencies,
+                   guint64 *out_mean,
+                   guint64 *out_p50,
+                   guint64 *out_p99,
+                   guint64 *out_max)
+{
+  guint64 total = 0;
+  guint n;
+
+  *out_mean = *out_p50 = *out_p99 = *out_max = 0;
+  if (latencies->len == 0)
+    return;
+
+  for (n = 0; n < latencies->len; n++)
+    total += g_array_index (latencies, guint64, n);
+
+  *out_mean = total / latencies->len;
+  *out_p50 = g_array_index (latencies, guint64, (latencies->len - 1) / 2);
+  *out_p99 = g_array_index (latencies, guint64, (latencies->len - 1) * 99 / 100);
+  *out_max = g_array_index (latencies, guint64, latencies->len - 1);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+measure_sequential (UDisksBaseJob                      *job,
+                    gint                                fd,
+                    guint64                             size,
+                    guint                               block_size,
+                    const UDisksBlockBenchmarkOptions  *options,
+                    guint                               num_steps,
+                    GVariantBuilder                    *builder,
+                    GCancellable                       *cancellable,
+                    GError                            **error)
+{
+  guint64 sample_size;
+  guint64 read_usec = 0;
+  guint64 write_usec = 0;
+  guchar *buf = NULL;
+  gboolean ret = FALSE;
+  guint n;
+
+  sample_size = MIN (options->sample_size, size);
+  sample_size -= sample_size % block_size;
+  if (sample_size == 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "The sample size has to be at least one block of %u bytes",
+                   block_size);
+      goto out;
+    }
+
+  if (posix_memalign ((void **) &buf, MAX (block_size, 4096), sample_size) != 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error allocating %" G_GUINT64_FORMAT " bytes", sample_size);
+      goto out;
+    }
+
+  for (n = 0; n < options->num_samples; n++)
+    {
+      guint64 offset;
+      gint64 start;
+
+      if (g_cancellable_is_cancelled (cancellable))
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_CANCELLED,
+                       "Job was canceled");
+          goto out;
+        }
+
+      offset = (size - sample_size) / options->num_samples * n;
+      offset -= offset % block_size;
+
+      start = g_get_monotonic_time ();
+      if (!transfer_all (fd, FALSE, buf, sample_size, offset))
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error reading %" G_GUINT64_FORMAT " bytes at offset %" G_GUINT64_FORMAT ": %m",
+                       sample_size, offset);
+          goto out;
+        }
+      read_usec += g_get_monotonic_time () - start;
+
+      /* write back what was just read so the contents are preserved */
+      if (options->write)
+        {
+          start = g_get_monotonic_time ();
+          if (!transfer_all (fd, TRUE, buf, sample_size, offset))
+            {
+              g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                           "Error writing %" G_GUINT64_FORMAT " bytes at offset %" G_GUINT64_FORMAT ": %m",
+                           sample_size, offset);
+              goto out;
+            }
+          write_usec += g_get_monotonic_time () - start;
+        }
+
+      if (job != NULL)
+        udisks_job_set_progress (UDISKS_JOB (job), (gdouble) (n + 1) / num_steps);
+    }
+
+  g_variant_builder_add (builder, "{sv}", "read-rate",
+                         g_variant_new_double ((gdouble) sample_size * options->num_samples * G_USEC_PER_SEC / MAX (read_usec, 1)));
+  if (options->write)
+    g_variant_builder_add (builder, "{sv}", "write-rate",
+                           g_variant_new_double ((gdouble) sample_size * options->num_samples * G_USEC_PER_SEC / MAX (write_usec, 1)));
+
+  ret = TRUE;
+
+ out:
+  free (buf);
+  return ret;
+}
+
+/**
+ * udisks_linux_block_benchmark_sync:
+ * @job: (allow-none): A #UDisksBaseJob to report the progress to or %NULL.
+ * @fd: A file descriptor for a block device opened with <literal>O_DIRECT</literal>, writable if @options request writing.
+ * @options: The #UDisksBlockBenchmarkOptions.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Benchmarks the block device behind @fd. This blocks the calling
+ * thread until all the measurements are done, so it is meant to be used
+ * from a #UDisksThreadedJob.
+ *
+ * The result contains the time of the benchmark as
+ * <literal>time</literal> (microseconds since the Epoch) and for the
+ * measurements that were done <literal>read-rate</literal> and
+ * <literal>write-rate</literal> (bytes per second),
+ * <literal>access-time</literal> (mean, median, 99th percentile and
+ * maximum in microseconds) and <literal>random-read</literal> (for
+ * every queue depth the depth, the number of reads per second and the
+ * latency statistics like in <literal>access-time</literal>).
+ *
+ * Returns: (transfer floating): A #GVariant of type
+ * <literal>a{sv}</literal> or %NULL if @error is set.
+ */
+GVariant *
+udisks_linux_block_benchmark_sync (UDisksBaseJob                      *job,
+                                   gint                                fd,
+                                   const UDisksBlockBenchmarkOptions  *options,
+                                   GCancellable                       *cancellable,
+                                   GError                            **error)
+{
+  GVariantBuilder builder;
+  GVariantBuilder random_builder;
+  GArray *latencies;
+  guint64 size;
+  gint block_size;
+  gint64 elapsed;
+  guint64 mean, p50, p99, max;
+  guint num_steps;
+  guint step;
+  guint n;
+
+  if (ioctl (fd, BLKGETSIZE64, &size) != 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error doing BLKGETSIZE64 ioctl: %m");
+      return NULL;
+    }
+  if (ioctl (fd, BLKSSZGET, &block_size) != 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error doing BLKSSZGET ioctl: %m");
+      return NULL;
+    }
+  if (size < MAX ((guint64) block_size, BENCHMARK_RANDOM_IO_SIZE))
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "The device is too small to be benchmarked");
+      return NULL;
+    }
+
+  num_steps = options->num_samples + (options->access_time_samples > 0 ? 1 : 0) + options->num_queue_depths;
+  if (job != NULL)
+    {
+      udisks_job_set_progress_valid (UDISKS_JOB (job), TRUE);
+      udisks_base_job_set_auto_estimate (job, TRUE);
+    }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "time", g_variant_new_uint64 (g_get_real_time ()));
+
+  if (options->num_samples > 0 &&
+      !measure_sequential (job, fd, size, block_size, options, num_steps, &builder, cancellable, error))
+    goto fail;
+  step = options->num_samples;
+
+  if (options->access_time_samples > 0)
+    {
+      latencies = run_random_reads (fd, size, block_size, 1, options->access_time_samples,
+                                    &elapsed, cancellable, error);
+      if (latencies == NULL)
+        goto fail;
+      get_latency_stats (latencies, &mean, &p50, &p99, &max);
+      g_variant_builder_add (&builder, "{sv}", "access-time",
+                             g_variant_new ("(tttt)", mean, p50, p99, max));
+      g_array_unref (latencies);
+
+      if (job != NULL)
+        udisks_job_set_progress (UDISKS_JOB (job), (gdouble) ++step / num_steps);
+    }
+
+  if (options->num_queue_depths > 0)
+    {
+      g_variant_builder_init (&random_builder, G_VARIANT_TYPE ("a(udtttt)"));
+      for (n = 0; n < options->num_queue_depths; n++)
+        {
+          latencies = run_random_reads (fd, size, MAX (block_size, BENCHMARK_RANDOM_IO_SIZE),
+                                        options->queue_depths[n], options->random_ios,
+                                        &elapsed, cancellable, error);
+          if (latencies == NULL)
+            {
+              g_variant_builder_clear (&random_builder);
+              goto fail;
+            }
+          get_latency_stats (latencies, &mean, &p50, &p99, &max);
+          g_variant_builder_add (&random_builder, "(udtttt)",
+                                 options->queue_depths[n],
+                                 (gdouble) latencies->len * G_USEC_PER_SEC / elapsed,
+                                 mean, p50, p99, max);
+          g_array_unref (latencies);
+
+          if (job != NULL)
+            udisks_job_set_progress (UDISKS_JOB (job), (gdouble) ++step / num_steps);
+        }
+      g_variant_builder_add (&builder, "{sv}", "random-read", g_variant_builder_end (&random_builder));
+    }
+
+  return g_variant_builder_end (&builder);
+
+ fail:
+  g_variant_builder_clear (&builder);
+  return NULL;
+}
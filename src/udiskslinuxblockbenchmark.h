@@ -0,0 +1,66 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __UDISKS_LINUX_BLOCK_BENCHMARK_H__
+#define __UDISKS_LINUX_BLOCK_BENCHMARK_H__
+
+#include "udisksdaemontypes.h"
+
+G_BEGIN_DECLS
+
+#define UDISKS_BLOCK_BENCHMARK_MAX_QUEUE_DEPTH 256
+/* upper bounds of the options, the buffers are sized after them */
+#define UDISKS_BLOCK_BENCHMARK_MAX_NUM_SAMPLES          1000
+#define UDISKS_BLOCK_BENCHMARK_MAX_SAMPLE_SIZE          (64 * 1024 * 1024)
+#define UDISKS_BLOCK_BENCHMARK_MAX_ACCESS_TIME_SAMPLES  100000
+#define UDISKS_BLOCK_BENCHMARK_MAX_RANDOM_IOS           (1024 * 1024)
+
+/**
+ * UDisksBlockBenchmarkOptions:
+ * @num_samples: Number of places the sequential transfer rate is measured at.
+ * @sample_size: Number of bytes transferred at each of the places.
+ * @write: Whether to also measure the sequential write rate by writing back the data that was read.
+ * @access_time_samples: Number of random reads of a single block the access time is measured with.
+ * @queue_depths: Queue depths to measure random reads of 4 KiB at.
+ * @num_queue_depths: Number of elements in @queue_depths.
+ * @random_ios: Number of random reads done at each of the @queue_depths.
+ *
+ * Parameters of udisks_linux_block_benchmark_sync(). Zero for
+ * @num_samples, @access_time_samples or @num_queue_depths skips the
+ * respective measurement.
+ */
+typedef struct
+{
+  guint     num_samples;
+  guint64   sample_size;
+  gboolean  write;
+  guint     access_time_samples;
+  guint    *queue_depths;
+  guint     num_queue_depths;
+  guint     random_ios;
+} UDisksBlockBenchmarkOptions;
+
+GVariant *udisks_linux_block_benchmark_sync (UDisksBaseJob                      *job,
+                                             gint                                fd,
+                                             const UDisksBlockBenchmarkOptions  *options,
+                                             GCancellable                       *cancellable,
+                                             GError                            **error);
+
+G_END_DECLS
+
+#endif /* __UDISKS_LINUX_BLOCK_BENCHMARK_H__ */
@@ -0,0 +1,661 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _GNU_SOURCE /* for splice() and SEEK_DATA */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <linux/fs.h>
+
+#include "udiskslogging.h"
+#include "udiskslinuxblockcopy.h"
+#include "udisksbasejob.h"
+
+/**
+ * SECTION:udiskslinuxblockcopy
+ * @title: Block device copying
+ * @short_description: Copying data between block devices and image files
+ *
+ * Copies the contents of a block device to a file descriptor or the
+ * other way around inside the daemon.
+ *
+ * When one side is a pipe and there is nothing to skip the data is
+ * moved with splice() without ever reaching user space. Otherwise a
+ * reader thread keeps a queue of up to <literal>queue_depth</literal>
+ * buffers filled ahead of the writer so that reading the source and
+ * writing the target overlap. With %UDISKS_BLOCK_COPY_FLAGS_SPARSE,
+ * holes of sparse source files are found with
+ * <literal>SEEK_DATA</literal> and never read, and runs of zeroes are
+ * left as holes in regular target files or zeroed out with the
+ * <literal>BLKZEROOUT</literal> ioctl on target block devices.
+ */
+
+#define COPY_BUFFER_SIZE (1024 * 1024)
+
+/* granularity of the detection of zeroes */
+#define COPY_ZERO_BLOCK_SIZE 4096
+
+/* shorter runs of zeroes are written to block devices as they are, a
+ * BLKZEROOUT for every few kilobytes would be slower than the write
+ */
+#define COPY_MIN_ZEROOUT_SIZE (64 * 1024)
+
+typedef struct
+{
+  guchar   *data;
+  guint64   offset;
+  guint64   length;
+  gboolean  hole;
+  gboolean  end;
+} CopyChunk;
+
+typedef struct
+{
+  gint          fd;
+  gboolean      seekable;
+  gboolean      seek_data;
+  guint64       size;   /* 0 if not known in advance */
+  guint64       limit;  /* 0 if unlimited */
+  GAsyncQueue  *free_chunks;
+  GAsyncQueue  *full_chunks;
+  gint          abort;
+  GError       *error;
+} CopyReader;
+
+typedef struct
+{
+  gint      fd;
+  gboolean  is_file;
+  gboolean  is_block;
+  gboolean  sparse;
+  gboolean  zeroout_supported;
+  guint64   min_skip;
+  guchar   *zeroes;
+} CopyWriter;
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gssize
+read_all (gint      fd,
+          gboolean  seekable,
+          guchar   *buf,
+          gsize     count,
+          guint64   offset)
+{
+  gsize done = 0;
+
+  while (done < count)
+    {
+      gssize num_read;
+
+      if (seekable)
+        num_read = pread (fd, buf + done, count - done, offset + done);
+      else
+        num_read = read (fd, buf + done, count - done);
+      if (num_read == -1)
+        {
+          if (errno == EINTR)
+            continue;
+          return -1;
+        }
+      if (num_read == 0)
+        break;
+      done += num_read;
+    }
+
+  return done;
+}
+
+static gpointer
+copy_reader_thread_func (gpointer user_data)
+{
+  CopyReader *reader = user_data;
+  CopyChunk *chunk;
+  guint64 pos = 0;
+  guint64 data_end = 0;
+
+  while (TRUE)
+    {
+      guint64 to_read;
+      gssize num_read;
+
+      chunk = g_async_queue_pop (reader->free_chunks);
+      chunk->offset = pos;
+      chunk->length = 0;
+      chunk->hole = FALSE;
+      chunk->end = FALSE;
+
+      if (g_atomic_int_get (&reader->abort))
+        break;
+
+      if (reader->size > 0 && pos >= reader->size)
+        break;
+
+      /* skip the holes of sparse files without reading them */
+      if (reader->seek_data && pos >= data_end)
+        {
+          off_t data;
+          off_t hole;
+
+          data = lseek (reader->fd, pos, SEEK_DATA);
+          if (data == -1 && errno == ENXIO)
+            {
+              /* only a hole up to the end of the file */
+              data = reader->size;
+            }
+          else if (data == -1)
+            {
+              /* not supported by the filesystem, read everything */
+              reader->seek_data = FALSE;
+              data = pos;
+            }
+
+          if ((guint64) data > pos)
+            {
+              chunk->hole = TRUE;
+              chunk->length = MIN ((guint64) data, reader->size) - pos;
+              pos += chunk->length;
+              g_async_queue_push (reader->full_chunks, chunk);
+              continue;
+            }
+
+          if (reader->seek_data)
+            {
+              hole = lseek (reader->fd, pos, SEEK_HOLE);
+              data_end = hole == -1 ? reader->size : (guint64) hole;
+            }
+        }
+
+      to_read = COPY_BUFFER_SIZE;
+      if (reader->size > 0)
+        to_read = MIN (to_read, reader->size - pos);
+      if (reader->seek_data)
+        to_read = MIN (to_read, data_end - pos);
+
+      num_read = read_all (reader->fd, reader->seekable, chunk->data, to_read, pos);
+      if (num_read == -1)
+        {
+          g_set_error (&reader->error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error reading %" G_GUINT64_FORMAT " bytes at offset %" G_GUINT64_FORMAT ": %m",
+                       to_read, pos);
+          break;
+        }
+      if (num_read == 0)
+        {
+          if (reader->size > 0)
+            g_set_error (&reader->error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                         "Unexpected end of data at offset %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " bytes",
+                         pos, reader->size);
+          break;
+        }
+      if (reader->limit > 0 && pos + num_read > reader->limit)
+        {
+          g_set_error (&reader->error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "The data does not fit onto the target of %" G_GUINT64_FORMAT " bytes",
+                       reader->limit);
+          break;
+        }
+
+      chunk->length = num_read;
+      pos += num_read;
+      g_async_queue_push (reader->full_chunks, chunk);
+    }
+
+  chunk->end = TRUE;
+  g_async_queue_push (reader->full_chunks, chunk);
+  return NULL;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+is_zero (const guchar *buf,
+         gsize         len)
+{
+  return buf[0] == 0 && memcmp (buf, buf + 1, len - 1) == 0;
+}
+
+static gboolean
+write_range (CopyWriter    *writer,
+             const guchar  *buf,
+             guint64        offset,
+             guint64        length,
+             GError       **error)
+{
+  guint64 done = 0;
+
+  while (done < length)
+    {
+      gssize num_written;
+
+      if (writer->is_file || writer->is_block)
+        num_written = pwrite (writer->fd, buf + done, length - done, offset + done);
+      else
+        num_written = write (writer->fd, buf + done, length - done);
+      if (num_written == -1 || num_written == 0)
+        {
+          if (num_written == -1 && errno == EINTR)
+            continue;
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error writing %" G_GUINT64_FORMAT " bytes at offset %" G_GUINT64_FORMAT ": %m",
+                       length - done, offset + done);
+          return FALSE;
+        }
+      done += num_written;
+    }
+
+  return TRUE;
+}
+
+/* makes the target read back zeroes in the given range */
+static gboolean
+skip_range (CopyWriter  *writer,
+            guint64      offset,
+            guint64      length,
+            GError     **error)
+{
+  /* regular files are truncated first, skipped ranges stay holes */
+  if (writer->is_file)
+    return TRUE;
+
+  if (writer->is_block && writer->zeroout_supported)
+    {
+      guint64 range[2] = { offset, length };
+
+      if (ioctl (writer->fd, BLKZEROOUT, range) == 0)
+        return TRUE;
+
+      udisks_debug ("BLKZEROOUT failed, writing zeroes instead: %m");
+      writer->zeroout_supported = FALSE;
+    }
+
+  while (length > 0)
+    {
+      guint64 len = MIN (length, COPY_BUFFER_SIZE);
+
+      if (!write_range (writer, writer->zeroes, offset, len, error))
+        return FALSE;
+      offset += len;
+      length -= len;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+write_chunk (CopyWriter  *writer,
+             CopyChunk   *chunk,
+             GError     **error)
+{
+  guint64 pos = 0;
+
+  if (chunk->hole)
+    return skip_range (writer, chunk->offset, chunk->length, error);
+
+  if (!writer->sparse)
+    return write_range (writer, chunk->data, chunk->offset, chunk->length, error);
+
+  /* write out the runs of data and skip the long enough runs of zeroes */
+  while (pos < chunk->length)
+    {
+      guint64 end = pos;
+      guint64 zero_start;
+
+      while (end < chunk->length &&
+             !is_zero (chunk->data + end, MIN (COPY_ZERO_BLOCK_SIZE, chunk->length - end)))
+        end += COPY_ZERO_BLOCK_SIZE;
+
+      zero_start = MIN (end, chunk->length);
+      while (end < chunk->length &&
+             is_zero (chunk->data + end, MIN (COPY_ZERO_BLOCK_SIZE, chunk->length - end)))
+        end += COPY_ZERO_BLOCK_SIZE;
+      end = MIN (end, chunk->length);
+
+      if (end - zero_start < writer->min_skip && end < chunk->length)
+        {
+          /* too short to be worth skipping, write it along with the data */
+          if (!write_range (writer, chunk->data + pos, chunk->offset + pos, end - pos, error))
+            return FALSE;
+        }
+      else
+        {
+          if (zero_start > pos &&
+              !write_range (writer, chunk->data + pos, chunk->offset + pos, zero_start - pos, error))
+            return FALSE;
+          if (end > zero_start &&
+              !skip_range (writer, chunk->offset + zero_start, end - zero_start, error))
+            return FALSE;
+        }
+      pos = end;
+    }
+
+  return TRUE;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+update_progress (UDisksBaseJob *job,
+                 guint64        done,
+                 guint64        size,
+                 gint64        *time_of_last_update)
+{
+  gint64 now;
+
+  if (job == NULL || size == 0)
+    return;
+
+  /* only emit D-Bus signal at most once a second */
+  now = g_get_monotonic_time ();
+  if (now - *time_of_last_update > G_USEC_PER_SEC)
+    {
+      udisks_job_set_progress (UDISKS_JOB (job), MIN ((gdouble) done / size, 1.0));
+      *time_of_last_update = now;
+    }
+}
+
+/* Returns -1 and sets @error on failure and 0 if splice() is not
+ * supported for the descriptors before anything was copied.
+ */
+static gint
+copy_splice (UDisksBaseJob  *job,
+             gint            source_fd,
+             gboolean        source_seekable,
+             gint            target_fd,
+             gboolean        target_seekable,
+             guint64         size,
+             GCancellable   *cancellable,
+             GError        **error)
+{
+  loff_t in_offset = 0;
+  loff_t out_offset = 0;
+  guint64 done = 0;
+  gint64 time_of_last_update;
+
+  time_of_last_update = g_get_monotonic_time ();
+  while (size == 0 || done < size)
+    {
+      gsize len = COPY_BUFFER_SIZE;
+      gssize num_moved;
+
+      if (size > 0)
+        len = MIN (len, size - done);
+
+      num_moved = splice (source_fd, source_seekable ? &in_offset : NULL,
+                          target_fd, target_seekable ? &out_offset : NULL,
+                          len, SPLICE_F_MOVE | SPLICE_F_MORE);
+      if (num_moved == -1)
+        {
+          if (errno == EINTR)
+            continue;
+          if (done == 0 && (errno == EINVAL || errno == ENOSYS))
+            return 0;
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error copying %" G_GSIZE_FORMAT " bytes at offset %" G_GUINT64_FORMAT ": %m",
+                       len, done);
+          return -1;
+        }
+      if (num_moved == 0)
+        {
+          if (size > 0)
+            {
+              g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                           "Unexpected end of data at offset %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " bytes",
+                           done, size);
+              return -1;
+            }
+          break;
+        }
+      done += num_moved;
+
+      if (g_cancellable_is_cancelled (cancellable))
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_CANCELLED,
+                       "Job was canceled");
+          return -1;
+        }
+
+      update_progress (job, done, size, &time_of_last_update);
+    }
+
+  return 1;
+}
+
+static gboolean
+copy_buffered (UDisksBaseJob  *job,
+               CopyReader     *reader,
+               CopyWriter     *writer,
+               guint           queue_depth,
+               GCancellable   *cancellable,
+               GError        **error)
+{
+  CopyChunk *chunks;
+  CopyChunk *chunk;
+  GThread *thread;
+  guint64 done = 0;
+  gint64 time_of_last_update;
+  GError *local_error = NULL;
+  guint n;
+
+  reader->free_chunks = g_async_queue_new ();
+  reader->full_chunks = g_async_queue_new ();
+  chunks = g_new0 (CopyChunk, queue_depth);
+  for (n = 0; n < queue_depth; n++)
+    {
+      chunks[n].data = g_malloc (COPY_BUFFER_SIZE);
+      g_async_queue_push (reader->free_chunks, &chunks[n]);
+    }
+
+  thread = g_thread_new ("block-copy-reader", copy_reader_thread_func, reader);
+
+  time_of_last_update = g_get_monotonic_time ();
+  while (TRUE)
+    {
+      chunk = g_async_queue_pop (reader->full_chunks);
+      if (chunk->end)
+        break;
+
+      /* keep taking the chunks from the queue after a failure until the
+       * reader notices it and stops
+       */
+      if (local_error == NULL)
+        {
+          if (g_cancellable_is_cancelled (cancellable))
+            g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_CANCELLED,
+                         "Job was canceled");
+          else
+            write_chunk (writer, chunk, &local_error);
+
+          if (local_error != NULL)
+            g_atomic_int_set (&reader->abort, TRUE);
+        }
+
+      done = chunk->offset + chunk->length;
+      g_async_queue_push (reader->free_chunks, chunk);
+
+      if (local_error == NULL)
+        update_progress (job, done, reader->size, &time_of_last_update);
+    }
+
+  g_thread_join (thread);
+
+  if (local_error == NULL && reader->error != NULL)
+    local_error = g_steal_pointer (&reader->error);
+  g_clear_error (&reader->error);
+
+  /* a regular file ending with a hole needs to be extended */
+  if (local_error == NULL && writer->is_file && ftruncate (writer->fd, done) != 0)
+    g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                 "Error setting the size of the target to %" G_GUINT64_FORMAT " bytes: %m",
+                 done);
+
+  for (n = 0; n < queue_depth; n++)
+    g_free (chunks[n].data);
+  g_free (chunks);
+  g_async_queue_unref (reader->free_chunks);
+  g_async_queue_unref (reader->full_chunks);
+
+  if (local_error != NULL)
+    {
+      g_propagate_error (error, local_error);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+/**
+ * udisks_linux_block_copy_sync:
+ * @job: (allow-none): A #UDisksBaseJob to report the progress to or %NULL.
+ * @source_fd: A readable file descriptor.
+ * @target_fd: A writable file descriptor.
+ * @queue_depth: Number of buffers read ahead of the writing, between 1 and #UDISKS_BLOCK_COPY_MAX_QUEUE_DEPTH.
+ * @flags: Flags from #UDisksBlockCopyFlags.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Copies everything from @source_fd to @target_fd, starting at the
+ * beginning of both. The file descriptors may refer to block devices,
+ * regular files or pipes. A regular target file is truncated to the
+ * size of the copied data, a target block device has to be large enough
+ * to hold it.
+ *
+ * The progress and the number of bytes are set on @job when the size of
+ * the source is known. This blocks the calling thread until the copy is
+ * finished, so it is meant to be used from a #UDisksThreadedJob.
+ *
+ * Returns: %TRUE if the data was copied, %FALSE if @error is set.
+ */
+gboolean
+udisks_linux_block_copy_sync (UDisksBaseJob         *job,
+                              gint                   source_fd,
+                              gint                   target_fd,
+                              guint                  queue_depth,
+                              UDisksBlockCopyFlags   flags,
+                              GCancellable          *cancellable,
+                              GError               **error)
+{
+  CopyReader reader = { 0, };
+  CopyWriter writer = { 0, };
+  struct stat source_stat;
+  struct stat target_stat;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (queue_depth >= 1 && queue_depth <= UDISKS_BLOCK_COPY_MAX_QUEUE_DEPTH, FALSE);
+
+  if (fstat (source_fd, &source_stat) != 0 || fstat (target_fd, &target_stat) != 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error statting file descriptor: %m");
+      goto out;
+    }
+
+  reader.fd = source_fd;
+  reader.seekable = S_ISREG (source_stat.st_mode) || S_ISBLK (source_stat.st_mode);
+  if (S_ISREG (source_stat.st_mode))
+    {
+      reader.size = source_stat.st_size;
+      reader.seek_data = (flags & UDISKS_BLOCK_COPY_FLAGS_SPARSE) && reader.size > 0;
+    }
+  else if (S_ISBLK (source_stat.st_mode) && ioctl (source_fd, BLKGETSIZE64, &reader.size) != 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error doing BLKGETSIZE64 ioctl on the source: %m");
+      goto out;
+    }
+
+  writer.fd = target_fd;
+  writer.is_file = S_ISREG (target_stat.st_mode);
+  writer.is_block = S_ISBLK (target_stat.st_mode);
+  writer.sparse = (flags & UDISKS_BLOCK_COPY_FLAGS_SPARSE) && (writer.is_file || writer.is_block);
+  writer.zeroout_supported = writer.is_block;
+  writer.min_skip = writer.is_block ? COPY_MIN_ZEROOUT_SIZE : COPY_ZERO_BLOCK_SIZE;
+
+  if (writer.is_block)
+    {
+      if (ioctl (target_fd, BLKGETSIZE64, &reader.limit) != 0)
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error doing BLKGETSIZE64 ioctl on the target: %m");
+          goto out;
+        }
+      if (reader.size > reader.limit)
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "The source of %" G_GUINT64_FORMAT " bytes does not fit onto the target of %" G_GUINT64_FORMAT " bytes",
+                       reader.size, reader.limit);
+          goto out;
+        }
+    }
+
+  if (job != NULL && reader.size > 0)
+    {
+      udisks_base_job_set_auto_estimate (job, TRUE);
+      udisks_job_set_progress_valid (UDISKS_JOB (job), TRUE);
+      udisks_job_set_bytes (UDISKS_JOB (job), reader.size);
+    }
+
+  if (reader.seekable)
+    posix_fadvise (source_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  /* pipes can be spliced to and from directly unless there is something to skip */
+  if ((S_ISFIFO (target_stat.st_mode) && reader.seekable && !reader.seek_data) ||
+      (S_ISFIFO (source_stat.st_mode) && (writer.is_file || writer.is_block) && !writer.sparse))
+    {
+      gint rc;
+
+      rc = copy_splice (job, source_fd, reader.seekable, target_fd, writer.is_file || writer.is_block,
+                        reader.size, cancellable, error);
+      if (rc != 0)
+        {
+          ret = rc > 0;
+          goto sync;
+        }
+      udisks_debug ("splice() not supported for the file descriptors, copying through buffers");
+    }
+
+  if (writer.is_file && ftruncate (target_fd, 0) != 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error truncating the target: %m");
+      goto out;
+    }
+
+  if (writer.sparse || !(writer.is_file || writer.is_block))
+    writer.zeroes = g_malloc0 (COPY_BUFFER_SIZE);
+
+  ret = copy_buffered (job, &reader, &writer, queue_depth, cancellable, error);
+
+ sync:
+  if (ret && (writer.is_file || writer.is_block) && fdatasync (target_fd) != 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error syncing the target: %m");
+      ret = FALSE;
+    }
+
+ out:
+  g_free (writer.zeroes);
+  return ret;
+}
@@ -0,0 +1,52 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __UDISKS_LINUX_BLOCK_COPY_H__
+#define __UDISKS_LINUX_BLOCK_COPY_H__
+
+#include "udisksdaemontypes.h"
+
+G_BEGIN_DECLS
+
+/**
+ * UDisksBlockCopyFlags:
+ * @UDISKS_BLOCK_COPY_FLAGS_NONE: No flags set.
+ * @UDISKS_BLOCK_COPY_FLAGS_SPARSE: Skip holes and runs of zeroes in the source instead of writing them out.
+ *
+ * Flags for udisks_linux_block_copy_sync().
+ */
+typedef enum
+{
+  UDISKS_BLOCK_COPY_FLAGS_NONE   = 0,
+  UDISKS_BLOCK_COPY_FLAGS_SPARSE = (1 << 0),
+} UDisksBlockCopyFlags;
+
+#define UDISKS_BLOCK_COPY_DEFAULT_QUEUE_DEPTH 8
+#define UDISKS_BLOCK_COPY_MAX_QUEUE_DEPTH     64
+
+gboolean udisks_linux_block_copy_sync (UDisksBaseJob         *job,
+                                       gint                   source_fd,
+                                       gint                   target_fd,
+                                       guint                  queue_depth,
+                                       UDisksBlockCopyFlags   flags,
+                                       GCancellable          *cancellable,
+                                       GError               **error);
+
+G_END_DECLS
+
+#endif /* __UDISKS_LINUX_BLOCK_COPY_H__ */
@@ -72,6 +72,18 @@
 
 typedef struct _UDisksLinuxBlockObjectClass   UDisksLinuxBlockObjectClass;
 
+/* What the interface checks need to know about a device and can learn from
+ * its uevent alone, without touching sysfs, see get_device_flags()
+ */
+typedef enum
+{
+  DEVICE_FLAGS_NONE              = 0,
+  DEVICE_FLAGS_WHOLE_DISK        = (1 << 0),
+  DEVICE_FLAGS_NEVER_PARTITIONED = (1 << 1),
+  DEVICE_FLAGS_MAYBE_NVME        = (1 << 2),
+  DEVICE_FLAGS_LOOP              = (1 << 3),
+} DeviceFlags;
+
 /**
  * UDisksLinuxBlockObject:
  *
@@ -87,6 +99,8 @@ struct _UDisksLinuxBlockObject
 
   UDisksLinuxDevice *device;
   GMutex device_mutex;
+  /* of device, updated on every uevent */
+  DeviceFlags device_flags;
 
   GMutex cleanup_mutex;
 
@@ -422,6 +436,34 @@ udisks_linux_block_object_get_device_number (UDisksLinuxBlockObject *object)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* kernel names of devices that are never partitioned: device-mapper, zram and optical drives */
+static const gchar *const never_partitioned_prefixes[] = { "dm-", "zram", "sr", NULL };
+
+static DeviceFlags
+get_device_flags (GUdevDevice *device)
+{
+  DeviceFlags flags = DEVICE_FLAGS_NONE;
+  const gchar *name;
+  guint n;
+
+  name = g_udev_device_get_name (device);
+  if (g_strcmp0 (g_udev_device_get_devtype (device), "disk") == 0)
+    {
+      flags |= DEVICE_FLAGS_WHOLE_DISK;
+      if (g_str_has_prefix (name, "loop"))
+        flags |= DEVICE_FLAGS_LOOP;
+      for (n = 0; never_partitioned_prefixes[n] != NULL; n++)
+        if (g_str_has_prefix (name, never_partitioned_prefixes[n]))
+          flags |= DEVICE_FLAGS_NEVER_PARTITIONED;
+    }
+  if (g_str_has_prefix (name, "nvme"))
+    flags |= DEVICE_FLAGS_MAYBE_NVME;
+
+  return flags;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 static void
 update_iface (UDisksObject                     *object,
               const gchar                      *uevent_action,
@@ -502,14 +544,18 @@ block_device_update (UDisksObject   *object,
 /* ---------------------------------------------------------------------------------------------------- */
 
 static gboolean
-disk_is_partitioned_by_kernel (GUdevDevice *device)
+disk_is_partitioned_by_kernel (GUdevDevice *device,
+                               DeviceFlags  flags)
 {
   gboolean ret = FALSE;
   GDir *dir = NULL;
   const gchar *name;
   const gchar *device_name;
 
-  g_return_val_if_fail (g_strcmp0 (g_udev_device_get_devtype (device), "disk") == 0, FALSE);
+  g_return_val_if_fail (flags & DEVICE_FLAGS_WHOLE_DISK, FALSE);
+
+  if (flags & DEVICE_FLAGS_NEVER_PARTITIONED)
+    goto out;
 
   dir = g_dir_open (g_udev_device_get_sysfs_path (device), 0 /* flags */, NULL /* GError */);
   if (dir == NULL)
@@ -544,7 +590,7 @@ partition_table_check (UDisksObject *object)
   gboolean ret = FALSE;
 
   /* only consider whole disks, never partitions */
-  if (g_strcmp0 (g_udev_device_get_devtype (block_object->device->udev_device), "disk") != 0)
+  if (!(block_object->device_flags & DEVICE_FLAGS_WHOLE_DISK))
     goto out;
 
   /* if blkid(8) already identified the device as a partition table, it's all good */
@@ -559,7 +605,7 @@ partition_table_check (UDisksObject *object)
        */
       if (g_strcmp0 (g_udev_device_get_property (block_object->device->udev_device, "ID_FS_USAGE"), "filesystem") == 0)
         {
-          if (!disk_is_partitioned_by_kernel (block_object->device->udev_device))
+          if (!disk_is_partitioned_by_kernel (block_object->device->udev_device, block_object->device_flags))
             {
               goto out;
             }
@@ -578,7 +624,7 @@ partition_table_check (UDisksObject *object)
    * children... then it must be partitioned by the kernel, hence it
    * must contain a partition table.
    */
-  if (disk_is_partitioned_by_kernel (block_object->device->udev_device))
+  if (disk_is_partitioned_by_kernel (block_object->device->udev_device, block_object->device_flags))
     {
       ret = TRUE;
       goto out;
@@ -652,6 +698,10 @@ drive_does_not_detect_media_change (UDisksLinuxBlockObject *object)
   gboolean ret = FALSE;
   UDisksObject *drive_object;
 
+  /* most device-mapper and other virtual devices have no drive */
+  if (g_strcmp0 (udisks_block_get_drive (object->iface_block_device), "/") == 0)
+    return FALSE;
+
   drive_object = udisks_daemon_find_object (object->daemon, udisks_block_get_drive (object->iface_block_device));
   if (drive_object != NULL)
     {
@@ -673,6 +723,7 @@ contains_filesystem_locked (UDisksLinuxBlockObject *block_object, UDisksLinuxDev
   gboolean ret = FALSE;
   gboolean detected_as_filesystem = FALSE;
   UDisksMountType mount_type;
+  DeviceFlags flags;
 
   /* if blkid(8) has detected the device as a filesystem, trust that */
   if (g_strcmp0 (udisks_block_get_id_usage (block_object->iface_block_device), "filesystem") == 0)
@@ -684,8 +735,9 @@ contains_filesystem_locked (UDisksLinuxBlockObject *block_object, UDisksLinuxDev
        * (see partition_table_check() above for the similar case where we don't pretend
        * to be a partition table)
        */
-      if (g_strcmp0 (g_udev_device_get_devtype (device->udev_device), "disk") == 0 &&
-          disk_is_partitioned_by_kernel (device->udev_device))
+      flags = device == block_object->device ? block_object->device_flags : get_device_flags (device->udev_device);
+      if ((flags & DEVICE_FLAGS_WHOLE_DISK) &&
+          disk_is_partitioned_by_kernel (device->udev_device, flags))
         {
           detected_as_filesystem = FALSE;
         }
@@ -826,8 +878,7 @@ loop_check (UDisksObject *object)
   gboolean ret;
 
   ret = FALSE;
-  if (g_str_has_prefix (g_udev_device_get_name (block_object->device->udev_device), "loop") &&
-      g_strcmp0 (g_udev_device_get_devtype (block_object->device->udev_device), "disk") == 0)
+  if (block_object->device_flags & DEVICE_FLAGS_LOOP)
     ret = TRUE;
 
   return ret;
@@ -854,6 +905,10 @@ nvme_namespace_check (UDisksObject *object)
 {
   UDisksLinuxBlockObject *block_object = UDISKS_LINUX_BLOCK_OBJECT (object);
 
+  /* namespaces are always named nvme*, don't walk up the device hierarchy for others */
+  if (!(block_object->device_flags & DEVICE_FLAGS_MAYBE_NVME))
+    return FALSE;
+
   if (udisks_linux_device_subsystem_is_nvme (block_object->device) &&
       g_udev_device_has_sysfs_attr (block_object->device->udev_device, "nsid"))
     return TRUE;
@@ -905,6 +960,7 @@ udisks_linux_block_object_uevent (UDisksLinuxBlockObject *object,
       g_mutex_unlock (&object->device_mutex);
       g_object_notify (G_OBJECT (object), "device");
     }
+  object->device_flags = get_device_flags (object->device->udev_device);
 
   update_iface (UDISKS_OBJECT (object), action, block_device_check, block_device_connect, block_device_update,
                 UDISKS_TYPE_LINUX_BLOCK, &object->iface_block_device);
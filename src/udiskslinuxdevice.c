@@ -433,3 +433,34 @@ udisks_linux_device_subsystem_is_nvme (UDisksLinuxDevice *device)
 
   return FALSE;
 }
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/**
+ * udisks_linux_device_dup_controller_key:
+ * @device: (nullable): A #UDisksLinuxDevice.
+ *
+ * Gets a key identifying the controller (e.g. the host bus adapter)
+ * @device is attached to, that is the sysfs path of the closest PCI
+ * function in the device hierarchy.
+ *
+ * Returns: (transfer full) (nullable): The controller key or %NULL if
+ *          not known. Free with g_free().
+ */
+gchar *
+udisks_linux_device_dup_controller_key (UDisksLinuxDevice *device)
+{
+  GUdevDevice *parent;
+  gchar *ret = NULL;
+
+  if (device == NULL || device->udev_device == NULL)
+    return NULL;
+
+  parent = g_udev_device_get_parent_with_subsystem (device->udev_device, "pci", NULL);
+  if (parent != NULL)
+    {
+      ret = g_strdup (g_udev_device_get_sysfs_path (parent));
+      g_object_unref (parent);
+    }
+  return ret;
+}
@@ -252,27 +252,16 @@ configuration_get_path (UDisksLinuxDrive *drive,
   return path;
 }
 
-/* returns TRUE if configuration changed */
-static gboolean
-update_configuration (UDisksLinuxDrive       *drive,
-                      UDisksLinuxDriveObject *object)
+/* returns a parsed copy of the drive config file at @path or %NULL if there is none */
+static GVariant *
+configuration_load (const gchar *path)
 {
-  UDisksDaemon *daemon;
   GKeyFile *key_file = NULL;
-  gboolean ret = FALSE;
-  gchar *path = NULL;
   GError *error = NULL;
   GVariant *value = NULL;
   GVariantBuilder builder;
-  GVariant *old_value;
   guint n;
 
-  daemon = udisks_linux_drive_object_get_daemon (object);
-
-  path = configuration_get_path (drive, daemon);
-  if (path == NULL)
-    goto out;
-
   key_file = g_key_file_new ();
   if (!g_key_file_load_from_file (key_file,
                                   path,
@@ -334,6 +323,41 @@ update_configuration (UDisksLinuxDrive       *drive,
 
   value = g_variant_ref_sink (g_variant_builder_end (&builder));
 
+ out:
+  g_key_file_free (key_file);
+
+  return value;
+}
+
+/* returns TRUE if configuration changed */
+static gboolean
+update_configuration (UDisksLinuxDrive       *drive,
+                      UDisksLinuxDriveObject *object)
+{
+  UDisksDaemon *daemon;
+  UDisksConfigManager *config_manager;
+  const gchar *id;
+  gboolean ret = FALSE;
+  gchar *path = NULL;
+  GVariant *value = NULL;
+  GVariant *old_value;
+  guint generation;
+
+  daemon = udisks_linux_drive_object_get_daemon (object);
+  config_manager = udisks_daemon_get_config_manager (daemon);
+
+  id = udisks_drive_get_id (UDISKS_DRIVE (drive));
+  if (id == NULL || strlen (id) == 0)
+    goto out;
+
+  /* the file is only read again once the config dir monitor reported a change */
+  if (!udisks_config_manager_lookup_drive_configuration (config_manager, id, &value, &generation))
+    {
+      path = configuration_get_path (drive, daemon);
+      value = configuration_load (path);
+      udisks_config_manager_set_drive_configuration (config_manager, id, value, generation);
+    }
+
  out:
   g_free (path);
 
@@ -342,8 +366,6 @@ update_configuration (UDisksLinuxDrive       *drive,
     ret = TRUE;
   udisks_drive_set_configuration (UDISKS_DRIVE (drive), value);
 
-  if (key_file != NULL)
-    g_key_file_free (key_file);
   if (value != NULL)
     g_variant_unref (value);
 
@@ -1245,6 +1267,9 @@ handle_set_configuration (UDisksDrive           *_drive,
       goto out;
     }
 
+  /* don't wait for the config dir monitor to drop the old configuration */
+  udisks_config_manager_invalidate_drive_configuration (udisks_daemon_get_config_manager (daemon),
+                                                        udisks_drive_get_id (UDISKS_DRIVE (drive)));
 
   udisks_drive_complete_set_configuration (UDISKS_DRIVE (drive), invocation);
 
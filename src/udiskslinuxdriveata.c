@@ -85,11 +85,17 @@ struct _UDisksLinuxDriveAta
   gint         smart_selftest_percent_remaining;
 
   GVariant    *smart_attributes;
+  /* raw libatasmart blob the smart_* fields were parsed from */
+  GBytes      *smart_blob;
 
   UDisksThreadedJob *selftest_job;
+  gboolean     selftest_in_batch;
 
   gboolean     secure_erase_in_progress;
   unsigned long drive_read, drive_write;
+  /* last CHECK POWER MODE result or -1, see udisks_linux_drive_ata_refresh_pm_state_sync() */
+  gint         pm_state;
+  guint64      pm_state_updated;
   gboolean     standby_enabled;
 };
 
@@ -114,6 +120,8 @@ udisks_linux_drive_ata_finalize (GObject *object)
 
   if (drive->smart_attributes != NULL)
     g_variant_unref (drive->smart_attributes);
+  if (drive->smart_blob != NULL)
+    g_bytes_unref (drive->smart_blob);
 
   if (G_OBJECT_CLASS (udisks_linux_drive_ata_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (udisks_linux_drive_ata_parent_class)->finalize (object);
@@ -125,6 +133,8 @@ udisks_linux_drive_ata_init (UDisksLinuxDriveAta *drive)
 {
   g_dbus_interface_skeleton_set_flags (G_DBUS_INTERFACE_SKELETON (drive),
                                        G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD);
+  drive->pm_state = -1;
+  udisks_drive_ata_set_pm_state (UDISKS_DRIVE_ATA (drive), -1);
 }
 
 static void
@@ -136,6 +146,18 @@ udisks_linux_drive_ata_class_init (UDisksLinuxDriveAtaClass *klass)
   gobject_class->finalize = udisks_linux_drive_ata_finalize;
 }
 
+/* may be called from any thread */
+static void
+set_pm_state (UDisksLinuxDriveAta *drive,
+              gint                 pm_state)
+{
+  G_LOCK (object_lock);
+  drive->pm_state = pm_state;
+  drive->pm_state_updated = pm_state >= 0 ? time (NULL) : 0;
+  G_UNLOCK (object_lock);
+  udisks_drive_ata_set_pm_state (UDISKS_DRIVE_ATA (drive), pm_state);
+}
+
 /**
  * udisks_linux_drive_ata_new:
  *
@@ -258,6 +280,8 @@ update_pm (UDisksLinuxDriveAta *drive,
   g_object_freeze_notify (G_OBJECT (drive));
   udisks_drive_ata_set_pm_supported (UDISKS_DRIVE_ATA (drive), !!pm_supported);
   udisks_drive_ata_set_pm_enabled (UDISKS_DRIVE_ATA (drive), !!pm_enabled);
+  if (!pm_supported || !pm_enabled)
+    set_pm_state (drive, -1);
   udisks_drive_ata_set_apm_supported (UDISKS_DRIVE_ATA (drive), !!apm_supported);
   udisks_drive_ata_set_apm_enabled (UDISKS_DRIVE_ATA (drive), !!apm_enabled);
   udisks_drive_ata_set_aam_supported (UDISKS_DRIVE_ATA (drive), !!aam_supported);
@@ -509,6 +533,10 @@ udisks_linux_drive_ata_refresh_smart_sync (UDisksLinuxDriveAta  *drive,
   uint64_t num_bad_sectors = 0;
   const SkSmartParsedData *data;
   ParseData parse_data;
+  const void *blob_data;
+  size_t blob_size;
+  GBytes *blob = NULL;
+  gboolean blob_unchanged = FALSE;
 
   object = udisks_daemon_util_dup_object (drive, error);
   if (object == NULL)
@@ -568,6 +596,7 @@ udisks_linux_drive_ata_refresh_smart_sync (UDisksLinuxDriveAta  *drive,
         noio = update_io_stats (drive, device);
       if (!udisks_ata_get_pm_state (g_udev_device_get_device_file (device->udev_device), error, &count))
         goto out;
+      set_pm_state (drive, count);
       awake = count == 0xFF || count == 0x80;
       /* don't wake up disk unless specically asked to */
       if (nowakeup && (!awake || noio))
@@ -607,6 +636,27 @@ udisks_linux_drive_ata_refresh_smart_sync (UDisksLinuxDriveAta  *drive,
       goto out;
     }
 
+  /* Drives are polled periodically and their SMART data rarely changes
+   * between two polls, so skip parsing if it's the same as last time.
+   * The status is not part of the blob and is compared separately.
+   */
+  if (sk_disk_get_blob (d, &blob_data, &blob_size) == 0)
+    blob = g_bytes_new (blob_data, blob_size);
+
+  G_LOCK (object_lock);
+  if (blob != NULL && drive->smart_blob != NULL &&
+      drive->smart_is_from_blob == (simulate_path != NULL) &&
+      drive->smart_failing == !good &&
+      g_bytes_equal (blob, drive->smart_blob))
+    {
+      drive->smart_updated = time (NULL);
+      blob_unchanged = TRUE;
+    }
+  G_UNLOCK (object_lock);
+
+  if (blob_unchanged)
+    goto out_update;
+
   if (sk_disk_smart_parse (d, &data) != 0)
     {
       g_set_error (error,
@@ -639,8 +689,13 @@ udisks_linux_drive_ata_refresh_smart_sync (UDisksLinuxDriveAta  *drive,
   if (drive->smart_attributes != NULL)
     g_variant_unref (drive->smart_attributes);
   drive->smart_attributes = g_variant_ref_sink (g_variant_builder_end (&parse_data.builder));
+  if (drive->smart_blob != NULL)
+    g_bytes_unref (drive->smart_blob);
+  drive->smart_blob = blob != NULL ? g_bytes_ref (blob) : NULL;
   G_UNLOCK (object_lock);
 
+ out_update:
+  /* the property setters only emit PropertiesChanged for values that differ */
   update_smart (drive, device);
 
   ret = TRUE;
@@ -654,6 +709,8 @@ udisks_linux_drive_ata_refresh_smart_sync (UDisksLinuxDriveAta  *drive,
     update_io_stats (drive, device);
 
  out:
+  if (blob != NULL)
+    g_bytes_unref (blob);
   g_clear_object (&device);
   if (d != NULL)
     sk_disk_free (d);
@@ -1162,7 +1219,7 @@ handle_smart_selftest_start (UDisksDriveAta        *_drive,
     }
 
   G_LOCK (object_lock);
-  if (drive->selftest_job != NULL)
+  if (drive->selftest_job != NULL || drive->selftest_in_batch)
     {
       g_dbus_method_invocation_return_error (invocation,
                                              UDISKS_ERROR,
@@ -1225,32 +1282,266 @@ handle_smart_selftest_start (UDisksDriveAta        *_drive,
 /* ---------------------------------------------------------------------------------------------------- */
 
 /**
- * udisks_linux_drive_ata_get_pm_state:
+ * udisks_linux_drive_ata_smart_batch_start_sync:
  * @drive: A #UDisksLinuxDriveAta.
- * @error: Return location for error.
- * @pm_state: Return location for the current power state value.
+ * @action: Either <literal>update</literal> or the type of self-test to start.
+ * @nowakeup: If %TRUE, don't wake up a sleeping drive when @action is <literal>update</literal>.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @error: Return location for error or %NULL.
  *
- * Get the current power mode state.
+ * Performs @drive's part of a SMART batch operation. If @action is
+ * <literal>update</literal>, the SMART data is refreshed. Otherwise
+ * @action is passed to udisks_linux_drive_ata_smart_selftest_sync()
+ * and the SMART data is refreshed afterwards.
  *
- * The format of @pm_state is the result obtained from sending the
- * ATA command `CHECK POWER MODE` to the drive.
+ * A started self-test is not monitored by a per-drive job. Instead
+ * the caller is expected to pass @drive to
+ * udisks_linux_drive_ata_smart_batch_wait_sync() which tracks the
+ * self-tests of all drives in the batch at once.
  *
- * Known values include:
- *  - `0x00`: Device is in PM2: Standby state.
- *  - `0x40`: Device is in the PM0: Active state, the NV Cache power mode is enabled, and the spindle is spun down or spinning down.
- *  - `0x41`: Device is in the PM0: Active state, the NV Cache power mode is enabled, and the spindle is spun up or spinning up.
- *  - `0x80`: Device is in PM1: Idle state.
- *  - `0xff`: Device is in the PM0: Active state or PM1: Idle State.
+ * This function can be called from any thread.
  *
- * Typically user interfaces will report "Drive is spun down" if @pm_state is
- * 0x00 and "Drive is spun up" otherwise.
+ * Returns: %TRUE if the operation succeed, %FALSE if @error is set.
+ */
+gboolean
+udisks_linux_drive_ata_smart_batch_start_sync (UDisksLinuxDriveAta  *drive,
+                                               const gchar          *action,
+                                               gboolean              nowakeup,
+                                               GCancellable         *cancellable,
+                                               GError              **error)
+{
+  gboolean is_abort = g_strcmp0 (action, "abort") == 0;
+
+  if (!udisks_drive_ata_get_smart_supported (UDISKS_DRIVE_ATA (drive)) ||
+      !udisks_drive_ata_get_smart_enabled (UDISKS_DRIVE_ATA (drive)))
+    {
+      g_set_error (error,
+                   UDISKS_ERROR,
+                   UDISKS_ERROR_FAILED,
+                   "SMART is not supported or enabled");
+      return FALSE;
+    }
+
+  if (g_strcmp0 (action, "update") == 0)
+    return udisks_linux_drive_ata_refresh_smart_sync (drive, nowakeup, NULL, cancellable, error);
+
+  if (!is_abort)
+    {
+      G_LOCK (object_lock);
+      if (drive->selftest_job != NULL || drive->selftest_in_batch)
+        {
+          G_UNLOCK (object_lock);
+          g_set_error (error,
+                       UDISKS_ERROR,
+                       UDISKS_ERROR_FAILED,
+                       "There is already SMART self-test running");
+          return FALSE;
+        }
+      drive->selftest_in_batch = TRUE;
+      G_UNLOCK (object_lock);
+    }
+
+  if (!udisks_linux_drive_ata_smart_selftest_sync (drive, action, cancellable, error))
+    {
+      if (!is_abort)
+        {
+          G_LOCK (object_lock);
+          drive->selftest_in_batch = FALSE;
+          G_UNLOCK (object_lock);
+        }
+      return FALSE;
+    }
+
+  if (is_abort)
+    {
+      /* This wakes up the selftest thread, a batch notices the abort on its next poll */
+      G_LOCK (object_lock);
+      if (drive->selftest_job != NULL)
+        g_cancellable_cancel (udisks_base_job_get_cancellable (UDISKS_BASE_JOB (drive->selftest_job)));
+      G_UNLOCK (object_lock);
+    }
+
+  /* the test is running (or aborted) even if this fails, so only the batch result carries the error */
+  return udisks_linux_drive_ata_refresh_smart_sync (drive, FALSE, NULL, NULL, error);
+}
+
+/**
+ * udisks_linux_drive_ata_smart_batch_wait_sync:
+ * @drives: (element-type UDisksLinuxDriveAta): Drives with a self-test started by udisks_linux_drive_ata_smart_batch_start_sync().
+ * @job: (allow-none): A #UDisksJob to report the aggregate progress on or %NULL.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @error: Return location for error or %NULL.
  *
- * Returns: %TRUE if the operation succeeded, %FALSE if @error is set.
+ * Polls all @drives every 30 seconds until none of them has a
+ * self-test in progress. The progress of @job is set to the average
+ * progress of the self-tests, finished ones counting as complete.
+ *
+ * If @cancellable is cancelled, the self-tests still in progress are
+ * aborted and @error is set to %UDISKS_ERROR_CANCELLED.
+ *
+ * Returns: %TRUE if all self-tests finished, %FALSE if @error is set.
  */
 gboolean
-udisks_linux_drive_ata_get_pm_state (UDisksLinuxDriveAta  *drive,
-                                     GError              **error,
-                                     guchar               *pm_state)
+udisks_linux_drive_ata_smart_batch_wait_sync (GPtrArray     *drives,
+                                              UDisksJob     *job,
+                                              GCancellable  *cancellable,
+                                              GError       **error)
+{
+  gboolean *finished;
+  gboolean ret = FALSE;
+  guint n;
+
+  finished = g_new0 (gboolean, drives->len);
+
+  if (job != NULL)
+    {
+      udisks_job_set_progress_valid (job, TRUE);
+      udisks_job_set_progress (job, 0.0);
+    }
+
+  while (TRUE)
+    {
+      guint num_running = 0;
+      gdouble progress = 0.0;
+      GPollFD poll_fd;
+
+      for (n = 0; n < drives->len; n++)
+        {
+          UDisksLinuxDriveAta *drive = g_ptr_array_index (drives, n);
+          GError *local_error = NULL;
+          gdouble drive_progress;
+
+          if (finished[n])
+            {
+              progress += 1.0;
+              continue;
+            }
+
+          /* a drive that can't be polled anymore (e.g. because it went away) is treated as finished */
+          if (!udisks_linux_drive_ata_refresh_smart_sync (drive, FALSE, NULL, NULL, &local_error))
+            {
+              udisks_warning ("Error updating ATA smart while polling during batch self-test: %s (%s, %d)",
+                              local_error->message, g_quark_to_string (local_error->domain), local_error->code);
+              g_clear_error (&local_error);
+              finished[n] = TRUE;
+            }
+
+          G_LOCK (object_lock);
+          if (finished[n] || g_strcmp0 (drive->smart_selftest_status, "inprogress") != 0)
+            {
+              finished[n] = TRUE;
+              drive->selftest_in_batch = FALSE;
+              drive_progress = 1.0;
+            }
+          else
+            {
+              num_running++;
+              drive_progress = CLAMP ((100.0 - drive->smart_selftest_percent_remaining) / 100.0, 0.0, 1.0);
+            }
+          G_UNLOCK (object_lock);
+
+          progress += drive_progress;
+        }
+
+      if (num_running == 0)
+        {
+          ret = TRUE;
+          goto out;
+        }
+
+      if (job != NULL)
+        udisks_job_set_progress (job, progress / drives->len);
+
+      /* Sleep for 30 seconds or until we're cancelled */
+      if (cancellable == NULL)
+        {
+          g_usleep (30 * G_USEC_PER_SEC);
+        }
+      else if (g_cancellable_make_pollfd (cancellable, &poll_fd))
+        {
+          gint poll_ret;
+          do
+            {
+              poll_ret = g_poll (&poll_fd, 1, 30 * 1000);
+            }
+          while (poll_ret == -1 && errno == EINTR);
+          g_cancellable_release_fd (cancellable);
+        }
+      else
+        {
+          g_set_error (error,
+                       UDISKS_ERROR,
+                       UDISKS_ERROR_FAILED,
+                       "Error creating pollfd for cancellable");
+          goto out;
+        }
+
+      if (g_cancellable_is_cancelled (cancellable))
+        {
+          g_set_error (error,
+                       UDISKS_ERROR,
+                       UDISKS_ERROR_CANCELLED,
+                       "Self-test was cancelled");
+          goto out;
+        }
+    }
+
+ out:
+  /* abort whatever is still running, e.g. on the cancel path */
+  for (n = 0; n < drives->len; n++)
+    {
+      UDisksLinuxDriveAta *drive = g_ptr_array_index (drives, n);
+      GError *c_error = NULL;
+
+      if (finished[n])
+        continue;
+
+      if (!udisks_linux_drive_ata_smart_selftest_sync (drive, "abort", NULL, &c_error) ||
+          !udisks_linux_drive_ata_refresh_smart_sync (drive, FALSE, NULL, NULL, &c_error))
+        {
+          udisks_warning ("Error aborting SMART selftest on cancel path: %s (%s, %d)",
+                          c_error->message, g_quark_to_string (c_error->domain), c_error->code);
+          g_clear_error (&c_error);
+        }
+
+      G_LOCK (object_lock);
+      drive->selftest_in_batch = FALSE;
+      G_UNLOCK (object_lock);
+    }
+
+  g_free (finished);
+  return ret;
+}
+
+/**
+ * udisks_linux_drive_ata_get_smart_selftest_status:
+ * @drive: A #UDisksLinuxDriveAta.
+ *
+ * Gets the self-test status from the last SMART data refresh of
+ * @drive. Unlike udisks_drive_ata_get_smart_selftest_status() this is
+ * safe to call from any thread.
+ *
+ * Returns: The status, see #UDisksDriveAta:smart-selftest-status. Do not free.
+ */
+const gchar *
+udisks_linux_drive_ata_get_smart_selftest_status (UDisksLinuxDriveAta *drive)
+{
+  const gchar *ret;
+
+  G_LOCK (object_lock);
+  ret = drive->smart_selftest_status;
+  G_UNLOCK (object_lock);
+
+  return ret != NULL ? ret : "";
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+get_pm_state (UDisksLinuxDriveAta  *drive,
+              gint                  timeout_msec,
+              GError              **error,
+              guchar               *pm_state)
 {
   UDisksLinuxDriveObject *object;
   UDisksLinuxDevice *device = NULL;
@@ -1288,7 +1579,10 @@ udisks_linux_drive_ata_get_pm_state (UDisksLinuxDriveAta  *drive,
       goto out;
     }
 
-  ret = udisks_ata_get_pm_state (g_udev_device_get_device_file (device->udev_device), error, pm_state);
+  ret = udisks_ata_get_pm_state_with_timeout (g_udev_device_get_device_file (device->udev_device),
+                                              timeout_msec, error, pm_state);
+  if (ret)
+    set_pm_state (drive, *pm_state);
 
  out:
   g_clear_object (&device);
@@ -1297,6 +1591,86 @@ udisks_linux_drive_ata_get_pm_state (UDisksLinuxDriveAta  *drive,
   return ret;
 }
 
+/**
+ * udisks_linux_drive_ata_get_pm_state:
+ * @drive: A #UDisksLinuxDriveAta.
+ * @error: Return location for error.
+ * @pm_state: Return location for the current power state value.
+ *
+ * Get the current power mode state.
+ *
+ * The format of @pm_state is the result obtained from sending the
+ * ATA command `CHECK POWER MODE` to the drive.
+ *
+ * Known values include:
+ *  - `0x00`: Device is in PM2: Standby state.
+ *  - `0x40`: Device is in the PM0: Active state, the NV Cache power mode is enabled, and the spindle is spun down or spinning down.
+ *  - `0x41`: Device is in the PM0: Active state, the NV Cache power mode is enabled, and the spindle is spun up or spinning up.
+ *  - `0x80`: Device is in PM1: Idle state.
+ *  - `0xff`: Device is in the PM0: Active state or PM1: Idle State.
+ *
+ * Typically user interfaces will report "Drive is spun down" if @pm_state is
+ * 0x00 and "Drive is spun up" otherwise.
+ *
+ * Returns: %TRUE if the operation succeeded, %FALSE if @error is set.
+ */
+gboolean
+udisks_linux_drive_ata_get_pm_state (UDisksLinuxDriveAta  *drive,
+                                     GError              **error,
+                                     guchar               *pm_state)
+{
+  return get_pm_state (drive, -1, error, pm_state);
+}
+
+/**
+ * udisks_linux_drive_ata_refresh_pm_state_sync:
+ * @drive: A #UDisksLinuxDriveAta.
+ * @timeout_msec: Timeout in milli-seconds for the command or -1 for the default.
+ * @error: Return location for error.
+ *
+ * Samples the current power mode state of @drive and updates the
+ * #UDisksDriveAta:pm-state property, e.g. for an authorized
+ * org.freedesktop.UDisks2.Manager.PmGetStates() call.
+ *
+ * The `CHECK POWER MODE` command doesn't wake up the drive.
+ *
+ * Returns: %TRUE if the operation succeeded, %FALSE if @error is set.
+ */
+gboolean
+udisks_linux_drive_ata_refresh_pm_state_sync (UDisksLinuxDriveAta  *drive,
+                                              gint                  timeout_msec,
+                                              GError              **error)
+{
+  guchar pm_state;
+
+  return get_pm_state (drive, timeout_msec, error, &pm_state);
+}
+
+/**
+ * udisks_linux_drive_ata_get_cached_pm_state:
+ * @drive: A #UDisksLinuxDriveAta.
+ * @out_updated: (out) (allow-none): Return location for the time of the last sample, in seconds since the Epoch, or %NULL.
+ *
+ * Gets the power mode state from the last successful sample without
+ * any I/O to the drive. This is safe to call from any thread.
+ *
+ * Returns: The power mode state or -1 if not known.
+ */
+gint
+udisks_linux_drive_ata_get_cached_pm_state (UDisksLinuxDriveAta *drive,
+                                            guint64             *out_updated)
+{
+  gint ret;
+
+  G_LOCK (object_lock);
+  ret = drive->pm_state;
+  if (out_updated != NULL)
+    *out_updated = drive->pm_state_updated;
+  G_UNLOCK (object_lock);
+
+  return ret;
+}
+
 static gboolean
 handle_pm_get_state (UDisksDriveAta        *_drive,
                      GDBusMethodInvocation *invocation,
@@ -1467,6 +1841,8 @@ handle_pm_standby_wakeup (UDisksDriveAta        *_drive,
                                                  g_udev_device_get_device_file (device->udev_device));
           goto out;
         }
+      /* the drive is spun up now, the next sample tells whether it's active or idle */
+      set_pm_state (drive, 0xff);
       udisks_drive_ata_complete_pm_wakeup (_drive, invocation);
    }
   else
@@ -1485,6 +1861,7 @@ handle_pm_standby_wakeup (UDisksDriveAta        *_drive,
         g_dbus_method_invocation_take_error (invocation, error);
         goto out;
       }
+     set_pm_state (drive, 0x00);
      udisks_drive_ata_complete_pm_standby (_drive, invocation);
    }
 
@@ -1578,6 +1955,8 @@ typedef struct
   GVariant *configuration;
   UDisksDrive *drive;
   UDisksLinuxDriveObject *object;
+  gchar *controller_key;
+  gboolean force;
 } ApplyConfData;
 
 static void
@@ -1588,16 +1967,64 @@ apply_conf_data_free (ApplyConfData *data)
   g_variant_unref (data->configuration);
   g_clear_object (&data->drive);
   g_clear_object (&data->object);
+  g_free (data->controller_key);
   g_free (data);
 }
 
+/* drops the settings from @data that @identify_data says are in effect already */
+static gboolean
+apply_conf_data_skip_current (ApplyConfData *data,
+                              const guchar  *identify_data)
+{
+  gboolean apm_enabled;
+  gboolean aam_enabled;
+  gboolean write_cache_enabled;
+  gboolean read_lookahead_enabled;
+  guint16 word_85;
+  guint16 word_86;
+  guint16 word_91;
+  guint16 word_94;
+
+  if (identify_data == NULL)
+    return FALSE;
+
+  /* ATA8: 7.16 IDENTIFY DEVICE - ECh, PIO Data-In - Table 29 IDENTIFY DEVICE data */
+  word_85 = udisks_ata_identify_get_word (identify_data, 85);
+  word_86 = udisks_ata_identify_get_word (identify_data, 86);
+  word_91 = udisks_ata_identify_get_word (identify_data, 91);
+  word_94 = udisks_ata_identify_get_word (identify_data, 94);
+
+  apm_enabled            = word_86 & (1<<3);
+  aam_enabled            = word_86 & (1<<9);
+  write_cache_enabled    = word_85 & (1<<5);
+  read_lookahead_enabled = word_85 & (1<<6);
+
+  /* 0xff disables APM and AAM, any other value enables them with that level */
+  if (data->ata_apm_level != -1 &&
+      (data->ata_apm_level == 0xff ? !apm_enabled : (apm_enabled && (word_91 & 0xff) == data->ata_apm_level)))
+    data->ata_apm_level = -1;
+
+  if (data->ata_aam_level != -1 &&
+      (data->ata_aam_level == 0xff ? !aam_enabled : (aam_enabled && (word_94 & 0xff) == data->ata_aam_level)))
+    data->ata_aam_level = -1;
+
+  if (data->ata_write_cache_enabled_set && !data->ata_write_cache_enabled == !write_cache_enabled)
+    data->ata_write_cache_enabled_set = FALSE;
+
+  if (data->ata_read_lookahead_enabled_set && !data->ata_read_lookahead_enabled == !read_lookahead_enabled)
+    data->ata_read_lookahead_enabled_set = FALSE;
+
+  /* the standby timer is not reported back by the drive */
+  return data->ata_pm_standby == -1 &&
+         data->ata_apm_level == -1 &&
+         data->ata_aam_level == -1 &&
+         !data->ata_write_cache_enabled_set &&
+         !data->ata_read_lookahead_enabled_set;
+}
+
 static void
-apply_configuration_thread_func (GTask        *task,
-                                 gpointer      source_object,
-                                 gpointer      task_data,
-                                 GCancellable *cancellable)
+apply_configuration_sync (ApplyConfData *data)
 {
-  ApplyConfData *data = task_data;
   UDisksDaemon *daemon;
   const gchar *device_file = NULL;
   gint fd = -1;
@@ -1606,10 +2033,6 @@ apply_configuration_thread_func (GTask        *task,
   daemon = udisks_linux_drive_object_get_daemon (data->object);
   device_file = g_udev_device_get_device_file (data->device->udev_device);
 
-  udisks_notice ("Applying configuration from %s/%s.conf to %s",
-                 udisks_config_manager_get_config_dir (udisks_daemon_get_config_manager (daemon)),
-                 udisks_drive_get_id (data->drive), device_file);
-
   /* Use O_RDRW instead of O_RDONLY to force a 'change' uevent so properties are updated */
   fd = open (device_file, O_RDWR|O_NONBLOCK);
   if (fd == -1)
@@ -1618,6 +2041,38 @@ apply_configuration_thread_func (GTask        *task,
       goto out;
     }
 
+  /* The IDENTIFY data of the device is only read when it's probed and our
+   * own SET FEATURES commands don't cause a uevent, so ask the drive what's
+   * in effect right now. If that fails, just send everything.
+   */
+  if (!data->force)
+    {
+      /* ATA8: 7.16 IDENTIFY DEVICE - ECh, PIO Data-In */
+      guchar identify[512];
+      UDisksAtaCommandInput input = {.command = 0xec, .count = 1};
+      UDisksAtaCommandOutput output = {.buffer = identify, .buffer_size = sizeof (identify)};
+      if (!udisks_ata_send_command_sync (fd,
+                                         -1,
+                                         UDISKS_ATA_COMMAND_PROTOCOL_DRIVE_TO_HOST,
+                                         &input,
+                                         &output,
+                                         &error))
+        {
+          udisks_debug ("Error sending ATA command IDENTIFY DEVICE to %s, applying all settings: %s",
+                        device_file, error->message);
+          g_clear_error (&error);
+        }
+      else if (apply_conf_data_skip_current (data, identify))
+        {
+          udisks_debug ("Configuration of %s already in effect", device_file);
+          goto out;
+        }
+    }
+
+  udisks_notice ("Applying configuration from %s/%s.conf to %s",
+                 udisks_config_manager_get_config_dir (udisks_daemon_get_config_manager (daemon)),
+                 udisks_drive_get_id (data->drive), device_file);
+
   if (data->ata_apm_level != -1)
     {
       /* ATA8: 7.48 SET FEATURES - EFh, Non-Data
@@ -1765,28 +2220,146 @@ apply_configuration_thread_func (GTask        *task,
         }
     }
 
+  udisks_drive_ata_set_configuration_applied (UDISKS_DRIVE_ATA (data->ata), g_get_real_time ());
+
  out:
   if (fd != -1)
     close (fd);
 }
 
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Applying the configuration sends several ATA commands that may need the
+ * drive to spin up first, and at startup or resume every drive is configured
+ * at once. At most APPLY_CONFIGURATION_MAX_PARALLEL drives in total and
+ * APPLY_CONFIGURATION_MAX_PER_CONTROLLER drives behind the same controller
+ * are configured at the same time, the others wait in apply_pending.
+ */
+#define APPLY_CONFIGURATION_MAX_PARALLEL       8
+#define APPLY_CONFIGURATION_MAX_PER_CONTROLLER 2
+
+static GMutex apply_lock;
+static GThreadPool *apply_pool = NULL;
+/* of ApplyConfData, in the order they were queued */
+static GQueue apply_pending = G_QUEUE_INIT;
+/* controller key -> number of drives being configured */
+static GHashTable *apply_running = NULL;
+/* since the queue was last empty */
+static guint apply_num_done = 0;
+static gint64 apply_started = 0;
+
+/* must be called with apply_lock held */
+static void
+apply_schedule_unlocked (void)
+{
+  GList *l;
+  GList *next;
+
+  for (l = apply_pending.head; l != NULL; l = next)
+    {
+      ApplyConfData *data = l->data;
+      guint running;
+
+      next = l->next;
+      running = GPOINTER_TO_UINT (g_hash_table_lookup (apply_running, data->controller_key));
+      if (running >= APPLY_CONFIGURATION_MAX_PER_CONTROLLER)
+        continue;
+
+      g_hash_table_insert (apply_running, g_strdup (data->controller_key), GUINT_TO_POINTER (running + 1));
+      g_queue_delete_link (&apply_pending, l);
+      g_thread_pool_push (apply_pool, data, NULL);
+    }
+}
+
+static void
+apply_configuration_worker (gpointer data,
+                            gpointer user_data)
+{
+  ApplyConfData *conf_data = data;
+  guint running;
+
+  apply_configuration_sync (conf_data);
+
+  g_mutex_lock (&apply_lock);
+  running = GPOINTER_TO_UINT (g_hash_table_lookup (apply_running, conf_data->controller_key));
+  if (running > 1)
+    g_hash_table_insert (apply_running, g_strdup (conf_data->controller_key), GUINT_TO_POINTER (running - 1));
+  else
+    g_hash_table_remove (apply_running, conf_data->controller_key);
+  apply_num_done++;
+
+  apply_schedule_unlocked ();
+
+  if (g_queue_is_empty (&apply_pending) && g_hash_table_size (apply_running) == 0)
+    {
+      udisks_notice ("Applied configuration to %u ATA drive(s) in %" G_GINT64_FORMAT " ms",
+                     apply_num_done, (g_get_monotonic_time () - apply_started) / 1000);
+      apply_num_done = 0;
+    }
+  g_mutex_unlock (&apply_lock);
+
+  apply_conf_data_free (conf_data);
+}
+
+static void
+apply_queue (ApplyConfData *data)
+{
+  GList *l;
+
+  g_mutex_lock (&apply_lock);
+  if (apply_pool == NULL)
+    {
+      apply_pool = g_thread_pool_new (apply_configuration_worker,
+                                      NULL,
+                                      APPLY_CONFIGURATION_MAX_PARALLEL,
+                                      FALSE,
+                                      NULL);
+      apply_running = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+  if (g_queue_is_empty (&apply_pending) && g_hash_table_size (apply_running) == 0)
+    apply_started = g_get_monotonic_time ();
+
+  /* a drive still waiting for its turn only needs the latest configuration */
+  for (l = apply_pending.head; l != NULL; l = l->next)
+    {
+      ApplyConfData *pending = l->data;
+      if (pending->ata == data->ata)
+        {
+          l->data = data;
+          apply_conf_data_free (pending);
+          data = NULL;
+          break;
+        }
+    }
+  if (data != NULL)
+    g_queue_push_tail (&apply_pending, data);
+
+  apply_schedule_unlocked ();
+  g_mutex_unlock (&apply_lock);
+}
+
 /**
  * udisks_linux_drive_ata_apply_configuration:
  * @drive: A #UDisksLinuxDriveAta.
  * @device: A #UDisksLinuxDevice
  * @configuration: The configuration to apply.
+ * @force: Whether to also send the settings the drive reports to be in effect.
  *
- * Spawns a thread to apply @configuration to @drive, if any. Does not
- * wait for the thread to terminate.
+ * Queues applying @configuration to @drive, if any, and does not wait
+ * for it. The settings are sent from a thread, with a limited number of
+ * drives per controller being configured at the same time. Unless
+ * @force is %TRUE, the IDENTIFY data is read from the drive right before
+ * and settings already in effect are skipped.
  */
 void
 udisks_linux_drive_ata_apply_configuration (UDisksLinuxDriveAta *drive,
                                             UDisksLinuxDevice   *device,
-                                            GVariant            *configuration)
+                                            GVariant            *configuration,
+                                            gboolean             force)
 {
   gboolean has_conf = FALSE;
   ApplyConfData *data = NULL;
-  GTask *task;
 
   data = g_new0 (ApplyConfData, 1);
   data->ata_pm_standby = -1;
@@ -1827,13 +2400,15 @@ udisks_linux_drive_ata_apply_configuration (UDisksLinuxDriveAta *drive,
   if (!has_conf)
     goto out;
 
+  data->force = force;
+
   /* this can easily take a long time and thus block (the drive may be in standby mode
    * and needs to spin up) - so run it in a thread
    */
-  task = g_task_new (data->object, NULL, NULL, NULL);
-  g_task_set_task_data (task, data, (GDestroyNotify) apply_conf_data_free);
-  g_task_run_in_thread (task, apply_configuration_thread_func);
-  g_object_unref (task);
+  data->controller_key = udisks_linux_device_dup_controller_key (device);
+  if (data->controller_key == NULL)
+    data->controller_key = g_strdup ("");
+  apply_queue (data);
 
   data = NULL; /* don't free data below */
 
@@ -1873,24 +2448,13 @@ on_secure_erase_update_progress_timeout (gpointer user_data)
   return TRUE; /* keep source around */
 }
 
-/**
- * udisks_linux_drive_ata_secure_erase_sync:
- * @drive: A #UDisksLinuxDriveAta.
- * @caller_uid: The unix user if of the caller requesting the operation.
- * @enhanced: %TRUE to use the enhanced version of the ATA secure erase command.
- * @error: Return location for error or %NULL.
- *
- * Performs an ATA Secure Erase operation. Blocks the calling thread until the operation completes.
- *
- * This operation may take a very long time (hours) to complete.
- *
- * Returns: %TRUE if the operation succeeded, %FALSE if @error is set.
- */
-gboolean
-udisks_linux_drive_ata_secure_erase_sync (UDisksLinuxDriveAta  *drive,
-                                          uid_t                 caller_uid,
-                                          gboolean              enhanced,
-                                          GError              **error)
+/* If @with_job is %FALSE, the caller is responsible for tracking the progress */
+static gboolean
+secure_erase_sync (UDisksLinuxDriveAta  *drive,
+                   uid_t                 caller_uid,
+                   gboolean              enhanced,
+                   gboolean              with_job,
+                   GError              **error)
 {
   gboolean ret = FALSE;
   UDisksDrive *_drive = NULL;
@@ -2038,17 +2602,20 @@ udisks_linux_drive_ata_secure_erase_sync (UDisksLinuxDriveAta  *drive,
 
   /* First, set up a Job object to track progress */
   num_minutes = enhanced ? 2 * GUINT16_FROM_LE (identify.words[90]) : 2 * GUINT16_FROM_LE (identify.words[89]);
-  job = udisks_daemon_launch_simple_job (daemon,
-                                         UDISKS_OBJECT (object),
-                                         enhanced ? "ata-enhanced-secure-erase" : "ata-secure-erase",
-                                         caller_uid, NULL);
-  udisks_job_set_cancelable (UDISKS_JOB (job), FALSE);
+  if (with_job)
+    {
+      job = udisks_daemon_launch_simple_job (daemon,
+                                             UDISKS_OBJECT (object),
+                                             enhanced ? "ata-enhanced-secure-erase" : "ata-secure-erase",
+                                             caller_uid, NULL);
+      udisks_job_set_cancelable (UDISKS_JOB (job), FALSE);
+    }
 
   /* A value of 510 (255 in the IDENTIFY DATA register) means "erase
    * is expected to take _at least_ 508 minutes" ... so don't attempt
    * to predict when the job is going to end and don't report progress
    */
-  if (num_minutes != 510)
+  if (job != NULL && num_minutes != 510)
     {
       udisks_job_set_expected_end_time (UDISKS_JOB (job),
                                         g_get_real_time () + num_minutes * 60LL * G_USEC_PER_SEC);
@@ -2137,6 +2704,9 @@ udisks_linux_drive_ata_secure_erase_sync (UDisksLinuxDriveAta  *drive,
       g_clear_error (&local_error);
     }
 
+  udisks_linux_block_object_trigger_uevent_sync (UDISKS_LINUX_BLOCK_OBJECT (block_object),
+                                                 UDISKS_DEFAULT_WAIT_TIMEOUT);
+
   ret = TRUE;
 
  out:
@@ -2217,6 +2787,54 @@ udisks_linux_drive_ata_secure_erase_sync (UDisksLinuxDriveAta  *drive,
   return ret;
 }
 
+/**
+ * udisks_linux_drive_ata_secure_erase_sync:
+ * @drive: A #UDisksLinuxDriveAta.
+ * @caller_uid: The unix user if of the caller requesting the operation.
+ * @enhanced: %TRUE to use the enhanced version of the ATA secure erase command.
+ * @error: Return location for error or %NULL.
+ *
+ * Performs an ATA Secure Erase operation. Blocks the calling thread until the operation completes.
+ * The partition table is re-read and a uevent is triggered once the drive is erased.
+ *
+ * This operation may take a very long time (hours) to complete.
+ *
+ * Returns: %TRUE if the operation succeeded, %FALSE if @error is set.
+ */
+gboolean
+udisks_linux_drive_ata_secure_erase_sync (UDisksLinuxDriveAta  *drive,
+                                          uid_t                 caller_uid,
+                                          gboolean              enhanced,
+                                          GError              **error)
+{
+  return secure_erase_sync (drive, caller_uid, enhanced, TRUE, error);
+}
+
+/**
+ * udisks_linux_drive_ata_secure_erase_batch_sync:
+ * @drive: A #UDisksLinuxDriveAta.
+ * @caller_uid: The unix user if of the caller requesting the operation.
+ * @enhanced: %TRUE to use the enhanced version of the ATA secure erase command.
+ * @error: Return location for error or %NULL.
+ *
+ * Like udisks_linux_drive_ata_secure_erase_sync(), with all the same
+ * checks, but without a job for @drive. Used when erasing many drives
+ * at once where a single job tracks the progress of all of them, see
+ * the #UDisksDriveAta:security-erase-unit-minutes and
+ * #UDisksDriveAta:security-enhanced-erase-unit-minutes properties for
+ * the estimates.
+ *
+ * Returns: %TRUE if the operation succeeded, %FALSE if @error is set.
+ */
+gboolean
+udisks_linux_drive_ata_secure_erase_batch_sync (UDisksLinuxDriveAta  *drive,
+                                                uid_t                 caller_uid,
+                                                gboolean              enhanced,
+                                                GError              **error)
+{
+  return secure_erase_sync (drive, caller_uid, enhanced, FALSE, error);
+}
+
 static gboolean
 handle_security_erase_unit (UDisksDriveAta        *_drive,
                             GDBusMethodInvocation *invocation,
@@ -2290,15 +2908,6 @@ handle_security_erase_unit (UDisksDriveAta        *_drive,
       goto out;
     }
 
-  if (!udisks_linux_block_object_reread_partition_table (UDISKS_LINUX_BLOCK_OBJECT (block_object), &error))
-    {
-      udisks_warning ("%s", error->message);
-      g_clear_error (&error);
-    }
-
-  udisks_linux_block_object_trigger_uevent_sync (UDISKS_LINUX_BLOCK_OBJECT (block_object),
-                                                 UDISKS_DEFAULT_WAIT_TIMEOUT);
-
  out:
   g_clear_object (&block_object);
   g_clear_object (&object);
@@ -42,18 +42,38 @@ gboolean        udisks_linux_drive_ata_smart_selftest_sync (UDisksLinuxDriveAta
                                                             const gchar             *type,
                                                             GCancellable            *cancellable,
                                                             GError                 **error);
+gboolean        udisks_linux_drive_ata_smart_batch_start_sync (UDisksLinuxDriveAta  *drive,
+                                                               const gchar          *action,
+                                                               gboolean              nowakeup,
+                                                               GCancellable         *cancellable,
+                                                               GError              **error);
+gboolean        udisks_linux_drive_ata_smart_batch_wait_sync  (GPtrArray            *drives,
+                                                               UDisksJob            *job,
+                                                               GCancellable         *cancellable,
+                                                               GError              **error);
+const gchar    *udisks_linux_drive_ata_get_smart_selftest_status (UDisksLinuxDriveAta *drive);
 gboolean        udisks_linux_drive_ata_secure_erase_sync   (UDisksLinuxDriveAta     *drive,
                                                             uid_t                    caller_uid,
                                                             gboolean                 enhanced,
                                                             GError                 **error);
+gboolean        udisks_linux_drive_ata_secure_erase_batch_sync (UDisksLinuxDriveAta *drive,
+                                                                uid_t                caller_uid,
+                                                                gboolean             enhanced,
+                                                                GError             **error);
 
 void            udisks_linux_drive_ata_apply_configuration (UDisksLinuxDriveAta     *drive,
                                                             UDisksLinuxDevice       *device,
-                                                            GVariant                *configuration);
+                                                            GVariant                *configuration,
+                                                            gboolean                 force);
 
 gboolean        udisks_linux_drive_ata_get_pm_state        (UDisksLinuxDriveAta     *drive,
                                                             GError                 **error,
                                                             guchar                  *pm_state);
+gboolean        udisks_linux_drive_ata_refresh_pm_state_sync (UDisksLinuxDriveAta   *drive,
+                                                              gint                   timeout_msec,
+                                                              GError               **error);
+gint            udisks_linux_drive_ata_get_cached_pm_state (UDisksLinuxDriveAta     *drive,
+                                                            guint64                 *out_updated);
 
 G_END_DECLS
 
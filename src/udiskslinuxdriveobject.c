@@ -661,7 +661,8 @@ nvme_ctrl_update (UDisksObject   *object,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-static void apply_configuration (UDisksLinuxDriveObject *object);
+static void apply_configuration (UDisksLinuxDriveObject *object,
+                                 gboolean                force);
 
 static GList *
 find_link_for_sysfs_path (UDisksLinuxDriveObject *object,
@@ -789,17 +790,19 @@ udisks_linux_drive_object_uevent (UDisksLinuxDriveObject *object,
     }
   g_list_free_full (modules, g_object_unref);
 
+  /* sent after resume when the drive may have lost its settings */
   if (g_strcmp0 (action, "reconfigure") == 0)
     conf_changed = TRUE;
 
   if (conf_changed)
-    apply_configuration (object);
+    apply_configuration (object, g_strcmp0 (action, "reconfigure") == 0);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
 static void
-apply_configuration (UDisksLinuxDriveObject *object)
+apply_configuration (UDisksLinuxDriveObject *object,
+                     gboolean                force)
 {
   GVariant *configuration = NULL;
   UDisksLinuxDevice *device = NULL;
@@ -819,7 +822,8 @@ apply_configuration (UDisksLinuxDriveObject *object)
     {
       udisks_linux_drive_ata_apply_configuration (UDISKS_LINUX_DRIVE_ATA (object->iface_drive_ata),
                                                   device,
-                                                  configuration);
+                                                  configuration,
+                                                  force);
     }
 
  out:
@@ -1051,7 +1055,8 @@ udisks_linux_drive_object_should_include_device (GUdevClient        *client,
  * @error: Return location for error or %NULL.
  *
  * Called periodically (every ten minutes or so) to perform
- * housekeeping tasks such as refreshing ATA SMART data.
+ * housekeeping tasks such as refreshing ATA SMART data or the NVMe
+ * health information.
  *
  * The function runs in a dedicated thread and is allowed to perform
  * blocking I/O.
@@ -1117,6 +1122,33 @@ udisks_linux_drive_object_housekeeping (UDisksLinuxDriveObject  *object,
         }
     }
 
+  if (object->iface_nvme_ctrl != NULL)
+    {
+      const gchar *state = udisks_nvme_controller_get_state (UDISKS_NVME_CONTROLLER (object->iface_nvme_ctrl));
+      GError *local_error = NULL;
+
+      /* a controller that is not live refuses I/O, see the State property */
+      if (state != NULL && *state != '\0' && g_strcmp0 (state, "live") != 0)
+        {
+          udisks_info ("NVMe controller %s is not live",
+                       g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+        }
+      else
+        {
+          /* NVMe has no standby to avoid waking up from, read the log on every housekeeping */
+          udisks_info ("Refreshing health information on %s",
+                       g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+
+          if (!udisks_linux_nvme_controller_refresh_smart_sync (object->iface_nvme_ctrl,
+                                                                cancellable,
+                                                                &local_error))
+            {
+              g_propagate_prefixed_error (error, local_error, "Error updating health information: ");
+              goto out;
+            }
+        }
+    }
+
   ret = TRUE;
 
  out:
@@ -68,6 +68,12 @@ typedef struct _UDisksLinuxEncryptedClass   UDisksLinuxEncryptedClass;
 struct _UDisksLinuxEncrypted
 {
   UDisksEncryptedSkeleton parent_instance;
+
+  /* protected by lock, the LUKS device for on-demand metadata size retrieval */
+  GMutex lock;
+  gchar *cached_device_file;
+  guint64 cached_metadata_size;
+  gboolean cached_metadata_size_valid;
 };
 
 struct _UDisksLinuxEncryptedClass
@@ -75,23 +81,89 @@ struct _UDisksLinuxEncryptedClass
   UDisksEncryptedSkeletonClass parent_class;
 };
 
+enum
+{
+  PROP_0,
+  PROP_METADATA_SIZE,
+};
+
 static void encrypted_iface_init (UDisksEncryptedIface *iface);
+static guint64 get_metadata_size (UDisksLinuxEncrypted *encrypted);
 
 G_DEFINE_TYPE_WITH_CODE (UDisksLinuxEncrypted, udisks_linux_encrypted, UDISKS_TYPE_ENCRYPTED_SKELETON,
                          G_IMPLEMENT_INTERFACE (UDISKS_TYPE_ENCRYPTED, encrypted_iface_init));
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static void
+udisks_linux_encrypted_finalize (GObject *object)
+{
+  UDisksLinuxEncrypted *encrypted = UDISKS_LINUX_ENCRYPTED (object);
+
+  g_mutex_clear (&encrypted->lock);
+  g_free (encrypted->cached_device_file);
+
+  if (G_OBJECT_CLASS (udisks_linux_encrypted_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (udisks_linux_encrypted_parent_class)->finalize (object);
+}
+
 static void
 udisks_linux_encrypted_init (UDisksLinuxEncrypted *encrypted)
 {
+  g_mutex_init (&encrypted->lock);
   g_dbus_interface_skeleton_set_flags (G_DBUS_INTERFACE_SKELETON (encrypted),
                                        G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD);
 }
 
+static void
+udisks_linux_encrypted_get_property (GObject    *object,
+                                     guint       prop_id,
+                                     GValue     *value,
+                                     GParamSpec *pspec)
+{
+  UDisksLinuxEncrypted *encrypted = UDISKS_LINUX_ENCRYPTED (object);
+
+  switch (prop_id)
+    {
+    case PROP_METADATA_SIZE:
+      g_value_set_uint64 (value, get_metadata_size (encrypted));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_linux_encrypted_set_property (GObject      *object,
+                                     guint         prop_id,
+                                     const GValue *value,
+                                     GParamSpec   *pspec)
+{
+  switch (prop_id)
+    {
+    case PROP_METADATA_SIZE:
+      g_warning ("udisks_linux_encrypted_set_property() should never be called, value = %" G_GUINT64_FORMAT, g_value_get_uint64 (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
 static void
 udisks_linux_encrypted_class_init (UDisksLinuxEncryptedClass *klass)
 {
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize     = udisks_linux_encrypted_finalize;
+  gobject_class->get_property = udisks_linux_encrypted_get_property;
+  gobject_class->set_property = udisks_linux_encrypted_set_property;
+
+  g_object_class_override_property (gobject_class, PROP_METADATA_SIZE, "metadata-size");
 }
 
 /**
@@ -157,31 +229,57 @@ update_child_configuration (UDisksLinuxEncrypted   *encrypted,
                                             udisks_block_get_id_uuid (block)));
 }
 
-static void
-update_metadata_size (UDisksLinuxEncrypted   *encrypted,
-                      UDisksLinuxBlockObject *object)
+/* WARNING: called with GDBusObjectManager lock held, avoid any object lookup */
+static guint64
+get_metadata_size (UDisksLinuxEncrypted *encrypted)
 {
-  UDisksLinuxDevice *device;
   guint64 metadata_size;
   GError *error = NULL;
 
-  device = udisks_linux_block_object_get_device (object);
+  g_mutex_lock (&encrypted->lock);
 
-  metadata_size = bd_crypto_luks_get_metadata_size (g_udev_device_get_device_file (device->udev_device),
-                                                    &error);
+  /* reading the LUKS header is deferred until the property is read, the
+   * result is kept until the next uevent
+   */
+  if (encrypted->cached_device_file == NULL || encrypted->cached_metadata_size_valid)
+    goto out;
 
+  encrypted->cached_metadata_size = bd_crypto_luks_get_metadata_size (encrypted->cached_device_file, &error);
   if (error != NULL)
     {
       udisks_warning ("Error getting '%s' metadata_size: %s (%s, %d)",
-                      g_udev_device_get_device_file (device->udev_device),
+                      encrypted->cached_device_file,
                       error->message,
                       g_quark_to_string (error->domain),
                       error->code);
       g_clear_error (&error);
     }
+  encrypted->cached_metadata_size_valid = TRUE;
+
+ out:
+  metadata_size = encrypted->cached_device_file != NULL ? encrypted->cached_metadata_size : 0;
+  g_mutex_unlock (&encrypted->lock);
+
+  return metadata_size;
+}
+
+static void
+update_metadata_size (UDisksLinuxEncrypted   *encrypted,
+                      UDisksLinuxBlockObject *object)
+{
+  UDisksLinuxDevice *device;
+
+  device = udisks_linux_block_object_get_device (object);
+
+  g_mutex_lock (&encrypted->lock);
+  g_free (encrypted->cached_device_file);
+  encrypted->cached_device_file = NULL;
+  if (udisks_linux_block_is_luks (udisks_object_peek_block (UDISKS_OBJECT (object))))
+    encrypted->cached_device_file = g_strdup (g_udev_device_get_device_file (device->udev_device));
+  encrypted->cached_metadata_size_valid = FALSE;
+  g_mutex_unlock (&encrypted->lock);
 
   g_object_unref (device);
-  udisks_encrypted_set_metadata_size (UDISKS_ENCRYPTED (encrypted), metadata_size);
 }
 
 static void
@@ -233,8 +331,7 @@ udisks_linux_encrypted_update (UDisksLinuxEncrypted   *encrypted,
         udisks_block_set_id_type (block, "crypto_TCRYPT");
     }
 
-  if (udisks_linux_block_is_luks (block))
-    update_metadata_size (encrypted, object);
+  update_metadata_size (encrypted, object);
 
   udisks_linux_block_encrypted_unlock (block);
 
@@ -363,6 +460,9 @@ handle_unlock (UDisksEncrypted        *encrypted,
   gboolean handle_as_tcrypt;
   void *open_func;
   const gchar *uuid = NULL;
+  UDisksEncryptionFlags flags = UDISKS_ENCRYPTION_FLAGS_NONE;
+  UDisksEncryptionFlags requested_flags = UDISKS_ENCRYPTION_FLAGS_NONE;
+  UDisksEncryptionFlags disabled_flags = UDISKS_ENCRYPTION_FLAGS_NONE;
 
   object = udisks_daemon_util_dup_object (encrypted, &error);
   if (object == NULL)
@@ -537,6 +637,34 @@ handle_unlock (UDisksEncrypted        *encrypted,
       name = g_strdup_printf ("tcrypt-%" G_GUINT64_FORMAT, udisks_block_get_device_number (block));
   }
 
+  /* unlock as read-only if specified in @options or if the device itself is read-only */
+  g_variant_lookup (options, "read-only", "b", &read_only);
+  if (udisks_block_get_read_only (block))
+    read_only = TRUE;
+
+  /* dm-crypt flags are only passed when activating LUKS devices, the
+   * configured defaults and crypttab options are silently skipped for
+   * other devices. The flags stored in a LUKS2 header are used as well,
+   * unless disabled in @options, the header itself is not modified. */
+  if (is_luks)
+    {
+      flags = udisks_config_manager_get_encryption_flags (udisks_daemon_get_config_manager (daemon));
+      if (is_in_crypttab)
+        flags |= crypto_flags_from_crypttab (crypttab_options);
+    }
+  flags = crypto_flags_from_options (options, NULL, flags, &requested_flags);
+  disabled_flags = ~crypto_flags_from_options (options, NULL, UDISKS_ENCRYPTION_FLAGS_ALL, NULL) &
+                   UDISKS_ENCRYPTION_FLAGS_ALL;
+  if ((requested_flags != UDISKS_ENCRYPTION_FLAGS_NONE ||
+       disabled_flags != UDISKS_ENCRYPTION_FLAGS_NONE) && !is_luks)
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_NOT_SUPPORTED,
+                                             "dm-crypt flags can only be set when unlocking LUKS devices");
+      goto out;
+    }
+
   /* save old encryption type to be able to restore it */
   old_hint_encryption_type = udisks_encrypted_dup_hint_encryption_type (encrypted);
 
@@ -552,11 +680,7 @@ handle_unlock (UDisksEncrypted        *encrypted,
 
   device = udisks_block_dup_device (block);
 
-  /* unlock as read-only if specified in @options or if the device itself is read-only */
-  g_variant_lookup (options, "read-only", "b", &read_only);
-  if (udisks_block_get_read_only (block))
-    read_only = TRUE;
-
+  memset (&data, 0, sizeof (data));
   data.device = device;
   data.map_name = name;
   data.passphrase = effective_passphrase;
@@ -565,6 +689,8 @@ handle_unlock (UDisksEncrypted        *encrypted,
   data.hidden = is_hidden;
   data.system = is_system;
   data.read_only = read_only;
+  data.flags = flags;
+  data.disabled_flags = disabled_flags;
 
   if (is_luks)
     open_func = luks_open_job_func;
@@ -904,7 +1030,7 @@ handle_change_passphrase (UDisksEncrypted        *encrypted,
   const gchar *action_id;
   GError *error = NULL;
   gchar *device = NULL;
-  CryptoJobData data = { NULL, NULL, NULL, NULL, NULL, 0, 0, FALSE, FALSE, FALSE, NULL };
+  CryptoJobData data = { NULL, NULL, NULL, NULL, NULL, 0, 0, FALSE, FALSE, FALSE, NULL, 0, UDISKS_ENCRYPTION_FLAGS_NONE, UDISKS_ENCRYPTION_FLAGS_NONE, NULL, 0 };
 
   object = udisks_daemon_util_dup_object (encrypted, &error);
   if (object == NULL)
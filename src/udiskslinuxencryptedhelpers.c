@@ -20,19 +20,269 @@
  *
  */
 
+#include <errno.h>
+
 #include <glib.h>
 #include <blockdev/crypto.h>
+#include <libcryptsetup.h>
 
+#include "udiskslogging.h"
 #include "udisksthreadedjob.h"
 #include "udiskslinuxencryptedhelpers.h"
 
+static const struct
+{
+  UDisksEncryptionFlags flag;
+  const gchar *option;
+  const gchar *crypttab_option;
+} crypto_flags[] =
+{
+  { UDISKS_ENCRYPTION_FLAGS_ALLOW_DISCARDS,     "allow-discards",     "discard" },
+  { UDISKS_ENCRYPTION_FLAGS_NO_READ_WORKQUEUE,  "no-read-workqueue",  "no-read-workqueue" },
+  { UDISKS_ENCRYPTION_FLAGS_NO_WRITE_WORKQUEUE, "no-write-workqueue", "no-write-workqueue" },
+};
+
+/* Returns @defaults updated with the flags enabled or disabled by the
+ * boolean @options named after the flags, with an optional @prefix such
+ * as "encrypt.". The flags explicitly enabled are set in @out_requested. */
+UDisksEncryptionFlags
+crypto_flags_from_options (GVariant              *options,
+                           const gchar           *prefix,
+                           UDisksEncryptionFlags  defaults,
+                           UDisksEncryptionFlags *out_requested)
+{
+  UDisksEncryptionFlags flags = defaults;
+  UDisksEncryptionFlags requested = UDISKS_ENCRYPTION_FLAGS_NONE;
+  gboolean value;
+  gchar *key;
+  guint n;
+
+  for (n = 0; n < G_N_ELEMENTS (crypto_flags); n++)
+    {
+      key = g_strconcat (prefix ? prefix : "", crypto_flags[n].option, NULL);
+      if (g_variant_lookup (options, key, "b", &value))
+        {
+          if (value)
+            {
+              flags |= crypto_flags[n].flag;
+              requested |= crypto_flags[n].flag;
+            }
+          else
+            flags &= ~crypto_flags[n].flag;
+        }
+      g_free (key);
+    }
+
+  if (out_requested != NULL)
+    *out_requested = requested;
+  return flags;
+}
+
+/* Returns the flags enabled by the options field of a crypttab entry */
+UDisksEncryptionFlags
+crypto_flags_from_crypttab (const gchar *crypttab_options)
+{
+  UDisksEncryptionFlags flags = UDISKS_ENCRYPTION_FLAGS_NONE;
+  gchar **tokens;
+  guint n, m;
+
+  if (crypttab_options == NULL)
+    return flags;
+
+  tokens = g_strsplit (crypttab_options, ",", -1);
+  for (n = 0; tokens[n] != NULL; n++)
+    for (m = 0; m < G_N_ELEMENTS (crypto_flags); m++)
+      if (g_strcmp0 (g_strstrip (tokens[n]), crypto_flags[m].crypttab_option) == 0)
+        flags |= crypto_flags[m].flag;
+  g_strfreev (tokens);
+
+  return flags;
+}
+
+/* Returns a newly allocated copy of the options field of a crypttab entry
+ * with the options matching @flags appended unless already present */
+gchar *
+crypto_flags_add_to_crypttab (const gchar           *crypttab_options,
+                              UDisksEncryptionFlags  flags)
+{
+  GString *str;
+  guint n;
+
+  /* "none" is a placeholder for an empty options field */
+  if (g_strcmp0 (crypttab_options, "none") == 0)
+    crypttab_options = NULL;
+
+  str = g_string_new (crypttab_options);
+  flags &= ~crypto_flags_from_crypttab (crypttab_options);
+  for (n = 0; n < G_N_ELEMENTS (crypto_flags); n++)
+    {
+      if (!(flags & crypto_flags[n].flag))
+        continue;
+      if (str->len > 0)
+        g_string_append_c (str, ',');
+      g_string_append (str, crypto_flags[n].crypttab_option);
+    }
+
+  return g_string_free (str, FALSE);
+}
+
+/* Converts @flags to the CRYPT_ACTIVATE_* flags of libcryptsetup */
+static gboolean
+crypto_flags_to_activate_flags (UDisksEncryptionFlags   flags,
+                                uint32_t               *out_activate_flags,
+                                GError                **error)
+{
+  uint32_t activate_flags = 0;
+
+  if (flags & UDISKS_ENCRYPTION_FLAGS_ALLOW_DISCARDS)
+    activate_flags |= CRYPT_ACTIVATE_ALLOW_DISCARDS;
+#if defined(CRYPT_ACTIVATE_NO_READ_WORKQUEUE) && defined(CRYPT_ACTIVATE_NO_WRITE_WORKQUEUE)
+  if (flags & UDISKS_ENCRYPTION_FLAGS_NO_READ_WORKQUEUE)
+    activate_flags |= CRYPT_ACTIVATE_NO_READ_WORKQUEUE;
+  if (flags & UDISKS_ENCRYPTION_FLAGS_NO_WRITE_WORKQUEUE)
+    activate_flags |= CRYPT_ACTIVATE_NO_WRITE_WORKQUEUE;
+#else
+  if (flags & (UDISKS_ENCRYPTION_FLAGS_NO_READ_WORKQUEUE | UDISKS_ENCRYPTION_FLAGS_NO_WRITE_WORKQUEUE))
+    {
+      g_set_error_literal (error, UDISKS_ERROR, UDISKS_ERROR_NOT_SUPPORTED,
+                           "The dm-crypt workqueue flags are not supported by this version of cryptsetup");
+      return FALSE;
+    }
+#endif
+
+  *out_activate_flags = activate_flags;
+  return TRUE;
+}
+
+static struct crypt_device *
+luks_load (const gchar  *device,
+           const gchar  *type,
+           GError      **error)
+{
+  struct crypt_device *cd = NULL;
+  int r;
+
+  r = crypt_init (&cd, device);
+  if (r < 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error opening device %s: %s", device, g_strerror (-r));
+      return NULL;
+    }
+
+  r = crypt_load (cd, type, NULL);
+  if (r < 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error loading the LUKS header of %s: %s", device, g_strerror (-r));
+      crypt_free (cd);
+      return NULL;
+    }
+
+  return cd;
+}
+
+/* Adds @flags to the flags stored in the LUKS2 header, the flags already
+ * stored there are kept */
+static gboolean
+luks_add_persistent_flags (const gchar            *device,
+                           UDisksEncryptionFlags   flags,
+                           GError                **error)
+{
+  struct crypt_device *cd;
+  uint32_t activate_flags = 0;
+  uint32_t persistent_flags = 0;
+  gboolean ret = FALSE;
+  int r;
+
+  if (flags == UDISKS_ENCRYPTION_FLAGS_NONE)
+    return TRUE;
+
+  if (!crypto_flags_to_activate_flags (flags, &activate_flags, error))
+    return FALSE;
+
+  cd = luks_load (device, CRYPT_LUKS2, error);
+  if (cd == NULL)
+    return FALSE;
+
+  r = crypt_persistent_flags_get (cd, CRYPT_FLAGS_ACTIVATION, &persistent_flags);
+  if (r < 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error reading the flags stored on %s: %s", device, g_strerror (-r));
+      goto out;
+    }
+
+  if ((persistent_flags | activate_flags) != persistent_flags)
+    {
+      r = crypt_persistent_flags_set (cd, CRYPT_FLAGS_ACTIVATION, persistent_flags | activate_flags);
+      if (r < 0)
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error storing the flags on %s: %s", device, g_strerror (-r));
+          goto out;
+        }
+    }
+
+  ret = TRUE;
+
+ out:
+  crypt_free (cd);
+  return ret;
+}
+
+/* Unlocks a LUKS device with the flags stored in its header except for
+ * data->disabled_flags, plus data->flags. The header itself is not modified. */
+static gboolean
+luks_open_with_flags (CryptoJobData  *data,
+                      GError        **error)
+{
+  struct crypt_device *cd;
+  uint32_t enabled = 0;
+  uint32_t disabled = 0;
+  uint32_t persistent_flags = 0;
+  uint32_t activate_flags;
+  int r;
+
+  if (!crypto_flags_to_activate_flags (data->flags, &enabled, error) ||
+      !crypto_flags_to_activate_flags (data->disabled_flags, &disabled, error))
+    return FALSE;
+
+  cd = luks_load (data->device, CRYPT_LUKS, error);
+  if (cd == NULL)
+    return FALSE;
+
+  /* LUKS1 headers have no flags */
+  if (crypt_persistent_flags_get (cd, CRYPT_FLAGS_ACTIVATION, &persistent_flags) < 0)
+    persistent_flags = 0;
+
+  activate_flags = CRYPT_ACTIVATE_IGNORE_PERSISTENT | (persistent_flags & ~disabled) | enabled;
+  if (data->read_only)
+    activate_flags |= CRYPT_ACTIVATE_READONLY;
+
+  r = crypt_activate_by_passphrase (cd, data->map_name, CRYPT_ANY_SLOT,
+                                    data->passphrase->str, data->passphrase->len,
+                                    activate_flags);
+  crypt_free (cd);
+  if (r < 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error unlocking %s: %s", data->device, g_strerror (-r));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 gboolean luks_format_job_func (UDisksThreadedJob  *job,
                       GCancellable       *cancellable,
                       gpointer            user_data,
                       GError            **error)
 {
   BDCryptoLUKSVersion luks_version;
+  BDCryptoLUKSExtra *extra = NULL;
   CryptoJobData *data = (CryptoJobData*) user_data;
+  gboolean ret;
 
   if (g_strcmp0 (data->type, "luks1") == 0)
     luks_version = BD_CRYPTO_LUKS_VERSION_LUKS1;
@@ -48,10 +298,28 @@ gboolean luks_format_job_func (UDisksThreadedJob  *job,
       return FALSE;
     }
 
+  if (luks_version != BD_CRYPTO_LUKS_VERSION_LUKS2 &&
+      (data->sector_size != 0 || data->flags != UDISKS_ENCRYPTION_FLAGS_NONE))
+    {
+      g_set_error (error,
+                   UDISKS_ERROR,
+                   UDISKS_ERROR_NOT_SUPPORTED,
+                   "Sector size and dm-crypt flags are only supported with LUKS2");
+      return FALSE;
+    }
+
+  /* data_alignment, data_device, integrity, sector_size, label, subsystem, pbkdf */
+  if (data->sector_size != 0)
+    extra = bd_crypto_luks_extra_new (0, NULL, NULL, data->sector_size, NULL, NULL, NULL);
+
   /* device, cipher, key_size, passphrase, key_file, min_entropy, luks_version, extra, error */
-  return bd_crypto_luks_format_luks2_blob (data->device, NULL, 0,
-                                           (const guint8*) data->passphrase->str, data->passphrase->len, 0,
-                                           luks_version, NULL, error);
+  ret = bd_crypto_luks_format_luks2_blob (data->device, data->cipher, data->key_size,
+                                          (const guint8*) data->passphrase->str, data->passphrase->len, 0,
+                                          luks_version, extra, error);
+  if (extra != NULL)
+    bd_crypto_luks_extra_free (extra);
+
+  return ret && luks_add_persistent_flags (data->device, data->flags, error);
 }
 
 gboolean luks_open_job_func (UDisksThreadedJob  *job,
@@ -61,6 +329,11 @@ gboolean luks_open_job_func (UDisksThreadedJob  *job,
 {
   CryptoJobData *data = (CryptoJobData*) user_data;
 
+  /* libblockdev has no way to pass activation flags */
+  if (data->flags != UDISKS_ENCRYPTION_FLAGS_NONE ||
+      data->disabled_flags != UDISKS_ENCRYPTION_FLAGS_NONE)
+    return luks_open_with_flags (data, error);
+
   /* device, name, passphrase, key_file, read_only, error */
   return bd_crypto_luks_open_blob (data->device, data->map_name,
                                    (const guint8*) data->passphrase->str, data->passphrase->len, data->read_only,
@@ -132,3 +405,187 @@ gboolean bitlk_close_job_func (UDisksThreadedJob  *job,
   CryptoJobData *data = (CryptoJobData*) user_data;
   return bd_crypto_bitlk_close (data->map_name, error);
 }
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* the same set of ciphers 'cryptsetup benchmark' measures */
+static const struct
+{
+  const gchar *cipher;
+  const gchar *mode;
+  const gchar *iv_mode;
+  gsize key_size;
+} benchmark_ciphers[] =
+{
+  { "aes",     "cbc", "essiv:sha256", 16 },
+  { "serpent", "cbc", "essiv:sha256", 16 },
+  { "twofish", "cbc", "essiv:sha256", 16 },
+  { "aes",     "cbc", "essiv:sha256", 32 },
+  { "serpent", "cbc", "essiv:sha256", 32 },
+  { "twofish", "cbc", "essiv:sha256", 32 },
+  { "aes",     "xts", "plain64",      32 },
+  { "serpent", "xts", "plain64",      32 },
+  { "twofish", "xts", "plain64",      32 },
+  { "aes",     "xts", "plain64",      64 },
+  { "serpent", "xts", "plain64",      64 },
+  { "twofish", "xts", "plain64",      64 },
+};
+
+static const struct
+{
+  const gchar *type;
+  const gchar *hash;
+} benchmark_pbkdfs[] =
+{
+  { CRYPT_KDF_PBKDF2,   "sha256" },
+  { CRYPT_KDF_PBKDF2,   "sha512" },
+  { CRYPT_KDF_ARGON2I,  "sha256" },
+  { CRYPT_KDF_ARGON2ID, "sha256" },
+};
+
+#define BENCHMARK_BUFFER_SIZE (1024 * 1024)
+#define BENCHMARK_IV_SIZE 16
+/* defaults cryptsetup uses for new LUKS2 devices */
+#define BENCHMARK_VOLUME_KEY_SIZE 64
+#define BENCHMARK_ARGON2_MAX_MEMORY_KB (1024 * 1024)
+#define BENCHMARK_ARGON2_MAX_THREADS 4
+
+static int
+benchmark_pbkdf_progress (uint32_t  time_ms,
+                          void     *user_data)
+{
+  /* a non-zero return value interrupts the benchmark */
+  return g_cancellable_is_cancelled (G_CANCELLABLE (user_data)) ? 1 : 0;
+}
+
+static gboolean
+benchmark_check_cancelled (GCancellable  *cancellable,
+                           GError       **error)
+{
+  if (cancellable != NULL && g_cancellable_is_cancelled (cancellable))
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_CANCELLED, "Job was canceled");
+      return TRUE;
+    }
+  return FALSE;
+}
+
+/* Measures the in-memory throughput of the ciphers usable for LUKS devices
+ * and the parameters of the key derivation functions needed for an unlock
+ * time of @pbkdf_time milliseconds, like 'cryptsetup benchmark' does.
+ *
+ * The fastest XTS cipher with a 512 bits key, the default key size of
+ * cryptsetup, is stored as @best_cipher. Smaller keys are not considered
+ * so the recommendation never trades security for speed.
+ */
+gboolean
+encryption_benchmark_job_func (UDisksThreadedJob  *job,
+                               GCancellable       *cancellable,
+                               gpointer            user_data,
+                               GError            **error)
+{
+  EncryptionBenchmarkJobData *data = user_data;
+  const gchar password[] = "foobarfo";
+  const gchar salt[] = "0123456789abcdef0123456789abcdef";
+  guint n_steps = G_N_ELEMENTS (benchmark_ciphers) + G_N_ELEMENTS (benchmark_pbkdfs);
+  guint step = 0;
+  gdouble best_speed = 0.0;
+  guint n;
+  int r;
+
+  udisks_job_set_progress_valid (UDISKS_JOB (job), TRUE);
+  udisks_job_set_progress (UDISKS_JOB (job), 0.0);
+
+  for (n = 0; n < G_N_ELEMENTS (benchmark_ciphers); n++, step++)
+    {
+      gdouble encryption_mbs = 0.0;
+      gdouble decryption_mbs = 0.0;
+      gchar *spec;
+
+      if (benchmark_check_cancelled (cancellable, error))
+        return FALSE;
+
+      r = crypt_benchmark (NULL, benchmark_ciphers[n].cipher, benchmark_ciphers[n].mode,
+                           benchmark_ciphers[n].key_size, BENCHMARK_IV_SIZE, BENCHMARK_BUFFER_SIZE,
+                           &encryption_mbs, &decryption_mbs);
+      if (r == -ENOENT || r == -ENOTSUP)
+        {
+          udisks_debug ("Cipher %s-%s not available, skipping benchmark",
+                        benchmark_ciphers[n].cipher, benchmark_ciphers[n].mode);
+          continue;
+        }
+      else if (r < 0)
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error benchmarking cipher %s-%s: %s",
+                       benchmark_ciphers[n].cipher, benchmark_ciphers[n].mode, g_strerror (-r));
+          return FALSE;
+        }
+
+      spec = g_strdup_printf ("%s-%s-%s", benchmark_ciphers[n].cipher,
+                              benchmark_ciphers[n].mode, benchmark_ciphers[n].iv_mode);
+      g_variant_builder_add (&data->ciphers, "(sudd)", spec,
+                             (guint) benchmark_ciphers[n].key_size * 8,
+                             encryption_mbs, decryption_mbs);
+
+      if (g_strcmp0 (benchmark_ciphers[n].mode, "xts") == 0 &&
+          benchmark_ciphers[n].key_size == BENCHMARK_VOLUME_KEY_SIZE &&
+          MIN (encryption_mbs, decryption_mbs) > best_speed)
+        {
+          best_speed = MIN (encryption_mbs, decryption_mbs);
+          g_free (data->best_cipher);
+          data->best_cipher = g_steal_pointer (&spec);
+          data->best_key_size = benchmark_ciphers[n].key_size * 8;
+        }
+      g_free (spec);
+
+      udisks_job_set_progress (UDISKS_JOB (job), (gdouble) (step + 1) / n_steps);
+    }
+
+  for (n = 0; n < G_N_ELEMENTS (benchmark_pbkdfs); n++, step++)
+    {
+      struct crypt_pbkdf_type pbkdf = { 0 };
+      gchar *name;
+
+      if (benchmark_check_cancelled (cancellable, error))
+        return FALSE;
+
+      pbkdf.type = benchmark_pbkdfs[n].type;
+      pbkdf.hash = benchmark_pbkdfs[n].hash;
+      pbkdf.time_ms = data->pbkdf_time;
+      if (g_strcmp0 (pbkdf.type, CRYPT_KDF_PBKDF2) != 0)
+        {
+          pbkdf.max_memory_kb = BENCHMARK_ARGON2_MAX_MEMORY_KB;
+          pbkdf.parallel_threads = MIN (g_get_num_processors (), BENCHMARK_ARGON2_MAX_THREADS);
+        }
+
+      r = crypt_benchmark_pbkdf (NULL, &pbkdf, password, sizeof (password) - 1,
+                                 salt, sizeof (salt) - 1, BENCHMARK_VOLUME_KEY_SIZE,
+                                 benchmark_pbkdf_progress, cancellable);
+      if (benchmark_check_cancelled (cancellable, error))
+        return FALSE;
+      if (r == -ENOENT || r == -ENOTSUP || r == -EINVAL)
+        {
+          udisks_debug ("PBKDF %s not available, skipping benchmark", pbkdf.type);
+          continue;
+        }
+      else if (r < 0)
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error benchmarking PBKDF %s: %s", pbkdf.type, g_strerror (-r));
+          return FALSE;
+        }
+
+      if (g_strcmp0 (pbkdf.type, CRYPT_KDF_PBKDF2) == 0)
+        name = g_strdup_printf ("%s-%s", pbkdf.type, pbkdf.hash);
+      else
+        name = g_strdup (pbkdf.type);
+      g_variant_builder_add (&data->pbkdfs, "(suuu)", name,
+                             pbkdf.iterations, pbkdf.max_memory_kb, pbkdf.parallel_threads);
+      g_free (name);
+
+      udisks_job_set_progress (UDISKS_JOB (job), (gdouble) (step + 1) / n_steps);
+    }
+
+  return TRUE;
+}
@@ -27,6 +27,7 @@
 #include <blockdev/crypto.h>
 
 #include "udisksthreadedjob.h"
+#include "udisksconfigmanager.h"
 
 G_BEGIN_DECLS
 
@@ -42,8 +43,31 @@ typedef struct {
   gboolean system;
   gboolean read_only;
   const gchar *type;
+  guint sector_size;
+  UDisksEncryptionFlags flags;
+  UDisksEncryptionFlags disabled_flags;
+  const gchar *cipher;
+  guint key_size;
 } CryptoJobData;
 
+typedef struct {
+  guint pbkdf_time;
+  GVariantBuilder ciphers;
+  GVariantBuilder pbkdfs;
+  gchar *best_cipher;
+  guint best_key_size;
+} EncryptionBenchmarkJobData;
+
+UDisksEncryptionFlags crypto_flags_from_options (GVariant              *options,
+                                                 const gchar           *prefix,
+                                                 UDisksEncryptionFlags  defaults,
+                                                 UDisksEncryptionFlags *out_requested);
+
+UDisksEncryptionFlags crypto_flags_from_crypttab (const gchar *crypttab_options);
+
+gchar *crypto_flags_add_to_crypttab (const gchar           *crypttab_options,
+                                     UDisksEncryptionFlags  flags);
+
 gboolean luks_format_job_func (UDisksThreadedJob  *job,
                                GCancellable       *cancellable,
                                gpointer            user_data,
@@ -74,6 +98,11 @@ gboolean tcrypt_close_job_func (UDisksThreadedJob  *job,
                                 gpointer            user_data,
                                 GError            **error);
 
+gboolean encryption_benchmark_job_func (UDisksThreadedJob  *job,
+                                        GCancellable       *cancellable,
+                                        gpointer            user_data,
+                                        GError            **error);
+
 gboolean bitlk_open_job_func (UDisksThreadedJob  *job,
                               GCancellable       *cancellable,
                               gpointer            user_data,
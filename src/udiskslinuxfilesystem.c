@@ -2308,7 +2308,7 @@ handle_take_ownership (UDisksFilesystem      *filesystem,
   const gchar *action_id = NULL;
   const gchar *message = NULL;
   const FSInfo *fs_info = NULL;
-  UDisksBaseJob *job = NULL;
+  TakeOwnershipJobData job_data;
   GError *error = NULL;
   gboolean recursive = FALSE;
   uid_t caller_uid;
@@ -2391,23 +2391,22 @@ handle_take_ownership (UDisksFilesystem      *filesystem,
                                                      invocation))
     goto out;
 
-  job = udisks_daemon_launch_simple_job (daemon,
-                                         UDISKS_OBJECT (object),
-                                         "filesystem-modify",
-                                         caller_uid,
-                                         NULL);
-  if (job == NULL)
-    {
-      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
-                                             "Failed to create a job object");
-      goto out;
-    }
-
-  if (! take_filesystem_ownership (udisks_block_get_device (block),
-                                   probed_fs_type,
-                                   caller_uid, caller_gid,
-                                   recursive,
-                                   &error))
+  job_data.device = udisks_block_get_device (block);
+  job_data.fstype = probed_fs_type;
+  job_data.caller_uid = caller_uid;
+  job_data.caller_gid = caller_gid;
+  job_data.recursive = recursive;
+
+  /* the recursive walk may take long, run it as a cancellable job reporting progress */
+  if (! udisks_daemon_launch_threaded_job_sync (daemon,
+                                                UDISKS_OBJECT (object),
+                                                "filesystem-modify",
+                                                caller_uid,
+                                                take_ownership_job_func,
+                                                &job_data,
+                                                NULL, /* user_data_free_func */
+                                                NULL, /* cancellable */
+                                                &error))
     {
       g_dbus_method_invocation_return_error (invocation,
                                              UDISKS_ERROR,
@@ -2415,13 +2414,10 @@ handle_take_ownership (UDisksFilesystem      *filesystem,
                                              "Error taking ownership of filesystem on %s: %s",
                                              udisks_block_get_device (block),
                                              error->message);
-      udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), FALSE, error->message);
       goto out;
     }
 
-
   udisks_filesystem_complete_take_ownership (filesystem, invocation);
-  udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), TRUE, NULL);
 
   out:
    if (object != NULL)
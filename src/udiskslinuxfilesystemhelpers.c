@@ -24,27 +24,373 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <blockdev/fs.h>
 
+#include "udisksthreadedjob.h"
 #include "udiskslinuxfilesystemhelpers.h"
 #include "udiskslogging.h"
 
+/* Maximal number of threads walking the tree */
+#define CHOWN_MAX_THREADS 8
+
+/* Directories are only queued for other threads up to this count, deeper
+ * subtrees are walked by the thread that found them. Together with closing
+ * the parent directory while such a subtree is walked, this bounds the
+ * number of open directory fds. */
+#define CHOWN_MAX_QUEUED_DIRS 256
+
+#define CHOWN_GETDENTS_BUFSIZE (64 * 1024)
+
+/* How often the job progress is updated, in microseconds */
+#define CHOWN_PROGRESS_INTERVAL (500 * G_TIME_SPAN_MILLISECOND)
+
+/* as returned by getdents64(), not exposed by older glibc */
+struct linux_dirent64
+{
+  guint64        d_ino;
+  gint64         d_off;
+  unsigned short d_reclen;
+  unsigned char  d_type;
+  char           d_name[];
+};
+
+typedef struct
+{
+  int fd;
+  gchar *path;
+} ChownDir;
+
+typedef struct
+{
+  uid_t uid;
+  gid_t gid;
+  GCancellable *cancellable;
+
+  GMutex lock;
+  GCond cond;         /* signalled when a directory is queued */
+  GCond done_cond;    /* signalled when the walk finished or failed */
+  GQueue dirs;        /* of ChownDir, waiting to be walked */
+  guint pending;      /* directories queued or being walked */
+  GError *error;      /* the first error, stops the walk */
+  guint64 files;
+  guint64 bytes;
+} ChownWalker;
+
+static void
+chown_dir_free (ChownDir *dir)
+{
+  if (dir->fd >= 0)
+    close (dir->fd);
+  g_free (dir->path);
+  g_free (dir);
+}
+
+/* takes ownership of @error */
+static void
+chown_walker_fail (ChownWalker *walker,
+                   GError      *error)
+{
+  g_mutex_lock (&walker->lock);
+  if (walker->error == NULL)
+    walker->error = error;
+  else
+    g_error_free (error);
+  g_cond_broadcast (&walker->cond);
+  g_cond_signal (&walker->done_cond);
+  g_mutex_unlock (&walker->lock);
+}
 
 static gboolean
-recursive_chown (const gchar *path,
-                 uid_t        caller_uid,
-                 gid_t        caller_gid,
-                 gboolean     recursive,
-                 GError     **error)
+chown_walker_should_stop (ChownWalker *walker)
 {
+  GError *error = NULL;
+  gboolean ret;
+
+  if (g_cancellable_set_error_if_cancelled (walker->cancellable, &error))
+    {
+      chown_walker_fail (walker, error);
+      return TRUE;
+    }
+
+  g_mutex_lock (&walker->lock);
+  ret = walker->error != NULL;
+  g_mutex_unlock (&walker->lock);
+  return ret;
+}
+
+/* hands @fd over to another thread if the queue is not full yet */
+static gboolean
+chown_walker_try_queue (ChownWalker *walker,
+                        int          fd,
+                        const gchar *path)
+{
+  ChownDir *dir;
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&walker->lock);
+  if (g_queue_get_length (&walker->dirs) < CHOWN_MAX_QUEUED_DIRS)
+    {
+      dir = g_new0 (ChownDir, 1);
+      dir->fd = fd;
+      dir->path = g_strdup (path);
+      g_queue_push_tail (&walker->dirs, dir);
+      walker->pending++;
+      g_cond_signal (&walker->cond);
+      ret = TRUE;
+    }
+  g_mutex_unlock (&walker->lock);
+
+  return ret;
+}
+
+/* reopens the directory @path closed before walking a subtree, failing if
+ * it is not the same directory as @dirstat anymore */
+static int
+chown_walker_reopen_dir (ChownWalker       *walker,
+                         const gchar       *path,
+                         const struct stat *dirstat)
+{
+  struct stat statbuf;
   int dirfd;
-  DIR *dir;
-  struct dirent *dirent;
-  GSList *list, *l;
+
+  dirfd = open (path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (dirfd < 0)
+    {
+      chown_walker_fail (walker, g_error_new (UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                              "Error reopening directory %s: %m", path));
+      return -1;
+    }
+  if (fstat (dirfd, &statbuf) != 0 ||
+      statbuf.st_dev != dirstat->st_dev || statbuf.st_ino != dirstat->st_ino)
+    {
+      chown_walker_fail (walker, g_error_new (UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                              "Directory %s was replaced during the walk", path));
+      close (dirfd);
+      return -1;
+    }
+
+  return dirfd;
+}
+
+/*
+ * Changes ownership of all entries in the directory @dirfd, relative to the
+ * fd so that nothing can be redirected by replacing a path component with a
+ * symlink. Subdirectories are queued for other threads or walked right away.
+ * Takes ownership of @dirfd.
+ */
+static gboolean
+chown_walker_walk_dir (ChownWalker *walker,
+                       int          dirfd,
+                       const gchar *path)
+{
+  GPtrArray *subdirs;
+  gchar *buf;
+  struct linux_dirent64 *dirent;
+  struct stat statbuf;
+  struct stat dirstat;
+  guint64 files = 0;
+  guint64 bytes = 0;
+  long nread;
+  long pos;
+  guint n;
+  gboolean ret = FALSE;
+
+  buf = g_malloc (CHOWN_GETDENTS_BUFSIZE);
+  subdirs = g_ptr_array_new_with_free_func (g_free);
+
+  /* read the directory in batches, collecting subdirectories to prevent fd exhaustion */
+  for (;;)
+    {
+      if (chown_walker_should_stop (walker))
+        goto out;
+
+      nread = syscall (SYS_getdents64, dirfd, buf, CHOWN_GETDENTS_BUFSIZE);
+      if (nread < 0)
+        {
+          chown_walker_fail (walker, g_error_new (UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                                  "Error reading directory %s: %m", path));
+          goto out;
+        }
+      if (nread == 0)
+        break;
+
+      for (pos = 0; pos < nread; pos += dirent->d_reclen)
+        {
+          dirent = (struct linux_dirent64 *) (buf + pos);
+          if (g_strcmp0 (dirent->d_name, ".") == 0 || g_strcmp0 (dirent->d_name, "..") == 0)
+            continue;
+
+          if (fstatat (dirfd, dirent->d_name, &statbuf, AT_SYMLINK_NOFOLLOW) != 0)
+            {
+              chown_walker_fail (walker, g_error_new (UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                                      "Error getting information about %s/%s: %m",
+                                                      path, dirent->d_name));
+              goto out;
+            }
+          if (fchownat (dirfd, dirent->d_name, walker->uid, walker->gid, AT_SYMLINK_NOFOLLOW) != 0)
+            {
+              chown_walker_fail (walker, g_error_new (UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                                      "Error changing ownership of %s/%s to uid=%u and gid=%u: %m",
+                                                      path, dirent->d_name, walker->uid, walker->gid));
+              goto out;
+            }
+
+          files++;
+          bytes += statbuf.st_size;
+          if (S_ISDIR (statbuf.st_mode))
+            g_ptr_array_add (subdirs, g_strdup (dirent->d_name));
+        }
+    }
+
+  g_clear_pointer (&buf, g_free);
+
+  g_mutex_lock (&walker->lock);
+  walker->files += files;
+  walker->bytes += bytes;
+  g_mutex_unlock (&walker->lock);
+
+  /* recurse into subdirectories */
+  for (n = 0; n < subdirs->len; n++)
+    {
+      const gchar *name = g_ptr_array_index (subdirs, n);
+      gchar *subpath;
+      int subfd;
+
+      subfd = openat (dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (subfd < 0)
+        {
+          chown_walker_fail (walker, g_error_new (UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                                  "Error opening directory %s/%s: %m", path, name));
+          goto out;
+        }
+
+      subpath = g_build_filename (path, name, NULL);
+      if (! chown_walker_try_queue (walker, subfd, subpath))
+        {
+          /* Close this directory while walking the subtree so that the
+           * fds held by a thread do not grow with the depth of the tree.
+           * It is reopened by path afterwards and checked to be the same. */
+          if (fstat (dirfd, &dirstat) != 0)
+            {
+              chown_walker_fail (walker, g_error_new (UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                                      "Error getting information about %s: %m", path));
+              close (subfd);
+              g_free (subpath);
+              goto out;
+            }
+          close (dirfd);
+          dirfd = -1;
+
+          if (! chown_walker_walk_dir (walker, subfd, subpath))
+            {
+              g_free (subpath);
+              goto out;
+            }
+          if (n + 1 < subdirs->len)
+            {
+              dirfd = chown_walker_reopen_dir (walker, path, &dirstat);
+              if (dirfd < 0)
+                {
+                  g_free (subpath);
+                  goto out;
+                }
+            }
+        }
+      g_free (subpath);
+    }
+
+  ret = TRUE;
+
+ out:
+  if (dirfd >= 0)
+    close (dirfd);
+  g_free (buf);
+  g_ptr_array_unref (subdirs);
+  return ret;
+}
+
+static gpointer
+chown_walker_thread_func (gpointer user_data)
+{
+  ChownWalker *walker = user_data;
+  ChownDir *dir;
+
+  g_mutex_lock (&walker->lock);
+  for (;;)
+    {
+      while (g_queue_is_empty (&walker->dirs) && walker->pending > 0 && walker->error == NULL)
+        g_cond_wait (&walker->cond, &walker->lock);
+      if (walker->error != NULL || g_queue_is_empty (&walker->dirs))
+        break;
+
+      dir = g_queue_pop_head (&walker->dirs);
+      g_mutex_unlock (&walker->lock);
+
+      chown_walker_walk_dir (walker, dir->fd, dir->path);
+      dir->fd = -1;
+      chown_dir_free (dir);
+
+      g_mutex_lock (&walker->lock);
+      walker->pending--;
+      if (walker->pending == 0)
+        {
+          /* wake up the other threads so that they can quit */
+          g_cond_broadcast (&walker->cond);
+          g_cond_signal (&walker->done_cond);
+        }
+    }
+  g_mutex_unlock (&walker->lock);
+
+  return NULL;
+}
+
+static void
+chown_walker_update_job (ChownWalker *walker,
+                         UDisksJob   *job,
+                         guint64      total_files,
+                         guint64      total_bytes)
+{
+  guint64 files;
+  guint64 bytes;
+  gdouble progress;
+
+  g_mutex_lock (&walker->lock);
+  files = walker->files;
+  bytes = walker->bytes;
+  g_mutex_unlock (&walker->lock);
+
+  /* the totals are only estimates based on the filesystem usage */
+  if (total_files > 0)
+    progress = (gdouble) files / total_files;
+  else
+    progress = (gdouble) bytes / total_bytes;
+  udisks_job_set_progress (job, MIN (progress, 0.99));
+}
+
+static gboolean
+recursive_chown (const gchar  *path,
+                 uid_t         caller_uid,
+                 gid_t         caller_gid,
+                 gboolean      recursive,
+                 UDisksJob    *job,
+                 GCancellable *cancellable,
+                 GError      **error)
+{
+  ChownWalker walker = {0, };
+  GThread *threads[CHOWN_MAX_THREADS];
+  guint n_threads;
+  guint64 total_files = 0;
+  guint64 total_bytes = 0;
+  struct statvfs statvfs_buf;
+  ChownDir *dir;
+  int dirfd;
+  guint n;
 
   g_return_val_if_fail (path != NULL, FALSE);
 
@@ -59,8 +405,7 @@ recursive_chown (const gchar *path,
   if (! recursive)
     return TRUE;
 
-  /* read and traverse through the directory */
-  dirfd = open (path, O_DIRECTORY | O_NOFOLLOW);
+  dirfd = open (path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
   if (dirfd < 0)
     {
       if (errno == ENOTDIR)
@@ -70,45 +415,72 @@ recursive_chown (const gchar *path,
       return FALSE;
     }
 
-  dir = fdopendir (dirfd);
-  if (! dir)
+  /* estimate the amount of work from the filesystem usage */
+  if (job != NULL && fstatvfs (dirfd, &statvfs_buf) == 0)
     {
-      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
-                   "Error opening directory %s: %m", path);
-      close (dirfd);
-      return FALSE;
+      total_files = statvfs_buf.f_files - statvfs_buf.f_ffree;
+      total_bytes = (guint64) (statvfs_buf.f_blocks - statvfs_buf.f_bfree) * statvfs_buf.f_frsize;
+      if (total_files > 0 || total_bytes > 0)
+        {
+          udisks_job_set_bytes (job, total_bytes);
+          udisks_job_set_progress (job, 0.0);
+          udisks_job_set_progress_valid (job, TRUE);
+        }
+      else
+        job = NULL;
     }
 
-  /* build a list of filenames to prevent fd exhaustion */
-  list = NULL;
-  while ((errno = 0, dirent = readdir (dir)))
-    if (g_strcmp0 (dirent->d_name, ".") != 0 && g_strcmp0 (dirent->d_name, "..") != 0)
-      list = g_slist_append (list, g_strdup (dirent->d_name));
-  if (!dirent && errno != 0)
-    {
-      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
-                   "Error reading directory %s: %m", path);
-      closedir (dir);
-      g_slist_free_full (list, g_free);
-      return FALSE;
-    }
-  closedir (dir);
+  walker.uid = caller_uid;
+  walker.gid = caller_gid;
+  walker.cancellable = cancellable;
+  g_mutex_init (&walker.lock);
+  g_cond_init (&walker.cond);
+  g_cond_init (&walker.done_cond);
+  g_queue_init (&walker.dirs);
 
-  /* recurse into parents */
-  for (l = list; l; l = g_slist_next (l))
-    {
-      gchar *newpath;
+  chown_walker_try_queue (&walker, dirfd, path);
+
+  n_threads = CLAMP (g_get_num_processors (), 1, CHOWN_MAX_THREADS);
+  for (n = 0; n < n_threads; n++)
+    threads[n] = g_thread_new ("chown-walker", chown_walker_thread_func, &walker);
 
-      newpath = g_build_filename (path, l->data, NULL);
-      if (! recursive_chown (newpath, caller_uid, caller_gid, TRUE, error))
+  /* wait for the walk to finish, reporting progress meanwhile */
+  g_mutex_lock (&walker.lock);
+  while (walker.pending > 0 && walker.error == NULL)
+    {
+      g_cond_wait_until (&walker.done_cond, &walker.lock,
+                         g_get_monotonic_time () + CHOWN_PROGRESS_INTERVAL);
+      if (job != NULL)
         {
-          g_free (newpath);
-          g_slist_free_full (list, g_free);
-          return FALSE;
+          g_mutex_unlock (&walker.lock);
+          chown_walker_update_job (&walker, job, total_files, total_bytes);
+          g_mutex_lock (&walker.lock);
         }
-      g_free (newpath);
     }
-  g_slist_free_full (list, g_free);
+  g_mutex_unlock (&walker.lock);
+
+  for (n = 0; n < n_threads; n++)
+    g_thread_join (threads[n]);
+
+  /* directories left behind after a failure */
+  while ((dir = g_queue_pop_head (&walker.dirs)) != NULL)
+    chown_dir_free (dir);
+
+  udisks_debug ("Changed ownership of %" G_GUINT64_FORMAT " files (%" G_GUINT64_FORMAT " bytes) in %s",
+                walker.files, walker.bytes, path);
+
+  g_cond_clear (&walker.done_cond);
+  g_cond_clear (&walker.cond);
+  g_mutex_clear (&walker.lock);
+
+  if (walker.error != NULL)
+    {
+      g_propagate_error (error, walker.error);
+      return FALSE;
+    }
+
+  if (job != NULL)
+    udisks_job_set_progress (job, 1.0);
 
   return TRUE;
 }
@@ -119,6 +491,8 @@ take_filesystem_ownership (const gchar  *device,
                            uid_t         caller_uid,
                            gid_t         caller_gid,
                            gboolean      recursive,
+                           UDisksJob    *job,
+                           GCancellable *cancellable,
                            GError      **error)
 
 {
@@ -169,7 +543,7 @@ take_filesystem_ownership (const gchar  *device,
     }
 
   /* actual chown */
-  success = recursive_chown (mountpoint, caller_uid, caller_gid, recursive, error);
+  success = recursive_chown (mountpoint, caller_uid, caller_gid, recursive, job, cancellable, error);
   if (! success)
     goto out;
 
@@ -199,3 +573,18 @@ take_filesystem_ownership (const gchar  *device,
 
   return success;
 }
+
+gboolean
+take_ownership_job_func (UDisksThreadedJob  *job,
+                         GCancellable       *cancellable,
+                         gpointer            user_data,
+                         GError            **error)
+{
+  TakeOwnershipJobData *data = (TakeOwnershipJobData *) user_data;
+
+  return take_filesystem_ownership (data->device, data->fstype,
+                                    data->caller_uid, data->caller_gid,
+                                    data->recursive,
+                                    UDISKS_JOB (job), cancellable,
+                                    error);
+}
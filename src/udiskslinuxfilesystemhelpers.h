@@ -29,13 +29,30 @@
 
 #include <blockdev/fs.h>
 
+#include "udisksdaemontypes.h"
+
 G_BEGIN_DECLS
 
+typedef struct {
+  const gchar *device;
+  const gchar *fstype;
+  uid_t caller_uid;
+  gid_t caller_gid;
+  gboolean recursive;
+} TakeOwnershipJobData;
+
+gboolean take_ownership_job_func (UDisksThreadedJob  *job,
+                                  GCancellable       *cancellable,
+                                  gpointer            user_data,
+                                  GError            **error);
+
 gboolean take_filesystem_ownership (const gchar *device,
                                     const gchar *fstype,
                                     uid_t caller_uid,
                                     gid_t caller_gid,
                                     gboolean recursive,
+                                    UDisksJob *job,
+                                    GCancellable *cancellable,
                                     GError **error);
 
 G_END_DECLS
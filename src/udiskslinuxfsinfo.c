@@ -76,6 +76,8 @@ const FSInfo _fs_info[] =
       "mkfs.ext2 -F -L $LABEL $OPTIONS $DEVICE",
       "mkfs.ext2 -n -F -L $LABEL $OPTIONS $DEVICE",
       "-E nodiscard", /* option_no_discard */
+      "-E lazy_itable_init=1,lazy_journal_init=1,nodiscard", /* option_profile_fast */
+      "-E lazy_itable_init=0,lazy_journal_init=0", /* option_profile_thorough */
     },
     {
       FS_EXT3,
@@ -86,6 +88,8 @@ const FSInfo _fs_info[] =
       "mkfs.ext3 -F -L $LABEL $OPTIONS $DEVICE",
       "mkfs.ext3 -n -F -L $LABEL $OPTIONS $DEVICE",
       "-E nodiscard", /* option_no_discard */
+      "-E lazy_itable_init=1,lazy_journal_init=1,nodiscard", /* option_profile_fast */
+      "-E lazy_itable_init=0,lazy_journal_init=0", /* option_profile_thorough */
     },
     {
       FS_EXT4,
@@ -96,6 +100,8 @@ const FSInfo _fs_info[] =
       "mkfs.ext4 -F -L $LABEL $OPTIONS $DEVICE",
       "mkfs.ext4 -n -F -L $LABEL $OPTIONS $DEVICE",
       "-E nodiscard", /* option_no_discard */
+      "-E lazy_itable_init=1,lazy_journal_init=1,nodiscard", /* option_profile_fast */
+      "-E lazy_itable_init=0,lazy_journal_init=0", /* option_profile_thorough */
     },
     {
       FS_VFAT,
@@ -135,7 +141,9 @@ const FSInfo _fs_info[] =
       TRUE,  /* supports_owners */
       "mkfs.xfs -f -L $LABEL $OPTIONS $DEVICE",
       "mkfs.xfs -N -f -L $LABEL $OPTIONS $DEVICE",
-      "-K" /* option_no_discard */
+      "-K", /* option_no_discard */
+      "-K", /* option_profile_fast */
+      NULL, /* option_profile_thorough */
     },
     {
       FS_REISERFS,
@@ -166,6 +174,8 @@ const FSInfo _fs_info[] =
       "mkfs.btrfs -L $LABEL $OPTIONS $DEVICE",
       NULL,
       "-K", /* option_no_discard */
+      "-K", /* option_profile_fast */
+      NULL, /* option_profile_thorough */
     },
     {
       FS_MINIX,
@@ -306,6 +316,111 @@ const gchar *_encryption_types[] =
     NULL
   };
 
+const gchar *_format_profiles[] =
+  {
+    UDISKS_FORMAT_PROFILE_DEFAULT,
+    UDISKS_FORMAT_PROFILE_FAST,
+    UDISKS_FORMAT_PROFILE_THOROUGH,
+    NULL
+  };
+
+/**
+ * udisks_linux_fsinfo_get_supported_format_profiles:
+ *
+ * Returns: a NULL terminated list of the names accepted by the
+ * <literal>format-profile</literal> option. Do not free or modify.
+ */
+const gchar **
+udisks_linux_fsinfo_get_supported_format_profiles (void)
+{
+  return _format_profiles;
+}
+
+/**
+ * udisks_linux_fsinfo_get_format_profile_options:
+ * @fs_info: #FSInfo of the filesystem to create.
+ * @profile: name of the format profile.
+ * @out_options: (out) (transfer none): return location for the built-in mkfs
+ *               options of @profile, %NULL if there are none.
+ *
+ * Looks up the mkfs options the built-in mapping of @profile adds for the
+ * filesystem described by @fs_info.
+ *
+ * Returns: %TRUE if @profile is known, %FALSE otherwise.
+ */
+gboolean
+udisks_linux_fsinfo_get_format_profile_options (const FSInfo *fs_info,
+                                                const gchar  *profile,
+                                                const gchar **out_options)
+{
+  *out_options = NULL;
+
+  if (g_strcmp0 (profile, UDISKS_FORMAT_PROFILE_DEFAULT) == 0)
+    return TRUE;
+  if (g_strcmp0 (profile, UDISKS_FORMAT_PROFILE_FAST) == 0)
+    {
+      *out_options = fs_info->option_profile_fast;
+      return TRUE;
+    }
+  if (g_strcmp0 (profile, UDISKS_FORMAT_PROFILE_THOROUGH) == 0)
+    {
+      *out_options = fs_info->option_profile_thorough;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+/**
+ * udisks_linux_fsinfo_join_mkfs_options:
+ * @options: (allow-none): mkfs options or %NULL.
+ * @extra: (allow-none): mkfs options to add after @options or %NULL.
+ *
+ * Joins two strings of mkfs options. mke2fs only takes the last
+ * <literal>-E</literal> option into account, so all the extended
+ * options are merged into a single one, those from @extra last.
+ *
+ * Returns: (transfer full): the joined options, free with g_free().
+ */
+gchar *
+udisks_linux_fsinfo_join_mkfs_options (const gchar *options,
+                                       const gchar *extra)
+{
+  GString *str;
+  GString *extended;
+  gchar *joined;
+  gchar **tokens;
+  guint n;
+
+  joined = g_strjoin (" ", options != NULL ? options : "", extra != NULL ? extra : "", NULL);
+  tokens = g_strsplit_set (joined, " \t", -1);
+  g_free (joined);
+
+  str = g_string_new (NULL);
+  extended = g_string_new (NULL);
+  for (n = 0; tokens[n] != NULL; n++)
+    {
+      if (*tokens[n] == '\0')
+        continue;
+      if (g_strcmp0 (tokens[n], "-E") == 0 && tokens[n + 1] != NULL && *tokens[n + 1] != '\0')
+        {
+          if (extended->len > 0)
+            g_string_append_c (extended, ',');
+          g_string_append (extended, tokens[++n]);
+          continue;
+        }
+      if (str->len > 0)
+        g_string_append_c (str, ' ');
+      g_string_append (str, tokens[n]);
+    }
+  if (extended->len > 0)
+    g_string_append_printf (str, "%s-E %s", str->len > 0 ? " " : "", extended->str);
+
+  g_strfreev (tokens);
+  g_string_free (extended, TRUE);
+  return g_string_free (str, FALSE);
+}
+
 /**
  * get_supported_encryption_types:
  *
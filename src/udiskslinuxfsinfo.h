@@ -36,12 +36,25 @@ typedef struct
   const gchar *command_create_fs;  /* should have $DEVICE and $LABEL */
   const gchar *command_validate_create_fs;  /* should have $DEVICE and $LABEL */
   const gchar *option_no_discard;
+  const gchar *option_profile_fast;  /* extra $OPTIONS for the "fast" format profile */
+  const gchar *option_profile_thorough;  /* extra $OPTIONS for the "thorough" format profile */
 } FSInfo;
 
+#define UDISKS_FORMAT_PROFILE_DEFAULT  "default"
+#define UDISKS_FORMAT_PROFILE_FAST     "fast"
+#define UDISKS_FORMAT_PROFILE_THOROUGH "thorough"
+
 const FSInfo  *get_fs_info (const gchar *fstype);
 const gchar  **get_supported_filesystems (void);
 const gchar  **get_supported_encryption_types (void);
 
+const gchar  **udisks_linux_fsinfo_get_supported_format_profiles (void);
+gboolean       udisks_linux_fsinfo_get_format_profile_options (const FSInfo *fs_info,
+                                                               const gchar  *profile,
+                                                               const gchar **out_options);
+gchar         *udisks_linux_fsinfo_join_mkfs_options (const gchar *options,
+                                                      const gchar *extra);
+
 gboolean       udisks_linux_fsinfo_creates_protective_parttable (const gchar *fs_type);
 
 G_END_DECLS
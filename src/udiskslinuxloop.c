@@ -187,6 +187,11 @@ udisks_linux_loop_update (UDisksLinuxLoop        *loop,
     }
   udisks_loop_set_setup_by_uid (UDISKS_LOOP (loop), setup_by_uid);
 
+  udisks_loop_set_direct_io (UDISKS_LOOP (loop),
+                             udisks_linux_device_read_sysfs_attr_as_int (device, "loop/dio", NULL) == 1);
+  udisks_loop_set_sector_size (UDISKS_LOOP (loop),
+                               udisks_linux_device_read_sysfs_attr_as_int (device, "queue/logical_block_size", NULL));
+
   g_dbus_interface_skeleton_flush (G_DBUS_INTERFACE_SKELETON (loop));
   g_object_unref (device);
 }
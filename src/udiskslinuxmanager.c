@@ -25,7 +25,11 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/ioctl.h>
 #include <fcntl.h>
+#include <linux/fs.h>
+#include <linux/loop.h>
 
 #include <pwd.h>
 #include <grp.h>
@@ -44,10 +48,16 @@
 #include "udisksstate.h"
 #include "udiskslinuxblockobject.h"
 #include "udiskslinuxdevice.h"
+#include "udiskslinuxdriveobject.h"
+#include "udiskslinuxdriveata.h"
 #include "udisksmodulemanager.h"
 #include "udiskslinuxfsinfo.h"
 #include "udiskssimplejob.h"
+#include "udisksthreadedjob.h"
 #include "udisksconfigmanager.h"
+#include "udisksauthorizationcache.h"
+#include "udisksstagestatistics.h"
+#include "udiskslinuxencryptedhelpers.h"
 
 /**
  * SECTION:udiskslinuxmanager
@@ -310,6 +320,100 @@ wait_for_loop_object (UDisksDaemon *daemon,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+#ifndef LOOP_SET_DIRECT_IO
+#define LOOP_SET_DIRECT_IO 0x4C08
+#endif
+
+#ifndef LOOP_SET_BLOCK_SIZE
+#define LOOP_SET_BLOCK_SIZE 0x4C09
+#endif
+
+/* Gets the logical block size of the device direct I/O on the backing
+ * file described by @statbuf has to be aligned to, or 0 if unknown (for
+ * example on btrfs, tmpfs or network filesystems).
+ */
+static guint
+get_backing_logical_block_size (const struct stat *statbuf)
+{
+  dev_t dev;
+  gchar *path;
+  gchar *contents = NULL;
+  guint ret = 0;
+
+  dev = S_ISBLK (statbuf->st_mode) ? statbuf->st_rdev : statbuf->st_dev;
+  if (major (dev) == 0)
+    return 0;
+
+  path = g_strdup_printf ("/sys/dev/block/%u:%u/queue/logical_block_size", major (dev), minor (dev));
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      /* partitions don't have a queue of their own, use the one of the disk */
+      g_free (path);
+      path = g_strdup_printf ("/sys/dev/block/%u:%u/../queue/logical_block_size", major (dev), minor (dev));
+      if (!g_file_get_contents (path, &contents, NULL, NULL))
+        contents = NULL;
+    }
+  if (contents != NULL)
+    ret = strtoul (contents, NULL, 10);
+
+  g_free (contents);
+  g_free (path);
+  return ret;
+}
+
+/* libblockdev can't set these up front, so tweak the freshly set up loop
+ * device before anybody else starts using it.
+ */
+static gboolean
+configure_loop_device (const gchar  *loop_device,
+                       guint32       sector_size,
+                       gboolean      direct_io,
+                       gboolean      direct_io_optional,
+                       gboolean      part_scan,
+                       GError      **error)
+{
+  gboolean ret = FALSE;
+  gint fd;
+
+  fd = open (loop_device, O_RDONLY);
+  if (fd == -1)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error opening %s: %m", loop_device);
+      return FALSE;
+    }
+
+  if (sector_size != 0)
+    {
+      if (ioctl (fd, LOOP_SET_BLOCK_SIZE, (unsigned long) sector_size) != 0)
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error setting sector size of %s to %u: %m", loop_device, sector_size);
+          goto out;
+        }
+      /* partitions were scanned with 512 bytes sectors */
+      if (part_scan && ioctl (fd, BLKRRPART) != 0)
+        udisks_debug ("Error re-reading partition table of %s: %m", loop_device);
+    }
+
+  if (direct_io && ioctl (fd, LOOP_SET_DIRECT_IO, 1UL) != 0)
+    {
+      if (!direct_io_optional)
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error enabling direct I/O on %s: %m", loop_device);
+          goto out;
+        }
+      udisks_debug ("Not using direct I/O on %s: %m", loop_device);
+    }
+
+  ret = TRUE;
+
+ out:
+  close (fd);
+  return ret;
+}
+
 /* runs in thread dedicated to handling @invocation */
 static gboolean
 handle_loop_setup (UDisksManager          *object,
@@ -330,11 +434,15 @@ handle_loop_setup (UDisksManager          *object,
   UDisksObject *loop_object = NULL;
   gboolean option_read_only = FALSE;
   gboolean option_no_part_scan = FALSE;
+  gboolean option_direct_io = FALSE;
+  gboolean direct_io_requested;
+  guint32 option_sector_size = 0;
   guint64 option_offset = 0;
   guint64 option_size = 0;
   uid_t caller_uid;
   struct stat fd_statbuf;
   gboolean fd_statbuf_valid = FALSE;
+  guint backing_block_size = 0;
   WaitForLoopData wait_data;
 
   /* we need the uid of the caller for the loop file */
@@ -394,12 +502,50 @@ handle_loop_setup (UDisksManager          *object,
   g_variant_lookup (options, "offset", "t", &option_offset);
   g_variant_lookup (options, "size", "t", &option_size);
   g_variant_lookup (options, "no-part-scan", "b", &option_no_part_scan);
+  g_variant_lookup (options, "sector-size", "u", &option_sector_size);
+  direct_io_requested = g_variant_lookup (options, "direct-io", "b", &option_direct_io);
+  if (!direct_io_requested)
+    option_direct_io = udisks_config_manager_get_loop_direct_io (udisks_daemon_get_config_manager (manager->daemon));
+
+  if (option_sector_size != 0 &&
+      (option_sector_size < 512 || (option_sector_size & (option_sector_size - 1)) != 0))
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_FAILED,
+                                             "Invalid sector size %u, expected a power of two of at least 512",
+                                             option_sector_size);
+      goto out;
+    }
 
   /* it's not a problem if fstat fails... for example, this can happen if the user
    * passes a fd to a file on the GVfs fuse mount
    */
   if (fstat (fd, &fd_statbuf) == 0)
-    fd_statbuf_valid = TRUE;
+    {
+      fd_statbuf_valid = TRUE;
+      backing_block_size = get_backing_logical_block_size (&fd_statbuf);
+    }
+
+  /* direct I/O requests have to be aligned to the logical block size of
+   * the backing device, leave it to the kernel to decide when unknown
+   */
+  if (option_direct_io && backing_block_size != 0 &&
+      (option_offset % backing_block_size != 0 ||
+       MAX (option_sector_size, 512) < backing_block_size))
+    {
+      if (direct_io_requested)
+        {
+          g_dbus_method_invocation_return_error (invocation,
+                                                 UDISKS_ERROR,
+                                                 UDISKS_ERROR_FAILED,
+                                                 "Cannot use direct I/O, the offset and the sector size "
+                                                 "must be aligned to %u bytes of the backing device",
+                                                 backing_block_size);
+          goto out;
+        }
+      option_direct_io = FALSE;
+    }
 
   error = NULL;
   if (!bd_loop_setup_from_fd (fd,
@@ -417,6 +563,21 @@ handle_loop_setup (UDisksManager          *object,
 
   loop_device = g_strdup_printf ("/dev/%s", loop_name);
 
+  error = NULL;
+  if ((option_sector_size != 0 || option_direct_io) &&
+      !configure_loop_device (loop_device,
+                              option_sector_size,
+                              option_direct_io,
+                              !direct_io_requested,
+                              !option_no_part_scan,
+                              &error))
+    {
+      bd_loop_teardown (loop_name, NULL);
+      g_prefix_error (&error, "Error setting up loop device %s: ", loop_device);
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
   /* Update the udisks loop state file (/run/udisks2/loop) with information
    * about the new loop device created by us.
    */
@@ -1037,6 +1198,46 @@ handle_can_format (UDisksManager         *object,
   return TRUE;
 }
 
+static gboolean
+handle_get_format_profiles (UDisksManager         *object,
+                            GDBusMethodInvocation *invocation,
+                            const gchar           *type,
+                            GVariant              *options)
+{
+  UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (object);
+  UDisksConfigManager *config_manager;
+  const FSInfo *fs_info;
+  const gchar **profiles;
+  GVariantBuilder builder;
+
+  fs_info = get_fs_info (type);
+  if (fs_info == NULL || fs_info->command_create_fs == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_NOT_SUPPORTED,
+                                             "Creation of filesystem type %s is not supported",
+                                             type);
+      return TRUE;
+    }
+
+  config_manager = udisks_daemon_get_config_manager (manager->daemon);
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{ss}"));
+  for (profiles = udisks_linux_fsinfo_get_supported_format_profiles (); *profiles != NULL; profiles++)
+    {
+      const gchar *profile_options = NULL;
+
+      udisks_linux_fsinfo_get_format_profile_options (fs_info, *profiles, &profile_options);
+      if (udisks_config_manager_get_format_profile (config_manager, type, *profiles) != NULL)
+        profile_options = udisks_config_manager_get_format_profile (config_manager, type, *profiles);
+      g_variant_builder_add (&builder, "{ss}", *profiles, profile_options != NULL ? profile_options : "");
+    }
+
+  udisks_manager_complete_get_format_profiles (object, invocation, g_variant_builder_end (&builder));
+
+  return TRUE;
+}
+
 static gboolean
 handle_can_resize (UDisksManager         *object,
                    GDBusMethodInvocation *invocation,
@@ -1263,6 +1464,1032 @@ handle_resolve_device (UDisksManager         *object,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* in milliseconds, the unlock time cryptsetup aims for with LUKS2 */
+#define BENCHMARK_PBKDF_TIME_DEFAULT 2000
+
+/* runs in thread dedicated to handling @invocation */
+static gboolean
+handle_benchmark_encryption (UDisksManager         *object,
+                             GDBusMethodInvocation *invocation,
+                             GVariant              *options)
+{
+  UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (object);
+  UDisksConfigManager *config_manager = udisks_daemon_get_config_manager (manager->daemon);
+  EncryptionBenchmarkJobData data = { 0 };
+  gboolean set_default = FALSE;
+  GError *error = NULL;
+  uid_t caller_uid;
+
+  data.pbkdf_time = BENCHMARK_PBKDF_TIME_DEFAULT;
+  g_variant_lookup (options, "pbkdf-time", "u", &data.pbkdf_time);
+  g_variant_lookup (options, "set-default", "b", &set_default);
+
+  if (data.pbkdf_time == 0)
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_FAILED,
+                                             "The pbkdf-time option must be greater than 0");
+      goto out;
+    }
+
+  if (!udisks_daemon_util_get_caller_uid_sync (manager->daemon, invocation, NULL /* GCancellable */, &caller_uid, &error))
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      g_clear_error (&error);
+      goto out;
+    }
+
+  /* The benchmark keeps the CPU busy for a while, require authorization for
+   * running it at all and the stronger one for changing the defaults. */
+  if (!udisks_daemon_util_check_authorization_sync (manager->daemon,
+                                                    NULL,
+                                                    "org.freedesktop.udisks2.modify-device",
+                                                    options,
+                                                    /* Translators: Shown in authentication dialog when the user
+                                                     * requests benchmarking the encryption ciphers.
+                                                     */
+                                                    N_("Authentication is required to benchmark encryption"),
+                                                    invocation))
+    goto out;
+
+  if (set_default &&
+      !udisks_daemon_util_check_authorization_sync (manager->daemon,
+                                                    NULL,
+                                                    "org.freedesktop.udisks2.modify-system-configuration",
+                                                    options,
+                                                    /* Translators: Shown in authentication dialog when the user
+                                                     * requests changing the default encryption cipher.
+                                                     */
+                                                    N_("Authentication is required to change the default encryption settings"),
+                                                    invocation))
+    goto out;
+
+  g_variant_builder_init (&data.ciphers, G_VARIANT_TYPE ("a(sudd)"));
+  g_variant_builder_init (&data.pbkdfs, G_VARIANT_TYPE ("a(suuu)"));
+
+  if (!udisks_daemon_launch_threaded_job_sync (manager->daemon,
+                                               NULL,
+                                               "encryption-benchmark",
+                                               caller_uid,
+                                               encryption_benchmark_job_func,
+                                               &data,
+                                               NULL, /* user_data_free_func */
+                                               NULL, /* cancellable */
+                                               &error))
+    {
+      g_prefix_error (&error, "Error running encryption benchmark: ");
+      g_dbus_method_invocation_take_error (invocation, error);
+      g_variant_builder_clear (&data.ciphers);
+      g_variant_builder_clear (&data.pbkdfs);
+      goto out;
+    }
+
+  if (set_default)
+    {
+      if (data.best_cipher == NULL)
+        {
+          g_dbus_method_invocation_return_error (invocation,
+                                                 UDISKS_ERROR,
+                                                 UDISKS_ERROR_NOT_SUPPORTED,
+                                                 "No XTS cipher with a 512 bits key is available");
+          g_variant_builder_clear (&data.ciphers);
+          g_variant_builder_clear (&data.pbkdfs);
+          goto out;
+        }
+      udisks_notice ("Using %s with a %u bits key for new encrypted devices",
+                     data.best_cipher, data.best_key_size);
+      udisks_config_manager_set_encryption_cipher (config_manager, data.best_cipher, data.best_key_size);
+    }
+
+  udisks_manager_complete_benchmark_encryption (object,
+                                                invocation,
+                                                g_variant_builder_end (&data.ciphers),
+                                                g_variant_builder_end (&data.pbkdfs));
+
+ out:
+  g_free (data.best_cipher);
+  return TRUE;  /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* the number of drives talked to at once if the caller doesn't say otherwise */
+#define SMART_BATCH_MAX_PARALLEL_DEFAULT 8
+/* larger values are clamped, each worker is a thread */
+#define SMART_BATCH_MAX_PARALLEL_LIMIT 32
+
+static const gchar *smart_batch_actions[] = {
+  "update",
+  "short",
+  "extended",
+  "conveyance",
+  "abort",
+  NULL
+};
+
+typedef struct
+{
+  const gchar *object_path;
+  UDisksLinuxDriveAta *drive;
+  GError *error;
+} SmartBatchItem;
+
+typedef struct
+{
+  const gchar *action;
+  gboolean nowakeup;
+  gboolean wait;
+  guint max_parallel;
+  GPtrArray *items;
+  GCancellable *cancellable;
+  GMutex lock;
+  guint num_done;
+  UDisksJob *job;
+} SmartBatchData;
+
+static void
+smart_batch_item_free (SmartBatchItem *item)
+{
+  g_clear_object (&item->drive);
+  g_clear_error (&item->error);
+  g_free (item);
+}
+
+static gboolean
+smart_batch_action_is_selftest (const gchar *action)
+{
+  return g_strcmp0 (action, "update") != 0 && g_strcmp0 (action, "abort") != 0;
+}
+
+static void
+smart_batch_worker (gpointer data,
+                    gpointer user_data)
+{
+  SmartBatchItem *item = data;
+  SmartBatchData *batch = user_data;
+
+  if (g_cancellable_set_error_if_cancelled (batch->cancellable, &item->error))
+    goto out;
+
+  if (!udisks_linux_drive_ata_smart_batch_start_sync (item->drive,
+                                                      batch->action,
+                                                      batch->nowakeup,
+                                                      batch->cancellable,
+                                                      &item->error))
+    udisks_warning ("Error running SMART %s for %s: %s (%s, %d)",
+                    batch->action, item->object_path,
+                    item->error->message, g_quark_to_string (item->error->domain), item->error->code);
+
+ out:
+  g_mutex_lock (&batch->lock);
+  batch->num_done++;
+  udisks_job_set_progress (batch->job, (gdouble) batch->num_done / batch->items->len);
+  g_mutex_unlock (&batch->lock);
+}
+
+static GPtrArray *
+smart_batch_get_started_selftests (SmartBatchData *batch)
+{
+  GPtrArray *drives;
+  guint n;
+
+  drives = g_ptr_array_new_with_free_func (g_object_unref);
+  if (!smart_batch_action_is_selftest (batch->action))
+    return drives;
+
+  for (n = 0; n < batch->items->len; n++)
+    {
+      SmartBatchItem *item = g_ptr_array_index (batch->items, n);
+      if (item->drive != NULL && item->error == NULL)
+        g_ptr_array_add (drives, g_object_ref (item->drive));
+    }
+  return drives;
+}
+
+static gboolean
+smart_batch_job_func (UDisksThreadedJob  *job,
+                      GCancellable       *cancellable,
+                      gpointer            user_data,
+                      GError            **error)
+{
+  SmartBatchData *batch = user_data;
+  GThreadPool *pool;
+  GPtrArray *started = NULL;
+  gboolean ret = FALSE;
+  guint n;
+
+  batch->job = UDISKS_JOB (job);
+  batch->cancellable = cancellable;
+  udisks_job_set_progress_valid (UDISKS_JOB (job), TRUE);
+  udisks_job_set_progress (UDISKS_JOB (job), 0.0);
+
+  /* Drives are independent devices, only the number of threads talking to them is bounded. */
+  pool = g_thread_pool_new (smart_batch_worker,
+                            batch,
+                            batch->max_parallel,
+                            FALSE,
+                            error);
+  if (pool == NULL)
+    goto out;
+
+  for (n = 0; n < batch->items->len; n++)
+    {
+      SmartBatchItem *item = g_ptr_array_index (batch->items, n);
+      /* drives that failed to resolve are already done */
+      if (item->drive == NULL)
+        batch->num_done++;
+      else
+        g_thread_pool_push (pool, item, NULL);
+    }
+
+  /* Wait for all the drives to finish. */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+      /* with @cancellable cancelled this aborts the self-tests that were started */
+      started = smart_batch_get_started_selftests (batch);
+      udisks_linux_drive_ata_smart_batch_wait_sync (started, NULL, cancellable, NULL);
+      goto out;
+    }
+
+  if (batch->wait)
+    {
+      started = smart_batch_get_started_selftests (batch);
+      if (started->len > 0 &&
+          !udisks_linux_drive_ata_smart_batch_wait_sync (started, UDISKS_JOB (job), cancellable, error))
+        goto out;
+    }
+
+  ret = TRUE;
+
+ out:
+  if (started != NULL)
+    g_ptr_array_unref (started);
+  return ret;
+}
+
+static gboolean
+smart_batch_monitor_job_func (UDisksThreadedJob  *job,
+                              GCancellable       *cancellable,
+                              gpointer            user_data,
+                              GError            **error)
+{
+  GPtrArray *drives = user_data;
+
+  return udisks_linux_drive_ata_smart_batch_wait_sync (drives, UDISKS_JOB (job), cancellable, error);
+}
+
+/* runs in thread dedicated to handling @invocation */
+static gboolean
+handle_smart_batch (UDisksManager         *object,
+                    GDBusMethodInvocation *invocation,
+                    const gchar *const    *arg_drives,
+                    const gchar           *arg_action,
+                    GVariant              *options)
+{
+  UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (object);
+  SmartBatchData batch = { 0 };
+  GVariantBuilder results;
+  const gchar *action_id;
+  const gchar *message;
+  GError *error = NULL;
+  uid_t caller_uid;
+  guint n;
+
+  batch.action = arg_action;
+  batch.max_parallel = SMART_BATCH_MAX_PARALLEL_DEFAULT;
+  g_variant_lookup (options, "nowakeup", "b", &batch.nowakeup);
+  g_variant_lookup (options, "wait", "b", &batch.wait);
+  g_variant_lookup (options, "max-parallel", "u", &batch.max_parallel);
+
+  if (!g_strv_contains (smart_batch_actions, arg_action))
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_FAILED,
+                                             "Unknown SMART batch action %s", arg_action);
+      goto out;
+    }
+
+  if (batch.max_parallel == 0)
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_FAILED,
+                                             "The max-parallel option must be greater than 0");
+      goto out;
+    }
+  /* no point in more threads than drives */
+  batch.max_parallel = MIN (batch.max_parallel, SMART_BATCH_MAX_PARALLEL_LIMIT);
+  batch.max_parallel = MIN (batch.max_parallel, MAX (g_strv_length ((gchar **) arg_drives), 1));
+
+  if (!udisks_daemon_util_get_caller_uid_sync (manager->daemon, invocation, NULL /* GCancellable */, &caller_uid, &error))
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      g_clear_error (&error);
+      goto out;
+    }
+
+  /* The same authorizations as for the single drive methods. */
+  if (g_strcmp0 (arg_action, "update") == 0)
+    {
+      action_id = "org.freedesktop.udisks2.ata-smart-update";
+      /* Translators: Shown in authentication dialog when the user
+       * refreshes SMART data from a disk.
+       *
+       * Do not translate $(drive), it's a placeholder and
+       * will be replaced by the name of the drive/device in question
+       */
+      message = N_("Authentication is required to update SMART data from $(drive)");
+    }
+  else if (g_strcmp0 (arg_action, "abort") == 0)
+    {
+      action_id = "org.freedesktop.udisks2.ata-smart-selftest";
+      /* Translators: Shown in authentication dialog when the user
+       * aborts a running SMART self-test.
+       *
+       * Do not translate $(drive), it's a placeholder and
+       * will be replaced by the name of the drive/device in question
+       */
+      message = N_("Authentication is required to abort a SMART self-test on $(drive)");
+    }
+  else
+    {
+      action_id = "org.freedesktop.udisks2.ata-smart-selftest";
+      /* Translators: Shown in authentication dialog when the user
+       * initiates a SMART self-test.
+       *
+       * Do not translate $(drive), it's a placeholder and
+       * will be replaced by the name of the drive/device in question
+       */
+      message = N_("Authentication is required to start a SMART self-test on $(drive)");
+    }
+
+  batch.items = g_ptr_array_new_with_free_func ((GDestroyNotify) smart_batch_item_free);
+  for (n = 0; arg_drives[n] != NULL; n++)
+    {
+      SmartBatchItem *item = g_new0 (SmartBatchItem, 1);
+      UDisksObject *drive_object;
+
+      item->object_path = arg_drives[n];
+      drive_object = udisks_daemon_find_object (manager->daemon, arg_drives[n]);
+      if (drive_object != NULL && UDISKS_IS_LINUX_DRIVE_OBJECT (drive_object))
+        {
+          UDisksDriveAta *ata = udisks_object_get_drive_ata (drive_object);
+          if (ata != NULL)
+            item->drive = UDISKS_LINUX_DRIVE_ATA (ata);
+        }
+      if (item->drive == NULL)
+        {
+          g_set_error (&item->error,
+                       UDISKS_ERROR,
+                       UDISKS_ERROR_FAILED,
+                       "Object %s is not an ATA drive", arg_drives[n]);
+        }
+      else
+        {
+          UDisksLinuxBlockObject *block_object;
+
+          /* Each drive is authorized on its own, a denied drive is only
+           * skipped. With auth_admin_keep the caller is only asked once.
+           */
+          block_object = udisks_linux_drive_object_get_block (UDISKS_LINUX_DRIVE_OBJECT (drive_object), FALSE);
+          if (!udisks_daemon_util_check_authorization_sync_with_error (manager->daemon,
+                                                                       block_object != NULL ? UDISKS_OBJECT (block_object)
+                                                                                            : drive_object,
+                                                                       action_id,
+                                                                       options,
+                                                                       message,
+                                                                       invocation,
+                                                                       &item->error))
+            g_clear_object (&item->drive);
+          g_clear_object (&block_object);
+        }
+      g_clear_object (&drive_object);
+      g_ptr_array_add (batch.items, item);
+    }
+  g_mutex_init (&batch.lock);
+
+  if (!udisks_daemon_launch_threaded_job_sync (manager->daemon,
+                                               NULL,
+                                               "ata-smart-batch",
+                                               caller_uid,
+                                               smart_batch_job_func,
+                                               &batch,
+                                               NULL, /* user_data_free_func */
+                                               NULL, /* cancellable */
+                                               &error))
+    {
+      g_prefix_error (&error, "Error running SMART batch: ");
+      g_dbus_method_invocation_take_error (invocation, error);
+      g_mutex_clear (&batch.lock);
+      goto out;
+    }
+  g_mutex_clear (&batch.lock);
+
+  /* Without waiting, a single job keeps track of all the started self-tests. */
+  if (!batch.wait && smart_batch_action_is_selftest (arg_action))
+    {
+      GPtrArray *started = smart_batch_get_started_selftests (&batch);
+      if (started->len > 0)
+        {
+          UDisksBaseJob *job;
+
+          job = udisks_daemon_launch_threaded_job (manager->daemon,
+                                                   NULL,
+                                                   "ata-smart-selftest",
+                                                   caller_uid,
+                                                   smart_batch_monitor_job_func,
+                                                   g_ptr_array_ref (started),
+                                                   (GDestroyNotify) g_ptr_array_unref,
+                                                   NULL); /* GCancellable */
+          udisks_threaded_job_start (UDISKS_THREADED_JOB (job));
+        }
+      g_ptr_array_unref (started);
+    }
+
+  g_variant_builder_init (&results, G_VARIANT_TYPE ("a(oss)"));
+  for (n = 0; n < batch.items->len; n++)
+    {
+      SmartBatchItem *item = g_ptr_array_index (batch.items, n);
+      g_variant_builder_add (&results, "(oss)",
+                             item->object_path,
+                             item->error != NULL ? item->error->message : "",
+                             item->drive != NULL ? udisks_linux_drive_ata_get_smart_selftest_status (item->drive) : "");
+    }
+
+  udisks_manager_complete_smart_batch (object,
+                                       invocation,
+                                       g_variant_builder_end (&results));
+
+ out:
+  if (batch.items != NULL)
+    g_ptr_array_unref (batch.items);
+  return TRUE;  /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct
+{
+  const gchar *object_path;
+  UDisksLinuxDriveAta *drive;
+  UDisksLinuxDriveObject *object;
+  /* the PCI function the drive hangs off or %NULL if not known */
+  gchar *controller_key;
+  /* IDENTIFY estimate, 0 if not known */
+  gint minutes;
+  guint64 size;
+  gint64 start_time;
+  gboolean done;
+  GError *error;
+} SecureEraseBatchItem;
+
+typedef struct
+{
+  gboolean enhanced;
+  guint max_per_controller;
+  uid_t caller_uid;
+  GPtrArray *items;
+  GCancellable *cancellable;
+  GMutex lock;
+  GCond cond;
+  /* controller key -> number of erases running on it */
+  GHashTable *running;
+  guint num_done;
+} SecureEraseBatchData;
+
+static void
+secure_erase_batch_item_free (SecureEraseBatchItem *item)
+{
+  g_clear_object (&item->drive);
+  g_clear_object (&item->object);
+  g_free (item->controller_key);
+  g_clear_error (&item->error);
+  g_free (item);
+}
+
+static gchar *
+get_controller_key (UDisksLinuxDriveObject *object)
+{
+  UDisksLinuxDevice *device;
+  GUdevDevice *parent = NULL;
+  gchar *ret = NULL;
+
+  device = udisks_linux_drive_object_get_device (object, TRUE /* get_hw */);
+  if (device == NULL)
+    return NULL;
+
+  parent = g_udev_device_get_parent_with_subsystem (device->udev_device, "pci", NULL);
+  if (parent != NULL)
+    ret = g_strdup (g_udev_device_get_sysfs_path (parent));
+
+  g_clear_object (&parent);
+  g_object_unref (device);
+  return ret;
+}
+
+static void
+secure_erase_batch_worker (gpointer data,
+                           gpointer user_data)
+{
+  SecureEraseBatchItem *item = data;
+  SecureEraseBatchData *batch = user_data;
+  guint count;
+
+  /* wait for a free slot on the controller */
+  g_mutex_lock (&batch->lock);
+  while (!g_cancellable_is_cancelled (batch->cancellable) &&
+         batch->max_per_controller > 0 && item->controller_key != NULL &&
+         GPOINTER_TO_UINT (g_hash_table_lookup (batch->running, item->controller_key)) >= batch->max_per_controller)
+    g_cond_wait (&batch->cond, &batch->lock);
+
+  /* once started, a secure erase can't be cancelled, but drives still waiting can be skipped */
+  if (g_cancellable_set_error_if_cancelled (batch->cancellable, &item->error))
+    {
+      item->done = TRUE;
+      batch->num_done++;
+      g_cond_broadcast (&batch->cond);
+      g_mutex_unlock (&batch->lock);
+      return;
+    }
+
+  if (item->controller_key != NULL)
+    {
+      count = GPOINTER_TO_UINT (g_hash_table_lookup (batch->running, item->controller_key));
+      g_hash_table_insert (batch->running, item->controller_key, GUINT_TO_POINTER (count + 1));
+    }
+  item->start_time = g_get_real_time ();
+  g_mutex_unlock (&batch->lock);
+
+  /* also re-reads the partition table once the drive is erased */
+  udisks_linux_drive_ata_secure_erase_batch_sync (item->drive, batch->caller_uid, batch->enhanced, &item->error);
+
+  g_mutex_lock (&batch->lock);
+  if (item->controller_key != NULL)
+    {
+      count = GPOINTER_TO_UINT (g_hash_table_lookup (batch->running, item->controller_key));
+      g_hash_table_insert (batch->running, item->controller_key, GUINT_TO_POINTER (count - 1));
+    }
+  item->done = TRUE;
+  batch->num_done++;
+  g_cond_broadcast (&batch->cond);
+  g_mutex_unlock (&batch->lock);
+}
+
+static void
+on_secure_erase_batch_cancelled (GCancellable *cancellable,
+                                 gpointer      user_data)
+{
+  SecureEraseBatchData *batch = user_data;
+
+  g_mutex_lock (&batch->lock);
+  g_cond_broadcast (&batch->cond);
+  g_mutex_unlock (&batch->lock);
+}
+
+/* Must be called with the lock held. Combines the IDENTIFY estimates of
+ * all the drives into one progress, rate and expected end time. Drives
+ * still waiting for their controller are assumed to start as soon as
+ * the erase with the earliest expected end on the same controller is
+ * done.
+ */
+static void
+secure_erase_batch_update_progress (SecureEraseBatchData *batch,
+                                    UDisksJob            *job)
+{
+  GHashTable *slots;
+  gint64 now;
+  gint64 end_time = 0;
+  gdouble total = 0.0;
+  gdouble done = 0.0;
+  gdouble rate = 0.0;
+  gboolean valid = TRUE;
+  guint pass;
+  guint n;
+
+  now = g_get_real_time ();
+  slots = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) g_array_unref);
+
+  /* running drives first so that the waiting ones queue up behind them */
+  for (pass = 0; pass < 2; pass++)
+    {
+      for (n = 0; n < batch->items->len; n++)
+        {
+          SecureEraseBatchItem *item = g_ptr_array_index (batch->items, n);
+          gint64 duration;
+          gint64 start;
+          gint64 end;
+          GArray *ends = NULL;
+
+          if (item->drive == NULL || item->done)
+            continue;
+          if ((pass == 0) != (item->start_time > 0))
+            continue;
+
+          /* 510 means "at least 508 minutes", there's no way to tell */
+          if (item->minutes <= 0 || item->minutes == 510)
+            {
+              valid = FALSE;
+              continue;
+            }
+          duration = item->minutes * 60LL * G_USEC_PER_SEC;
+
+          if (item->controller_key != NULL)
+            {
+              ends = g_hash_table_lookup (slots, item->controller_key);
+              if (ends == NULL)
+                {
+                  ends = g_array_new (FALSE, FALSE, sizeof (gint64));
+                  g_hash_table_insert (slots, item->controller_key, ends);
+                }
+            }
+
+          if (item->start_time > 0)
+            {
+              start = item->start_time;
+              rate += item->size / (duration / (gdouble) G_USEC_PER_SEC);
+            }
+          else if (ends == NULL || batch->max_per_controller == 0 || ends->len < batch->max_per_controller)
+            {
+              start = now;
+            }
+          else
+            {
+              guint i, first = 0;
+
+              for (i = 1; i < ends->len; i++)
+                if (g_array_index (ends, gint64, i) < g_array_index (ends, gint64, first))
+                  first = i;
+              start = g_array_index (ends, gint64, first);
+              g_array_remove_index_fast (ends, first);
+            }
+
+          end = MAX (start + duration, now);
+          if (ends != NULL)
+            g_array_append_val (ends, end);
+          end_time = MAX (end_time, end);
+        }
+    }
+
+  for (n = 0; n < batch->items->len; n++)
+    {
+      SecureEraseBatchItem *item = g_ptr_array_index (batch->items, n);
+      gdouble duration = item->minutes * 60.0 * G_USEC_PER_SEC;
+
+      if (item->drive == NULL || item->minutes <= 0)
+        continue;
+      total += duration;
+      if (item->done)
+        done += duration;
+      else if (item->start_time > 0)
+        done += CLAMP ((now - item->start_time) / duration, 0.0, 1.0) * duration;
+    }
+
+  g_hash_table_unref (slots);
+
+  if (valid && total > 0)
+    {
+      udisks_job_set_progress_valid (job, TRUE);
+      udisks_job_set_progress (job, done / total);
+      udisks_job_set_expected_end_time (job, end_time);
+      udisks_job_set_rate (job, rate);
+    }
+  else
+    {
+      udisks_job_set_progress_valid (job, FALSE);
+      udisks_job_set_expected_end_time (job, 0);
+      udisks_job_set_rate (job, 0);
+    }
+}
+
+static gboolean
+secure_erase_batch_job_func (UDisksThreadedJob  *job,
+                             GCancellable       *cancellable,
+                             gpointer            user_data,
+                             GError            **error)
+{
+  SecureEraseBatchData *batch = user_data;
+  GThreadPool *pool;
+  gulong handler_id;
+  guint64 bytes = 0;
+  guint num_workers = 0;
+  guint n;
+
+  batch->cancellable = cancellable;
+
+  for (n = 0; n < batch->items->len; n++)
+    {
+      SecureEraseBatchItem *item = g_ptr_array_index (batch->items, n);
+      /* drives that failed to resolve are already done */
+      if (item->drive == NULL)
+        {
+          item->done = TRUE;
+          batch->num_done++;
+        }
+      else
+        {
+          bytes += item->size;
+          num_workers++;
+        }
+    }
+  udisks_job_set_bytes (UDISKS_JOB (job), bytes);
+
+  if (num_workers == 0)
+    return TRUE;
+
+  /* The drives do all the work, a thread per drive just waits for the
+   * SECURITY ERASE UNIT command to return. Only the controllers are a
+   * shared resource.
+   */
+  pool = g_thread_pool_new (secure_erase_batch_worker,
+                            batch,
+                            num_workers,
+                            FALSE,
+                            error);
+  if (pool == NULL)
+    return FALSE;
+
+  handler_id = g_cancellable_connect (cancellable, G_CALLBACK (on_secure_erase_batch_cancelled), batch, NULL);
+
+  for (n = 0; n < batch->items->len; n++)
+    {
+      SecureEraseBatchItem *item = g_ptr_array_index (batch->items, n);
+      if (item->drive != NULL)
+        g_thread_pool_push (pool, item, NULL);
+    }
+
+  g_mutex_lock (&batch->lock);
+  while (batch->num_done < batch->items->len)
+    {
+      secure_erase_batch_update_progress (batch, UDISKS_JOB (job));
+      g_cond_wait_until (&batch->cond, &batch->lock, g_get_monotonic_time () + G_TIME_SPAN_SECOND);
+    }
+  g_mutex_unlock (&batch->lock);
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+  g_cancellable_disconnect (cancellable, handler_id);
+
+  return TRUE;
+}
+
+/* runs in thread dedicated to handling @invocation */
+static gboolean
+handle_secure_erase_batch (UDisksManager         *object,
+                           GDBusMethodInvocation *invocation,
+                           const gchar *const    *arg_drives,
+                           GVariant              *options)
+{
+  UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (object);
+  UDisksConfigManager *config_manager;
+  SecureEraseBatchData batch = { 0 };
+  GVariantBuilder results;
+  GError *error = NULL;
+  guint n;
+
+  config_manager = udisks_daemon_get_config_manager (manager->daemon);
+  batch.max_per_controller = udisks_config_manager_get_max_concurrent_jobs_per_controller (config_manager);
+  g_variant_lookup (options, "enhanced", "b", &batch.enhanced);
+  g_variant_lookup (options, "max-per-controller", "u", &batch.max_per_controller);
+
+  if (!udisks_daemon_util_get_caller_uid_sync (manager->daemon, invocation, NULL /* GCancellable */, &batch.caller_uid, &error))
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      g_clear_error (&error);
+      goto out;
+    }
+
+  batch.items = g_ptr_array_new_with_free_func ((GDestroyNotify) secure_erase_batch_item_free);
+  for (n = 0; arg_drives[n] != NULL; n++)
+    {
+      SecureEraseBatchItem *item = g_new0 (SecureEraseBatchItem, 1);
+      UDisksObject *drive_object;
+
+      item->object_path = arg_drives[n];
+      drive_object = udisks_daemon_find_object (manager->daemon, arg_drives[n]);
+      if (drive_object != NULL && UDISKS_IS_LINUX_DRIVE_OBJECT (drive_object))
+        {
+          UDisksDriveAta *ata = udisks_object_get_drive_ata (drive_object);
+          if (ata != NULL)
+            {
+              UDisksDrive *drive = udisks_object_peek_drive (drive_object);
+
+              item->drive = UDISKS_LINUX_DRIVE_ATA (ata);
+              item->object = UDISKS_LINUX_DRIVE_OBJECT (g_object_ref (drive_object));
+              item->controller_key = get_controller_key (item->object);
+              item->minutes = batch.enhanced ? udisks_drive_ata_get_security_enhanced_erase_unit_minutes (ata)
+                                             : udisks_drive_ata_get_security_erase_unit_minutes (ata);
+              item->size = drive != NULL ? udisks_drive_get_size (drive) : 0;
+            }
+        }
+      /* Every drive is checked before any of them is erased so that the
+       * dialog shows which drive it is about. With auth_admin_keep the
+       * caller is only asked once.
+       */
+      if (item->drive != NULL)
+        {
+          UDisksLinuxBlockObject *block_object;
+          gboolean authorized;
+
+          block_object = udisks_linux_drive_object_get_block (item->object, FALSE);
+          /* Translators: Shown in authentication dialog when the user
+           * requests erasing several hard disks at once using the SECURE
+           * ERASE UNIT command.
+           *
+           * Do not translate $(drive), it's a placeholder and
+           * will be replaced by the name of the drive/device in question
+           */
+          authorized = udisks_daemon_util_check_authorization_sync (manager->daemon,
+                                                                    block_object != NULL ? UDISKS_OBJECT (block_object)
+                                                                                         : UDISKS_OBJECT (item->object),
+                                                                    "org.freedesktop.udisks2.ata-secure-erase",
+                                                                    options,
+                                                                    N_("Authentication is required to perform a secure erase of $(drive)"),
+                                                                    invocation);
+          g_clear_object (&block_object);
+          if (!authorized)
+            {
+              secure_erase_batch_item_free (item);
+              g_clear_object (&drive_object);
+              goto out;
+            }
+        }
+      if (item->drive == NULL)
+        g_set_error (&item->error,
+                     UDISKS_ERROR,
+                     UDISKS_ERROR_FAILED,
+                     "Object %s is not an ATA drive", arg_drives[n]);
+      g_clear_object (&drive_object);
+      g_ptr_array_add (batch.items, item);
+    }
+  g_mutex_init (&batch.lock);
+  g_cond_init (&batch.cond);
+  batch.running = g_hash_table_new (g_str_hash, g_str_equal);
+
+  if (!udisks_daemon_launch_threaded_job_sync (manager->daemon,
+                                               NULL,
+                                               "ata-secure-erase-batch",
+                                               batch.caller_uid,
+                                               secure_erase_batch_job_func,
+                                               &batch,
+                                               NULL, /* user_data_free_func */
+                                               NULL, /* cancellable */
+                                               &error))
+    {
+      g_prefix_error (&error, "Error running secure erase batch: ");
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  g_variant_builder_init (&results, G_VARIANT_TYPE ("a(os)"));
+  for (n = 0; n < batch.items->len; n++)
+    {
+      SecureEraseBatchItem *item = g_ptr_array_index (batch.items, n);
+      g_variant_builder_add (&results, "(os)",
+                             item->object_path,
+                             item->error != NULL ? item->error->message : "");
+    }
+  udisks_manager_complete_secure_erase_batch (object,
+                                              invocation,
+                                              g_variant_builder_end (&results));
+
+ out:
+  if (batch.running != NULL)
+    {
+      g_hash_table_unref (batch.running);
+      g_mutex_clear (&batch.lock);
+      g_cond_clear (&batch.cond);
+    }
+  if (batch.items != NULL)
+    g_ptr_array_unref (batch.items);
+  return TRUE;  /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* how long a drive may take to answer when refreshing all of them */
+#define PM_STATE_REFRESH_TIMEOUT_MSEC 1000
+
+static gboolean
+handle_pm_get_states (UDisksManager         *object,
+                      GDBusMethodInvocation *invocation,
+                      GVariant              *options)
+{
+  UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (object);
+  GVariantBuilder states;
+  gboolean refresh = FALSE;
+  GList *objects = NULL;
+  GList *l;
+
+  g_variant_lookup (options, "refresh", "b", &refresh);
+
+  /* Translators: Shown in authentication dialog when the user
+   * requests the power state of all drives at once.
+   */
+  if (!udisks_daemon_util_check_authorization_sync (manager->daemon,
+                                                    NULL,
+                                                    "org.freedesktop.udisks2.ata-check-power",
+                                                    options,
+                                                    N_("Authentication is required to check power state of multiple drives"),
+                                                    invocation))
+    goto out;
+
+  g_variant_builder_init (&states, G_VARIANT_TYPE ("a(oit)"));
+  objects = udisks_daemon_get_objects (manager->daemon);
+  for (l = objects; l != NULL; l = l->next)
+    {
+      UDisksDriveAta *ata;
+      guint64 updated = 0;
+      gint pm_state;
+
+      if (!UDISKS_IS_LINUX_DRIVE_OBJECT (l->data))
+        continue;
+      ata = udisks_object_get_drive_ata (UDISKS_OBJECT (l->data));
+      if (ata == NULL)
+        continue;
+
+      if (!udisks_drive_ata_get_pm_supported (ata) || !udisks_drive_ata_get_pm_enabled (ata))
+        {
+          g_object_unref (ata);
+          continue;
+        }
+
+      /* errors leave the last known state in place */
+      if (refresh)
+        udisks_linux_drive_ata_refresh_pm_state_sync (UDISKS_LINUX_DRIVE_ATA (ata),
+                                                      PM_STATE_REFRESH_TIMEOUT_MSEC,
+                                                      NULL);
+
+      pm_state = udisks_linux_drive_ata_get_cached_pm_state (UDISKS_LINUX_DRIVE_ATA (ata), &updated);
+      g_variant_builder_add (&states, "(oit)",
+                             g_dbus_object_get_object_path (G_DBUS_OBJECT (l->data)),
+                             pm_state,
+                             updated);
+      g_object_unref (ata);
+    }
+
+  udisks_manager_complete_pm_get_states (object,
+                                         invocation,
+                                         g_variant_builder_end (&states));
+
+ out:
+  g_list_free_full (objects, g_object_unref);
+  return TRUE;  /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+handle_get_authorization_statistics (UDisksManager         *object,
+                                     GDBusMethodInvocation *invocation,
+                                     GVariant              *options)
+{
+  UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (object);
+  GVariantBuilder statistics;
+  guint64 credential_hits;
+  guint64 credential_misses;
+  guint64 authorization_hits;
+  guint64 authorization_misses;
+
+  udisks_authorization_cache_get_statistics (udisks_daemon_get_authorization_cache (manager->daemon),
+                                             &credential_hits,
+                                             &credential_misses,
+                                             &authorization_hits,
+                                             &authorization_misses);
+
+  g_variant_builder_init (&statistics, G_VARIANT_TYPE ("a{st}"));
+  g_variant_builder_add (&statistics, "{st}", "credential-hits", credential_hits);
+  g_variant_builder_add (&statistics, "{st}", "credential-misses", credential_misses);
+  g_variant_builder_add (&statistics, "{st}", "authorization-hits", authorization_hits);
+  g_variant_builder_add (&statistics, "{st}", "authorization-misses", authorization_misses);
+
+  udisks_manager_complete_get_authorization_statistics (object,
+                                                        invocation,
+                                                        g_variant_builder_end (&statistics));
+
+  return TRUE;  /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+handle_get_stage_statistics (UDisksManager         *object,
+                             GDBusMethodInvocation *invocation,
+                             GVariant              *options)
+{
+  UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (object);
+
+  udisks_manager_complete_get_stage_statistics (object,
+                                                invocation,
+                                                udisks_stage_statistics_to_variant (udisks_daemon_get_stage_statistics (manager->daemon)));
+
+  return TRUE;  /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 static void
 manager_iface_init (UDisksManagerIface *iface)
 {
@@ -1271,9 +2498,16 @@ manager_iface_init (UDisksManagerIface *iface)
   iface->handle_enable_modules = handle_enable_modules;
   iface->handle_enable_module = handle_enable_module;
   iface->handle_can_format = handle_can_format;
+  iface->handle_get_format_profiles = handle_get_format_profiles;
   iface->handle_can_resize = handle_can_resize;
   iface->handle_can_check = handle_can_check;
   iface->handle_can_repair = handle_can_repair;
   iface->handle_get_block_devices = handle_get_block_devices;
   iface->handle_resolve_device = handle_resolve_device;
+  iface->handle_benchmark_encryption = handle_benchmark_encryption;
+  iface->handle_smart_batch = handle_smart_batch;
+  iface->handle_pm_get_states = handle_pm_get_states;
+  iface->handle_secure_erase_batch = handle_secure_erase_batch;
+  iface->handle_get_authorization_statistics = handle_get_authorization_statistics;
+  iface->handle_get_stage_statistics = handle_get_stage_statistics;
 }
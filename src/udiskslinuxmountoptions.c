@@ -46,7 +46,7 @@
 /* ---------------------------------------------------------------------------------------------------- */
 
 static GHashTable * mount_options_parse_config_file (const gchar *filename, GError **error);
-static GHashTable * mount_options_get_from_udev (UDisksLinuxDevice *device, GError **error);
+static GHashTable * mount_options_dup_for_device (UDisksLinuxDevice *device, GError **error);
 
 /* ---------------------------------------------------------------------------------------------------- */
 
@@ -184,32 +184,19 @@ compute_block_level_mount_options (GHashTable      *opts,
       changed = changed || o != NULL;
     }
 
-  /* Match specific block device */
+  /* Match specific block device, the device file first, then the symlinks */
   block_options = NULL;
   if (block)
     {
-      const gchar *block_device;
       const gchar * const *block_symlinks;
-      GList *keys;
-      GList *l;
 
-      block_device = udisks_block_get_device (block);
+      block_options = g_hash_table_lookup (opts, udisks_block_get_device (block));
       block_symlinks = udisks_block_get_symlinks (block);
-
-      keys = g_hash_table_get_keys (opts);
-      g_warn_if_fail (keys != NULL);
-      for (l = keys; l != NULL; l = l->next)
+      for (; block_options == NULL && block_symlinks != NULL && *block_symlinks != NULL; block_symlinks++)
         {
-          if (!l->data || g_str_equal (l->data, MOUNT_OPTIONS_CONFIG_GROUP_DEFAULTS))
-            continue;
-          if (g_str_equal (l->data, block_device) ||
-              (block_symlinks && g_strv_contains (block_symlinks, l->data)))
-            {
-              block_options = g_hash_table_lookup (opts, l->data);
-              break;
-            }
+          if (!g_str_equal (*block_symlinks, MOUNT_OPTIONS_CONFIG_GROUP_DEFAULTS))
+            block_options = g_hash_table_lookup (opts, *block_symlinks);
         }
-      g_list_free (keys);
     }
 
   /* Block device specific options should fully override "general" options per-member basis */
@@ -254,6 +241,9 @@ compute_mount_options_for_fs_type (UDisksDaemon           *daemon,
   FSMountOptions *fsmo;
   FSMountOptions *fsmo_any;
   gchar *config_file_path;
+  GStatBuf statbuf;
+  gint64 stamp = 0;
+  guint generation;
   GError *error = NULL;
   gboolean changed = FALSE;
 
@@ -267,30 +257,38 @@ compute_mount_options_for_fs_type (UDisksDaemon           *daemon,
   fsmo_any = g_malloc0 (sizeof (FSMountOptions));
   compute_block_level_mount_options (builtin_opts, block, fstype, fsmo, fsmo_any);
 
-  /* Global config file overrides, two-level hashtable */
+  /* Global config file overrides, two-level hashtable, parsed once
+   * until the file changes
+   */
   config_file_path = g_build_filename (udisks_config_manager_get_config_dir (config_manager),
                                        MOUNT_OPTIONS_GLOBAL_CONFIG_FILE_NAME, NULL);
-  overrides = mount_options_parse_config_file (config_file_path, &error);
-  if (overrides)
+  if (g_stat (config_file_path, &statbuf) == 0)
+    stamp = (gint64) statbuf.st_mtim.tv_sec * G_USEC_PER_SEC + statbuf.st_mtim.tv_nsec / 1000;
+  overrides = udisks_config_manager_dup_mount_options (config_manager, stamp, &generation);
+  if (overrides == NULL)
     {
-      changed = compute_block_level_mount_options (overrides, block, fstype, fsmo, fsmo_any);
-      g_hash_table_unref (overrides);
-    }
-  else
-    {
-      if (! g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT) /* not found */ &&
-          ! g_error_matches (error, UDISKS_ERROR, UDISKS_ERROR_NOT_SUPPORTED) /* empty file */ )
+      overrides = mount_options_parse_config_file (config_file_path, &error);
+      if (overrides == NULL)
         {
-          udisks_warning ("Error reading global mount options config file %s: %s",
-                          config_file_path, error->message);
+          if (! g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT) /* not found */ &&
+              ! g_error_matches (error, UDISKS_ERROR, UDISKS_ERROR_NOT_SUPPORTED) /* empty file */ )
+            {
+              udisks_warning ("Error reading global mount options config file %s: %s",
+                              config_file_path, error->message);
+            }
+          g_clear_error (&error);
+          /* nothing to override, remember that as well */
+          overrides = g_hash_table_new (g_str_hash, g_str_equal);
         }
-      g_clear_error (&error);
+      udisks_config_manager_set_mount_options (config_manager, overrides, stamp, generation);
     }
   g_free (config_file_path);
+  changed = compute_block_level_mount_options (overrides, block, fstype, fsmo, fsmo_any);
+  g_hash_table_unref (overrides);
 
   /* udev properties, single-level hashtable */
   device = udisks_linux_block_object_get_device (object);
-  overrides = mount_options_get_from_udev (device, &error);
+  overrides = mount_options_dup_for_device (device, &error);
   if (overrides)
     {
       FSMountOptions *o;
@@ -591,6 +589,34 @@ mount_options_get_from_udev (UDisksLinuxDevice *device, GError **error)
   return mount_options;
 }
 
+static gpointer
+ref_mount_options (gpointer data,
+                   gpointer user_data)
+{
+  return data != NULL ? g_hash_table_ref (data) : NULL;
+}
+
+/* the udev properties of a UDisksLinuxDevice never change, a new one
+ * is created on every uevent, so its parsed options can be kept with it
+ */
+static GHashTable *
+mount_options_dup_for_device (UDisksLinuxDevice *device, GError **error)
+{
+  GHashTable *mount_options;
+
+  mount_options = g_object_dup_data (G_OBJECT (device), "mount-options", ref_mount_options, NULL);
+  if (mount_options != NULL)
+    return mount_options;
+
+  mount_options = mount_options_get_from_udev (device, error);
+  if (mount_options != NULL)
+    g_object_set_data_full (G_OBJECT (device), "mount-options",
+                            g_hash_table_ref (mount_options),
+                            (GDestroyNotify) g_hash_table_unref);
+
+  return mount_options;
+}
+
 /*
  * udisks_linux_mount_options_get_builtin: <internal>
  *
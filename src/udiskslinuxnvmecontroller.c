@@ -30,6 +30,8 @@
 
 #include <errno.h>
 
+#include <blockdev/nvme.h>
+
 #include "udiskslogging.h"
 #include "udiskslinuxprovider.h"
 #include "udiskslinuxdriveobject.h"
@@ -62,6 +64,14 @@ typedef struct _UDisksLinuxNVMeControllerClass   UDisksLinuxNVMeControllerClass;
 struct _UDisksLinuxNVMeController
 {
   UDisksNVMeControllerSkeleton parent_instance;
+
+  guint64             smart_updated;
+  BDNVMESmartLog     *smart_log;
+  BDNVMESelfTestLog  *selftest_log;
+  BDNVMESanitizeLog  *sanitize_log;
+
+  UDisksThreadedJob  *selftest_job;
+  gboolean            sanitize_in_progress;
 };
 
 struct _UDisksLinuxNVMeControllerClass
@@ -74,11 +84,19 @@ static void nvme_controller_iface_init (UDisksNVMeControllerIface *iface);
 G_DEFINE_TYPE_WITH_CODE (UDisksLinuxNVMeController, udisks_linux_nvme_controller, UDISKS_TYPE_NVME_CONTROLLER_SKELETON,
                          G_IMPLEMENT_INTERFACE (UDISKS_TYPE_NVME_CONTROLLER, nvme_controller_iface_init));
 
+G_LOCK_DEFINE_STATIC (object_lock);
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 static void
 udisks_linux_nvme_controller_finalize (GObject *object)
 {
+  UDisksLinuxNVMeController *ctrl = UDISKS_LINUX_NVME_CONTROLLER (object);
+
+  bd_nvme_smart_log_free (ctrl->smart_log);
+  bd_nvme_self_test_log_free (ctrl->selftest_log);
+  bd_nvme_sanitize_log_free (ctrl->sanitize_log);
+
   if (G_OBJECT_CLASS (udisks_linux_nvme_controller_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (udisks_linux_nvme_controller_parent_class)->finalize (object);
 }
@@ -115,6 +133,155 @@ udisks_linux_nvme_controller_new (void)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static const struct
+{
+  BDNVMESmartCriticalWarning flag;
+  const gchar *name;
+} critical_warnings[] = {
+  { BD_NVME_SMART_CRITICAL_WARNING_SPARE, "spare" },
+  { BD_NVME_SMART_CRITICAL_WARNING_TEMPERATURE, "temperature" },
+  { BD_NVME_SMART_CRITICAL_WARNING_DEGRADED, "degraded" },
+  { BD_NVME_SMART_CRITICAL_WARNING_READONLY, "readonly" },
+  { BD_NVME_SMART_CRITICAL_WARNING_VOLATILE_MEM, "volatile_mem" },
+  { BD_NVME_SMART_CRITICAL_WARNING_PMR_READONLY, "pmr_readonly" },
+};
+
+static const gchar *
+selftest_result_to_string (BDNVMESelfTestResult result)
+{
+  switch (result)
+    {
+    case BD_NVME_SELF_TEST_RESULT_NO_ERROR:
+      return "success";
+    case BD_NVME_SELF_TEST_RESULT_ABORTED:
+      return "aborted";
+    case BD_NVME_SELF_TEST_RESULT_CTRL_RESET:
+      return "ctrl_reset";
+    case BD_NVME_SELF_TEST_RESULT_NS_REMOVED:
+      return "ns_removed";
+    case BD_NVME_SELF_TEST_RESULT_ABORTED_FORMAT:
+      return "aborted_format";
+    case BD_NVME_SELF_TEST_RESULT_FATAL_ERROR:
+      return "fatal_error";
+    case BD_NVME_SELF_TEST_RESULT_UNKNOWN_SEG_FAIL:
+      return "unknown_seg_fail";
+    case BD_NVME_SELF_TEST_RESULT_KNOWN_SEG_FAIL:
+      return "known_seg_fail";
+    case BD_NVME_SELF_TEST_RESULT_ABORTED_UNKNOWN:
+      return "aborted_unknown";
+    case BD_NVME_SELF_TEST_RESULT_ABORTED_SANITIZE:
+      return "aborted_sanitize";
+    default:
+      return "unknown";
+    }
+}
+
+static const gchar *
+sanitize_status_to_string (BDNVMESanitizeStatus status)
+{
+  switch (status)
+    {
+    case BD_NVME_SANITIZE_STATUS_NEVER_SANITIZED:
+      return "never_sanitized";
+    case BD_NVME_SANITIZE_STATUS_SUCCESS:
+    case BD_NVME_SANITIZE_STATUS_SUCCESS_NO_DEALLOC:
+      return "success";
+    case BD_NVME_SANITIZE_STATUS_FAILED:
+      return "failure";
+    default:
+      return "sanitizing";
+    }
+}
+
+static gboolean
+selftest_supported (UDisksLinuxDevice *device)
+{
+  return device->nvme_ctrl_info != NULL &&
+         (device->nvme_ctrl_info->features & BD_NVME_CTRL_FEAT_SELFTEST) != 0;
+}
+
+static gboolean
+sanitize_supported (UDisksLinuxDevice *device)
+{
+  return device->nvme_ctrl_info != NULL &&
+         (device->nvme_ctrl_info->features & (BD_NVME_CTRL_FEAT_SANITIZE_CRYPTO |
+                                              BD_NVME_CTRL_FEAT_SANITIZE_BLOCK |
+                                              BD_NVME_CTRL_FEAT_SANITIZE_OVERWRITE)) != 0;
+}
+
+/* may be called from *any* thread when the SMART data has been updated */
+static void
+update_smart (UDisksLinuxNVMeController *ctrl,
+              UDisksLinuxDevice         *device)
+{
+  UDisksNVMeController *iface = UDISKS_NVME_CONTROLLER (ctrl);
+  GPtrArray *warnings;
+  guint64 updated = 0;
+  guint64 power_on_hours = 0;
+  guint16 temperature = 0;
+  guint8 percent_used = 0;
+  guint64 media_errors = 0;
+  const gchar *selftest_status = "";
+  gint selftest_percent_remaining = -1;
+  const gchar *sanitize_status = "";
+  gint sanitize_percent_remaining = -1;
+  guint n;
+
+  warnings = g_ptr_array_new ();
+
+  G_LOCK (object_lock);
+  if (ctrl->smart_log != NULL)
+    {
+      updated = ctrl->smart_updated;
+      power_on_hours = ctrl->smart_log->power_on_hours;
+      temperature = ctrl->smart_log->temperature;
+      percent_used = ctrl->smart_log->percent_used;
+      media_errors = ctrl->smart_log->media_errors;
+      for (n = 0; n < G_N_ELEMENTS (critical_warnings); n++)
+        if (ctrl->smart_log->critical_warning & critical_warnings[n].flag)
+          g_ptr_array_add (warnings, (gpointer) critical_warnings[n].name);
+    }
+  if (ctrl->selftest_log != NULL)
+    {
+      if (ctrl->selftest_log->current_operation != BD_NVME_SELF_TEST_ACTION_NOT_RUNNING)
+        {
+          selftest_status = "inprogress";
+          selftest_percent_remaining = 100 - ctrl->selftest_log->current_operation_completion;
+        }
+      else if (ctrl->selftest_log->entries != NULL && ctrl->selftest_log->entries[0] != NULL)
+        {
+          /* the most recent self-test is the first entry */
+          selftest_status = selftest_result_to_string (ctrl->selftest_log->entries[0]->result);
+        }
+    }
+  if (ctrl->sanitize_log != NULL)
+    {
+      sanitize_status = sanitize_status_to_string (ctrl->sanitize_log->sanitize_status);
+      if (g_strcmp0 (sanitize_status, "sanitizing") == 0)
+        sanitize_percent_remaining = 100 - (gint) ctrl->sanitize_log->sanitize_progress;
+    }
+  G_UNLOCK (object_lock);
+  g_ptr_array_add (warnings, NULL);
+
+  /* the property setters only emit PropertiesChanged for values that differ */
+  g_object_freeze_notify (G_OBJECT (ctrl));
+  udisks_nvme_controller_set_smart_updated (iface, updated);
+  udisks_nvme_controller_set_smart_critical_warning (iface, (const gchar *const *) warnings->pdata);
+  udisks_nvme_controller_set_smart_power_on_hours (iface, power_on_hours);
+  udisks_nvme_controller_set_smart_temperature (iface, temperature);
+  udisks_nvme_controller_set_smart_percentage_used (iface, percent_used);
+  udisks_nvme_controller_set_smart_media_errors (iface, media_errors);
+  udisks_nvme_controller_set_smart_selftest_status (iface, selftest_status);
+  udisks_nvme_controller_set_smart_selftest_percent_remaining (iface, selftest_percent_remaining);
+  udisks_nvme_controller_set_sanitize_status (iface, sanitize_status);
+  udisks_nvme_controller_set_sanitize_percent_remaining (iface, sanitize_percent_remaining);
+  g_object_thaw_notify (G_OBJECT (ctrl));
+
+  g_ptr_array_free (warnings, TRUE);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 /**
  * udisks_linux_nvme_controller_update:
  * @ctrl: A #UDisksLinuxNVMeController.
@@ -167,6 +334,8 @@ udisks_linux_nvme_controller_update (UDisksLinuxNVMeController *ctrl,
 
   g_object_thaw_notify (G_OBJECT (object));
 
+  update_smart (ctrl, device);
+
   g_dbus_interface_skeleton_flush (G_DBUS_INTERFACE_SKELETON (ctrl));
   g_object_unref (device);
 
@@ -175,7 +344,777 @@ udisks_linux_nvme_controller_update (UDisksLinuxNVMeController *ctrl,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/**
+ * udisks_linux_nvme_controller_refresh_smart_sync:
+ * @ctrl: The #UDisksLinuxNVMeController to refresh.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Synchronously retrieves the SMART / Health Information log page,
+ * the Device Self-test log page (if self-tests are supported) and the
+ * Sanitize Status log page (if sanitize is supported) from the
+ * controller. The calling thread is blocked until the data has
+ * been obtained.
+ *
+ * This may only be called if @ctrl has been associated with a
+ * #UDisksLinuxDriveObject instance.
+ *
+ * This method may be called from any thread.
+ *
+ * Returns: %TRUE if the operation succeeded, %FALSE if @error is set.
+ */
+gboolean
+udisks_linux_nvme_controller_refresh_smart_sync (UDisksLinuxNVMeController  *ctrl,
+                                                 GCancellable               *cancellable,
+                                                 GError                    **error)
+{
+  UDisksLinuxDriveObject *object;
+  UDisksLinuxDevice *device = NULL;
+  BDNVMESmartLog *smart_log = NULL;
+  BDNVMESelfTestLog *selftest_log = NULL;
+  BDNVMESanitizeLog *sanitize_log = NULL;
+  const gchar *dev_file;
+  gboolean ret = FALSE;
+
+  object = udisks_daemon_util_dup_object (ctrl, error);
+  if (object == NULL)
+    goto out;
+
+  device = udisks_linux_drive_object_get_device (object, TRUE /* get_hw */);
+  if (device == NULL)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "No udev device");
+      goto out;
+    }
+
+  dev_file = g_udev_device_get_device_file (device->udev_device);
+  if (dev_file == NULL)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "No device file available");
+      goto out;
+    }
+
+  smart_log = bd_nvme_get_smart_log (dev_file, error);
+  if (smart_log == NULL)
+    goto out;
+
+  if (selftest_supported (device))
+    {
+      selftest_log = bd_nvme_get_self_test_log (dev_file, error);
+      if (selftest_log == NULL)
+        goto out;
+    }
+
+  if (sanitize_supported (device))
+    {
+      sanitize_log = bd_nvme_get_sanitize_log (dev_file, error);
+      if (sanitize_log == NULL)
+        goto out;
+    }
+
+  G_LOCK (object_lock);
+  bd_nvme_smart_log_free (ctrl->smart_log);
+  bd_nvme_self_test_log_free (ctrl->selftest_log);
+  bd_nvme_sanitize_log_free (ctrl->sanitize_log);
+  ctrl->smart_log = g_steal_pointer (&smart_log);
+  ctrl->selftest_log = g_steal_pointer (&selftest_log);
+  ctrl->sanitize_log = g_steal_pointer (&sanitize_log);
+  ctrl->smart_updated = time (NULL);
+  G_UNLOCK (object_lock);
+
+  update_smart (ctrl, device);
+
+  /* ensure property changes are sent before the method return */
+  g_dbus_interface_skeleton_flush (G_DBUS_INTERFACE_SKELETON (ctrl));
+
+  ret = TRUE;
+
+ out:
+  bd_nvme_smart_log_free (smart_log);
+  bd_nvme_self_test_log_free (selftest_log);
+  bd_nvme_sanitize_log_free (sanitize_log);
+  g_clear_object (&device);
+  g_clear_object (&object);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+handle_smart_update (UDisksNVMeController  *_ctrl,
+                     GDBusMethodInvocation *invocation,
+                     GVariant              *options)
+{
+  UDisksLinuxNVMeController *ctrl = UDISKS_LINUX_NVME_CONTROLLER (_ctrl);
+  UDisksLinuxDriveObject *object;
+  UDisksDaemon *daemon;
+  GError *error = NULL;
+
+  object = udisks_daemon_util_dup_object (ctrl, &error);
+  if (object == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  daemon = udisks_linux_drive_object_get_daemon (object);
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    UDISKS_OBJECT (object),
+                                                    "org.freedesktop.udisks2.ata-smart-update",
+                                                    options,
+                                                    /* Translators: Shown in authentication dialog when the user
+                                                     * refreshes SMART data from a disk.
+                                                     *
+                                                     * Do not translate $(drive), it's a placeholder and
+                                                     * will be replaced by the name of the drive/device in question
+                                                     */
+                                                    N_("Authentication is required to update SMART data from $(drive)"),
+                                                    invocation))
+    goto out;
+
+  if (!udisks_linux_nvme_controller_refresh_smart_sync (ctrl,
+                                                        NULL, /* cancellable */
+                                                        &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  udisks_nvme_controller_complete_smart_update (_ctrl, invocation);
+
+ out:
+  g_clear_object (&object);
+  return TRUE; /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+handle_smart_get_attributes (UDisksNVMeController  *_ctrl,
+                             GDBusMethodInvocation *invocation,
+                             GVariant              *options)
+{
+  UDisksLinuxNVMeController *ctrl = UDISKS_LINUX_NVME_CONTROLLER (_ctrl);
+  GVariantBuilder builder;
+  GVariantBuilder sensors;
+  guint n;
+
+  G_LOCK (object_lock);
+  if (ctrl->smart_log == NULL)
+    {
+      G_UNLOCK (object_lock);
+      g_dbus_method_invocation_return_error (invocation,
+                                             UDISKS_ERROR,
+                                             UDISKS_ERROR_FAILED,
+                                             "SMART data not collected");
+      goto out;
+    }
+
+  /* served from the cache, call SmartUpdate() first for fresh data */
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "avail_spare", g_variant_new_byte (ctrl->smart_log->avail_spare));
+  g_variant_builder_add (&builder, "{sv}", "spare_thresh", g_variant_new_byte (ctrl->smart_log->spare_thresh));
+  g_variant_builder_add (&builder, "{sv}", "percent_used", g_variant_new_byte (ctrl->smart_log->percent_used));
+  g_variant_builder_add (&builder, "{sv}", "total_data_read", g_variant_new_uint64 (ctrl->smart_log->total_data_read));
+  g_variant_builder_add (&builder, "{sv}", "total_data_written", g_variant_new_uint64 (ctrl->smart_log->total_data_written));
+  g_variant_builder_add (&builder, "{sv}", "ctrl_busy_time", g_variant_new_uint64 (ctrl->smart_log->ctrl_busy_time));
+  g_variant_builder_add (&builder, "{sv}", "power_cycles", g_variant_new_uint64 (ctrl->smart_log->power_cycles));
+  g_variant_builder_add (&builder, "{sv}", "unsafe_shutdowns", g_variant_new_uint64 (ctrl->smart_log->unsafe_shutdowns));
+  g_variant_builder_add (&builder, "{sv}", "media_errors", g_variant_new_uint64 (ctrl->smart_log->media_errors));
+  g_variant_builder_add (&builder, "{sv}", "num_err_log_entries", g_variant_new_uint64 (ctrl->smart_log->num_err_log_entries));
+  g_variant_builder_add (&builder, "{sv}", "wctemp", g_variant_new_uint16 (ctrl->smart_log->wctemp));
+  g_variant_builder_add (&builder, "{sv}", "cctemp", g_variant_new_uint16 (ctrl->smart_log->cctemp));
+  g_variant_builder_add (&builder, "{sv}", "warning_temp_time", g_variant_new_uint32 (ctrl->smart_log->warning_temp_time));
+  g_variant_builder_add (&builder, "{sv}", "critical_temp_time", g_variant_new_uint32 (ctrl->smart_log->critical_temp_time));
+  g_variant_builder_init (&sensors, G_VARIANT_TYPE ("aq"));
+  for (n = 0; n < G_N_ELEMENTS (ctrl->smart_log->temp_sensors); n++)
+    g_variant_builder_add (&sensors, "q", ctrl->smart_log->temp_sensors[n]);
+  g_variant_builder_add (&builder, "{sv}", "temp_sensors", g_variant_builder_end (&sensors));
+  G_UNLOCK (object_lock);
+
+  udisks_nvme_controller_complete_smart_get_attributes (_ctrl, invocation,
+                                                        g_variant_builder_end (&builder));
+
+ out:
+  return TRUE; /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+selftest_job_func (UDisksThreadedJob  *job,
+                   GCancellable       *cancellable,
+                   gpointer            user_data,
+                   GError            **error)
+{
+  UDisksLinuxNVMeController *ctrl = UDISKS_LINUX_NVME_CONTROLLER (user_data);
+  UDisksLinuxDriveObject *object;
+  UDisksLinuxDevice *device = NULL;
+  gboolean ret = FALSE;
+
+  object = udisks_daemon_util_dup_object (ctrl, error);
+  if (object == NULL)
+    goto out;
+
+  udisks_job_set_progress_valid (UDISKS_JOB (job), TRUE);
+  udisks_job_set_progress (UDISKS_JOB (job), 0.0);
+
+  while (TRUE)
+    {
+      gboolean still_in_progress;
+      gdouble progress;
+      GPollFD poll_fd;
+
+      if (!udisks_linux_nvme_controller_refresh_smart_sync (ctrl, NULL, error))
+        {
+          udisks_warning ("Error updating NVMe health log for %s while polling during self-test: %s (%s, %d)",
+                          g_dbus_object_get_object_path (G_DBUS_OBJECT (object)),
+                          (*error)->message, g_quark_to_string ((*error)->domain), (*error)->code);
+          goto out;
+        }
+
+      G_LOCK (object_lock);
+      still_in_progress = ctrl->selftest_log != NULL &&
+                          ctrl->selftest_log->current_operation != BD_NVME_SELF_TEST_ACTION_NOT_RUNNING;
+      progress = still_in_progress ? ctrl->selftest_log->current_operation_completion / 100.0 : 1.0;
+      G_UNLOCK (object_lock);
+      if (!still_in_progress)
+        {
+          ret = TRUE;
+          goto out;
+        }
+
+      udisks_job_set_progress (UDISKS_JOB (job), CLAMP (progress, 0.0, 1.0));
+
+      /* Sleep for 30 seconds or until we're cancelled */
+      if (g_cancellable_make_pollfd (cancellable, &poll_fd))
+        {
+          gint poll_ret;
+          do
+            {
+              poll_ret = g_poll (&poll_fd, 1, 30 * 1000);
+            }
+          while (poll_ret == -1 && errno == EINTR);
+          g_cancellable_release_fd (cancellable);
+        }
+      else
+        {
+          g_set_error (error,
+                       UDISKS_ERROR,
+                       UDISKS_ERROR_FAILED,
+                       "Error creating pollfd for cancellable");
+          goto out;
+        }
+
+      if (g_cancellable_is_cancelled (cancellable))
+        {
+          GError *c_error = NULL;
+
+          g_set_error (error,
+                       UDISKS_ERROR,
+                       UDISKS_ERROR_CANCELLED,
+                       "Self-test was cancelled");
+
+          /* OK, cancelled ... still need to a) abort the test; and b) update the status */
+          device = udisks_linux_drive_object_get_device (object, TRUE /* get_hw */);
+          if (device == NULL ||
+              !bd_nvme_device_self_test (g_udev_device_get_device_file (device->udev_device),
+                                         BD_NVME_SELF_TEST_ACTION_ABORT,
+                                         &c_error) ||
+              !udisks_linux_nvme_controller_refresh_smart_sync (ctrl, NULL, &c_error))
+            {
+              udisks_warning ("Error aborting NVMe self-test for %s on cancel path: %s",
+                              g_dbus_object_get_object_path (G_DBUS_OBJECT (object)),
+                              c_error != NULL ? c_error->message : "No udev device");
+              g_clear_error (&c_error);
+            }
+          goto out;
+        }
+    }
+
+ out:
+  /* terminate the job */
+  G_LOCK (object_lock);
+  ctrl->selftest_job = NULL;
+  G_UNLOCK (object_lock);
+  g_clear_object (&device);
+  g_clear_object (&object);
+  return ret;
+}
+
+static gboolean
+handle_smart_selftest_start (UDisksNVMeController  *_ctrl,
+                             GDBusMethodInvocation *invocation,
+                             const gchar           *arg_type,
+                             GVariant              *options)
+{
+  UDisksLinuxNVMeController *ctrl = UDISKS_LINUX_NVME_CONTROLLER (_ctrl);
+  UDisksLinuxDriveObject *object;
+  UDisksLinuxDevice *device = NULL;
+  UDisksDaemon *daemon;
+  BDNVMESelfTestAction action;
+  uid_t caller_uid;
+  GError *error = NULL;
+
+  object = udisks_daemon_util_dup_object (ctrl, &error);
+  if (object == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  daemon = udisks_linux_drive_object_get_daemon (object);
+  device = udisks_linux_drive_object_get_device (object, TRUE /* get_hw */);
+  if (device == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                             "No udev device");
+      goto out;
+    }
+
+  if (!selftest_supported (device))
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_NOT_SUPPORTED,
+                                             "The NVMe controller has no support for self-tests");
+      goto out;
+    }
+
+  if (g_strcmp0 (arg_type, "short") == 0)
+    action = BD_NVME_SELF_TEST_ACTION_SHORT;
+  else if (g_strcmp0 (arg_type, "extended") == 0)
+    action = BD_NVME_SELF_TEST_ACTION_EXTENDED;
+  else
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                             "Unknown self-test type %s", arg_type);
+      goto out;
+    }
+
+  if (!udisks_daemon_util_get_caller_uid_sync (daemon,
+                                               invocation,
+                                               NULL /* GCancellable */,
+                                               &caller_uid,
+                                               &error))
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      g_clear_error (&error);
+      goto out;
+    }
+
+  G_LOCK (object_lock);
+  if (ctrl->selftest_job != NULL)
+    {
+      G_UNLOCK (object_lock);
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                             "There is already SMART self-test running");
+      goto out;
+    }
+  G_UNLOCK (object_lock);
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    UDISKS_OBJECT (object),
+                                                    "org.freedesktop.udisks2.ata-smart-selftest",
+                                                    options,
+                                                    /* Translators: Shown in authentication dialog when the user
+                                                     * initiates a device self-test.
+                                                     *
+                                                     * Do not translate $(drive), it's a placeholder and
+                                                     * will be replaced by the name of the drive/device in question
+                                                     */
+                                                    N_("Authentication is required to start a device self-test on $(drive)"),
+                                                    invocation))
+    goto out;
+
+  if (!bd_nvme_device_self_test (g_udev_device_get_device_file (device->udev_device),
+                                 action,
+                                 &error))
+    {
+      g_prefix_error (&error, "Error starting device self-test: ");
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  G_LOCK (object_lock);
+  if (ctrl->selftest_job == NULL)
+    {
+      ctrl->selftest_job = UDISKS_THREADED_JOB (udisks_daemon_launch_threaded_job (daemon,
+                                                                                   UDISKS_OBJECT (object),
+                                                                                   "nvme-selftest", caller_uid,
+                                                                                   selftest_job_func,
+                                                                                   g_object_ref (ctrl),
+                                                                                   g_object_unref,
+                                                                                   NULL)); /* GCancellable */
+      udisks_threaded_job_start (ctrl->selftest_job);
+    }
+  G_UNLOCK (object_lock);
+
+  udisks_nvme_controller_complete_smart_selftest_start (_ctrl, invocation);
+
+ out:
+  g_clear_object (&device);
+  g_clear_object (&object);
+  return TRUE; /* returning TRUE means that we handled the method invocation */
+}
+
+static gboolean
+handle_smart_selftest_abort (UDisksNVMeController  *_ctrl,
+                             GDBusMethodInvocation *invocation,
+                             GVariant              *options)
+{
+  UDisksLinuxNVMeController *ctrl = UDISKS_LINUX_NVME_CONTROLLER (_ctrl);
+  UDisksLinuxDriveObject *object;
+  UDisksLinuxDevice *device = NULL;
+  UDisksDaemon *daemon;
+  GError *error = NULL;
+
+  object = udisks_daemon_util_dup_object (ctrl, &error);
+  if (object == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  daemon = udisks_linux_drive_object_get_daemon (object);
+  device = udisks_linux_drive_object_get_device (object, TRUE /* get_hw */);
+  if (device == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                             "No udev device");
+      goto out;
+    }
+
+  if (!selftest_supported (device))
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_NOT_SUPPORTED,
+                                             "The NVMe controller has no support for self-tests");
+      goto out;
+    }
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    UDISKS_OBJECT (object),
+                                                    "org.freedesktop.udisks2.ata-smart-selftest",
+                                                    options,
+                                                    /* Translators: Shown in authentication dialog when the user
+                                                     * aborts a running device self-test.
+                                                     *
+                                                     * Do not translate $(drive), it's a placeholder and
+                                                     * will be replaced by the name of the drive/device in question
+                                                     */
+                                                    N_("Authentication is required to abort a device self-test on $(drive)"),
+                                                    invocation))
+    goto out;
+
+  if (!bd_nvme_device_self_test (g_udev_device_get_device_file (device->udev_device),
+                                 BD_NVME_SELF_TEST_ACTION_ABORT,
+                                 &error))
+    {
+      g_prefix_error (&error, "Error aborting device self-test: ");
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  /* This wakes up the selftest thread */
+  G_LOCK (object_lock);
+  if (ctrl->selftest_job != NULL)
+    g_cancellable_cancel (udisks_base_job_get_cancellable (UDISKS_BASE_JOB (ctrl->selftest_job)));
+  G_UNLOCK (object_lock);
+
+  if (!udisks_linux_nvme_controller_refresh_smart_sync (ctrl, NULL, &error))
+    {
+      udisks_warning ("Error updating health information for %s: %s (%s, %d)",
+                      g_dbus_object_get_object_path (G_DBUS_OBJECT (object)),
+                      error->message, g_quark_to_string (error->domain), error->code);
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  udisks_nvme_controller_complete_smart_selftest_abort (_ctrl, invocation);
+
+ out:
+  g_clear_object (&device);
+  g_clear_object (&object);
+  return TRUE; /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* the content of all namespaces changed, make sure it's probed again */
+static void
+trigger_namespace_uevents (UDisksLinuxDriveObject *object)
+{
+  UDisksDaemon *daemon = udisks_linux_drive_object_get_daemon (object);
+  const gchar *drive_object_path = g_dbus_object_get_object_path (G_DBUS_OBJECT (object));
+  GList *objects;
+  GList *l;
+
+  objects = udisks_daemon_get_objects (daemon);
+  for (l = objects; l != NULL; l = l->next)
+    {
+      UDisksBlock *block;
+
+      if (!UDISKS_IS_LINUX_BLOCK_OBJECT (l->data))
+        continue;
+      block = udisks_object_peek_block (UDISKS_OBJECT (l->data));
+      if (block != NULL && g_strcmp0 (udisks_block_get_drive (block), drive_object_path) == 0)
+        udisks_linux_block_object_trigger_uevent (UDISKS_LINUX_BLOCK_OBJECT (l->data));
+    }
+  g_list_free_full (objects, g_object_unref);
+}
+
+/**
+ * udisks_linux_nvme_controller_sanitize_sync:
+ * @ctrl: A #UDisksLinuxNVMeController.
+ * @caller_uid: The unix user if of the caller requesting the operation.
+ * @action: The sanitize action, <literal>block-erase</literal>, <literal>crypto-erase</literal> or <literal>overwrite</literal>.
+ * @options: (allow-none): Options for the sanitize operation or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Starts a sanitize operation on @ctrl and waits for it to finish. This
+ * erases the user data of all namespaces attached to the controller.
+ * The progress is read from the Sanitize Status log page and is
+ * reported by a job with the operation <literal>nvme-sanitize</literal>.
+ *
+ * Known @options are <literal>no_dealloc</literal> (b),
+ * <literal>overwrite_pass_count</literal> (y),
+ * <literal>overwrite_pattern</literal> (u) and
+ * <literal>overwrite_invert_pattern</literal> (b).
+ *
+ * The calling thread is blocked until the operation has finished.
+ *
+ * Returns: %TRUE if the operation succeeded, %FALSE if @error is set.
+ */
+gboolean
+udisks_linux_nvme_controller_sanitize_sync (UDisksLinuxNVMeController  *ctrl,
+                                            uid_t                       caller_uid,
+                                            const gchar                *action,
+                                            GVariant                   *options,
+                                            GError                    **error)
+{
+  UDisksLinuxDriveObject *object;
+  UDisksLinuxDevice *device = NULL;
+  UDisksDaemon *daemon;
+  UDisksBaseJob *job = NULL;
+  BDNVMESanitizeAction sanitize_action;
+  BDNVMEControllerFeature feature;
+  const gchar *dev_file = NULL;
+  gboolean no_dealloc = FALSE;
+  guchar overwrite_pass_count = 0;
+  guint32 overwrite_pattern = 0;
+  gboolean overwrite_invert_pattern = FALSE;
+  gboolean claimed = FALSE;
+  gboolean ret = FALSE;
+  GError *local_error = NULL;
+
+  object = udisks_daemon_util_dup_object (ctrl, &local_error);
+  if (object == NULL)
+    goto out;
+
+  daemon = udisks_linux_drive_object_get_daemon (object);
+  device = udisks_linux_drive_object_get_device (object, TRUE /* get_hw */);
+  if (device == NULL)
+    {
+      g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "No udev device");
+      goto out;
+    }
+  dev_file = g_udev_device_get_device_file (device->udev_device);
+
+  if (g_strcmp0 (action, "block-erase") == 0)
+    {
+      sanitize_action = BD_NVME_SANITIZE_ACTION_BLOCK_ERASE;
+      feature = BD_NVME_CTRL_FEAT_SANITIZE_BLOCK;
+    }
+  else if (g_strcmp0 (action, "crypto-erase") == 0)
+    {
+      sanitize_action = BD_NVME_SANITIZE_ACTION_CRYPTO_ERASE;
+      feature = BD_NVME_CTRL_FEAT_SANITIZE_CRYPTO;
+    }
+  else if (g_strcmp0 (action, "overwrite") == 0)
+    {
+      sanitize_action = BD_NVME_SANITIZE_ACTION_OVERWRITE;
+      feature = BD_NVME_CTRL_FEAT_SANITIZE_OVERWRITE;
+    }
+  else
+    {
+      g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Unknown sanitize action %s", action);
+      goto out;
+    }
+
+  if (device->nvme_ctrl_info == NULL || (device->nvme_ctrl_info->features & feature) == 0)
+    {
+      g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_NOT_SUPPORTED,
+                   "The NVMe controller has no support for the %s sanitize action", action);
+      goto out;
+    }
+
+  if (options != NULL)
+    {
+      g_variant_lookup (options, "no_dealloc", "b", &no_dealloc);
+      g_variant_lookup (options, "overwrite_pass_count", "y", &overwrite_pass_count);
+      g_variant_lookup (options, "overwrite_pattern", "u", &overwrite_pattern);
+      g_variant_lookup (options, "overwrite_invert_pattern", "b", &overwrite_invert_pattern);
+    }
+
+  G_LOCK (object_lock);
+  if (ctrl->sanitize_in_progress)
+    {
+      G_UNLOCK (object_lock);
+      g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_DEVICE_BUSY,
+                   "Sanitize in progress");
+      goto out;
+    }
+  ctrl->sanitize_in_progress = TRUE;
+  G_UNLOCK (object_lock);
+  claimed = TRUE;
+
+  /* all namespaces are erased, none of them may be in use */
+  if (!udisks_linux_drive_object_is_not_in_use (object, NULL, &local_error))
+    goto out;
+
+  job = udisks_daemon_launch_simple_job (daemon, UDISKS_OBJECT (object), "nvme-sanitize", caller_uid, NULL);
+  udisks_job_set_cancelable (UDISKS_JOB (job), FALSE);
+  udisks_job_set_progress_valid (UDISKS_JOB (job), TRUE);
+  udisks_job_set_progress (UDISKS_JOB (job), 0.0);
+
+  udisks_notice ("Commencing NVMe %s sanitize of %s", action, dev_file);
+
+  if (!bd_nvme_sanitize (dev_file,
+                         sanitize_action,
+                         no_dealloc,
+                         overwrite_pass_count,
+                         overwrite_pattern,
+                         overwrite_invert_pattern,
+                         &local_error))
+    {
+      g_prefix_error (&local_error, "Error starting sanitize: ");
+      goto out;
+    }
+
+  /* The operation runs in the background, poll its progress */
+  while (TRUE)
+    {
+      const gchar *status = NULL;
+      gdouble progress = 0.0;
+
+      if (!udisks_linux_nvme_controller_refresh_smart_sync (ctrl, NULL, &local_error))
+        goto out;
+
+      G_LOCK (object_lock);
+      if (ctrl->sanitize_log != NULL)
+        {
+          status = sanitize_status_to_string (ctrl->sanitize_log->sanitize_status);
+          progress = ctrl->sanitize_log->sanitize_progress / 100.0;
+        }
+      G_UNLOCK (object_lock);
+
+      if (g_strcmp0 (status, "failure") == 0)
+        {
+          g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "The sanitize operation failed");
+          goto out;
+        }
+      if (g_strcmp0 (status, "sanitizing") != 0)
+        break;
+
+      udisks_job_set_progress (UDISKS_JOB (job), CLAMP (progress, 0.0, 1.0));
+      g_usleep (G_USEC_PER_SEC);
+    }
+
+  trigger_namespace_uevents (object);
+
+  ret = TRUE;
+
+ out:
+  if (job != NULL)
+    udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), ret, ret ? "" : local_error->message);
+
+  if (ret)
+    udisks_notice ("Finished sanitizing %s", dev_file);
+  else
+    g_propagate_error (error, local_error);
+
+  if (claimed)
+    {
+      G_LOCK (object_lock);
+      ctrl->sanitize_in_progress = FALSE;
+      G_UNLOCK (object_lock);
+    }
+  g_clear_object (&device);
+  g_clear_object (&object);
+  return ret;
+}
+
+static gboolean
+handle_sanitize (UDisksNVMeController  *_ctrl,
+                 GDBusMethodInvocation *invocation,
+                 const gchar           *arg_action,
+                 GVariant              *options)
+{
+  UDisksLinuxNVMeController *ctrl = UDISKS_LINUX_NVME_CONTROLLER (_ctrl);
+  UDisksLinuxDriveObject *object;
+  UDisksDaemon *daemon;
+  uid_t caller_uid;
+  GError *error = NULL;
+
+  object = udisks_daemon_util_dup_object (ctrl, &error);
+  if (object == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  daemon = udisks_linux_drive_object_get_daemon (object);
+
+  if (!udisks_daemon_util_get_caller_uid_sync (daemon,
+                                               invocation,
+                                               NULL /* GCancellable */,
+                                               &caller_uid,
+                                               &error))
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      g_clear_error (&error);
+      goto out;
+    }
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    UDISKS_OBJECT (object),
+                                                    "org.freedesktop.udisks2.ata-secure-erase",
+                                                    options,
+                                                    /* Translators: Shown in authentication dialog when the user
+                                                     * requests sanitizing a NVMe drive.
+                                                     *
+                                                     * Do not translate $(drive), it's a placeholder and
+                                                     * will be replaced by the name of the drive/device in question
+                                                     */
+                                                    N_("Authentication is required to perform a sanitize operation on $(drive)"),
+                                                    invocation))
+    goto out;
+
+  if (!udisks_linux_nvme_controller_sanitize_sync (ctrl, caller_uid, arg_action, options, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  udisks_nvme_controller_complete_sanitize (_ctrl, invocation);
+
+ out:
+  g_clear_object (&object);
+  return TRUE; /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 static void
 nvme_controller_iface_init (UDisksNVMeControllerIface *iface)
 {
+  iface->handle_smart_update = handle_smart_update;
+  iface->handle_smart_get_attributes = handle_smart_get_attributes;
+  iface->handle_smart_selftest_start = handle_smart_selftest_start;
+  iface->handle_smart_selftest_abort = handle_smart_selftest_abort;
+  iface->handle_sanitize = handle_sanitize;
 }
@@ -33,6 +33,14 @@ GType                 udisks_linux_nvme_controller_get_type (void) G_GNUC_CONST;
 UDisksNVMeController *udisks_linux_nvme_controller_new      (void);
 gboolean              udisks_linux_nvme_controller_update   (UDisksLinuxNVMeController *ctrl,
                                                              UDisksLinuxDriveObject    *object);
+gboolean              udisks_linux_nvme_controller_refresh_smart_sync (UDisksLinuxNVMeController  *ctrl,
+                                                                       GCancellable               *cancellable,
+                                                                       GError                    **error);
+gboolean              udisks_linux_nvme_controller_sanitize_sync      (UDisksLinuxNVMeController  *ctrl,
+                                                                       uid_t                       caller_uid,
+                                                                       const gchar                *action,
+                                                                       GVariant                   *options,
+                                                                       GError                    **error);
 
 G_END_DECLS
 
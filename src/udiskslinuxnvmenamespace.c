@@ -23,6 +23,8 @@
 
 #include <sys/types.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <blockdev/nvme.h>
 
@@ -191,7 +193,189 @@ udisks_linux_nvme_namespace_update (UDisksLinuxNVMeNamespace *ns,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/**
+ * udisks_linux_nvme_namespace_format_sync:
+ * @ns: A #UDisksLinuxNVMeNamespace.
+ * @caller_uid: The unix user if of the caller requesting the operation.
+ * @lba_data_size: The LBA data size (sector size) in bytes or 0 to keep the current one.
+ * @metadata_size: The metadata size in bytes or 0 for none.
+ * @secure_erase: (allow-none): %NULL or empty for no secure erase, <literal>user_data</literal> or <literal>crypto_erase</literal>.
+ * @error: Return location for error or %NULL.
+ *
+ * Performs a Format NVM operation on the namespace, tracked by a job
+ * with the operation <literal>nvme-format-ns</literal>. The calling
+ * thread is blocked until the operation has finished.
+ *
+ * Returns: %TRUE if the operation succeeded, %FALSE if @error is set.
+ */
+gboolean
+udisks_linux_nvme_namespace_format_sync (UDisksLinuxNVMeNamespace  *ns,
+                                         uid_t                      caller_uid,
+                                         guint16                    lba_data_size,
+                                         guint16                    metadata_size,
+                                         const gchar               *secure_erase,
+                                         GError                   **error)
+{
+  UDisksLinuxBlockObject *object;
+  UDisksDaemon *daemon;
+  UDisksBaseJob *job = NULL;
+  BDNVMEFormatSecureErase se;
+  gchar *device_file = NULL;
+  gint fd = -1;
+  gboolean ret = FALSE;
+  GError *local_error = NULL;
+
+  object = udisks_daemon_util_dup_object (ns, &local_error);
+  if (object == NULL)
+    goto out;
+
+  daemon = udisks_linux_block_object_get_daemon (object);
+
+  if (secure_erase == NULL || *secure_erase == '\0')
+    se = BD_NVME_FORMAT_SECURE_ERASE_NONE;
+  else if (g_strcmp0 (secure_erase, "user_data") == 0)
+    se = BD_NVME_FORMAT_SECURE_ERASE_USER_DATA;
+  else if (g_strcmp0 (secure_erase, "crypto_erase") == 0)
+    se = BD_NVME_FORMAT_SECURE_ERASE_CRYPTO;
+  else
+    {
+      g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Unknown secure erase type %s", secure_erase);
+      goto out;
+    }
+
+  /* Use O_EXCL so it fails if mounted or in use */
+  device_file = udisks_linux_block_object_get_device_file (object);
+  fd = open (device_file, O_RDONLY | O_EXCL);
+  if (fd == -1)
+    {
+      g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error opening device file %s for format: %m",
+                   device_file);
+      goto out;
+    }
+
+  job = udisks_daemon_launch_simple_job (daemon, UDISKS_OBJECT (object), "nvme-format-ns", caller_uid, NULL);
+  udisks_job_set_cancelable (UDISKS_JOB (job), FALSE);
+
+  udisks_notice ("Commencing NVMe Format NVM of %s (secure erase: %s)",
+                 device_file, se == BD_NVME_FORMAT_SECURE_ERASE_NONE ? "none" : secure_erase);
+
+  if (!bd_nvme_format (device_file, lba_data_size, metadata_size, se, &local_error))
+    {
+      g_prefix_error (&local_error, "Format NVM failed: ");
+      goto out;
+    }
+
+  /* the LBA format may have changed, let the namespace be probed again */
+  close (fd);
+  fd = -1;
+  udisks_linux_block_object_trigger_uevent_sync (object, UDISKS_DEFAULT_WAIT_TIMEOUT);
+
+  ret = TRUE;
+
+ out:
+  if (fd != -1)
+    close (fd);
+  if (job != NULL)
+    udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), ret, ret ? "" : local_error->message);
+  if (ret)
+    udisks_notice ("Finished formatting %s", device_file);
+  else
+    g_propagate_error (error, local_error);
+  g_free (device_file);
+  g_clear_object (&object);
+  return ret;
+}
+
+static gboolean
+handle_format_namespace (UDisksNVMeNamespace   *_ns,
+                         GDBusMethodInvocation *invocation,
+                         GVariant              *options)
+{
+  UDisksLinuxNVMeNamespace *ns = UDISKS_LINUX_NVME_NAMESPACE (_ns);
+  UDisksLinuxBlockObject *object;
+  UDisksDaemon *daemon;
+  guint16 lba_data_size = 0;
+  guint16 metadata_size = 0;
+  const gchar *secure_erase = NULL;
+  const gchar *action_id;
+  const gchar *message;
+  uid_t caller_uid;
+  GError *error = NULL;
+
+  object = udisks_daemon_util_dup_object (ns, &error);
+  if (object == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  daemon = udisks_linux_block_object_get_daemon (object);
+
+  g_variant_lookup (options, "lba_data_size", "q", &lba_data_size);
+  g_variant_lookup (options, "metadata_size", "q", &metadata_size);
+  g_variant_lookup (options, "secure_erase", "&s", &secure_erase);
+
+  if (!udisks_daemon_util_get_caller_uid_sync (daemon,
+                                               invocation,
+                                               NULL /* GCancellable */,
+                                               &caller_uid,
+                                               &error))
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      g_clear_error (&error);
+      goto out;
+    }
+
+  if (secure_erase != NULL && *secure_erase != '\0')
+    {
+      /* Translators: Shown in authentication dialog when the user
+       * requests a secure erase of a NVMe namespace.
+       *
+       * Do not translate $(drive), it's a placeholder and
+       * will be replaced by the name of the drive/device in question
+       */
+      message = N_("Authentication is required to perform a secure erase of $(drive)");
+      action_id = "org.freedesktop.udisks2.ata-secure-erase";
+    }
+  else
+    {
+      /* Translators: Shown in authentication dialog when the user
+       * requests formatting a NVMe namespace.
+       *
+       * Do not translate $(drive), it's a placeholder and
+       * will be replaced by the name of the drive/device in question
+       */
+      message = N_("Authentication is required to format $(drive)");
+      action_id = "org.freedesktop.udisks2.modify-device";
+    }
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    UDISKS_OBJECT (object),
+                                                    action_id,
+                                                    options,
+                                                    message,
+                                                    invocation))
+    goto out;
+
+  if (!udisks_linux_nvme_namespace_format_sync (ns, caller_uid, lba_data_size, metadata_size, secure_erase, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  udisks_nvme_namespace_complete_format_namespace (_ns, invocation);
+
+ out:
+  g_clear_object (&object);
+  return TRUE; /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 static void
 nvme_namespace_iface_init (UDisksNVMeNamespaceIface *iface)
 {
+  iface->handle_format_namespace = handle_format_namespace;
 }
@@ -33,6 +33,12 @@ GType                udisks_linux_nvme_namespace_get_type (void) G_GNUC_CONST;
 UDisksNVMeNamespace *udisks_linux_nvme_namespace_new      (void);
 void                 udisks_linux_nvme_namespace_update   (UDisksLinuxNVMeNamespace *ns,
                                                            UDisksLinuxBlockObject   *object);
+gboolean             udisks_linux_nvme_namespace_format_sync (UDisksLinuxNVMeNamespace  *ns,
+                                                              uid_t                      caller_uid,
+                                                              guint16                    lba_data_size,
+                                                              guint16                    metadata_size,
+                                                              const gchar               *secure_erase,
+                                                              GError                   **error);
 
 G_END_DECLS
 
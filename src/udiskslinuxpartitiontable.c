@@ -42,6 +42,7 @@
 #include "udiskslinuxdevice.h"
 #include "udiskslinuxblock.h"
 #include "udiskslinuxpartition.h"
+#include "udiskslinuxfsinfo.h"
 #include "udiskssimplejob.h"
 
 /**
@@ -247,94 +248,15 @@ wait_for_partition (UDisksDaemon *daemon,
 
 #define MIB_SIZE (1048576L)
 
-static UDisksObject *
-udisks_linux_partition_table_handle_create_partition (UDisksPartitionTable   *table,
-                                                      GDBusMethodInvocation  *invocation,
-                                                      guint64                 offset,
-                                                      guint64                 size,
-                                                      const gchar            *type,
-                                                      const gchar            *name,
-                                                      GVariant               *options)
+/* Determines whether a primary, extended or logical partition is to be created */
+static gboolean
+determine_part_type (const gchar    *table_type,
+                     const gchar    *type,
+                     const gchar    *name,
+                     const gchar    *partition_type,
+                     BDPartTypeReq  *out_part_type,
+                     GError        **error)
 {
-  const gchar *action_id = NULL;
-  const gchar *message = NULL;
-  UDisksBlock *block = NULL;
-  UDisksObject *object = NULL;
-  UDisksDaemon *daemon = NULL;
-  gchar *device_name = NULL;
-  WaitForPartitionData *wait_data = NULL;
-  UDisksObject *partition_object = NULL;
-  UDisksBlock *partition_block = NULL;
-  BDPartSpec *part_spec = NULL;
-  BDPartSpec *overlapping_part = NULL;
-  BDPartTypeReq part_type = 0;
-  gchar *table_type = NULL;
-  uid_t caller_uid;
-  GError *error = NULL;
-  UDisksBaseJob *job = NULL;
-  const gchar *partition_type = NULL;
-
-  object = udisks_daemon_util_dup_object (table, &error);
-  if (object == NULL)
-    {
-      g_dbus_method_invocation_return_gerror (invocation, error);
-      goto out;
-    }
-
-  daemon = udisks_linux_block_object_get_daemon (UDISKS_LINUX_BLOCK_OBJECT (object));
-
-  g_variant_lookup (options, "partition-type", "&s", &partition_type);
-
-  block = udisks_object_get_block (object);
-  if (block == NULL)
-    {
-      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
-                                             "Partition table object is not a block device");
-      goto out;
-    }
-
-  if (!udisks_daemon_util_get_caller_uid_sync (daemon,
-                                               invocation,
-                                               NULL /* GCancellable */,
-                                               &caller_uid,
-                                               &error))
-    {
-      g_dbus_method_invocation_return_gerror (invocation, error);
-      goto out;
-    }
-
-  action_id = "org.freedesktop.udisks2.modify-device";
-  /* Translators: Shown in authentication dialog when the user
-   * requests creating a new partition.
-   *
-   * Do not translate $(drive), it's a placeholder and
-   * will be replaced by the name of the drive/device in question
-   */
-  message = N_("Authentication is required to create a partition on $(drive)");
-  if (!udisks_daemon_util_setup_by_user (daemon, object, caller_uid))
-    {
-      if (udisks_block_get_hint_system (block))
-        {
-          action_id = "org.freedesktop.udisks2.modify-device-system";
-        }
-      else if (!udisks_daemon_util_on_user_seat (daemon, object, caller_uid))
-        {
-          action_id = "org.freedesktop.udisks2.modify-device-other-seat";
-        }
-    }
-
-  if (!udisks_daemon_util_check_authorization_sync (daemon,
-                                                    object,
-                                                    action_id,
-                                                    options,
-                                                    message,
-                                                    invocation))
-    goto out;
-
-  device_name = g_strdup (udisks_block_get_device (block));
-
-  table_type = udisks_partition_table_dup_type_ (table);
-  wait_data = g_new0 (WaitForPartitionData, 1);
   if (g_strcmp0 (table_type, "dos") == 0)
     {
       char *endp;
@@ -342,68 +264,74 @@ udisks_linux_partition_table_handle_create_partition (UDisksPartitionTable   *ta
 
       if (strlen (name) > 0)
         {
-          g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
-                                                 "MBR partition table does not support names");
-          goto out;
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "MBR partition table does not support names");
+          return FALSE;
         }
 
       type_as_int = strtol (type, &endp, 0);
 
-      /* Determine whether we are creating a primary, extended or logical partition */
       if (partition_type != NULL)
         {
           if (g_strcmp0 (partition_type, "primary") == 0)
             {
-              part_type = BD_PART_TYPE_REQ_NORMAL;
+              *out_part_type = BD_PART_TYPE_REQ_NORMAL;
             }
           else if (g_strcmp0 (partition_type, "extended") == 0)
             {
-              part_type = BD_PART_TYPE_REQ_EXTENDED;
+              *out_part_type = BD_PART_TYPE_REQ_EXTENDED;
             }
           else if (g_strcmp0 (partition_type, "logical") == 0)
             {
-              part_type = BD_PART_TYPE_REQ_LOGICAL;
+              *out_part_type = BD_PART_TYPE_REQ_LOGICAL;
             }
           else
             {
-              g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
-                                                     "Don't know how to create partition of type `%s'",
-                                                     partition_type);
-              goto out;
+              g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                           "Don't know how to create partition of type `%s'",
+                           partition_type);
+              return FALSE;
             }
         }
       else if (type[0] != '\0' && *endp == '\0' &&
                (type_as_int == 0x05 || type_as_int == 0x0f || type_as_int == 0x85))
         {
-          part_type = BD_PART_TYPE_REQ_EXTENDED;
+          *out_part_type = BD_PART_TYPE_REQ_EXTENDED;
         }
       else
-        part_type = BD_PART_TYPE_REQ_NEXT;
+        *out_part_type = BD_PART_TYPE_REQ_NEXT;
     }
   else if (g_strcmp0 (table_type, "gpt") == 0)
     {
-      part_type = BD_PART_TYPE_REQ_NORMAL;
+      *out_part_type = BD_PART_TYPE_REQ_NORMAL;
     }
   else
     {
-      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
-                                             "Don't know how to create partitions this partition table of type `%s'",
-                                             table_type);
-      goto out;
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Don't know how to create partitions this partition table of type `%s'",
+                   table_type);
+      return FALSE;
     }
 
-  job = udisks_daemon_launch_simple_job (daemon,
-                                         UDISKS_OBJECT (object),
-                                         "partition-create",
-                                         caller_uid,
-                                         NULL);
+  return TRUE;
+}
 
-  if (job == NULL)
-    {
-      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
-                                             "Failed to create a job object");
-      goto out;
-    }
+/* Creates the partition, sets its name and type and wipes it, without
+ * waiting for the partition object to show up.
+ */
+static BDPartSpec *
+create_partition (const gchar    *device_name,
+                  const gchar    *table_type,
+                  BDPartTypeReq   part_type,
+                  guint64         offset,
+                  guint64         size,
+                  const gchar    *type,
+                  const gchar    *name,
+                  GError        **error)
+{
+  BDPartSpec *part_spec = NULL;
+  BDPartSpec *overlapping_part = NULL;
+  GError *local_error = NULL;
 
   /* Users might want to specify logical partitions start and size using size of
    * of the extended partition. If this happens we need to shift start (offset)
@@ -414,7 +342,7 @@ udisks_linux_partition_table_handle_create_partition (UDisksPartitionTable   *ta
    *      use case. But we should definitely provide some functionality to get
    *      right "numbers" and stop doing this.
   */
-  overlapping_part = bd_part_get_part_by_pos (device_name, offset, &error);
+  overlapping_part = bd_part_get_part_by_pos (device_name, offset, &local_error);
   if (overlapping_part != NULL && ! (overlapping_part->type & BD_PART_TYPE_FREESPACE))
     {
       /* extended partition or metadata of the extended partition */
@@ -432,39 +360,34 @@ udisks_linux_partition_table_handle_create_partition (UDisksPartitionTable   *ta
       else
         {
           /* overlapping partition is not a free space nor an extended part -> error */
-          g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
-                                                 "Requested start for the new partition %"G_GUINT64_FORMAT" "
-                                                 "overlaps with existing partition %s.",
-                                                  offset, overlapping_part->path);
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Requested start for the new partition %"G_GUINT64_FORMAT" "
+                       "overlaps with existing partition %s.",
+                       offset, overlapping_part->path);
           goto out;
         }
     }
   else
-    g_clear_error (&error);
+    g_clear_error (&local_error);
 
   part_spec = bd_part_create_part (device_name, part_type, offset,
-                                   size, BD_PART_ALIGN_OPTIMAL, &error);
+                                   size, BD_PART_ALIGN_OPTIMAL, &local_error);
   if (!part_spec)
     {
-      g_dbus_method_invocation_return_error (invocation,
-                                             UDISKS_ERROR,
-                                             UDISKS_ERROR_FAILED,
-                                             "Error creating partition on %s: %s",
-                                             udisks_block_get_device (block),
-                                             error->message);
-      udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), FALSE, error->message);
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error creating partition on %s: %s",
+                   device_name, local_error->message);
+      g_clear_error (&local_error);
       goto out;
     }
 
   /* set name if given */
   if (g_strcmp0 (table_type, "gpt") == 0 && strlen (name) > 0)
     {
-      if (!bd_part_set_part_name (device_name, part_spec->path, name, &error))
+      if (!bd_part_set_part_name (device_name, part_spec->path, name, error))
         {
-          g_prefix_error (&error, "Error setting name for newly created partition: ");
-          g_dbus_method_invocation_return_gerror (invocation, error);
-          udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), FALSE, error->message);
-          goto out;
+          g_prefix_error (error, "Error setting name for newly created partition: ");
+          goto fail;
         }
     }
 
@@ -474,40 +397,176 @@ udisks_linux_partition_table_handle_create_partition (UDisksPartitionTable   *ta
       gboolean ret = FALSE;
 
       if (g_strcmp0 (table_type, "gpt") == 0)
-          ret = bd_part_set_part_type (device_name, part_spec->path, type, &error);
+          ret = bd_part_set_part_type (device_name, part_spec->path, type, error);
       else if (g_strcmp0 (table_type, "dos") == 0)
-          ret = bd_part_set_part_id (device_name, part_spec->path, type, &error);
+          ret = bd_part_set_part_id (device_name, part_spec->path, type, error);
 
       if (!ret)
         {
-          g_prefix_error (&error, "Error setting type for newly created partition: ");
-          g_dbus_method_invocation_return_gerror (invocation, error);
-          udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), FALSE, error->message);
-          goto out;
+          g_prefix_error (error, "Error setting type for newly created partition: ");
+          goto fail;
         }
     }
 
   /* wipe the newly created partition if wanted */
   if (part_spec->type != BD_PART_TYPE_EXTENDED)
     {
-      if (!bd_fs_wipe (part_spec->path, TRUE, FALSE, &error))
+      if (!bd_fs_wipe (part_spec->path, TRUE, FALSE, &local_error))
         {
-          if (g_error_matches (error, BD_FS_ERROR, BD_FS_ERROR_NOFS))
-            g_clear_error (&error);
+          if (g_error_matches (local_error, BD_FS_ERROR, BD_FS_ERROR_NOFS))
+            g_clear_error (&local_error);
           else
             {
-              g_dbus_method_invocation_return_error (invocation,
-                                                     UDISKS_ERROR,
-                                                     UDISKS_ERROR_FAILED,
-                                                     "Error wiping newly created partition %s: %s",
-                                                     part_spec->path,
-                                                     error->message);
-              udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), FALSE, error->message);
-              goto out;
+              g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                           "Error wiping newly created partition %s: %s",
+                           part_spec->path, local_error->message);
+              g_clear_error (&local_error);
+              goto fail;
             }
         }
     }
 
+  goto out;
+
+ fail:
+  bd_part_spec_free (part_spec);
+  part_spec = NULL;
+
+ out:
+  if (overlapping_part)
+    bd_part_spec_free (overlapping_part);
+  return part_spec;
+}
+
+static gboolean
+check_create_partition_authorization (UDisksDaemon          *daemon,
+                                      UDisksObject          *object,
+                                      UDisksBlock           *block,
+                                      uid_t                  caller_uid,
+                                      GVariant              *options,
+                                      GDBusMethodInvocation *invocation)
+{
+  const gchar *action_id = NULL;
+  const gchar *message = NULL;
+
+  action_id = "org.freedesktop.udisks2.modify-device";
+  /* Translators: Shown in authentication dialog when the user
+   * requests creating a new partition.
+   *
+   * Do not translate $(drive), it's a placeholder and
+   * will be replaced by the name of the drive/device in question
+   */
+  message = N_("Authentication is required to create a partition on $(drive)");
+  if (!udisks_daemon_util_setup_by_user (daemon, object, caller_uid))
+    {
+      if (udisks_block_get_hint_system (block))
+        {
+          action_id = "org.freedesktop.udisks2.modify-device-system";
+        }
+      else if (!udisks_daemon_util_on_user_seat (daemon, object, caller_uid))
+        {
+          action_id = "org.freedesktop.udisks2.modify-device-other-seat";
+        }
+    }
+
+  if (!udisks_daemon_util_check_authorization_sync (daemon,
+                                                    object,
+                                                    action_id,
+                                                    options,
+                                                    message,
+                                                    invocation))
+    return FALSE;
+
+  return TRUE;
+}
+
+static UDisksObject *
+udisks_linux_partition_table_handle_create_partition (UDisksPartitionTable   *table,
+                                                      GDBusMethodInvocation  *invocation,
+                                                      guint64                 offset,
+                                                      guint64                 size,
+                                                      const gchar            *type,
+                                                      const gchar            *name,
+                                                      GVariant               *options)
+{
+  UDisksBlock *block = NULL;
+  UDisksObject *object = NULL;
+  UDisksDaemon *daemon = NULL;
+  gchar *device_name = NULL;
+  WaitForPartitionData *wait_data = NULL;
+  UDisksObject *partition_object = NULL;
+  UDisksBlock *partition_block = NULL;
+  BDPartSpec *part_spec = NULL;
+  BDPartTypeReq part_type = 0;
+  gchar *table_type = NULL;
+  uid_t caller_uid;
+  GError *error = NULL;
+  UDisksBaseJob *job = NULL;
+  const gchar *partition_type = NULL;
+
+  object = udisks_daemon_util_dup_object (table, &error);
+  if (object == NULL)
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      goto out;
+    }
+
+  daemon = udisks_linux_block_object_get_daemon (UDISKS_LINUX_BLOCK_OBJECT (object));
+
+  g_variant_lookup (options, "partition-type", "&s", &partition_type);
+
+  block = udisks_object_get_block (object);
+  if (block == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                             "Partition table object is not a block device");
+      goto out;
+    }
+
+  if (!udisks_daemon_util_get_caller_uid_sync (daemon,
+                                               invocation,
+                                               NULL /* GCancellable */,
+                                               &caller_uid,
+                                               &error))
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      goto out;
+    }
+
+  if (!check_create_partition_authorization (daemon, object, block, caller_uid, options, invocation))
+    goto out;
+
+  device_name = g_strdup (udisks_block_get_device (block));
+
+  table_type = udisks_partition_table_dup_type_ (table);
+  wait_data = g_new0 (WaitForPartitionData, 1);
+  if (!determine_part_type (table_type, type, name, partition_type, &part_type, &error))
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      goto out;
+    }
+
+  job = udisks_daemon_launch_simple_job (daemon,
+                                         UDISKS_OBJECT (object),
+                                         "partition-create",
+                                         caller_uid,
+                                         NULL);
+
+  if (job == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                             "Failed to create a job object");
+      goto out;
+    }
+
+  part_spec = create_partition (device_name, table_type, part_type, offset, size, type, name, &error);
+  if (!part_spec)
+    {
+      g_dbus_method_invocation_return_gerror (invocation, error);
+      udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), FALSE, error->message);
+      goto out;
+    }
+
   wait_data->ignore_container = (part_spec->type == BD_PART_TYPE_LOGICAL);
   wait_data->pos_to_wait_for = part_spec->start + (part_spec->size / 2L);
 
@@ -556,8 +615,6 @@ udisks_linux_partition_table_handle_create_partition (UDisksPartitionTable   *ta
   g_clear_object (&block);
   if (part_spec)
     bd_part_spec_free (part_spec);
-  if (overlapping_part)
-    bd_part_spec_free (overlapping_part);
   return partition_object;
 }
 
@@ -694,9 +751,503 @@ handle_create_partition_and_format (UDisksPartitionTable   *table,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+typedef struct
+{
+  UDisksObject  *partition_table_object;
+  guint          num_partitions;
+  guint64       *pos_to_wait_for;
+  gboolean      *ignore_container;
+  const gchar  **format_types;
+} WaitForPartitionsData;
+
+/* Waits for all the partitions at once and, if @format_types is set, also for
+ * the filesystems created on them.
+ */
+static UDisksObject **
+wait_for_partitions (UDisksDaemon *daemon,
+                     gpointer      user_data)
+{
+  WaitForPartitionsData *data = user_data;
+  WaitForPartitionData partition_data;
+  UDisksObject **ret = NULL;
+  guint n;
+
+  ret = g_new0 (UDisksObject *, data->num_partitions + 1);
+  partition_data.partition_table_object = data->partition_table_object;
+  for (n = 0; n < data->num_partitions; n++)
+    {
+      partition_data.pos_to_wait_for = data->pos_to_wait_for[n];
+      partition_data.ignore_container = data->ignore_container[n];
+      ret[n] = wait_for_partition (daemon, &partition_data);
+      if (ret[n] == NULL)
+        goto fail;
+
+      if (data->format_types != NULL && data->format_types[n] != NULL)
+        {
+          UDisksBlock *block = udisks_object_peek_block (ret[n]);
+          gchar *id_type;
+
+          if (block == NULL)
+            goto fail;
+
+          id_type = udisks_block_dup_id_type (block);
+          if (g_strcmp0 (id_type, data->format_types[n]) != 0)
+            {
+              g_free (id_type);
+              goto fail;
+            }
+          g_free (id_type);
+
+          /* also wait for the corresponding interface to be exported */
+          if (udisks_linux_block_object_contains_filesystem (ret[n]) &&
+              udisks_object_peek_filesystem (ret[n]) == NULL)
+            goto fail;
+        }
+    }
+
+  return ret;
+
+ fail:
+  for (n = 0; ret[n] != NULL; n++)
+    g_object_unref (ret[n]);
+  g_free (ret);
+  return NULL;
+}
+
+/* Returns where the free region starting at @offset ends, given the
+ * @existing partitions. Used for entries requesting the maximal size.
+ */
+static guint64
+free_region_end (GList   *existing,
+                 guint64  offset,
+                 guint64  device_size)
+{
+  guint64 end = device_size;
+  GList *l;
+
+  for (l = existing; l != NULL; l = l->next)
+    {
+      UDisksPartition *partition = UDISKS_PARTITION (l->data);
+      guint64 part_start = udisks_partition_get_offset (partition);
+      guint64 part_end = part_start + udisks_partition_get_size (partition);
+
+      if (part_start > offset && part_start < end)
+        end = part_start;
+      else if (udisks_partition_get_is_container (partition) &&
+               part_start <= offset && part_end > offset && part_end < end)
+        end = part_end;
+    }
+
+  return end;
+}
+
+/* Checks that the requested partitions fit on the device and overlap neither
+ * each other nor the existing partitions. Logical partitions may of course
+ * overlap with the extended partition containing them.
+ */
+static gboolean
+validate_partitions_layout (UDisksDaemon          *daemon,
+                            UDisksPartitionTable  *table,
+                            guint64                device_size,
+                            GVariant              *partitions,
+                            const BDPartTypeReq   *part_types,
+                            GError               **error)
+{
+  GList *existing;
+  GList *l;
+  guint num_partitions = 0;
+  guint64 *starts;
+  guint64 *ends;
+  guint num_existing;
+  gboolean ret = FALSE;
+  guint n, m;
+
+  existing = udisks_linux_partition_table_get_partitions (daemon, table, &num_existing);
+  num_partitions = g_variant_n_children (partitions);
+  starts = g_new0 (guint64, num_partitions);
+  ends = g_new0 (guint64, num_partitions);
+
+  for (n = 0; n < num_partitions; n++)
+    {
+      guint64 offset;
+      guint64 size;
+
+      g_variant_get_child (partitions, n, "(tt&s&s@a{sv})", &offset, &size, NULL, NULL, NULL);
+      if (offset >= device_size || size > device_size - offset)
+        {
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Partition %u: Requested range %" G_GUINT64_FORMAT "+%" G_GUINT64_FORMAT
+                       " does not fit on the device of size %" G_GUINT64_FORMAT,
+                       n, offset, size, device_size);
+          goto out;
+        }
+
+      starts[n] = offset;
+      ends[n] = size > 0 ? offset + size : free_region_end (existing, offset, device_size);
+
+      for (l = existing; l != NULL; l = l->next)
+        {
+          UDisksPartition *partition = UDISKS_PARTITION (l->data);
+          guint64 part_start = udisks_partition_get_offset (partition);
+          guint64 part_end = part_start + udisks_partition_get_size (partition);
+
+          if (udisks_partition_get_is_container (partition))
+            continue;
+          if (starts[n] < part_end && part_start < ends[n])
+            {
+              g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                           "Partition %u: Requested range %" G_GUINT64_FORMAT "+%" G_GUINT64_FORMAT
+                           " overlaps with existing partition %u",
+                           n, offset, size, udisks_partition_get_number (partition));
+              goto out;
+            }
+        }
+
+      for (m = 0; m < n; m++)
+        {
+          if (part_types[n] == BD_PART_TYPE_REQ_EXTENDED || part_types[m] == BD_PART_TYPE_REQ_EXTENDED)
+            continue;
+          if (starts[n] < ends[m] && starts[m] < ends[n])
+            {
+              g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                           "Partition %u: Requested range %" G_GUINT64_FORMAT "+%" G_GUINT64_FORMAT
+                           " overlaps with partition %u",
+                           n, offset, size, m);
+              goto out;
+            }
+        }
+    }
+
+  ret = TRUE;
+
+ out:
+  g_free (starts);
+  g_free (ends);
+  g_list_free_full (existing, g_object_unref);
+  return ret;
+}
+
+/* Deletes the partitions created by a failed CreatePartitions() call, the
+ * last one first so that logical partitions go before the extended one.
+ */
+static void
+delete_created_partitions (UDisksLinuxBlockObject *object,
+                           const gchar            *device_name,
+                           GPtrArray              *created_paths)
+{
+  GError *error = NULL;
+  guint n;
+
+  for (n = created_paths->len; n > 0; n--)
+    {
+      const gchar *path = g_ptr_array_index (created_paths, n - 1);
+
+      if (!bd_part_delete_part (device_name, path, &error))
+        {
+          udisks_warning ("Error deleting partition %s after failing to create partitions: %s",
+                          path, error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  udisks_linux_block_object_trigger_uevent_sync (object, UDISKS_DEFAULT_WAIT_TIMEOUT);
+}
+
+/* runs in thread dedicated to handling @invocation */
+static gboolean
+handle_create_partitions (UDisksPartitionTable   *table,
+                          GDBusMethodInvocation  *invocation,
+                          GVariant               *partitions,
+                          GVariant               *options)
+{
+  UDisksBlock *block = NULL;
+  UDisksObject *object = NULL;
+  UDisksDaemon *daemon = NULL;
+  gchar *device_name = NULL;
+  gchar *table_type = NULL;
+  WaitForPartitionsData wait_data = { 0 };
+  BDPartTypeReq *part_types = NULL;
+  gchar **format_types = NULL;
+  gchar **format_labels = NULL;
+  GPtrArray *created_paths = NULL;
+  gboolean have_format = FALSE;
+  gboolean success = FALSE;
+  UDisksObject **partition_objects = NULL;
+  gchar **partition_object_paths = NULL;
+  UDisksBaseJob *job = NULL;
+  uid_t caller_uid;
+  GError *error = NULL;
+  guint num_partitions = 0;
+  guint n;
+  int fd;
+
+  /* See handle_create_partition for a motivation of taking the lock.
+   */
+  fd = flock_block_dev (table);
+
+  object = udisks_daemon_util_dup_object (table, &error);
+  if (object == NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  daemon = udisks_linux_block_object_get_daemon (UDISKS_LINUX_BLOCK_OBJECT (object));
+
+  block = udisks_object_get_block (object);
+  if (block == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                             "Partition table object is not a block device");
+      goto out;
+    }
+
+  num_partitions = g_variant_n_children (partitions);
+  if (num_partitions == 0)
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                             "No partitions specified");
+      goto out;
+    }
+
+  if (!udisks_daemon_util_get_caller_uid_sync (daemon,
+                                               invocation,
+                                               NULL /* GCancellable */,
+                                               &caller_uid,
+                                               &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  if (!check_create_partition_authorization (daemon, object, block, caller_uid, options, invocation))
+    goto out;
+
+  device_name = g_strdup (udisks_block_get_device (block));
+  table_type = udisks_partition_table_dup_type_ (table);
+
+  wait_data.partition_table_object = object;
+  wait_data.num_partitions = num_partitions;
+  wait_data.pos_to_wait_for = g_new0 (guint64, num_partitions);
+  wait_data.ignore_container = g_new0 (gboolean, num_partitions);
+  part_types = g_new0 (BDPartTypeReq, num_partitions);
+  format_types = g_new0 (gchar *, num_partitions);
+  format_labels = g_new0 (gchar *, num_partitions);
+  wait_data.format_types = (const gchar **) format_types;
+
+  /* Validate the whole layout before touching the disk */
+  for (n = 0; n < num_partitions; n++)
+    {
+      const gchar *type;
+      const gchar *name;
+      gchar *partition_type = NULL;
+      GVariant *partition_options;
+      gboolean valid;
+
+      g_variant_get_child (partitions, n, "(tt&s&s@a{sv})", NULL, NULL, &type, &name, &partition_options);
+      g_variant_lookup (partition_options, "partition-type", "s", &partition_type);
+      g_variant_lookup (partition_options, "format-type", "s", &format_types[n]);
+      g_variant_lookup (partition_options, "format-label", "s", &format_labels[n]);
+      g_variant_unref (partition_options);
+
+      valid = determine_part_type (table_type, type, name, partition_type, &part_types[n], &error);
+      g_free (partition_type);
+      if (!valid)
+        {
+          g_prefix_error (&error, "Partition %u: ", n);
+          g_dbus_method_invocation_take_error (invocation, error);
+          goto out;
+        }
+
+      if (format_types[n] != NULL)
+        {
+          const FSInfo *fs_info = get_fs_info (format_types[n]);
+
+          if (fs_info == NULL || fs_info->command_create_fs == NULL ||
+              g_strcmp0 (format_types[n], "dos") == 0 ||
+              g_strcmp0 (format_types[n], "gpt") == 0 ||
+              g_strcmp0 (format_types[n], "empty") == 0)
+            {
+              g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_NOT_SUPPORTED,
+                                                     "Partition %u: Creation of file system type %s is not supported",
+                                                     n, format_types[n]);
+              goto out;
+            }
+          if (format_labels[n] != NULL && strstr (fs_info->command_create_fs, "$LABEL") == NULL)
+            {
+              g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_NOT_SUPPORTED,
+                                                     "Partition %u: File system type %s does not support labels",
+                                                     n, format_types[n]);
+              goto out;
+            }
+          have_format = TRUE;
+        }
+    }
+
+  if (!validate_partitions_layout (daemon, table, udisks_block_get_size (block),
+                                   partitions, part_types, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  job = udisks_daemon_launch_simple_job (daemon,
+                                         UDISKS_OBJECT (object),
+                                         "partition-create",
+                                         caller_uid,
+                                         NULL);
+  if (job == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                                             "Failed to create a job object");
+      goto out;
+    }
+
+  /* Create all the partitions first, without waiting for each of them
+   * to appear, so that udev and the daemon only process the final layout.
+   */
+  created_paths = g_ptr_array_new_with_free_func (g_free);
+  for (n = 0; n < num_partitions; n++)
+    {
+      guint64 offset;
+      guint64 size;
+      const gchar *type;
+      const gchar *name;
+      BDPartSpec *part_spec;
+
+      g_variant_get_child (partitions, n, "(tt&s&s@a{sv})", &offset, &size, &type, &name, NULL);
+      part_spec = create_partition (device_name, table_type, part_types[n], offset, size, type, name, &error);
+      if (part_spec == NULL)
+        {
+          g_prefix_error (&error, "Partition %u: ", n);
+          udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), FALSE, error->message);
+          g_dbus_method_invocation_take_error (invocation, error);
+          goto out;
+        }
+
+      g_ptr_array_add (created_paths, g_strdup (part_spec->path));
+      wait_data.ignore_container[n] = (part_spec->type == BD_PART_TYPE_LOGICAL);
+      wait_data.pos_to_wait_for[n] = part_spec->start + (part_spec->size / 2L);
+      g_warn_if_fail (wait_data.pos_to_wait_for[n] > 0);
+      bd_part_spec_free (part_spec);
+    }
+
+  /* See udisks_linux_partition_table_handle_create_partition() for why this
+     is needed, one change event for the whole layout is enough. */
+  udisks_linux_block_object_trigger_uevent_sync (UDISKS_LINUX_BLOCK_OBJECT (object),
+                                                 UDISKS_DEFAULT_WAIT_TIMEOUT);
+
+  /* sit and wait for all the partitions to show up */
+  partition_objects = udisks_daemon_wait_for_objects_sync (daemon,
+                                                           wait_for_partitions,
+                                                           &wait_data,
+                                                           NULL,
+                                                           UDISKS_DEFAULT_WAIT_TIMEOUT,
+                                                           &error);
+  if (partition_objects == NULL)
+    {
+      g_prefix_error (&error, "Error waiting for partitions to appear: ");
+      udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), FALSE, error->message);
+      g_dbus_method_invocation_take_error (invocation, error);
+      goto out;
+    }
+
+  udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), TRUE, NULL);
+
+  if (have_format)
+    {
+      UDisksObject **formatted_objects;
+
+      for (n = 0; n < num_partitions; n++)
+        {
+          if (format_types[n] == NULL)
+            continue;
+
+          if (!udisks_linux_block_mkfs_sync (daemon,
+                                             partition_objects[n],
+                                             format_types[n],
+                                             format_labels[n],
+                                             caller_uid,
+                                             &error))
+            {
+              g_prefix_error (&error, "Partition %u: ", n);
+              g_dbus_method_invocation_take_error (invocation, error);
+              goto out;
+            }
+        }
+
+      /* The mkfs programs may not generate all the uevents we need */
+      for (n = 0; n < num_partitions; n++)
+        if (format_types[n] != NULL)
+          udisks_linux_block_object_trigger_uevent (UDISKS_LINUX_BLOCK_OBJECT (partition_objects[n]));
+
+      formatted_objects = udisks_daemon_wait_for_objects_sync (daemon,
+                                                               wait_for_partitions,
+                                                               &wait_data,
+                                                               NULL,
+                                                               UDISKS_DEFAULT_WAIT_TIMEOUT,
+                                                               &error);
+      if (formatted_objects == NULL)
+        {
+          g_prefix_error (&error, "Error waiting for filesystems after creating: ");
+          g_dbus_method_invocation_take_error (invocation, error);
+          goto out;
+        }
+
+      for (n = 0; n < num_partitions; n++)
+        g_object_unref (partition_objects[n]);
+      g_free (partition_objects);
+      partition_objects = formatted_objects;
+    }
+
+  partition_object_paths = g_new0 (gchar *, num_partitions + 1);
+  for (n = 0; n < num_partitions; n++)
+    partition_object_paths[n] = g_strdup (g_dbus_object_get_object_path (G_DBUS_OBJECT (partition_objects[n])));
+
+  udisks_partition_table_complete_create_partitions (table,
+                                                     invocation,
+                                                     (const gchar *const *) partition_object_paths);
+  success = TRUE;
+
+ out:
+  if (partition_objects != NULL)
+    {
+      for (n = 0; partition_objects[n] != NULL; n++)
+        g_object_unref (partition_objects[n]);
+      g_free (partition_objects);
+    }
+  /* Don't leave a half-created layout behind */
+  if (!success && created_paths != NULL && created_paths->len > 0)
+    delete_created_partitions (UDISKS_LINUX_BLOCK_OBJECT (object), device_name, created_paths);
+  if (created_paths != NULL)
+    g_ptr_array_unref (created_paths);
+  g_strfreev (partition_object_paths);
+  g_free (wait_data.pos_to_wait_for);
+  g_free (wait_data.ignore_container);
+  if (format_types != NULL)
+    for (n = 0; n < num_partitions; n++)
+      g_free (format_types[n]);
+  g_free (format_types);
+  if (format_labels != NULL)
+    for (n = 0; n < num_partitions; n++)
+      g_free (format_labels[n]);
+  g_free (format_labels);
+  g_free (part_types);
+  g_free (table_type);
+  g_free (device_name);
+  g_clear_object (&block);
+  g_clear_object (&object);
+  unflock_block_dev (fd);
+
+  return TRUE; /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 static void
 partition_table_iface_init (UDisksPartitionTableIface *iface)
 {
   iface->handle_create_partition = handle_create_partition;
   iface->handle_create_partition_and_format = handle_create_partition_and_format;
+  iface->handle_create_partitions = handle_create_partitions;
 }
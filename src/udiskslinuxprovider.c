@@ -459,6 +459,7 @@ on_etc_udisks2_dir_monitor_changed (GFileMonitor     *monitor,
                                     gpointer          user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
+  UDisksDaemon *daemon;
 
   if (event_type == G_FILE_MONITOR_EVENT_CREATED ||
       event_type == G_FILE_MONITOR_EVENT_DELETED ||
@@ -467,7 +468,12 @@ on_etc_udisks2_dir_monitor_changed (GFileMonitor     *monitor,
       gchar *filename = g_file_get_basename (file);
       gchar *id = dup_id_from_config_name (filename);
       if (id)
+        {
+          /* only the drive with this id re-reads its configuration */
+          daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
+          udisks_config_manager_invalidate_drive_configuration (udisks_daemon_get_config_manager (daemon), id);
           synthesize_uevent_for_id (provider, id, "change");
+        }
       g_free (id);
       g_free (filename);
     }
@@ -35,6 +35,8 @@
 #include "udisks-daemon-marshal.h"
 #include "udisksdaemon.h"
 #include "udisksdaemonutil.h"
+#include "udisksconfigmanager.h"
+#include "udisksjobscheduler.h"
 
 /**
  * SECTION:udisksspawnedjob
@@ -47,6 +49,21 @@
 
 typedef struct _UDisksSpawnedJobClass   UDisksSpawnedJobClass;
 
+/* Captured output of the child. If the output exceeds the output limit
+ * of the job, only the first and the last bytes are kept: the head is
+ * stored in @data and the tail in the @tail ring buffer. Both are
+ * joined into @data once the child is done.
+ */
+typedef struct
+{
+  GString *data;
+  gchar *tail;
+  gsize tail_pos;
+  gsize tail_len;
+  guint64 total;
+  gboolean finished;
+} OutputCapture;
+
 /**
  * UDisksSpawnedJob:
  *
@@ -86,8 +103,11 @@ struct _UDisksSpawnedJob
   GSource *child_stdout_source;
   GSource *child_stderr_source;
 
-  GString *child_stdout;
-  GString *child_stderr;
+  gsize output_limit;
+  /* whether output_limit was requested explicitly, otherwise the configured limit is used */
+  gboolean output_limit_set;
+  OutputCapture child_stdout;
+  OutputCapture child_stderr;
 };
 
 struct _UDisksSpawnedJobClass
@@ -109,7 +129,8 @@ enum
   PROP_COMMAND_LINE,
   PROP_INPUT_STRING,
   PROP_RUN_AS_UID,
-  PROP_RUN_AS_EUID
+  PROP_RUN_AS_EUID,
+  PROP_OUTPUT_LIMIT
 };
 
 enum
@@ -127,6 +148,8 @@ static gboolean udisks_spawned_job_spawned_job_completed_default (UDisksSpawnedJ
                                                                   GString           *standard_error);
 
 static void udisks_spawned_job_release_resources (UDisksSpawnedJob *job);
+static void output_capture_finish (UDisksSpawnedJob *job,
+                                   OutputCapture    *capture);
 
 G_DEFINE_TYPE_WITH_CODE (UDisksSpawnedJob, udisks_spawned_job, UDISKS_TYPE_BASE_JOB,
                          G_IMPLEMENT_INTERFACE (UDISKS_TYPE_JOB, job_iface_init));
@@ -173,6 +196,10 @@ udisks_spawned_job_get_property (GObject    *object,
       g_value_set_string (value, udisks_spawned_job_get_command_line (job));
       break;
 
+    case PROP_OUTPUT_LIMIT:
+      g_value_set_uint64 (value, job->output_limit);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -211,6 +238,10 @@ udisks_spawned_job_set_property (GObject      *object,
       job->run_as_euid = g_value_get_uint (value);
       break;
 
+    case PROP_OUTPUT_LIMIT:
+      udisks_spawned_job_set_output_limit (job, g_value_get_uint64 (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -231,13 +262,15 @@ emit_completed_with_error_in_idle_cb (gpointer user_data)
   EmitCompletedData *data = user_data;
   gboolean ret;
 
+  output_capture_finish (data->job, &data->job->child_stdout);
+  output_capture_finish (data->job, &data->job->child_stderr);
   g_signal_emit (data->job,
                  signals[SPAWNED_JOB_COMPLETED_SIGNAL],
                  0,
                  data->error,
-                 0,                        /* status */
-                 data->job->child_stdout,  /* standard_output */
-                 data->job->child_stderr,  /* standard_error */
+                 0,                             /* status */
+                 data->job->child_stdout.data,  /* standard_output */
+                 data->job->child_stderr.data,  /* standard_error */
                  &ret);
   g_object_unref (data->job);
   g_clear_error (&(data->error));
@@ -247,7 +280,7 @@ emit_completed_with_error_in_idle_cb (gpointer user_data)
 
 static void
 emit_completed_with_error_in_idle (UDisksSpawnedJob *job,
-                                   GError           *error)
+                                   const GError     *error)
 {
   EmitCompletedData *data;
   GSource *idle_source;
@@ -282,6 +315,113 @@ on_cancelled (GCancellable *cancellable,
   g_clear_error (&error);
 }
 
+static void
+output_capture_store (UDisksSpawnedJob *job,
+                      OutputCapture    *capture,
+                      const gchar      *buf,
+                      gsize             len)
+{
+  gsize head_size;
+  gsize tail_size;
+  gsize n;
+
+  capture->total += len;
+
+  if (job->output_limit == 0)
+    {
+      g_string_append_len (capture->data, buf, len);
+      return;
+    }
+
+  head_size = job->output_limit / 2;
+  tail_size = job->output_limit - head_size;
+
+  if (capture->data->len < head_size)
+    {
+      n = MIN (len, head_size - capture->data->len);
+      g_string_append_len (capture->data, buf, n);
+      buf += n;
+      len -= n;
+    }
+  if (len == 0 || tail_size == 0)
+    return;
+
+  /* only the last tail_size bytes can make it to the ring */
+  if (len > tail_size)
+    {
+      buf += len - tail_size;
+      len = tail_size;
+    }
+
+  if (capture->tail == NULL)
+    capture->tail = g_malloc (tail_size);
+
+  n = MIN (len, tail_size - capture->tail_pos);
+  memcpy (capture->tail + capture->tail_pos, buf, n);
+  memcpy (capture->tail, buf + n, len - n);
+  capture->tail_pos = (capture->tail_pos + len) % tail_size;
+  capture->tail_len = MIN (capture->tail_len + len, tail_size);
+}
+
+static void
+output_capture_append (UDisksSpawnedJob *job,
+                       OutputCapture    *capture,
+                       const gchar      *buf,
+                       gsize             len)
+{
+  if (capture->data == NULL || capture->finished)
+    return;
+
+  output_capture_store (job, capture, buf, len);
+}
+
+/* joins the head and the tail of the output into capture->data */
+static void
+output_capture_finish (UDisksSpawnedJob *job,
+                       OutputCapture    *capture)
+{
+  guint64 omitted;
+  gsize tail_size;
+
+  if (capture->data == NULL || capture->finished)
+    return;
+  capture->finished = TRUE;
+
+  if (capture->tail == NULL)
+    return;
+
+  omitted = capture->total - capture->data->len - capture->tail_len;
+  if (omitted > 0)
+    g_string_append_printf (capture->data, "\n[... %" G_GUINT64_FORMAT " bytes omitted ...]\n", omitted);
+
+  tail_size = job->output_limit - job->output_limit / 2;
+  if (capture->tail_len == tail_size)
+    {
+      /* the ring is full, the oldest byte is at the write position */
+      g_string_append_len (capture->data, capture->tail + capture->tail_pos, tail_size - capture->tail_pos);
+      g_string_append_len (capture->data, capture->tail, capture->tail_pos);
+    }
+  else
+    {
+      g_string_append_len (capture->data, capture->tail, capture->tail_len);
+    }
+
+  g_clear_pointer (&capture->tail, g_free);
+  capture->tail_pos = 0;
+  capture->tail_len = 0;
+}
+
+static void
+output_capture_clear (OutputCapture *capture)
+{
+  if (capture->data != NULL)
+    {
+      g_string_free (capture->data, TRUE);
+      capture->data = NULL;
+    }
+  g_clear_pointer (&capture->tail, g_free);
+}
+
 static gboolean
 read_child_stderr (GIOChannel *channel,
                    GIOCondition condition,
@@ -292,7 +432,7 @@ read_child_stderr (GIOChannel *channel,
   gsize bytes_read = 0;
 
   g_io_channel_read_chars (channel, buf, sizeof buf, &bytes_read, NULL);
-  g_string_append_len (job->child_stderr, buf, bytes_read);
+  output_capture_append (job, &job->child_stderr, buf, bytes_read);
   return TRUE;
 }
 
@@ -306,10 +446,32 @@ read_child_stdout (GIOChannel *channel,
   gsize bytes_read = 0;
 
   g_io_channel_read_chars (channel, buf, sizeof buf, &bytes_read, NULL);
-  g_string_append_len (job->child_stdout, buf, bytes_read);
+  output_capture_append (job, &job->child_stdout, buf, bytes_read);
   return TRUE;
 }
 
+/* reads whatever the child left in the pipe after it exited */
+static void
+read_child_remaining (UDisksSpawnedJob *job,
+                      GIOChannel       *channel,
+                      OutputCapture    *capture)
+{
+  gchar buf[1024];
+  gsize bytes_read;
+
+  if (channel == NULL)
+    return;
+
+  do
+    {
+      bytes_read = 0;
+      if (g_io_channel_read_chars (channel, buf, sizeof buf, &bytes_read, NULL) != G_IO_STATUS_NORMAL)
+        break;
+      output_capture_append (job, capture, buf, bytes_read);
+    }
+  while (bytes_read > 0);
+}
+
 static gboolean
 write_child_stdin (GIOChannel *channel,
                    GIOCondition condition,
@@ -354,22 +516,12 @@ child_watch_cb (GPid     pid,
                 gpointer user_data)
 {
   UDisksSpawnedJob *job = UDISKS_SPAWNED_JOB (user_data);
-  gchar *buf;
-  gsize buf_size;
   gboolean ret;
 
-  buf_size = 0;
-  if (g_io_channel_read_to_end (job->child_stdout_channel, &buf, &buf_size, NULL) == G_IO_STATUS_NORMAL)
-    {
-      g_string_append_len (job->child_stdout, buf, buf_size);
-      g_free (buf);
-    }
-  buf_size = 0;
-  if (g_io_channel_read_to_end (job->child_stderr_channel, &buf, &buf_size, NULL) == G_IO_STATUS_NORMAL)
-    {
-      g_string_append_len (job->child_stderr, buf, buf_size);
-      g_free (buf);
-    }
+  read_child_remaining (job, job->child_stdout_channel, &job->child_stdout);
+  read_child_remaining (job, job->child_stderr_channel, &job->child_stderr);
+  output_capture_finish (job, &job->child_stdout);
+  output_capture_finish (job, &job->child_stderr);
 
   //g_debug ("helper(pid %5d): completed with exit code %d\n", job->child_pid, WEXITSTATUS (status));
 
@@ -380,8 +532,8 @@ child_watch_cb (GPid     pid,
                  0,
                  NULL, /* GError */
                  status,
-                 job->child_stdout,
-                 job->child_stderr,
+                 job->child_stdout.data,
+                 job->child_stderr.data,
                  &ret);
   job->child_pid = 0;
   job->child_watch_source = NULL;
@@ -437,13 +589,28 @@ child_setup (gpointer user_data)
 static void
 udisks_spawned_job_init (UDisksSpawnedJob *job)
 {
-  job->child_stdout = g_string_new (NULL);
-  job->child_stderr = g_string_new (NULL);
+  job->child_stdout.data = g_string_new (NULL);
+  job->child_stderr.data = g_string_new (NULL);
   job->child_stdin_fd = -1;
   job->child_stdout_fd = -1;
   job->child_stderr_fd = -1;
 }
 
+static void
+udisks_spawned_job_constructed (GObject *object)
+{
+  UDisksSpawnedJob *job = UDISKS_SPAWNED_JOB (object);
+  UDisksDaemon *daemon;
+
+  /* use the configured limit unless one was explicitly requested */
+  daemon = udisks_base_job_get_daemon (UDISKS_BASE_JOB (job));
+  if (daemon != NULL && !job->output_limit_set)
+    job->output_limit = udisks_config_manager_get_job_output_limit (udisks_daemon_get_config_manager (daemon));
+
+  if (G_OBJECT_CLASS (udisks_spawned_job_parent_class)->constructed != NULL)
+    G_OBJECT_CLASS (udisks_spawned_job_parent_class)->constructed (object);
+}
+
 static void
 udisks_spawned_job_class_init (UDisksSpawnedJobClass *klass)
 {
@@ -452,6 +619,7 @@ udisks_spawned_job_class_init (UDisksSpawnedJobClass *klass)
   klass->spawned_job_completed = udisks_spawned_job_spawned_job_completed_default;
 
   gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->constructed  = udisks_spawned_job_constructed;
   gobject_class->finalize     = udisks_spawned_job_finalize;
   gobject_class->set_property = udisks_spawned_job_set_property;
   gobject_class->get_property = udisks_spawned_job_get_property;
@@ -521,6 +689,24 @@ udisks_spawned_job_class_init (UDisksSpawnedJobClass *klass)
                                                       G_PARAM_CONSTRUCT_ONLY |
                                                       G_PARAM_STATIC_STRINGS));
 
+  /**
+   * UDisksSpawnedJob:output-limit:
+   *
+   * The maximal number of bytes of standard output and standard error
+   * to keep, each. If the program writes more, only the first and the
+   * last half of the limit is kept. 0 means no limit. If the property
+   * is not set explicitly, the configured job output limit is used.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_OUTPUT_LIMIT,
+                                   g_param_spec_uint64 ("output-limit",
+                                                        "Output Limit",
+                                                        "The maximal size of the captured output",
+                                                        0, G_MAXSIZE, 0,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_STATIC_STRINGS));
+
   /**
    * UDisksSpawnedJob::spawned-job-completed:
    * @job: The #UDisksSpawnedJob emitting the signal.
@@ -622,6 +808,48 @@ udisks_spawned_job_get_command_line (UDisksSpawnedJob *job)
   return job->command_line;
 }
 
+/**
+ * udisks_spawned_job_get_output_limit:
+ * @job: A #UDisksSpawnedJob.
+ *
+ * Gets the maximal number of bytes of output kept by @job.
+ *
+ * Returns: The limit in bytes, 0 if the output is not limited.
+ */
+gsize
+udisks_spawned_job_get_output_limit (UDisksSpawnedJob *job)
+{
+  g_return_val_if_fail (UDISKS_IS_SPAWNED_JOB (job), 0);
+  return job->output_limit;
+}
+
+/**
+ * udisks_spawned_job_set_output_limit:
+ * @job: A #UDisksSpawnedJob.
+ * @limit: The limit in bytes or 0 to keep the whole output.
+ *
+ * Sets the maximal number of bytes of standard output and standard
+ * error that @job keeps. If the program writes more, the first and the
+ * last @limit / 2 bytes are passed to the
+ * #UDisksSpawnedJob::spawned-job-completed signal. This must be called
+ * before the job is started. Unless this is called, the limit from the
+ * <literal>[jobs]</literal> section of the udisks2.conf file is used.
+ */
+void
+udisks_spawned_job_set_output_limit (UDisksSpawnedJob *job,
+                                     gsize             limit)
+{
+  g_return_if_fail (UDISKS_IS_SPAWNED_JOB (job));
+  g_return_if_fail (job->child_pid == 0);
+
+  job->output_limit_set = TRUE;
+  if (job->output_limit == limit)
+    return;
+
+  job->output_limit = limit;
+  g_object_notify (G_OBJECT (job), "output-limit");
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 static void
@@ -817,17 +1045,8 @@ udisks_spawned_job_release_resources (UDisksSpawnedJob *job)
       job->child_pid = 0;
     }
 
-  if (job->child_stdout != NULL)
-    {
-      g_string_free (job->child_stdout, TRUE);
-      job->child_stdout = NULL;
-    }
-
-  if (job->child_stderr != NULL)
-    {
-      g_string_free (job->child_stderr, TRUE);
-      job->child_stderr = NULL;
-    }
+  output_capture_clear (&job->child_stdout);
+  output_capture_clear (&job->child_stderr);
 
   if (job->child_stdin_channel != NULL)
     {
@@ -890,15 +1109,8 @@ udisks_spawned_job_release_resources (UDisksSpawnedJob *job)
     }
 }
 
-/**
- * udisks_spawned_job_start:
- * @job: the job to start
- *
- * Connect to the #UDisksSpawnedJob::spawned-job-completed or
- * #UDisksJob::completed signals to get notified when the job is done.
- *
- * */
-void udisks_spawned_job_start (UDisksSpawnedJob *job)
+static void
+spawn_child (UDisksSpawnedJob *job)
 {
   GError *error;
   gint child_argc;
@@ -908,10 +1120,6 @@ void udisks_spawned_job_start (UDisksSpawnedJob *job)
   struct passwd *pw = NULL;
   int rc;
 
-  job->main_context = g_main_context_get_thread_default ();
-  if (job->main_context != NULL)
-    g_main_context_ref (job->main_context);
-
   /* could already be cancelled */
   error = NULL;
   if (g_cancellable_set_error_if_cancelled (udisks_base_job_get_cancellable (UDISKS_BASE_JOB (job)), &error))
@@ -1075,6 +1283,48 @@ void udisks_spawned_job_start (UDisksSpawnedJob *job)
   g_strfreev (child_argv);
 }
 
+static void
+on_job_admitted (UDisksBaseJob *base_job,
+                 const GError  *error,
+                 gpointer       user_data)
+{
+  UDisksSpawnedJob *job = UDISKS_SPAWNED_JOB (base_job);
+
+  if (error != NULL)
+    emit_completed_with_error_in_idle (job, error);
+  else
+    spawn_child (job);
+}
+
+/**
+ * udisks_spawned_job_start:
+ * @job: the job to start
+ *
+ * Connect to the #UDisksSpawnedJob::spawned-job-completed or
+ * #UDisksJob::completed signals to get notified when the job is done.
+ *
+ * If @job belongs to a daemon, the program is only spawned once the
+ * #UDisksJobScheduler of the daemon lets the job run.
+ *
+ * */
+void udisks_spawned_job_start (UDisksSpawnedJob *job)
+{
+  UDisksDaemon *daemon;
+
+  job->main_context = g_main_context_get_thread_default ();
+  if (job->main_context != NULL)
+    g_main_context_ref (job->main_context);
+
+  daemon = udisks_base_job_get_daemon (UDISKS_BASE_JOB (job));
+  if (daemon != NULL)
+    udisks_job_scheduler_submit (udisks_daemon_get_job_scheduler (daemon),
+                                 UDISKS_BASE_JOB (job),
+                                 on_job_admitted,
+                                 NULL);
+  else
+    spawn_child (job);
+}
+
 /* manage strings with potentially unsafe content */
 
 static gpointer
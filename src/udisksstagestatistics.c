@@ -0,0 +1,198 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+
+#include "udisksstagestatistics.h"
+
+/**
+ * SECTION:udisksstagestatistics
+ * @title: UDisksStageStatistics
+ * @short_description: Aggregated durations of job stages
+ *
+ * The #UDisksStageStatistics collects the durations of the stages of
+ * multi-step operations, such as formatting, over the lifetime of the
+ * daemon. For every stage it keeps the number of samples, their total
+ * and a histogram with power of two buckets: bucket 0 counts the
+ * durations shorter than one millisecond and bucket <literal>n</literal>
+ * the durations of at least 2<superscript>n-1</superscript> and less than
+ * 2<superscript>n</superscript> milliseconds. The last bucket also counts
+ * all the longer durations.
+ */
+
+typedef struct _UDisksStageStatisticsClass UDisksStageStatisticsClass;
+
+typedef struct
+{
+  guint64 count;
+  guint64 total_usec;
+  guint64 buckets[UDISKS_STAGE_STATISTICS_NUM_BUCKETS];
+} StageHistogram;
+
+/**
+ * UDisksStageStatistics:
+ *
+ * The #UDisksStageStatistics structure contains only private data and
+ * should only be accessed using the provided API.
+ */
+struct _UDisksStageStatistics
+{
+  GObject parent_instance;
+
+  GMutex lock;
+  /* "<operation>:<stage>" -> StageHistogram */
+  GHashTable *stages;
+};
+
+struct _UDisksStageStatisticsClass
+{
+  GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (UDisksStageStatistics, udisks_stage_statistics, G_TYPE_OBJECT);
+
+static void
+udisks_stage_statistics_finalize (GObject *object)
+{
+  UDisksStageStatistics *statistics = UDISKS_STAGE_STATISTICS (object);
+
+  g_hash_table_unref (statistics->stages);
+  g_mutex_clear (&statistics->lock);
+
+  G_OBJECT_CLASS (udisks_stage_statistics_parent_class)->finalize (object);
+}
+
+static void
+udisks_stage_statistics_init (UDisksStageStatistics *statistics)
+{
+  g_mutex_init (&statistics->lock);
+  statistics->stages = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+udisks_stage_statistics_class_init (UDisksStageStatisticsClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = udisks_stage_statistics_finalize;
+}
+
+/**
+ * udisks_stage_statistics_new:
+ *
+ * Creates a new, empty #UDisksStageStatistics.
+ *
+ * Returns: A #UDisksStageStatistics. Free with g_object_unref().
+ */
+UDisksStageStatistics *
+udisks_stage_statistics_new (void)
+{
+  return UDISKS_STAGE_STATISTICS (g_object_new (UDISKS_TYPE_STAGE_STATISTICS, NULL));
+}
+
+/**
+ * udisks_stage_statistics_record:
+ * @statistics: A #UDisksStageStatistics.
+ * @operation: The job operation the stage belongs to, e.g. <literal>format</literal>.
+ * @stage: The name of the stage, e.g. <literal>wipe</literal>.
+ * @duration_usec: How long the stage took, in micro-seconds.
+ *
+ * Adds a sample for @stage of @operation.
+ *
+ * This function is thread-safe.
+ */
+void
+udisks_stage_statistics_record (UDisksStageStatistics *statistics,
+                                const gchar           *operation,
+                                const gchar           *stage,
+                                gint64                 duration_usec)
+{
+  StageHistogram *histogram;
+  gchar *key;
+  guint64 msec;
+  guint bucket;
+
+  g_return_if_fail (UDISKS_IS_STAGE_STATISTICS (statistics));
+
+  if (duration_usec < 0)
+    duration_usec = 0;
+
+  /* index of the highest bit set in the number of milliseconds */
+  msec = duration_usec / 1000;
+  for (bucket = 0; msec > 0 && bucket < UDISKS_STAGE_STATISTICS_NUM_BUCKETS - 1; bucket++)
+    msec >>= 1;
+
+  key = g_strdup_printf ("%s:%s", operation, stage);
+
+  g_mutex_lock (&statistics->lock);
+  histogram = g_hash_table_lookup (statistics->stages, key);
+  if (histogram == NULL)
+    {
+      histogram = g_new0 (StageHistogram, 1);
+      g_hash_table_insert (statistics->stages, key, histogram);
+      key = NULL;
+    }
+  histogram->count++;
+  histogram->total_usec += duration_usec;
+  histogram->buckets[bucket]++;
+  g_mutex_unlock (&statistics->lock);
+
+  g_free (key);
+}
+
+/**
+ * udisks_stage_statistics_to_variant:
+ * @statistics: A #UDisksStageStatistics.
+ *
+ * Gets the collected statistics as a dictionary mapping
+ * <literal>operation:stage</literal> to a tuple of the number of samples,
+ * their total duration in micro-seconds and the histogram buckets.
+ *
+ * Returns: (transfer floating): A #GVariant of type <literal>a{s(ttat)}</literal>.
+ */
+GVariant *
+udisks_stage_statistics_to_variant (UDisksStageStatistics *statistics)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+
+  g_return_val_if_fail (UDISKS_IS_STAGE_STATISTICS (statistics), NULL);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s(ttat)}"));
+
+  g_mutex_lock (&statistics->lock);
+  g_hash_table_iter_init (&iter, statistics->stages);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      StageHistogram *histogram = value;
+
+      g_variant_builder_add (&builder, "{s(tt@at)}",
+                             key,
+                             histogram->count,
+                             histogram->total_usec,
+                             g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                                        histogram->buckets,
+                                                        UDISKS_STAGE_STATISTICS_NUM_BUCKETS,
+                                                        sizeof (guint64)));
+    }
+  g_mutex_unlock (&statistics->lock);
+
+  return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,48 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __UDISKS_STAGE_STATISTICS_H__
+#define __UDISKS_STAGE_STATISTICS_H__
+
+#include "udisksdaemontypes.h"
+
+G_BEGIN_DECLS
+
+#define UDISKS_TYPE_STAGE_STATISTICS  (udisks_stage_statistics_get_type ())
+#define UDISKS_STAGE_STATISTICS(o)    (G_TYPE_CHECK_INSTANCE_CAST ((o), UDISKS_TYPE_STAGE_STATISTICS, UDisksStageStatistics))
+#define UDISKS_IS_STAGE_STATISTICS(o) (G_TYPE_CHECK_INSTANCE_TYPE ((o), UDISKS_TYPE_STAGE_STATISTICS))
+
+/**
+ * UDISKS_STAGE_STATISTICS_NUM_BUCKETS:
+ *
+ * Number of buckets of the duration histograms kept by #UDisksStageStatistics.
+ */
+#define UDISKS_STAGE_STATISTICS_NUM_BUCKETS 21
+
+GType                  udisks_stage_statistics_get_type   (void) G_GNUC_CONST;
+UDisksStageStatistics *udisks_stage_statistics_new        (void);
+
+void                   udisks_stage_statistics_record     (UDisksStageStatistics *statistics,
+                                                           const gchar           *operation,
+                                                           const gchar           *stage,
+                                                           gint64                 duration_usec);
+GVariant              *udisks_stage_statistics_to_variant (UDisksStageStatistics *statistics);
+
+G_END_DECLS
+
+#endif /* __UDISKS_STAGE_STATISTICS_H__ */
@@ -28,6 +28,7 @@
 #include "udisksthreadedjob.h"
 #include "udisks-daemon-marshal.h"
 #include "udisksdaemon.h"
+#include "udisksjobscheduler.h"
 
 /**
  * SECTION:udisksthreadedjob
@@ -164,15 +165,12 @@ udisks_threaded_job_set_property (GObject      *object,
 
 
 static gboolean
-job_finish (UDisksThreadedJob  *job,
-            GTask              *task,
-            GError            **error)
+emit_threaded_job_completed (UDisksThreadedJob  *job,
+                             gboolean            job_result,
+                             GError             *job_error,
+                             GError            **error)
 {
   gboolean ret;
-  gboolean job_result;
-  GError *job_error = NULL;
-
-  job_result = g_task_propagate_boolean (task, &job_error);
 
   g_signal_emit (job,
                  signals[THREADED_JOB_COMPLETED_SIGNAL],
@@ -189,6 +187,18 @@ job_finish (UDisksThreadedJob  *job,
   return job_result;
 }
 
+static gboolean
+job_finish (UDisksThreadedJob  *job,
+            GTask              *task,
+            GError            **error)
+{
+  gboolean job_result;
+  GError *job_error = NULL;
+
+  job_result = g_task_propagate_boolean (task, &job_error);
+  return emit_threaded_job_completed (job, job_result, job_error, error);
+}
+
 static void
 job_complete_cb (GObject      *source_object,
                  GAsyncResult *res,
@@ -206,12 +216,19 @@ run_task_job (GTask            *task,
               GCancellable     *cancellable)
 {
   UDisksThreadedJob *job = UDISKS_THREADED_JOB (source_object);
+  UDisksBaseJob *previous_job;
   GError *job_error = NULL;
+  gboolean job_result;
 
   if (g_task_return_error_if_cancelled (task))
     return;
 
-  if (! job->job_func (job, cancellable, job->user_data, &job_error))
+  /* jobs launched by job_func are nested in this one */
+  previous_job = udisks_job_scheduler_enter_job (UDISKS_BASE_JOB (job));
+  job_result = job->job_func (job, cancellable, job->user_data, &job_error);
+  udisks_job_scheduler_leave_job (previous_job);
+
+  if (! job_result)
     {
       g_task_return_error (task, job_error);
       return;
@@ -365,19 +382,20 @@ udisks_threaded_job_new (UDisksThreadedJobFunc  job_func,
                                             NULL));
 }
 
-/**
- * udisks_threaded_job_start:
- * @job: the job to start
- *
- * Start the @job. Connect to the #UDisksThreadedJob::threaded-job-completed or
- * #UDisksJob::completed signals to get notified when the job is done.
- *
- * */
-void
-udisks_threaded_job_start (UDisksThreadedJob *job)
+static void
+on_job_admitted (UDisksBaseJob *base_job,
+                 const GError  *error,
+                 gpointer       user_data)
 {
+  UDisksThreadedJob *job = UDISKS_THREADED_JOB (base_job);
   GTask *task;
 
+  if (error != NULL)
+    {
+      emit_threaded_job_completed (job, FALSE, g_error_copy (error), NULL);
+      return;
+    }
+
   task = g_task_new (job,
                      udisks_base_job_get_cancellable (UDISKS_BASE_JOB (job)),
                      job_complete_cb,
@@ -390,12 +408,89 @@ udisks_threaded_job_start (UDisksThreadedJob *job)
   g_object_unref (task);
 }
 
+/**
+ * udisks_threaded_job_start:
+ * @job: the job to start
+ *
+ * Start the @job. Connect to the #UDisksThreadedJob::threaded-job-completed or
+ * #UDisksJob::completed signals to get notified when the job is done.
+ *
+ * If @job belongs to a daemon, the job function is only run once the
+ * #UDisksJobScheduler of the daemon lets the job run.
+ *
+ * */
+void
+udisks_threaded_job_start (UDisksThreadedJob *job)
+{
+  UDisksDaemon *daemon;
+
+  daemon = udisks_base_job_get_daemon (UDISKS_BASE_JOB (job));
+  if (daemon != NULL)
+    udisks_job_scheduler_submit (udisks_daemon_get_job_scheduler (daemon),
+                                 UDISKS_BASE_JOB (job),
+                                 on_job_admitted,
+                                 NULL);
+  else
+    on_job_admitted (UDISKS_BASE_JOB (job), NULL, NULL);
+}
+
+typedef struct
+{
+  gboolean admitted;
+  GError *error;
+} WaitAdmittedData;
+
+static void
+on_job_admitted_sync (UDisksBaseJob *job,
+                      const GError  *error,
+                      gpointer       user_data)
+{
+  WaitAdmittedData *data = user_data;
+
+  data->admitted = TRUE;
+  if (error != NULL)
+    data->error = g_error_copy (error);
+}
+
+/* iterates a private main context until the scheduler of the daemon lets @job run */
+static gboolean
+wait_admitted_sync (UDisksThreadedJob  *job,
+                    GError            **error)
+{
+  UDisksDaemon *daemon;
+  GMainContext *context;
+  WaitAdmittedData data = { FALSE, NULL };
+
+  daemon = udisks_base_job_get_daemon (UDISKS_BASE_JOB (job));
+  if (daemon == NULL)
+    return TRUE;
+
+  context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+  udisks_job_scheduler_submit (udisks_daemon_get_job_scheduler (daemon),
+                               UDISKS_BASE_JOB (job),
+                               on_job_admitted_sync,
+                               &data);
+  while (!data.admitted)
+    g_main_context_iteration (context, TRUE);
+  g_main_context_pop_thread_default (context);
+  g_main_context_unref (context);
+
+  if (data.error != NULL)
+    {
+      g_propagate_error (error, data.error);
+      return FALSE;
+    }
+  return TRUE;
+}
+
 /**
  * udisks_threaded_job_run_sync:
  * @job: the job to run
  * @error: The #GError set in case of failure
  *
- * Run the @job synchronously.
+ * Run the @job synchronously. If @job belongs to a daemon, this first
+ * waits until the #UDisksJobScheduler of the daemon lets the job run.
  *
  * Connect to the #UDisksThreadedJob::threaded-job-completed or
  * #UDisksJob::completed signals to get notified when the job is done.
@@ -408,6 +503,10 @@ udisks_threaded_job_run_sync (UDisksThreadedJob     *job,
 {
   GTask *task;
   gboolean job_result;
+  GError *queue_error = NULL;
+
+  if (!wait_admitted_sync (job, &queue_error))
+    return emit_threaded_job_completed (job, FALSE, queue_error, error);
 
   task = g_task_new (job,
                      udisks_base_job_get_cancellable (UDISKS_BASE_JOB (job)),
@@ -2319,6 +2319,161 @@ handle_command_power_off (gint        *argc,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static gint opt_benchmark_pbkdf_time = 0;
+static gboolean opt_benchmark_set_default = FALSE;
+static gboolean opt_benchmark_no_user_interaction = FALSE;
+
+static const GOptionEntry command_benchmark_entries[] =
+{
+  { "pbkdf-time", 't', 0, G_OPTION_ARG_INT, &opt_benchmark_pbkdf_time, "Unlock time in milliseconds to compute the PBKDF parameters for", NULL},
+  { "set-default", 0, 0, G_OPTION_ARG_NONE, &opt_benchmark_set_default, "Use the fastest cipher for new encrypted devices", NULL},
+  { "no-user-interaction", 0, 0, G_OPTION_ARG_NONE, &opt_benchmark_no_user_interaction, "Do not authenticate the user if needed", NULL},
+  { NULL }
+};
+
+static gint
+handle_command_benchmark (gint        *argc,
+                          gchar      **argv[],
+                          gboolean     request_completion,
+                          const gchar *completion_cur,
+                          const gchar *completion_prev)
+{
+  gint ret;
+  GOptionContext *o;
+  gchar *s;
+  GVariant *options;
+  GVariantBuilder builder;
+  GVariant *ciphers = NULL;
+  GVariant *pbkdfs = NULL;
+  GVariantIter iter;
+  const gchar *name;
+  guint key_size;
+  gdouble encryption_mbs;
+  gdouble decryption_mbs;
+  guint iterations;
+  guint memory;
+  guint threads;
+  GError *error;
+
+  ret = 1;
+  opt_benchmark_pbkdf_time = 0;
+  opt_benchmark_set_default = FALSE;
+  opt_benchmark_no_user_interaction = FALSE;
+  options = NULL;
+
+  modify_argv0_for_command (argc, argv, "benchmark");
+
+  o = g_option_context_new (NULL);
+  if (request_completion)
+    g_option_context_set_ignore_unknown_options (o, TRUE);
+  g_option_context_set_help_enabled (o, FALSE);
+  g_option_context_set_summary (o, "Measure the performance of ciphers and key derivation functions.");
+  g_option_context_add_main_entries (o,
+                                     command_benchmark_entries,
+                                     NULL /* GETTEXT_PACKAGE*/);
+
+  if (!g_option_context_parse (o, argc, argv, NULL))
+    {
+      if (!request_completion)
+        {
+          s = g_option_context_get_help (o, FALSE, NULL);
+          g_printerr ("%s", s);
+          g_free (s);
+          goto out;
+        }
+    }
+
+  if (request_completion)
+    {
+      list_options (command_benchmark_entries);
+      goto out;
+    }
+
+  if (opt_benchmark_pbkdf_time < 0)
+    {
+      g_printerr ("Invalid PBKDF time %d\n", opt_benchmark_pbkdf_time);
+      goto out;
+    }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  if (opt_benchmark_pbkdf_time > 0)
+    {
+      g_variant_builder_add (&builder,
+                             "{sv}",
+                             "pbkdf-time", g_variant_new_uint32 (opt_benchmark_pbkdf_time));
+    }
+  if (opt_benchmark_set_default)
+    {
+      g_variant_builder_add (&builder,
+                             "{sv}",
+                             "set-default", g_variant_new_boolean (TRUE));
+    }
+  if (opt_benchmark_no_user_interaction)
+    {
+      g_variant_builder_add (&builder,
+                             "{sv}",
+                             "auth.no_user_interaction", g_variant_new_boolean (TRUE));
+    }
+  options = g_variant_builder_end (&builder);
+  g_variant_ref_sink (options);
+
+  /* the benchmark takes longer than the default D-Bus timeout on slow machines */
+  g_dbus_proxy_set_default_timeout (G_DBUS_PROXY (udisks_client_get_manager (client)), 5 * 60 * 1000);
+
+ try_again:
+  error = NULL;
+  if (!udisks_manager_call_benchmark_encryption_sync (udisks_client_get_manager (client),
+                                                      options,
+                                                      &ciphers,
+                                                      &pbkdfs,
+                                                      NULL,                       /* GCancellable */
+                                                      &error))
+    {
+      if (error->domain == UDISKS_ERROR &&
+          error->code == UDISKS_ERROR_NOT_AUTHORIZED_CAN_OBTAIN &&
+          setup_local_polkit_agent ())
+        {
+          g_clear_error (&error);
+          goto try_again;
+        }
+      g_dbus_error_strip_remote_error (error);
+      g_printerr ("Error running benchmark: %s (%s, %d)\n",
+                  error->message, g_quark_to_string (error->domain), error->code);
+      g_clear_error (&error);
+      goto out;
+    }
+
+  g_print ("# Tests are approximate using memory only (no storage IO).\n");
+  g_variant_iter_init (&iter, pbkdfs);
+  while (g_variant_iter_next (&iter, "(&suuu)", &name, &iterations, &memory, &threads))
+    {
+      if (memory == 0)
+        g_print ("%-16s %8u iterations\n", name, iterations);
+      else
+        g_print ("%-16s %8u iterations, %u KiB memory, %u parallel threads\n",
+                 name, iterations, memory, threads);
+    }
+
+  g_print ("#%26s | %6s | %15s | %15s\n", "Algorithm", "Key", "Encryption", "Decryption");
+  g_variant_iter_init (&iter, ciphers);
+  while (g_variant_iter_next (&iter, "(&sudd)", &name, &key_size, &encryption_mbs, &decryption_mbs))
+    g_print ("%27s   %5ub   %10.1f MiB/s   %10.1f MiB/s\n", name, key_size, encryption_mbs, decryption_mbs);
+
+  ret = 0;
+
+ out:
+  if (options != NULL)
+    g_variant_unref (options);
+  if (ciphers != NULL)
+    g_variant_unref (ciphers);
+  if (pbkdfs != NULL)
+    g_variant_unref (pbkdfs);
+  g_option_context_free (o);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 static gchar *opt_info_object = NULL;
 static gchar *opt_info_device = NULL;
 static gchar *opt_info_drive = NULL;
@@ -3166,6 +3321,7 @@ usage (gint *argc, gchar **argv[], gboolean use_stdout)
                        "  loop-delete     Delete a loop device\n"
                        "  power-off       Safely power off a drive\n"
                        "  smart-simulate  Set SMART data for a drive\n"
+                       "  benchmark       Measure encryption performance\n"
                        "\n"
                        "Use \"%s COMMAND --help\" to get help on each command.\n",
                        program_name);
@@ -3377,6 +3533,15 @@ main (int argc,
                                       completion_prev);
       goto out;
     }
+  else if (g_strcmp0 (command, "benchmark") == 0)
+    {
+      ret = handle_command_benchmark (&argc,
+                                      &argv,
+                                      request_completion,
+                                      completion_cur,
+                                      completion_prev);
+      goto out;
+    }
   else if (g_strcmp0 (command, "dump") == 0)
     {
       ret = handle_command_dump (&argc,
@@ -3484,6 +3649,7 @@ main (int argc,
                    "loop-delete \n"
                    "power-off \n"
                    "smart-simulate \n"
+                   "benchmark \n"
                    );
           ret = 0;
           goto out;